@@ -207,6 +207,7 @@ OBJS    =   $(addprefix $(OBJ)/,    \
             ddp.o                   \
             deadstart.o             \
             device.o                \
+            disk_io.o               \
             dsa311.o                \
             dump.o                  \
             float.o                 \
@@ -244,13 +245,16 @@ OBJS    =   $(addprefix $(OBJ)/,    \
             operator.o              \
             pci_channel_linux.o     \
             pci_console_linux.o     \
+            persist.o               \
             pp.o                    \
             rtc.o                   \
             scr_channel.o           \
             shift.o                 \
+            tap_index.o             \
             time.o                  \
             tpmux.o                 \
             trace.o                 \
+            trace_format.o          \
             window_x11.o            \
 			)
 
@@ -0,0 +1,113 @@
+#!/usr/bin/env node
+//
+// Simulate a number of PLATO terminals connected to the NIU of DtCyber and
+// measure the time from a key press until the first output arrives back at
+// the terminal.
+//
+// Usage:
+//   node niu-load.js [-h host] [-p port] [-n count] [-i interval] [-d duration] [-k key]
+//
+//   -h host      host name or address of DtCyber (default localhost)
+//   -p port      NIU TCP port (default 5004)
+//   -n count     number of terminals to simulate (default 100)
+//   -i interval  milliseconds between key presses of a terminal (default 1000)
+//   -d duration  seconds to run (default 60)
+//   -k key       octal PLATO key code to press (default 026, NEXT)
+//
+const net = require("net");
+
+const options = {
+  host:     "localhost",
+  port:     5004,
+  count:    100,
+  interval: 1000,
+  duration: 60,
+  key:      0o26
+};
+
+const args = process.argv.slice(2);
+while (args.length > 0) {
+  const opt = args.shift();
+  const val = args.shift();
+  switch (opt) {
+  case "-h": options.host     = val;               break;
+  case "-p": options.port     = parseInt(val);     break;
+  case "-n": options.count    = parseInt(val);     break;
+  case "-i": options.interval = parseInt(val);     break;
+  case "-d": options.duration = parseInt(val);     break;
+  case "-k": options.key      = parseInt(val, 8);  break;
+  default:
+    process.stderr.write(`Unrecognized option: ${opt}\n`);
+    process.exit(1);
+  }
+}
+
+//
+// A key press is sent as two bytes: the upper three bits of the 10 bit key
+// code, then 0200 plus the lower seven bits.
+//
+const keyBytes = Buffer.from([(options.key >> 7) & 0o7, 0o200 | (options.key & 0o177)]);
+
+const latencies = [];
+const terminals = [];
+let connected   = 0;
+let failed      = 0;
+
+const press = term => {
+  if (term.pressedAt === 0) {
+    term.pressedAt = process.hrtime.bigint();
+    term.socket.write(keyBytes);
+  }
+};
+
+const startTerminal = id => {
+  const term = { id: id, pressedAt: 0, timer: null };
+  term.socket = net.createConnection({ host: options.host, port: options.port }, () => {
+    connected += 1;
+    term.socket.setNoDelay(true);
+    //
+    // Spread the key presses of the terminals evenly over the interval.
+    //
+    setTimeout(() => {
+      term.timer = setInterval(() => press(term), options.interval);
+    }, Math.floor(Math.random() * options.interval));
+  });
+  term.socket.on("data", () => {
+    if (term.pressedAt !== 0) {
+      latencies.push(Number(process.hrtime.bigint() - term.pressedAt) / 1e6);
+      term.pressedAt = 0;
+    }
+  });
+  term.socket.on("error", err => {
+    failed += 1;
+    process.stderr.write(`Terminal ${id}: ${err.message}\n`);
+  });
+  term.socket.on("close", () => {
+    if (term.timer !== null) clearInterval(term.timer);
+  });
+  terminals.push(term);
+};
+
+const percentile = (sorted, p) => {
+  if (sorted.length < 1) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p / 100))];
+};
+
+for (let i = 0; i < options.count; i++) {
+  startTerminal(i);
+}
+
+setTimeout(() => {
+  for (const term of terminals) {
+    if (term.timer !== null) clearInterval(term.timer);
+    term.socket.destroy();
+  }
+  const sorted = latencies.sort((a, b) => a - b);
+  const mean   = sorted.reduce((sum, v) => sum + v, 0) / Math.max(1, sorted.length);
+  console.log(`Terminals: ${connected} connected, ${failed} failed`);
+  console.log(`Key presses answered: ${sorted.length}`);
+  console.log(`Latency (ms): mean ${mean.toFixed(2)}, p50 ${percentile(sorted, 50).toFixed(2)}, `
+    + `p90 ${percentile(sorted, 90).toFixed(2)}, p99 ${percentile(sorted, 99).toFixed(2)}, `
+    + `max ${percentile(sorted, 100).toFixed(2)}`);
+  process.exit(0);
+}, options.duration * 1000);
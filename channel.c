@@ -65,17 +65,18 @@
 **  Public Variables
 **  ----------------
 */
-ChSlot  *channel;
-ChSlot  *activeChannel;
-DevSlot *activeDevice;
-u8      channelCount;
+ChSlot              *channel;
+ThreadLocal ChSlot  *activeChannel;
+ThreadLocal DevSlot *activeDevice;
+u8                  channelCount;
 
 /*
 **  -----------------
 **  Private Variables
 **  -----------------
 */
-static u8 ch = 0;
+static u8  ch = 0;
+static u32 delayedChannels = 0;     /* one bit per channel with a pending delay */
 
 /*
  **--------------------------------------------------------------------------
@@ -345,6 +346,11 @@ void channelTerminate(void)
 #pragma warning(pop)
     u8 i;
 
+    /*
+    **  Complete queued disk container I/O before any file is closed.
+    */
+    diskIoDrain();
+
     /*
     **  Give some devices a chance to cleanup and free allocated memory of all
     **  devices hanging of this channel.
@@ -358,6 +364,16 @@ void channelTerminate(void)
                 dcc6681Terminate(dp);
                 }
 
+            if (dp->devType == DtDd6603)
+                {
+                dd6603Terminate(dp);
+                }
+
+            if (dp->devType == DtDd8xx)
+                {
+                dd8xxTerminate(dp);
+                }
+
             if (dp->devType == DtMt669)
                 {
                 mt669Terminate(dp);
@@ -507,7 +523,8 @@ void channelFunction(PpWord funcCode)
     {
     FcStatus status = FcDeclined;
 
-    activeChannel->full = FALSE;
+    activeChannel->events += 1;
+    activeChannel->full    = FALSE;
     for (activeDevice = activeChannel->firstDevice; activeDevice != NULL; activeDevice = activeDevice->next)
         {
         status = activeDevice->func(funcCode);
@@ -552,7 +569,8 @@ void channelFunction(PpWord funcCode)
 **------------------------------------------------------------------------*/
 void channelActivate(void)
     {
-    activeChannel->active = TRUE;
+    activeChannel->active  = TRUE;
+    activeChannel->events += 1;
 
     if (activeChannel->ioDevice != NULL)
         {
@@ -571,7 +589,8 @@ void channelActivate(void)
 **------------------------------------------------------------------------*/
 void channelDisconnect(void)
     {
-    activeChannel->active = FALSE;
+    activeChannel->active  = FALSE;
+    activeChannel->events += 1;
 
     if (activeChannel->ioDevice != NULL)
         {
@@ -710,7 +729,8 @@ void channelSetFull(void)
             }
         }
 
-    activeChannel->full = TRUE;
+    activeChannel->full    = TRUE;
+    activeChannel->events += 1;
     }
 
 /*--------------------------------------------------------------------------
@@ -732,11 +752,48 @@ void channelSetEmpty(void)
             }
         }
 
-    activeChannel->full = FALSE;
+    activeChannel->full    = FALSE;
+    activeChannel->events += 1;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Delay the next change of empty/full status of the
+**                  active channel.
+**
+**  Parameters:     Name        Description.
+**                  cycles      number of major cycles to delay
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void channelDelayStatus(u8 cycles)
+    {
+    activeChannel->delayStatus = cycles;
+    delayedChannels           |= 1U << activeChannel->id;
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Handle delayed channel disconnect.
+**  Purpose:        Disconnect the active channel after a delay.
+**
+**  Parameters:     Name        Description.
+**                  cycles      number of major cycles to delay
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void channelDelayDisconnect(u8 cycles)
+    {
+    activeChannel->delayDisconnect = cycles;
+    delayedChannels               |= 1U << activeChannel->id;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Handle delayed channel status and disconnect.
+**
+**                  Only channels registered through channelDelayStatus or
+**                  channelDelayDisconnect are visited. A delay cancelled
+**                  by clearing its counter drops the channel from the set
+**                  on the next call.
 **
 **  Parameters:     Name        Description.
 **
@@ -746,13 +803,20 @@ void channelSetEmpty(void)
 void channelStep(void)
     {
     ChSlot *cc;
+    u32    pending;
+    u8     i;
 
     /*
     **  Process any delayed disconnects.
     */
-    for (ch = 0; ch < channelCount; ch++)
+    for (i = 0, pending = delayedChannels; pending != 0; i++, pending >>= 1)
         {
-        cc = &channel[ch];
+        if ((pending & 1) == 0)
+            {
+            continue;
+            }
+
+        cc = &channel[i];
         if (cc->delayDisconnect != 0)
             {
             cc->delayDisconnect -= 1;
@@ -760,6 +824,7 @@ void channelStep(void)
                 {
                 cc->active         = FALSE;
                 cc->discAfterInput = FALSE;
+                cc->events        += 1;
                 }
             }
 
@@ -767,6 +832,11 @@ void channelStep(void)
             {
             cc->delayStatus -= 1;
             }
+
+        if ((cc->delayDisconnect == 0) && (cc->delayStatus == 0))
+            {
+            delayedChannels &= ~(1U << i);
+            }
         }
     }
 
@@ -0,0 +1,263 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: channelbench.c
+**
+**  Description:
+**      Microbenchmark of the per major cycle channel work. channelStep()
+**      of channel.c, which only visits channels with a pending delay, is
+**      timed against a scan of every channel as channelStep() did before,
+**      with all 32 channels configured and delays started at different
+**      rates.
+**
+**      Usage: channelbench [<major cycles>]
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+#define DefaultCycles    50000000
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static double channelBenchRun(void (*step)(void), u32 cycles, u32 interval);
+static void channelBenchScan(void);
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+static const u32 intervals[] = { 0, 1000, 100, 10 };
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Time the channel work of a major cycle.
+**
+**  Parameters:     Name        Description.
+**                  argc        argument count
+**                  argv        number of major cycles per measurement
+**
+**  Returns:        0.
+**
+**------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+    {
+    u32 cycles = DefaultCycles;
+    u32 i;
+
+    if (argc > 1)
+        {
+        cycles = (u32)strtoul(argv[1], NULL, 10);
+        }
+
+    channelInit(MaxChannels);
+
+    printf("(channelbench) %u major cycles, %d channels\n", cycles, channelCount);
+    printf("(channelbench) delay started every   scan all   pending set  (ns per major cycle)\n");
+    for (i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++)
+        {
+        if (intervals[i] == 0)
+            {
+            printf("(channelbench)              never");
+            }
+        else
+            {
+            printf("(channelbench) %11u cycles", intervals[i]);
+            }
+
+        printf("  %9.2f  %11.2f\n",
+               channelBenchRun(channelBenchScan, cycles, intervals[i]),
+               channelBenchRun(channelStep, cycles, intervals[i]));
+        }
+
+    return (0);
+    }
+
+/*
+**  The emulator's device terminate functions are not part of the
+**  benchmark.
+*/
+void cciHipTerminate(DevSlot *dp)
+    {
+    }
+
+void dcc6681Terminate(DevSlot *dp)
+    {
+    }
+
+void dd6603Terminate(DevSlot *dp)
+    {
+    }
+
+void dd8xxTerminate(DevSlot *dp)
+    {
+    }
+
+void diskIoDrain(void)
+    {
+    }
+
+void mt669Terminate(DevSlot *dp)
+    {
+    }
+
+void mt679Terminate(DevSlot *dp)
+    {
+    }
+
+void opDisplay(char *msg)
+    {
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Run a channel step function for a number of major
+**                  cycles, starting a delay on the next channel in turn
+**                  every <interval> cycles, alternating between status
+**                  and disconnect delays like the tape drivers use them.
+**
+**  Parameters:     Name        Description.
+**                  step        channel step function
+**                  cycles      number of major cycles
+**                  interval    cycles between delays, 0 for none
+**
+**  Returns:        Nanoseconds per major cycle.
+**
+**------------------------------------------------------------------------*/
+static double channelBenchRun(void (*step)(void), u32 cycles, u32 interval)
+    {
+    struct timespec start;
+    struct timespec end;
+    u32             countdown = interval;
+    u32             delays    = 0;
+    u32             n;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < cycles; n++)
+        {
+        if ((interval != 0) && (--countdown == 0))
+            {
+            countdown     = interval;
+            activeChannel = channel + (delays % channelCount);
+            if ((delays & 1) == 0)
+                {
+                channelDelayStatus(5);
+                }
+            else
+                {
+                channelDelayDisconnect(3);
+                }
+
+            delays += 1;
+            }
+
+        step();
+        }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / cycles);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Reference: count down the delays of every channel,
+**                  as channelStep() did before it kept a pending set.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void channelBenchScan(void)
+    {
+    ChSlot *cc;
+    u8     i;
+
+    for (i = 0; i < channelCount; i++)
+        {
+        cc = &channel[i];
+        if (cc->delayDisconnect != 0)
+            {
+            cc->delayDisconnect -= 1;
+            if (cc->delayDisconnect == 0)
+                {
+                cc->active         = FALSE;
+                cc->discAfterInput = FALSE;
+                cc->events        += 1;
+                }
+            }
+
+        if (cc->delayStatus != 0)
+            {
+            cc->delayStatus -= 1;
+            }
+        }
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
@@ -610,6 +610,15 @@ static void consoleIo(void)
         break;
 
     case Fc6612SelKeyIn:
+        /*
+        **  The keyboard is polled once per display refresh cycle, so
+        **  this is where a complete frame is handed to the window.
+        */
+        if (isConsoleWindowOpen)
+            {
+            windowFrameEnd();
+            }
+
         consoleCheckDisplayCycle();
         activeChannel->data   = 0;
         activeChannel->full   = TRUE;
@@ -213,6 +213,40 @@
 #define TraceCpu                   (1 << 30)
 #define TraceExchange              (1 << 29)
 
+/*
+**  Binary trace record types.
+*/
+#define TraceRecPpStart            1
+#define TraceRecPpEnd              2
+#define TraceRecCpuOp              3
+#define TraceRecCpuStop            4
+#define TraceRecExchange           5
+
+/*
+**  Channel status bits of a PP end record.
+*/
+#define TraceChActive              0x01
+#define TraceChFull                0x02
+#define TraceChDevice              0x04
+#define TraceChValid               0x08
+
+/*
+**  Exchange package layout in binary trace records.
+*/
+#define TraceExchangeParts         4
+#define TraceExchangeValues        12
+
+/*
+**  Binary trace unit types and trigger conditions.
+*/
+#define TraceUnitCpu               1
+#define TraceUnitPp                2
+
+#define TraceTriggerExit           0x01
+#define TraceTriggerStop           0x02
+#define TraceTriggerFunction       0x04
+#define TraceTriggerManual         0x08
+
 /*
 **  Sign extension and overflow.
 */
@@ -42,7 +42,10 @@
 #if defined(_WIN32)
 #include <windows.h>
 #else
+#include <fcntl.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #endif
 
@@ -69,6 +72,34 @@
 #define EcsBankSize            (131072 - 5120)
 #define EsmBankSize            131072
 
+/*
+**  Number of entries in the per-CPU predecoded instruction word cache
+**  (must be a power of 2).
+*/
+#define DecodeCacheSize        8192
+
+/*
+**  Number of superblocks in the per-CPU block cache of the threaded engine
+**  (must be a power of 2) and maximum number of instruction words per block.
+*/
+#define BlockCacheSize         1024
+#define MaxBlockWords          16
+
+/*
+**  Number of 4 bit flag registers of the 865/875 ESM side door, and
+**  offset of the ECS words within a shared ECS segment (the flag
+**  registers are kept in front of them).
+*/
+#define EcsFlagRegisters       16384
+#define EcsSharedOffset        (((sizeof(EcsFlags) + 4095) / 4096) * 4096)
+
+/*
+**  States of the exchange request slot (CpuContext.ppRequestingExchange)
+**  other than the number of a PP whose exchange request is posted.
+*/
+#define ExchangeIdle           (-1)
+#define ExchangeClaimed        (-2)
+
 /*
 **  -----------------------
 **  Private Macro Functions
@@ -86,40 +117,136 @@ typedef struct opDispatch
     u8 length;
     } OpDispatch;
 
+/*
+**  One predecoded instruction parcel. Parcels are indexed by their
+**  starting bit offset within the instruction word: slot 0 starts at
+**  bit 60, slot 1 at bit 45, slot 2 at bit 30 and slot 3 at bit 15.
+*/
+typedef struct cpuDecodedParcel
+    {
+    void (*execute)(CpuContext *activeCpu); /* handler, NULL if invalid packing */
+    u32 opAddress;                          /* K field (18 bits) */
+    u8  opFm;                               /* opcode field */
+    u8  opI;                                /* I field */
+    u8  opJ;                                /* J field */
+    u8  opK;                                /* K field (3 bits) */
+    u8  length;                             /* 15 or 30, 0 if no parcel starts here */
+    } CpuDecodedParcel;
+
+/*
+**  Predecoded instruction word. An entry is only used when both its absolute
+**  address and its 60 bit contents match the word just fetched, so stores into
+**  CM by any agent (CPU, PP, ECS/UEM transfer, CMU move, exchange jump) can
+**  never cause a stale decode to be executed.
+*/
+typedef struct cpuDecodedWord
+    {
+    CpWord           opWord;                /* instruction word */
+    u32              location;              /* absolute CM address */
+    bool             isValid;               /* TRUE if entry has been filled */
+    CpuDecodedParcel parcels[4];
+    } CpuDecodedWord;
+
+/*
+**  One instruction of a superblock, with the handler to call directly and
+**  the value of opOffset once the instruction has been taken from the word.
+*/
+typedef struct cpuThreadedOp
+    {
+    void (*execute)(CpuContext *activeCpu); /* handler */
+    u32 opAddress;                          /* K field (18 bits) */
+    u8  opFm;                               /* opcode field */
+    u8  opI;                                /* I field */
+    u8  opJ;                                /* J field */
+    u8  opK;                                /* K field (3 bits) */
+    u8  offset;                             /* opOffset after this instruction */
+    } CpuThreadedOp;
+
+/*
+**  One instruction word of a superblock. Like a predecoded word it is only
+**  executed when its absolute address and its contents match the word just
+**  fetched. Each entry is complete in itself, and the entry following one
+**  which does not end the block was always written together with it.
+*/
+typedef struct cpuBlockWord
+    {
+    CpWord        opWord;                   /* instruction word */
+    u32           location;                 /* absolute CM address */
+    bool          isLast;                   /* TRUE if the block ends here */
+    CpuThreadedOp ops[4];
+    } CpuBlockWord;
+
+/*
+**  Superblock: straight line instruction words starting at an absolute CM
+**  address, ending with the first word holding a jump, return jump, exchange
+**  jump or other 00 - 07 instruction.
+*/
+typedef struct cpuBlock
+    {
+    u32          location;                  /* absolute CM address of first word */
+    u8           wordCount;                 /* number of words, 0 if unused */
+    CpuBlockWord words[MaxBlockWords];
+    } CpuBlock;
+
+/*
+**  ECS flag registers. When ECS is shared between several emulators the
+**  flag registers live in the shared segment and are only changed by
+**  atomic compare and swap, so they are coherent across processes.
+*/
+typedef struct ecsFlags
+    {
+    AtomicInt flagRegister;                         /* 18 bit ECS flag register */
+    AtomicInt flagRegisters16K[EcsFlagRegisters];   /* 16K x 4 bit ESM flag registers */
+    } EcsFlags;
+
 /*
 **  ---------------------------
 **  Private Function Prototypes
 **  ---------------------------
 */
 static void cpuCreateThread(int cpuNum);
+static int  cpuAtomicLoad(AtomicInt *ap);
+static void cpuAtomicStore(AtomicInt *ap, int value);
+static bool cpuAtomicSwap(AtomicInt *ap, int expected, int value);
+static CpWord *cpuMapSharedEcs(char *name, u32 words);
+static void cpuUnmapSharedEcs(void);
+static bool cpuClaimMonitor(CpuContext *activeCpu);
+static int  cpuLockExchange(CpuContext *activeCpu);
 
 #if defined(_WIN32)
 static void cpuThread(void *param);
-static void cpuAcquireMutex(HANDLE *mutexp);
-static void cpuReleaseMutex(HANDLE *mutexp);
 
 #else
 static void *cpuThread(void *param);
-static void cpuAcquireMutex(pthread_mutex_t *mutexp);
-static void cpuReleaseMutex(pthread_mutex_t *mutexp);
 
 #endif
 
 static u32  cpuAdd18(u32 op1, u32 op2);
 static u32  cpuAdd24(u32 op1, u32 op2);
 static u32  cpuAddRa(CpuContext *activeCpu, u32 op);
+static void cpuBlockCopy(CpWord *dst, CpWord *src, u32 count);
+static u32  cpuCmuCharsInRange(CpuContext *activeCpu, u32 address, u32 pos);
+static bool cpuCmuCompare(CpuContext *activeCpu, u32 k1, u32 c1, u32 k2, u32 c2, u32 ll, bool isCollated, CpWord *result);
 static void cpuCmuCompareCollated(CpuContext *activeCpu);
 static void cpuCmuCompareUncollated(CpuContext *activeCpu);
+static CpWord cpuCmuFetchChars(CpuContext *activeCpu, u32 address, u32 pos);
 static bool cpuCmuGetByte(CpuContext *activeCpu, u32 address, u32 pos, u8 *byte);
+static bool cpuCmuMove(CpuContext *activeCpu, u32 k1, u32 c1, u32 k2, u32 c2, u32 ll);
 static void cpuCmuMoveDirect(CpuContext *activeCpu);
 static void cpuCmuMoveIndirect(CpuContext *activeCpu);
 static bool cpuCmuPutByte(CpuContext *activeCpu, u32 address, u32 pos, u8 byte);
+static CpuBlockWord *cpuBuildBlock(CpuContext *activeCpu);
+static CpuDecodedWord *cpuDecodeOpWord(CpuContext *activeCpu);
 static void cpuEcsTransfer(CpuContext *activeCpu, bool writeToEcs);
 static void cpuEcsWord(CpuContext *activeCpu, bool writeToEcs);
 static void cpuExchangeJump(CpuContext *activeCpu, u32 address, bool doChangeMode);
+static void cpuExecuteBlockWord(CpuContext *activeCpu);
+static void cpuExecuteParcels(CpuContext *activeCpu, CpuDecodedWord *dw);
+static void cpuExecuteWord(CpuContext *activeCpu);
 static void cpuFetchOpWord(CpuContext *activeCpu);
 static void cpuFloatCheck(CpuContext *activeCpu, CpWord value);
 static void cpuFloatExceptionHandler(CpuContext *activeCpu);
+static void cpuLoadOpWord(CpuContext *activeCpu, u32 location);
 static void cpuOpIllegal(CpuContext *activeCpu);
 static bool cpuReadMem(CpuContext *activeCpu, u32 address, CpWord *data);
 static void cpuRegASemantics(CpuContext *activeCpu);
@@ -206,6 +333,9 @@ CpuContext   *cpus;
 u32          extMaxMemory;
 CpWord       *extMem;
 ExtMemory    extMemType = ECS;
+char         ecsSharedName[64];
+volatile bool cpuDecodeCacheEnabled = TRUE;
+CpuEngine    cpuEngine = CpuEngineClassic;
 
 /*
 **  -----------------
@@ -215,10 +345,15 @@ ExtMemory    extMemType = ECS;
 static FILE   *cmHandle;
 static FILE   *ecsHandle;
 
-static volatile u32 ecsFlagRegister = 0;
-static volatile u8 ecs16Kx4bitFlagRegisters[16384];
+static EcsFlags localEcsFlags;
+static EcsFlags *ecsFlags = &localEcsFlags;
 
-static volatile int monitorCpu = -1;
+#if !defined(_WIN32)
+static int  ecsShmFd = -1;
+static char ecsShmName[80];
+#endif
+
+static AtomicInt monitorCpu = -1;
 
 #if CcSMM_EJT
 static int skipStep = 0;
@@ -228,14 +363,6 @@ static int skipStep = 0;
 static FILE *emLog = NULL;
 #endif
 
-#if defined(_WIN32)
-static HANDLE exchangeMutex;
-static HANDLE flagRegMutex;
-#else
-static pthread_mutex_t exchangeMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t flagRegMutex = PTHREAD_MUTEX_INITIALIZER;
-#endif
-
 /*
 **  Opcode decode and dispatch table.
 */
@@ -336,9 +463,18 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
     int i;
 
     /*
-    **  Allocate configured central memory.
+    **  Allocate configured central memory, or map it onto its persistence
+    **  file.
     */
-    cpMem = calloc(memory, sizeof(CpWord));
+    if (persistMapped)
+        {
+        cpMem = persistMap("cmStore", (size_t)memory * sizeof(CpWord), "CM");
+        }
+    else
+        {
+        cpMem = calloc(memory, sizeof(CpWord));
+        }
+
     if (cpMem == NULL)
         {
         fprintf(stderr, "(cpu    ) Failed to allocate CPU memory\n");
@@ -359,9 +495,22 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
         }
 
     /*
-    **  Allocate configured ECS memory.
+    **  Allocate configured ECS memory, place it in a shared memory segment
+    **  used by several emulators, or map it onto its persistence file.
     */
-    extMem = calloc(emBanks * extBanksSize, sizeof(CpWord));
+    if ((ecsSharedName[0] != '\0') && (emBanks != 0))
+        {
+        extMem = cpuMapSharedEcs(ecsSharedName, emBanks * extBanksSize);
+        }
+    else if (persistMapped && (emBanks != 0))
+        {
+        extMem = persistMap("ecsStore", (size_t)emBanks * extBanksSize * sizeof(CpWord), "ECS");
+        }
+    else
+        {
+        extMem = calloc(emBanks * extBanksSize, sizeof(CpWord));
+        }
+
     if (extMem == NULL)
         {
         fprintf(stderr, "(cpu    ) Failed to allocate ECS memory\n");
@@ -372,9 +521,11 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
     extMemType   = emType;
 
     /*
-    **  Optionally read in persistent CM and ECS contents.
+    **  Optionally read in persistent CM and ECS contents. Mapped memory
+    **  already has its persistent contents, and shared ECS belongs to all
+    **  emulators using it, so it is never loaded or saved.
     */
-    if (*persistDir != '\0')
+    if ((*persistDir != '\0') && !persistMapped)
         {
         char fileName[256];
 
@@ -409,32 +560,35 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
             }
 
         /*
-        **  Try to open existing ECS file.
+        **  Try to open existing ECS file, unless ECS is shared.
         */
-        strcpy(fileName, persistDir);
-        strcat(fileName, "/ecsStore");
-        ecsHandle = fopen(fileName, "r+b");
-        if (ecsHandle != NULL)
+        if (ecsFlags == &localEcsFlags)
             {
-            /*
-            **  Read ECS contents.
-            */
-            if (fread(extMem, sizeof(CpWord), extMaxMemory, ecsHandle) != extMaxMemory)
+            strcpy(fileName, persistDir);
+            strcat(fileName, "/ecsStore");
+            ecsHandle = fopen(fileName, "r+b");
+            if (ecsHandle != NULL)
                 {
-                printf("(cpu    ) Unexpected length of ECS backing file, clearing ECS\n");
-                memset(extMem, 0, extMaxMemory);
+                /*
+                **  Read ECS contents.
+                */
+                if (fread(extMem, sizeof(CpWord), extMaxMemory, ecsHandle) != extMaxMemory)
+                    {
+                    printf("(cpu    ) Unexpected length of ECS backing file, clearing ECS\n");
+                    memset(extMem, 0, extMaxMemory);
+                    }
                 }
-            }
-        else
-            {
-            /*
-            **  Create a new file.
-            */
-            ecsHandle = fopen(fileName, "w+b");
-            if (ecsHandle == NULL)
+            else
                 {
-                fprintf(stderr, "(cpu    ) Failed to create ECS backing file\n");
-                exit(1);
+                /*
+                **  Create a new file.
+                */
+                ecsHandle = fopen(fileName, "w+b");
+                if (ecsHandle == NULL)
+                    {
+                    fprintf(stderr, "(cpu    ) Failed to create ECS backing file\n");
+                    exit(1);
+                    }
                 }
             }
         }
@@ -452,8 +606,23 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
         {
         cpus[cpuNum].id                   = cpuNum;
         cpus[cpuNum].isStopped            = TRUE;
-        cpus[cpuNum].ppRequestingExchange = -1;
+        cpus[cpuNum].ppRequestingExchange = ExchangeIdle;
         cpus[cpuNum].idleCycles = 0;
+        cpus[cpuNum].decodeCache = (CpuDecodedWord *)calloc(DecodeCacheSize, sizeof(CpuDecodedWord));
+        if (cpus[cpuNum].decodeCache == NULL)
+            {
+            fputs("(cpu    ) Failed to allocate memory for CPU decode cache\n", stderr);
+            exit(1);
+            }
+        if (cpuEngine == CpuEngineThreaded)
+            {
+            cpus[cpuNum].blockCache = (CpuBlock *)calloc(BlockCacheSize, sizeof(CpuBlock));
+            if (cpus[cpuNum].blockCache == NULL)
+                {
+                fputs("(cpu    ) Failed to allocate memory for CPU block cache\n", stderr);
+                exit(1);
+                }
+            }
         if (cpuNum > 0)
             {
             cpuCreateThread(cpuNum);
@@ -462,11 +631,16 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
 
     /*
     **  Initialize 16K x 4-bit EM flag registers. Currently, only models 865 and 875
-    **  have this feature.
+    **  have this feature. Shared flag registers keep the state set by the other
+    **  emulators.
     */
-
-    for (i = 0; i < sizeof(ecs16Kx4bitFlagRegisters); i++)
-         ecs16Kx4bitFlagRegisters[i] = 0;
+    if (ecsFlags == &localEcsFlags)
+        {
+        for (i = 0; i < EcsFlagRegisters; i++)
+            {
+            cpuAtomicStore(&ecsFlags->flagRegisters16K[i], 0);
+            }
+        }
 
     /*
     **  Print a friendly message.
@@ -482,16 +656,22 @@ void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType)
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Acquire lock on exchange mutex
+**  Purpose:        Claim the exchange request slot of a CPU on behalf of
+**                  the active PP. While the slot is claimed the CPU will
+**                  neither start an exchange nor change its monitor mode,
+**                  so the PP may inspect the CPU state and then either
+**                  post its request or release the claim.
 **
 **  Parameters:     Name        Description.
+**                  cpu         pointer to CPU context
 **
-**  Returns:        Nothing.
+**  Returns:        TRUE if claimed, FALSE if an exchange is already
+**                  pending or in progress.
 **
 **------------------------------------------------------------------------*/
-void cpuAcquireExchangeMutex(void)
+bool cpuClaimExchange(CpuContext *cpu)
     {
-    cpuAcquireMutex(&exchangeMutex);
+    return cpuAtomicSwap(&cpu->ppRequestingExchange, ExchangeIdle, ExchangeClaimed);
     }
 
 /*--------------------------------------------------------------------------
@@ -512,16 +692,57 @@ u32 cpuGetP(u8 cpuNum)
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Release lock on exchange mutex
+**  Purpose:        Check whether an exchange requested by a PP is still
+**                  waiting to be performed.
+**
+**  Parameters:     Name        Description.
+**                  cpu         pointer to CPU context
+**                  ppId        PP number
+**
+**  Returns:        TRUE if the request is still pending.
+**
+**------------------------------------------------------------------------*/
+bool cpuIsExchangePending(CpuContext *cpu, u8 ppId)
+    {
+    return cpuAtomicLoad(&cpu->ppRequestingExchange) == ppId;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Post an exchange request into a slot previously
+**                  claimed with cpuClaimExchange. The exchange parameters
+**                  are stored before the PP number is published, so the
+**                  CPU sees them once it sees the request.
+**
+**  Parameters:     Name         Description.
+**                  cpu          pointer to CPU context
+**                  ppId         PP number
+**                  address      exchange address
+**                  doChangeMode TRUE if monitor mode flag should change
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void cpuPostExchange(CpuContext *cpu, u8 ppId, u32 address, bool doChangeMode)
+    {
+    cpu->ppExchangeAddress   = address;
+    cpu->doChangeMode        = doChangeMode;
+    cpu->exchangesRequested += 1;
+    cpuAtomicStore(&cpu->ppRequestingExchange, ppId);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Release a claim on the exchange request slot of a CPU
+**                  without posting a request.
 **
 **  Parameters:     Name        Description.
+**                  cpu         pointer to CPU context
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void cpuReleaseExchangeMutex(void)
+void cpuReleaseExchange(CpuContext *cpu)
     {
-    cpuReleaseMutex(&exchangeMutex);
+    cpuAtomicStore(&cpu->ppRequestingExchange, ExchangeIdle);
     }
 
 /*--------------------------------------------------------------------------
@@ -534,6 +755,16 @@ void cpuReleaseExchangeMutex(void)
 **------------------------------------------------------------------------*/
 void cpuTerminate(void)
     {
+    /*
+    **  Mapped CM and ECS only need their dirty pages written back. The
+    **  mappings stay in place as the CPU threads may still be running.
+    */
+    if (persistMapped)
+        {
+        persistSync(cpMem, TRUE);
+        persistSync(extMem, TRUE);
+        }
+
     /*
     **  Optionally save CM.
     */
@@ -561,6 +792,11 @@ void cpuTerminate(void)
 
         fclose(ecsHandle);
         }
+
+    /*
+    **  Remove a shared ECS segment nobody else uses any more.
+    */
+    cpuUnmapSharedEcs();
     }
 
 /*--------------------------------------------------------------------------
@@ -632,26 +868,26 @@ void cpuPpWriteMem(u32 address, CpWord data)
 **------------------------------------------------------------------------*/
 void cpuStep(CpuContext *activeCpu)
     {
-    u32 length;
-    u32 oldRegP;
-
     /*
     **  If this CPU needs to be exchanged, do that first.
     **  This check must come BEFORE the "stopped" check.
+    **  Only this CPU moves a posted request back to idle, so the slot
+    **  keeps the PP number (and other agents stay out) until the
+    **  exchange is complete.
     */
-    if (activeCpu->ppRequestingExchange != -1)
+    if (cpuAtomicLoad(&activeCpu->ppRequestingExchange) >= 0)
         {
-        cpuAcquireExchangeMutex();
-        if ((monitorCpu == -1 || activeCpu->doChangeMode == FALSE)
-            && (activeCpu->opOffset == 60 || activeCpu->isStopped))
+        if ((activeCpu->opOffset == 60 || activeCpu->isStopped)
+            && (activeCpu->doChangeMode == FALSE
+                || cpuAtomicSwap(&monitorCpu, -1, activeCpu->id)))
             {
             cpuExchangeJump(activeCpu, activeCpu->ppExchangeAddress, activeCpu->doChangeMode);
-            activeCpu->ppRequestingExchange = -1;
-            cpuReleaseExchangeMutex();
+            activeCpu->exchangesGranted += 1;
+            cpuAtomicStore(&activeCpu->ppRequestingExchange, ExchangeIdle);
             }
         else
             {
-            cpuReleaseExchangeMutex();
+            activeCpu->exchangesDeferred += 1;
             }
         }
 
@@ -669,96 +905,14 @@ void cpuStep(CpuContext *activeCpu)
         }
 #endif
 
-    /*
-    **  Execute one CM word atomically.
-    */
-    activeCpu->isErrorExitPending = FALSE;
-    do
+    if (cpuEngine == CpuEngineThreaded)
         {
-        /*
-        **  Decode based on type.
-        */
-        activeCpu->opFm = (u8)((activeCpu->opWord >> (activeCpu->opOffset - 6)) & Mask6);
-        activeCpu->opI  = (u8)((activeCpu->opWord >> (activeCpu->opOffset -  9)) & Mask3);
-        activeCpu->opJ  = (u8)((activeCpu->opWord >> (activeCpu->opOffset - 12)) & Mask3);
-        length = decodeCpuOpcode[activeCpu->opFm].length;
-
-        if (length == 0)
-            {
-            length = cpOp01Length[activeCpu->opI];
-            }
-
-        if (length == 15)
-            {
-            activeCpu->opK       = (u8)((activeCpu->opWord >> (activeCpu->opOffset - 15)) & Mask3);
-            activeCpu->opAddress = 0;
-            activeCpu->opOffset -= 15;
-            }
-        else
-            {
-            if (activeCpu->opOffset == 15)
-                {
-                /*
-                **  Invalid packing is handled as illegal instruction.
-                */
-                cpuOpIllegal(activeCpu);
-                break;
-                }
-            activeCpu->opK       = 0;
-            activeCpu->opAddress = (u32)((activeCpu->opWord >> (activeCpu->opOffset - 30)) & Mask18);
-            activeCpu->opOffset -= 30;
-            }
-
-        oldRegP = activeCpu->regP;
-
-        /*
-        **  Force B0 to 0.
-        */
-        activeCpu->regB[0] = 0;
-
-        /*
-        **  Execute instruction.
-        */
-        decodeCpuOpcode[activeCpu->opFm].execute(activeCpu);
-
-        /*
-        **  Force B0 to 0.
-        */
-        activeCpu->regB[0] = 0;
-
-#if CcDebug == 1
-        traceCpu(activeCpu, oldRegP, activeCpu->opFm, activeCpu->opI, activeCpu->opJ, activeCpu->opK, activeCpu->opAddress);
-#endif
-
-        if (activeCpu->isStopped)
-            {
-            if (activeCpu->opOffset == 0)
-                {
-                activeCpu->regP = (activeCpu->regP + 1) & Mask18;
-                }
-#if CcDebug == 1
-            traceCpuPrint(activeCpu, "Stopped\n");
-#endif
-
-            break;
-            }
-
-        /*
-        **  Fetch next instruction word if necessary.
-        */
-        if (activeCpu->opOffset == 0)
-            {
-            activeCpu->regP = (activeCpu->regP + 1) & Mask18;
-            cpuFetchOpWord(activeCpu);
-            }
-        } while (activeCpu->opOffset != 60 && !activeCpu->isStopped);
+        cpuExecuteBlockWord(activeCpu);
 
-    if (activeCpu->isErrorExitPending)
-        {
-        cpuAcquireExchangeMutex();
-        cpuExchangeJump(activeCpu, activeCpu->regMa, TRUE);
-        cpuReleaseExchangeMutex();
+        return;
         }
+
+    cpuExecuteWord(activeCpu);
     }
 
 /*--------------------------------------------------------------------------
@@ -775,7 +929,7 @@ bool cpuEcsFlagRegister(u32 ecsAddress)
     u32  flagFunction;
     u16  flagRegisterAddress;
     u32  flagWord;
-    bool isExtendedFlag;
+    int  flagRegister;
     bool result;
 
 #if DEBUG_ECS
@@ -784,8 +938,11 @@ bool cpuEcsFlagRegister(u32 ecsAddress)
 
     result = TRUE;
 
-    cpuAcquireMutex(&flagRegMutex);
-
+    /*
+    **  The flag registers may be shared with other emulators, so every
+    **  update is a compare and swap against the value the decision was
+    **  based on, retried if another CPU or emulator changed it meanwhile.
+    */
     if (((ecsAddress & (1 << 29)) != 0 && (ecsAddress & (1 << 20)) != 0))
         {
         flagFunction        = (ecsAddress >> 18) & Mask5;
@@ -799,13 +956,9 @@ bool cpuEcsFlagRegister(u32 ecsAddress)
             */
 #if DEBUG_ECS
             fprintf(emLog, "\n    Zero/Select: addr %05o, flag register %02o, flag word %02o",
-               flagRegisterAddress, ecs16Kx4bitFlagRegisters[flagRegisterAddress], flagWord);
+               flagRegisterAddress, cpuAtomicLoad(&ecsFlags->flagRegisters16K[flagRegisterAddress]), flagWord);
 #endif
-            if (ecs16Kx4bitFlagRegisters[flagRegisterAddress] == 0)
-                {
-                ecs16Kx4bitFlagRegisters[flagRegisterAddress] = flagWord;
-                }
-            else
+            if (!cpuAtomicSwap(&ecsFlags->flagRegisters16K[flagRegisterAddress], 0, (int)flagWord))
                 {
                 /*
                 **  Error exit.
@@ -830,11 +983,12 @@ bool cpuEcsFlagRegister(u32 ecsAddress)
             /*
             **  Equality Status.
             */
+            flagRegister = cpuAtomicLoad(&ecsFlags->flagRegisters16K[flagRegisterAddress]);
 #if DEBUG_ECS
             fprintf(emLog, "\n    Equality Status: addr %05o, flag register %02o, flag word %02o",
-               flagRegisterAddress, ecs16Kx4bitFlagRegisters[flagRegisterAddress], flagWord);
+               flagRegisterAddress, flagRegister, flagWord);
 #endif
-            result = ecs16Kx4bitFlagRegisters[flagRegisterAddress] == flagWord;
+            result = (u32)flagRegister == flagWord;
             break;
             }
         }
@@ -848,40 +1002,45 @@ bool cpuEcsFlagRegister(u32 ecsAddress)
             /*
             **  Ready/Select.
             */
+            do
+                {
+                flagRegister = cpuAtomicLoad(&ecsFlags->flagRegister);
 #if DEBUG_ECS
-            fprintf(emLog, "\n    Ready/Select: flag register %06o, flag word %06o", ecsFlagRegister, flagWord);
+                fprintf(emLog, "\n    Ready/Select: flag register %06o, flag word %06o", flagRegister, flagWord);
 #endif
-            if ((ecsFlagRegister & flagWord) != 0)
-                {
-                /*
-                **  Error exit.
-                */
-                result = FALSE;
-                }
-            else
-                {
-                ecsFlagRegister |= flagWord;
-                }
+                if (((u32)flagRegister & flagWord) != 0)
+                    {
+                    /*
+                    **  Error exit.
+                    */
+                    result = FALSE;
+                    break;
+                    }
+                } while (!cpuAtomicSwap(&ecsFlags->flagRegister, flagRegister, (int)((u32)flagRegister | flagWord)));
             break;
 
         case 1:
             /*
             **  Selective Set.
             */
+            do
+                {
+                flagRegister = cpuAtomicLoad(&ecsFlags->flagRegister);
 #if DEBUG_ECS
-            fprintf(emLog, "\n    Selective Set: flag register %06o, flag word %06o", ecsFlagRegister, flagWord);
+                fprintf(emLog, "\n    Selective Set: flag register %06o, flag word %06o", flagRegister, flagWord);
 #endif
-            ecsFlagRegister |= flagWord;
+                } while (!cpuAtomicSwap(&ecsFlags->flagRegister, flagRegister, (int)((u32)flagRegister | flagWord)));
             break;
 
         case 2:
             /*
             **  Status.
             */
+            flagRegister = cpuAtomicLoad(&ecsFlags->flagRegister);
 #if DEBUG_ECS
-            fprintf(emLog, "\n    Status: flag register %06o, flag word %06o", ecsFlagRegister, flagWord);
+            fprintf(emLog, "\n    Status: flag register %06o, flag word %06o", flagRegister, flagWord);
 #endif
-            if ((ecsFlagRegister & flagWord) != 0)
+            if (((u32)flagRegister & flagWord) != 0)
                 {
                 /*
                 **  Error exit.
@@ -894,16 +1053,17 @@ bool cpuEcsFlagRegister(u32 ecsAddress)
             /*
             **  Selective Clear,
             */
+            do
+                {
+                flagRegister = cpuAtomicLoad(&ecsFlags->flagRegister);
 #if DEBUG_ECS
-            fprintf(emLog, "\n    Selective Clear: flag register %06o, flag word %06o", ecsFlagRegister, flagWord);
+                fprintf(emLog, "\n    Selective Clear: flag register %06o, flag word %06o", flagRegister, flagWord);
 #endif
-            ecsFlagRegister = (ecsFlagRegister & ~flagWord) & Mask18;
+                } while (!cpuAtomicSwap(&ecsFlags->flagRegister, flagRegister, (int)(((u32)flagRegister & ~flagWord) & Mask18)));
             break;
             }
         }
 
-    cpuReleaseMutex(&flagRegMutex);
-
     return result;
     }
 
@@ -977,17 +1137,6 @@ static void cpuCreateThread(int cpuNum)
     DWORD  dwThreadId;
     HANDLE hThread;
 
-    /*
-    **  Create mutexes
-    */
-    exchangeMutex = CreateMutex(NULL, FALSE, NULL);
-    flagRegMutex  = CreateMutex(NULL, FALSE, NULL);
-    if (exchangeMutex == NULL || flagRegMutex == NULL)
-        {
-        fputs("(cpu     ) Failed to create mutex\n", stderr);
-        exit(1);
-        }
-
     /*
     **  Create operator thread.
     */
@@ -1023,85 +1172,505 @@ static void cpuCreateThread(int cpuNum)
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Acquires a lock on a mutex
+**  Purpose:        Atomically load a shared integer with acquire ordering.
 **
 **  Parameters:     Name        Description.
-**                  mutexp      pointer to mutex/handle
+**                  ap          pointer to atomic integer
 **
-**  Returns:        Nothing.
+**  Returns:        Current value.
 **
 **------------------------------------------------------------------------*/
-#if defined(_WIN32)
-static void cpuAcquireMutex(HANDLE *mutexp)
+static int cpuAtomicLoad(AtomicInt *ap)
     {
-    WaitForSingleObject(*mutexp, INFINITE);
-    }
+#if defined(_WIN32)
+    return InterlockedCompareExchange(ap, 0, 0);
 #else
-static void cpuAcquireMutex(pthread_mutex_t *mutexp)
-    {
-    pthread_mutex_lock(mutexp);
-    }
+    return atomic_load_explicit(ap, memory_order_acquire);
 #endif
+    }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Releases a lock on a mutex
+**  Purpose:        Atomically store a shared integer with release ordering.
 **
 **  Parameters:     Name        Description.
-**                  mutexp      pointer to mutex/handle
+**                  ap          pointer to atomic integer
+**                  value       new value
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-#if defined(_WIN32)
-static void cpuReleaseMutex(HANDLE *mutexp)
+static void cpuAtomicStore(AtomicInt *ap, int value)
     {
-    ReleaseMutex(*mutexp);
-    }
+#if defined(_WIN32)
+    InterlockedExchange(ap, value);
 #else
-static void cpuReleaseMutex(pthread_mutex_t *mutexp)
-    {
-    pthread_mutex_unlock(mutexp);
-    }
+    atomic_store_explicit(ap, value, memory_order_release);
 #endif
+    }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Thread execution function for a CPU
+**  Purpose:        Atomically replace a shared integer if it holds the
+**                  expected value.
 **
 **  Parameters:     Name        Description.
-**                  param       pointer to CPU context
+**                  ap          pointer to atomic integer
+**                  expected    value the integer must hold
+**                  value       new value
 **
-**  Returns:        Nothing.
+**  Returns:        TRUE if the value was replaced.
 **
 **------------------------------------------------------------------------*/
+static bool cpuAtomicSwap(AtomicInt *ap, int expected, int value)
+    {
 #if defined(_WIN32)
-static void cpuThread(void *param)
+    return InterlockedCompareExchange(ap, value, expected) == expected;
 #else
-static void *cpuThread(void *param)
-#endif
-    {
-    CpuContext *activeCpu = (CpuContext *)param;
-    printf("(cpu    ) CPU%o started\n",  activeCpu->id);
-
-    while (emulationActive)
-        {
-        while (opPaused)
-            {
-            /* wait for operator thread to clear the flag */
-            sleepMsec(500);
-            }
-        cpuStep(activeCpu);
-        idleThrottle(activeCpu);
-        }
-#if !defined(_WIN32)
-    return (NULL);
+    return atomic_compare_exchange_strong_explicit(ap, &expected, value,
+                                                   memory_order_acq_rel, memory_order_acquire);
 #endif
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Perform exchange jump.
+**  Purpose:        Place ECS and its flag registers in a shared memory
+**                  segment, so several emulators on the same host share
+**                  them like mainframes coupled through ECS. The first
+**                  emulator to attach starts with zeroed ECS and flag
+**                  registers, even when the segment survived an earlier
+**                  run; later ones attach to its contents and must be
+**                  configured with the same ECS size.
 **
-**  Parameters:     Name         Description.
-**                  activeCpu    Pointer to CPU context
+**                  On Windows the named mapping is zero filled on
+**                  creation and released by the system when the last
+**                  emulator exits. On POSIX the segment is removed by
+**                  the last emulator to terminate; one left behind by a
+**                  crash is re-initialised by the next first attacher.
+**
+**  Parameters:     Name        Description.
+**                  name        name of shared memory segment
+**                  words       size of ECS in 60 bit words
+**
+**  Returns:        Pointer to ECS words in the segment, NULL on failure.
+**
+**------------------------------------------------------------------------*/
+static CpWord *cpuMapSharedEcs(char *name, u32 words)
+    {
+    size_t size;
+    u8     *segment;
+
+    size = EcsSharedOffset + (size_t)words * sizeof(CpWord);
+
+#if defined(_WIN32)
+    {
+    char   mapName[80];
+    HANDLE mapHandle;
+
+    sprintf(mapName, "Local\\%s", name);
+    mapHandle = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((u64)size >> 32), (DWORD)size, mapName);
+    if (mapHandle == NULL)
+        {
+        fprintf(stderr, "(cpu    ) Failed to create shared ECS segment '%s'\n", name);
+
+        return (NULL);
+        }
+
+    segment = MapViewOfFile(mapHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (segment == NULL)
+        {
+        fprintf(stderr, "(cpu    ) Failed to map shared ECS segment '%s'\n", name);
+        CloseHandle(mapHandle);
+
+        return (NULL);
+        }
+    }
+#else
+    {
+    struct flock lock;
+    struct stat  s;
+
+    sprintf(ecsShmName, "/%s", name);
+    for (;;)
+        {
+        ecsShmFd = shm_open(ecsShmName, O_RDWR | O_CREAT, 0660);
+        if (ecsShmFd < 0)
+            {
+            fprintf(stderr, "(cpu    ) Failed to open shared ECS segment '%s'\n", ecsShmName);
+
+            return (NULL);
+            }
+
+        /*
+        **  Every attached emulator holds a read lock on the segment for
+        **  as long as it runs. If a write lock can be taken nobody else
+        **  is attached, so whatever the segment holds is left over from
+        **  an earlier or crashed run: discard it by truncating the
+        **  segment and size it zero filled, then convert the write lock
+        **  into a read lock (an atomic conversion for fcntl locks).
+        **  Emulators starting at the same time wait for the read lock
+        **  until this is done.
+        */
+        memset(&lock, 0, sizeof(lock));
+        lock.l_type   = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        lock.l_start  = 0;
+        lock.l_len    = 1;
+        if (fcntl(ecsShmFd, F_SETLK, &lock) == 0)
+            {
+            if ((ftruncate(ecsShmFd, 0) != 0) || (ftruncate(ecsShmFd, (off_t)size) != 0))
+                {
+                fprintf(stderr, "(cpu    ) Failed to size shared ECS segment '%s'\n", ecsShmName);
+                close(ecsShmFd);
+
+                return (NULL);
+                }
+
+            printf("(cpu    ) Shared ECS segment '%s' initialised\n", ecsShmName);
+            }
+
+        lock.l_type = F_RDLCK;
+        if ((fcntl(ecsShmFd, F_SETLKW, &lock) != 0) || (fstat(ecsShmFd, &s) != 0))
+            {
+            fprintf(stderr, "(cpu    ) Failed to lock shared ECS segment '%s'\n", ecsShmName);
+            close(ecsShmFd);
+
+            return (NULL);
+            }
+
+        /*
+        **  A segment removed by the last emulator while this one waited
+        **  for the lock is stale, open the name again.
+        */
+        if (s.st_nlink != 0)
+            {
+            break;
+            }
+
+        close(ecsShmFd);
+        }
+
+    if ((size_t)s.st_size != size)
+        {
+        fprintf(stderr, "(cpu    ) Shared ECS segment '%s' has a different ECS size\n", ecsShmName);
+        close(ecsShmFd);
+
+        return (NULL);
+        }
+
+    /*
+    **  The descriptor stays open, closing it would drop the read lock.
+    */
+    segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ecsShmFd, 0);
+    if (segment == MAP_FAILED)
+        {
+        fprintf(stderr, "(cpu    ) Failed to map shared ECS segment '%s'\n", ecsShmName);
+        close(ecsShmFd);
+
+        return (NULL);
+        }
+    }
+#endif
+
+    ecsFlags = (EcsFlags *)segment;
+
+    printf("(cpu    ) ECS shared through segment '%s'\n", name);
+
+    return ((CpWord *)(segment + EcsSharedOffset));
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Detach from a shared ECS segment and remove it when
+**                  no other emulator is attached. The mapping itself is
+**                  kept as CPU threads may still be running.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void cpuUnmapSharedEcs(void)
+    {
+#if !defined(_WIN32)
+    struct flock lock;
+
+    if (ecsShmFd < 0)
+        {
+        return;
+        }
+
+    /*
+    **  Upgrading the read lock to a write lock only succeeds when no
+    **  other emulator holds a read lock on the segment.
+    */
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type   = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start  = 0;
+    lock.l_len    = 1;
+    if (fcntl(ecsShmFd, F_SETLK, &lock) == 0)
+        {
+        shm_unlink(ecsShmName);
+        }
+
+    close(ecsShmFd);
+    ecsShmFd = -1;
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Make the active CPU the monitor CPU unless another CPU
+**                  already is.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   pointer to CPU context
+**
+**  Returns:        TRUE if the active CPU is (now) the monitor CPU.
+**
+**------------------------------------------------------------------------*/
+static bool cpuClaimMonitor(CpuContext *activeCpu)
+    {
+    return cpuAtomicLoad(&monitorCpu) == activeCpu->id
+           || cpuAtomicSwap(&monitorCpu, -1, activeCpu->id);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Take exclusive use of the exchange request slot of the
+**                  active CPU for an exchange which cannot be deferred.
+**                  A request already posted by a PP is preserved, and
+**                  must be put back by storing the returned value.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   pointer to CPU context
+**
+**  Returns:        Previous slot contents.
+**
+**------------------------------------------------------------------------*/
+static int cpuLockExchange(CpuContext *activeCpu)
+    {
+    int slot;
+
+    /*
+    **  A PP holds a claim only while it decodes its exchange
+    **  instruction, so this spins for a few instructions at most.
+    */
+    do
+        {
+        slot = cpuAtomicLoad(&activeCpu->ppRequestingExchange);
+        } while (slot == ExchangeClaimed
+                 || !cpuAtomicSwap(&activeCpu->ppRequestingExchange, slot, ExchangeClaimed));
+
+    return slot;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Thread execution function for a CPU
+**
+**  Parameters:     Name        Description.
+**                  param       pointer to CPU context
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+#if defined(_WIN32)
+static void cpuThread(void *param)
+#else
+static void *cpuThread(void *param)
+#endif
+    {
+    CpuContext *activeCpu = (CpuContext *)param;
+    printf("(cpu    ) CPU%o started\n",  activeCpu->id);
+
+    while (emulationActive)
+        {
+        while (opPaused)
+            {
+            /* wait for operator thread to clear the flag */
+            sleepMsec(500);
+            }
+        cpuStep(activeCpu);
+        idleThrottle(activeCpu);
+        }
+#if !defined(_WIN32)
+    return (NULL);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Execute one CM word atomically and take any error exit
+**                  which results from it.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   pointer to CPU context
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void cpuExecuteWord(CpuContext *activeCpu)
+    {
+    CpuDecodedWord *dw;
+
+    /*
+    **  Use the predecoded form of the instruction word if available.
+    */
+    dw = NULL;
+    if (cpuDecodeCacheEnabled && (activeCpu->opOffset == 60))
+        {
+        dw = cpuDecodeOpWord(activeCpu);
+        }
+
+    /*
+    **  Execute one CM word atomically.
+    */
+    activeCpu->isErrorExitPending = FALSE;
+    cpuExecuteParcels(activeCpu, dw);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Execute the remaining instructions of the current CM
+**                  word.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   pointer to CPU context
+**                  dw          predecoded instruction word or NULL
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void cpuExecuteParcels(CpuContext *activeCpu, CpuDecodedWord *dw)
+    {
+    CpuDecodedParcel *parcel;
+    void             (*execute)(CpuContext *activeCpu);
+    u32              length;
+    u32              oldRegP;
+
+    do
+        {
+        parcel = NULL;
+        if (dw != NULL)
+            {
+            parcel = dw->parcels + ((60 - activeCpu->opOffset) / 15);
+            if (parcel->length == 0)
+                {
+                parcel = NULL;
+                }
+            }
+
+        if (parcel != NULL)
+            {
+            activeCpu->opFm = parcel->opFm;
+            activeCpu->opI  = parcel->opI;
+            activeCpu->opJ  = parcel->opJ;
+            if (parcel->execute == NULL)
+                {
+                /*
+                **  Invalid packing is handled as illegal instruction.
+                */
+                cpuOpIllegal(activeCpu);
+                break;
+                }
+
+            activeCpu->opK       = parcel->opK;
+            activeCpu->opAddress = parcel->opAddress;
+            activeCpu->opOffset -= parcel->length;
+            execute = parcel->execute;
+            }
+        else
+            {
+            /*
+            **  Decode based on type.
+            */
+            activeCpu->opFm = (u8)((activeCpu->opWord >> (activeCpu->opOffset - 6)) & Mask6);
+            activeCpu->opI  = (u8)((activeCpu->opWord >> (activeCpu->opOffset -  9)) & Mask3);
+            activeCpu->opJ  = (u8)((activeCpu->opWord >> (activeCpu->opOffset - 12)) & Mask3);
+            length = decodeCpuOpcode[activeCpu->opFm].length;
+
+            if (length == 0)
+                {
+                length = cpOp01Length[activeCpu->opI];
+                }
+
+            if (length == 15)
+                {
+                activeCpu->opK       = (u8)((activeCpu->opWord >> (activeCpu->opOffset - 15)) & Mask3);
+                activeCpu->opAddress = 0;
+                activeCpu->opOffset -= 15;
+                }
+            else
+                {
+                if (activeCpu->opOffset == 15)
+                    {
+                    /*
+                    **  Invalid packing is handled as illegal instruction.
+                    */
+                    cpuOpIllegal(activeCpu);
+                    break;
+                    }
+                activeCpu->opK       = 0;
+                activeCpu->opAddress = (u32)((activeCpu->opWord >> (activeCpu->opOffset - 30)) & Mask18);
+                activeCpu->opOffset -= 30;
+                }
+
+            execute = decodeCpuOpcode[activeCpu->opFm].execute;
+            }
+
+        oldRegP = activeCpu->regP;
+
+        /*
+        **  Force B0 to 0.
+        */
+        activeCpu->regB[0] = 0;
+
+        /*
+        **  Execute instruction.
+        */
+        execute(activeCpu);
+        activeCpu->instructionCount += 1;
+
+        /*
+        **  Force B0 to 0.
+        */
+        activeCpu->regB[0] = 0;
+
+#if CcDebug == 1
+        traceCpu(activeCpu, oldRegP, activeCpu->opFm, activeCpu->opI, activeCpu->opJ, activeCpu->opK, activeCpu->opAddress);
+#endif
+
+        if (activeCpu->isStopped)
+            {
+            if (activeCpu->opOffset == 0)
+                {
+                activeCpu->regP = (activeCpu->regP + 1) & Mask18;
+                }
+#if CcDebug == 1
+            traceCpuStop(activeCpu);
+#endif
+
+            break;
+            }
+
+        /*
+        **  Fetch next instruction word if necessary.
+        */
+        if (activeCpu->opOffset == 0)
+            {
+            activeCpu->regP = (activeCpu->regP + 1) & Mask18;
+            cpuFetchOpWord(activeCpu);
+            }
+        } while (activeCpu->opOffset != 60 && !activeCpu->isStopped);
+
+    if (activeCpu->isErrorExitPending)
+        {
+        int slot;
+
+        slot = cpuLockExchange(activeCpu);
+        cpuExchangeJump(activeCpu, activeCpu->regMa, TRUE);
+        cpuAtomicStore(&activeCpu->ppRequestingExchange, slot);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Perform exchange jump.
+**
+**  Parameters:     Name         Description.
+**                  activeCpu    Pointer to CPU context
 **                  address      Exchange address
 **                  doChangeMode TRUE if monitor mode flag should change
 **
@@ -1286,11 +1855,11 @@ static void cpuExchangeJump(CpuContext *activeCpu, u32 address, bool doChangeMod
         }
     if (activeCpu->isMonitorMode)
         {
-        if (monitorCpu == -1) monitorCpu = activeCpu->id;
+        cpuAtomicSwap(&monitorCpu, -1, activeCpu->id);
         }
-    else if (monitorCpu == activeCpu->id)
+    else
         {
-        monitorCpu = -1;
+        cpuAtomicSwap(&monitorCpu, activeCpu->id, -1);
         }
 
     cpuFetchOpWord(activeCpu);
@@ -1407,6 +1976,145 @@ static void cpuOpIllegal(CpuContext *activeCpu)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Execute one CM word atomically using the threaded
+**                  engine. The instructions of the word are taken from a
+**                  superblock and their handlers are called directly, and
+**                  as long as execution falls through to the next word the
+**                  following block word is used without a cache lookup.
+**                  Like cpuExecuteWord exactly one word is executed per
+**                  call.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   pointer to CPU context
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void cpuExecuteBlockWord(CpuContext *activeCpu)
+    {
+    CpuBlockWord  *bw;
+    CpuBlockWord  *next;
+    CpuThreadedOp *op;
+    u32           location;
+#if CcDebug == 1
+    u32           oldRegP;
+#endif
+
+    bw = activeCpu->blockWord;
+    if ((bw == NULL) || (bw->location != activeCpu->opLocation) || (bw->opWord != activeCpu->opWord)
+        || (activeCpu->opOffset != 60))
+        {
+        bw = NULL;
+        if (activeCpu->opOffset == 60)
+            {
+            bw = cpuBuildBlock(activeCpu);
+            }
+
+        if (bw == NULL)
+            {
+            /*
+            **  Partially executed word or invalid packing.
+            */
+            activeCpu->blockWord = NULL;
+            cpuExecuteWord(activeCpu);
+
+            return;
+            }
+        }
+
+    /*
+    **  Execute one CM word atomically. The instruction count is updated
+    **  once the word is done.
+    */
+    activeCpu->isErrorExitPending = FALSE;
+    next = NULL;
+    for (op = bw->ops; ; op++)
+        {
+        activeCpu->opFm      = op->opFm;
+        activeCpu->opI       = op->opI;
+        activeCpu->opJ       = op->opJ;
+        activeCpu->opK       = op->opK;
+        activeCpu->opAddress = op->opAddress;
+        activeCpu->opOffset  = op->offset;
+
+#if CcDebug == 1
+        oldRegP = activeCpu->regP;
+#endif
+
+        /*
+        **  Execute instruction with B0 forced to 0.
+        */
+        activeCpu->regB[0] = 0;
+        op->execute(activeCpu);
+        activeCpu->regB[0] = 0;
+
+#if CcDebug == 1
+        traceCpu(activeCpu, oldRegP, activeCpu->opFm, activeCpu->opI, activeCpu->opJ, activeCpu->opK, activeCpu->opAddress);
+#endif
+
+        if (activeCpu->isStopped)
+            {
+            if (activeCpu->opOffset == 0)
+                {
+                activeCpu->regP = (activeCpu->regP + 1) & Mask18;
+                }
+#if CcDebug == 1
+            traceCpuStop(activeCpu);
+#endif
+
+            break;
+            }
+
+        if (activeCpu->opOffset == 0)
+            {
+            /*
+            **  Fall through to the next word, which is expected to be the
+            **  next word of the block. Within FL and CM the address check
+            **  of cpuFetchOpWord can not fail and needs no wraparound.
+            */
+            activeCpu->regP = (activeCpu->regP + 1) & Mask18;
+            location        = cpuAddRa(activeCpu, activeCpu->regP);
+            if ((activeCpu->regP < activeCpu->regFlCm) && (location < cpuMaxMemory))
+                {
+                cpuLoadOpWord(activeCpu, location);
+                }
+            else
+                {
+                cpuFetchOpWord(activeCpu);
+                }
+
+            if (!bw->isLast)
+                {
+                next = bw + 1;
+                }
+
+            break;
+            }
+
+        if (activeCpu->opOffset != op->offset)
+            {
+            /*
+            **  Jump, exchange jump or retry of the word. Anything else leaves
+            **  the rest of the word to the classic decoder.
+            */
+            if (activeCpu->opOffset != 60)
+                {
+                activeCpu->instructionCount += op - bw->ops + 1;
+                activeCpu->blockWord         = NULL;
+                cpuExecuteParcels(activeCpu, NULL);
+
+                return;
+                }
+
+            break;
+            }
+        }
+
+    activeCpu->instructionCount += op - bw->ops + 1;
+    activeCpu->blockWord         = next;
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Check if CPU instruction word address is within limits.
 **
@@ -1478,6 +2186,24 @@ static void cpuFetchOpWord(CpuContext *activeCpu)
         return;
         }
 
+    cpuLoadOpWord(activeCpu, location);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Read CPU instruction word at P whose absolute address
+**                  has already been verified.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**                  location    Absolute address of P.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void cpuLoadOpWord(CpuContext *activeCpu, u32 location)
+    {
+    activeCpu->opLocation = location;
+
     if ((features & HasInstructionStack) != 0)
         {
         int i;
@@ -1521,36 +2247,224 @@ static void cpuFetchOpWord(CpuContext *activeCpu)
                     return;
                     }
 
-                activeCpu->iwRank = (activeCpu->iwRank + 1) % MaxIwStack;
-                activeCpu->iwAddress[activeCpu->iwRank] = location;
-                activeCpu->iwStack[activeCpu->iwRank]   = cpMem[location] & Mask60;
-                activeCpu->iwValid[activeCpu->iwRank]   = TRUE;
-                }
-#else
-            /*
-            **  Prefetch one instruction word.
-            */
-            if (cpuCheckOpAddress(activeCpu, activeCpu->regP + 1, &location))
+                activeCpu->iwRank = (activeCpu->iwRank + 1) % MaxIwStack;
+                activeCpu->iwAddress[activeCpu->iwRank] = location;
+                activeCpu->iwStack[activeCpu->iwRank]   = cpMem[location] & Mask60;
+                activeCpu->iwValid[activeCpu->iwRank]   = TRUE;
+                }
+#else
+            /*
+            **  Prefetch one instruction word.
+            */
+            if (cpuCheckOpAddress(activeCpu, activeCpu->regP + 1, &location))
+                {
+                return;
+                }
+
+            activeCpu->iwRank = (activeCpu->iwRank + 1) % MaxIwStack;
+            activeCpu->iwAddress[activeCpu->iwRank] = location;
+            activeCpu->iwStack[activeCpu->iwRank]   = cpMem[location] & Mask60;
+            activeCpu->iwValid[activeCpu->iwRank]   = TRUE;
+#endif
+            }
+        }
+    else
+        {
+        /*
+        **  Fetch the instruction from CM.
+        */
+        activeCpu->opWord = cpMem[location] & Mask60;
+        }
+
+    activeCpu->opOffset = 60;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Return the superblock starting with the current
+**                  instruction word, building it if necessary. Words after
+**                  the first are taken from CM and only checked against
+**                  the instruction word stack when they are executed.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**
+**  Returns:        Pointer to first block word, NULL if the current word
+**                  has invalid packing.
+**
+**------------------------------------------------------------------------*/
+static CpuBlockWord *cpuBuildBlock(CpuContext *activeCpu)
+    {
+    CpuBlock      *block;
+    CpuBlockWord  *bw;
+    CpuThreadedOp *op;
+    CpWord        opWord;
+    u32           location;
+    u8            length;
+    u8            offset;
+    bool          isJump;
+
+    block = activeCpu->blockCache + (activeCpu->opLocation & (BlockCacheSize - 1));
+    if ((block->wordCount != 0) && (block->location == activeCpu->opLocation)
+        && (block->words[0].opWord == activeCpu->opWord))
+        {
+        return (block->words);
+        }
+
+    block->location  = activeCpu->opLocation;
+    block->wordCount = 0;
+    location         = activeCpu->opLocation;
+    opWord           = activeCpu->opWord;
+
+    for (;;)
+        {
+        /*
+        **  Decode all instructions of the word the same way cpuExecuteWord
+        **  does, ending the block before a word with invalid packing.
+        */
+        bw     = block->words + block->wordCount;
+        op     = bw->ops;
+        isJump = FALSE;
+        for (offset = 60; offset > 0; offset -= length)
+            {
+            op->opFm = (u8)((opWord >> (offset - 6)) & Mask6);
+            op->opI  = (u8)((opWord >> (offset -  9)) & Mask3);
+            op->opJ  = (u8)((opWord >> (offset - 12)) & Mask3);
+            length   = decodeCpuOpcode[op->opFm].length;
+
+            if (length == 0)
+                {
+                length = cpOp01Length[op->opI];
+                }
+
+            if (length == 15)
+                {
+                op->opK       = (u8)((opWord >> (offset - 15)) & Mask3);
+                op->opAddress = 0;
+                }
+            else
+                {
+                if (offset == 15)
+                    {
+                    break;
+                    }
+
+                op->opK       = 0;
+                op->opAddress = (u32)((opWord >> (offset - 30)) & Mask18);
+                }
+
+            op->execute = decodeCpuOpcode[op->opFm].execute;
+            op->offset  = offset - length;
+            isJump     |= op->opFm < 010;
+            op         += 1;
+            }
+
+        if (offset > 0)
+            {
+            bw->location = ~0;
+            if (block->wordCount > 0)
+                {
+                bw[-1].isLast = TRUE;
+                }
+
+            break;
+            }
+
+        bw->opWord       = opWord;
+        bw->location     = location;
+        bw->isLast       = TRUE;
+        block->wordCount += 1;
+
+        location += 1;
+        if (isJump || (block->wordCount == MaxBlockWords) || (location >= cpuMaxMemory))
+            {
+            break;
+            }
+
+        bw->isLast = FALSE;
+        opWord     = cpMem[location] & Mask60;
+        }
+
+    if (block->wordCount == 0)
+        {
+        return (NULL);
+        }
+
+    return (block->words);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Return the predecoded form of the current instruction
+**                  word, decoding it into the cache if necessary.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**
+**  Returns:        Pointer to decoded instruction word.
+**
+**------------------------------------------------------------------------*/
+static CpuDecodedWord *cpuDecodeOpWord(CpuContext *activeCpu)
+    {
+    CpuDecodedWord   *dw;
+    CpuDecodedParcel *parcel;
+    u8               length;
+    u8               offset;
+
+    dw = activeCpu->decodeCache + (activeCpu->opLocation & (DecodeCacheSize - 1));
+    if (dw->isValid && (dw->location == activeCpu->opLocation) && (dw->opWord == activeCpu->opWord))
+        {
+        activeCpu->decodeHits += 1;
+
+        return (dw);
+        }
+
+    activeCpu->decodeMisses += 1;
+
+    dw->opWord   = activeCpu->opWord;
+    dw->location = activeCpu->opLocation;
+    dw->isValid  = TRUE;
+    memset(dw->parcels, 0, sizeof(dw->parcels));
+
+    /*
+    **  Decode all parcels of the word the same way cpuStep does.
+    */
+    for (offset = 60; offset > 0; offset -= length)
+        {
+        parcel       = dw->parcels + ((60 - offset) / 15);
+        parcel->opFm = (u8)((dw->opWord >> (offset - 6)) & Mask6);
+        parcel->opI  = (u8)((dw->opWord >> (offset -  9)) & Mask3);
+        parcel->opJ  = (u8)((dw->opWord >> (offset - 12)) & Mask3);
+        length       = decodeCpuOpcode[parcel->opFm].length;
+
+        if (length == 0)
+            {
+            length = cpOp01Length[parcel->opI];
+            }
+
+        parcel->length = length;
+
+        if (length == 15)
+            {
+            parcel->opK       = (u8)((dw->opWord >> (offset - 15)) & Mask3);
+            parcel->opAddress = 0;
+            }
+        else
+            {
+            if (offset == 15)
                 {
-                return;
+                /*
+                **  Invalid packing, leave handler NULL.
+                */
+                break;
                 }
 
-            activeCpu->iwRank = (activeCpu->iwRank + 1) % MaxIwStack;
-            activeCpu->iwAddress[activeCpu->iwRank] = location;
-            activeCpu->iwStack[activeCpu->iwRank]   = cpMem[location] & Mask60;
-            activeCpu->iwValid[activeCpu->iwRank]   = TRUE;
-#endif
+            parcel->opK       = 0;
+            parcel->opAddress = (u32)((dw->opWord >> (offset - 30)) & Mask18);
             }
-        }
-    else
-        {
-        /*
-        **  Fetch the instruction from CM.
-        */
-        activeCpu->opWord = cpMem[location] & Mask60;
+
+        parcel->execute = decodeCpuOpcode[parcel->opFm].execute;
         }
 
-    activeCpu->opOffset = 60;
+    return (dw);
     }
 
 /*--------------------------------------------------------------------------
@@ -2163,6 +3077,32 @@ static void cpuEcsWord(CpuContext *activeCpu, bool writeToEcs)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Copy a block of words between CM and extended memory
+**                  whose ranges have already been validated.
+**
+**  Parameters:     Name        Description.
+**                  dst         destination word pointer
+**                  src         source word pointer
+**                  count       number of words
+**
+**  Returns:        Nothing
+**
+**  Note:           The copy proceeds upwards one word at a time, so
+**                  overlapping UEM blocks behave exactly as in the word
+**                  by word transfer.
+**
+**------------------------------------------------------------------------*/
+static void cpuBlockCopy(CpWord *dst, CpWord *src, u32 count)
+    {
+    u32 i;
+
+    for (i = 0; i < count; i++)
+        {
+        dst[i] = src[i] & Mask60;
+        }
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Transfer block to/from UEM initiated by a CPU instruction.
 **
@@ -2294,6 +3234,33 @@ static void cpuUemTransfer(CpuContext *activeCpu, bool writeToUem)
     cmAddress  = cpuAddRa(activeCpu, cmAddress);
     cmAddress %= cpuMaxMemory;
 
+    /*
+    **  Fast path for the common case of a block which lies entirely within
+    **  memory on both sides: no zero fill, no partial transfer and no wrap
+    **  of the CM address, so the ranges need to be validated only once.
+    */
+    if ((writeToUem || !isZeroFill)
+        && (absUemAddr + wordCount <= cpuMaxMemory)
+        && (cmAddress + wordCount <= cpuMaxMemory))
+        {
+        activeCpu->extFastTransfers += 1;
+        if (writeToUem)
+            {
+            cpuBlockCopy(cpMem + absUemAddr, cpMem + cmAddress, wordCount);
+            }
+        else
+            {
+            cpuBlockCopy(cpMem + cmAddress, cpMem + absUemAddr, wordCount);
+            }
+
+        activeCpu->regP = (activeCpu->regP + 1) & Mask18;
+        cpuFetchOpWord(activeCpu);
+
+        return;
+        }
+
+    activeCpu->extSlowTransfers += 1;
+
     /*
     **  Perform the transfer.
     */
@@ -2564,6 +3531,31 @@ static void cpuEcsTransfer(CpuContext *activeCpu, bool writeToEcs)
     cmAddress  = cpuAddRa(activeCpu, cmAddress);
     cmAddress %= cpuMaxMemory;
 
+    /*
+    **  Fast path for a block which lies entirely within ECS and CM.
+    */
+    if ((writeToEcs || !isZeroFill)
+        && (absEcsAddr + wordCount <= extMaxMemory)
+        && (cmAddress + wordCount <= cpuMaxMemory))
+        {
+        activeCpu->extFastTransfers += 1;
+        if (writeToEcs)
+            {
+            cpuBlockCopy(extMem + absEcsAddr, cpMem + cmAddress, wordCount);
+            }
+        else
+            {
+            cpuBlockCopy(cpMem + cmAddress, extMem + absEcsAddr, wordCount);
+            }
+
+        activeCpu->regP = (activeCpu->regP + 1) & Mask18;
+        cpuFetchOpWord(activeCpu);
+
+        return;
+        }
+
+    activeCpu->extSlowTransfers += 1;
+
     /*
     **  Perform the transfer.
     */
@@ -2696,90 +3688,385 @@ static bool cpuCmuGetByte(CpuContext *activeCpu, u32 address, u32 pos, u8 *byte)
     location  = cpuAddRa(activeCpu, address);
     location %= cpuMaxMemory;
 
-    /*
-    **  Fetch the word.
-    */
-    data = cpMem[location] & Mask60;
+    /*
+    **  Fetch the word.
+    */
+    data = cpMem[location] & Mask60;
+
+    /*
+    **  Extract and return the byte.
+    */
+    *byte = (u8)((data >> ((9 - pos) * 6)) & Mask6);
+
+    return (FALSE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        CMU put a byte.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**                  address     CM word address
+**                  pos         character position
+**                  byte        data byte to put
+**
+**  Returns:        TRUE if access failed, FALSE otherwise.
+**
+**------------------------------------------------------------------------*/
+static bool cpuCmuPutByte(CpuContext *activeCpu, u32 address, u32 pos, u8 byte)
+    {
+    u32    location;
+    CpWord data;
+
+    /*
+    **  Validate access.
+    */
+    if ((address >= activeCpu->regFlCm) || (activeCpu->regRaCm + address >= cpuMaxMemory))
+        {
+        activeCpu->exitCondition |= EcAddressOutOfRange;
+        if ((activeCpu->exitMode & EmAddressOutOfRange) != 0)
+            {
+            /*
+            **  Exit mode selected.
+            */
+            activeCpu->isStopped = TRUE;
+
+            if (activeCpu->regRaCm < cpuMaxMemory)
+                {
+                cpMem[activeCpu->regRaCm] = ((CpWord)activeCpu->exitCondition << 48) | ((CpWord)(activeCpu->regP + 1) << 30);
+                }
+
+            activeCpu->regP = 0;
+
+            if (((features & (HasNoCejMej | IsSeries6x00)) == 0) && !activeCpu->isMonitorMode)
+                {
+                activeCpu->isErrorExitPending = TRUE;
+                }
+            }
+
+        return (TRUE);
+        }
+
+    /*
+    **  Calculate absolute address with wraparound.
+    */
+    location  = cpuAddRa(activeCpu, address);
+    location %= cpuMaxMemory;
+
+    /*
+    **  Fetch the word.
+    */
+    data = cpMem[location] & Mask60;
+
+    /*
+    **  Mask the destination position.
+    */
+    data &= ~(((CpWord)Mask6) << ((9 - pos) * 6));
+
+    /*
+    **  Store byte into position
+    */
+    data |= (((CpWord)byte) << ((9 - pos) * 6));
+
+    /*
+    **  Store the word.
+    */
+    cpMem[location] = data & Mask60;
+
+    return (FALSE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        CMU determine how many characters starting at a given
+**                  position can be accessed without an address error.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**                  address     CM word address
+**                  pos         character position
+**
+**  Returns:        Number of accessible characters.
+**
+**------------------------------------------------------------------------*/
+static u32 cpuCmuCharsInRange(CpuContext *activeCpu, u32 address, u32 pos)
+    {
+    u32 limit;
+
+    /*
+    **  This is the range accepted by cpuCmuGetByte and cpuCmuPutByte.
+    */
+    if (activeCpu->regRaCm >= cpuMaxMemory)
+        {
+        return (0);
+        }
+
+    limit = activeCpu->regFlCm;
+    if (cpuMaxMemory - activeCpu->regRaCm < limit)
+        {
+        limit = cpuMaxMemory - activeCpu->regRaCm;
+        }
+
+    if (address >= limit)
+        {
+        return (0);
+        }
+
+    return ((limit - address) * 10 - pos);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        CMU fetch ten consecutive characters as a 60 bit word.
+**                  The caller guarantees that all ten are in range.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**                  address     CM word address of first character
+**                  pos         position of first character
+**
+**  Returns:        Characters, first one in the upper six bits.
+**
+**------------------------------------------------------------------------*/
+static CpWord cpuCmuFetchChars(CpuContext *activeCpu, u32 address, u32 pos)
+    {
+    CpWord data;
+
+    data = cpMem[cpuAddRa(activeCpu, address) % cpuMaxMemory] & Mask60;
+    if (pos != 0)
+        {
+        data   = (data << (pos * 6)) & Mask60;
+        data  |= (cpMem[cpuAddRa(activeCpu, address + 1) % cpuMaxMemory] & Mask60) >> ((10 - pos) * 6);
+        }
+
+    return (data);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        CMU move a character string.
+**
+**                  The accessible part of both strings is determined up
+**                  front. Once the destination is word aligned, whole
+**                  words are assembled from the source and stored at
+**                  once. A destination which overlaps the source further
+**                  up is moved character by character, because such a
+**                  move propagates characters already moved.
+**
+**                  If a string runs out of range, the failing access is
+**                  repeated through cpuCmuGetByte/cpuCmuPutByte, which
+**                  raise the exit condition exactly as before.
+**
+**  Parameters:     Name        Description.
+**                  activeCpu   Pointer to CPU context
+**                  k1, c1      source word address and character position
+**                  k2, c2      destination word address and character position
+**                  ll          number of characters
+**
+**  Returns:        TRUE if the CPU was stopped by an error exit.
+**
+**------------------------------------------------------------------------*/
+static bool cpuCmuMove(CpuContext *activeCpu, u32 k1, u32 c1, u32 k2, u32 c2, u32 ll)
+    {
+    u8     byte;
+    CpWord data;
+    u32    location;
+    u32    n;
+    u32    shift;
+
+    n = cpuCmuCharsInRange(activeCpu, k1, c1);
+    if (n > cpuCmuCharsInRange(activeCpu, k2, c2))
+        {
+        n = cpuCmuCharsInRange(activeCpu, k2, c2);
+        }
+
+    if (n > ll)
+        {
+        n = ll;
+        }
+
+    ll -= n;
+
+    while (n > 0)
+        {
+        if ((c2 == 0) && (n >= 10)
+            && ((k2 * 10 <= k1 * 10 + c1) || (k2 * 10 >= k1 * 10 + c1 + n)))
+            {
+            /*
+            **  Whole destination word.
+            */
+            location        = cpuAddRa(activeCpu, k2) % cpuMaxMemory;
+            cpMem[location] = cpuCmuFetchChars(activeCpu, k1, c1);
+            k1 += 1;
+            k2 += 1;
+            n  -= 10;
+            continue;
+            }
+
+        /*
+        **  Single character.
+        */
+        byte            = (u8)((cpMem[cpuAddRa(activeCpu, k1) % cpuMaxMemory] >> ((9 - c1) * 6)) & Mask6);
+        shift           = (9 - c2) * 6;
+        location        = cpuAddRa(activeCpu, k2) % cpuMaxMemory;
+        data            = cpMem[location] & Mask60 & ~(((CpWord)Mask6) << shift);
+        cpMem[location] = data | ((CpWord)byte << shift);
+
+        if (++c1 > 9)
+            {
+            c1  = 0;
+            k1 += 1;
+            }
+
+        if (++c2 > 9)
+            {
+            c2  = 0;
+            k2 += 1;
+            }
+
+        n -= 1;
+        }
+
+    if (ll == 0)
+        {
+        return (FALSE);
+        }
 
     /*
-    **  Extract and return the byte.
+    **  The next access fails.
     */
-    *byte = (u8)((data >> ((9 - pos) * 6)) & Mask6);
+    if (cpuCmuGetByte(activeCpu, k1, c1, &byte)
+        || cpuCmuPutByte(activeCpu, k2, c2, byte))
+        {
+        return (activeCpu->isStopped);
+        }
 
     return (FALSE);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        CMU put a byte.
+**  Purpose:        CMU compare two character strings.
+**
+**                  Equal runs of ten characters are skipped a word at a
+**                  time; characters are only examined one by one from
+**                  the first difference.
 **
 **  Parameters:     Name        Description.
 **                  activeCpu   Pointer to CPU context
-**                  address     CM word address
-**                  pos         character position
-**                  byte        data byte to put
+**                  k1, c1      first string word address and character position
+**                  k2, c2      second string word address and character position
+**                  ll          number of characters
+**                  isCollated  TRUE if differing characters are compared
+**                              through the collating table at A0
+**                  result      pointer to result for X0
 **
-**  Returns:        TRUE if access failed, FALSE otherwise.
+**  Returns:        TRUE if the CPU was stopped by an error exit.
 **
 **------------------------------------------------------------------------*/
-static bool cpuCmuPutByte(CpuContext *activeCpu, u32 address, u32 pos, u8 byte)
+static bool cpuCmuCompare(CpuContext *activeCpu, u32 k1, u32 c1, u32 k2, u32 c2, u32 ll, bool isCollated, CpWord *result)
     {
-    u32    location;
-    CpWord data;
+    u8     byte1, byte2;
+    u32    collTable;
+    CpWord diff;
+    u32    n;
+    u32    skip;
 
-    /*
-    **  Validate access.
-    */
-    if ((address >= activeCpu->regFlCm) || (activeCpu->regRaCm + address >= cpuMaxMemory))
+    *result   = 0;
+    collTable = activeCpu->regA[0];
+
+    n = cpuCmuCharsInRange(activeCpu, k1, c1);
+    if (n > cpuCmuCharsInRange(activeCpu, k2, c2))
         {
-        activeCpu->exitCondition |= EcAddressOutOfRange;
-        if ((activeCpu->exitMode & EmAddressOutOfRange) != 0)
+        n = cpuCmuCharsInRange(activeCpu, k2, c2);
+        }
+
+    if (n > ll)
+        {
+        n = ll;
+        }
+
+    while (n > 0)
+        {
+        if (n >= 10)
             {
+            diff = cpuCmuFetchChars(activeCpu, k1, c1) ^ cpuCmuFetchChars(activeCpu, k2, c2);
+
             /*
-            **  Exit mode selected.
+            **  Skip the leading equal characters.
             */
-            activeCpu->isStopped = TRUE;
+            for (skip = 0; skip < 10 && ((diff >> ((9 - skip) * 6)) & Mask6) == 0; skip++)
+                {
+                }
 
-            if (activeCpu->regRaCm < cpuMaxMemory)
+            c1 += skip;
+            k1 += c1 / 10;
+            c1 %= 10;
+            c2 += skip;
+            k2 += c2 / 10;
+            c2 %= 10;
+            n  -= skip;
+            ll -= skip;
+            if (skip == 10)
                 {
-                cpMem[activeCpu->regRaCm] = ((CpWord)activeCpu->exitCondition << 48) | ((CpWord)(activeCpu->regP + 1) << 30);
+                continue;
                 }
+            }
 
-            activeCpu->regP = 0;
+        byte1 = (u8)((cpMem[cpuAddRa(activeCpu, k1) % cpuMaxMemory] >> ((9 - c1) * 6)) & Mask6);
+        byte2 = (u8)((cpMem[cpuAddRa(activeCpu, k2) % cpuMaxMemory] >> ((9 - c2) * 6)) & Mask6);
 
-            if (((features & (HasNoCejMej | IsSeries6x00)) == 0) && !activeCpu->isMonitorMode)
+        if ((byte1 != byte2) && isCollated)
+            {
+            /*
+            **  Bytes differ - check using collating table.
+            */
+            if (cpuCmuGetByte(activeCpu, collTable + ((byte1 >> 3) & Mask3), byte1 & Mask3, &byte1)
+                || cpuCmuGetByte(activeCpu, collTable + ((byte2 >> 3) & Mask3), byte2 & Mask3, &byte2))
                 {
-                activeCpu->isErrorExitPending = TRUE;
+                return (activeCpu->isStopped);
                 }
             }
 
-        return (TRUE);
-        }
+        if (byte1 != byte2)
+            {
+            /*
+            **  Terminate comparision and calculate result.
+            */
+            *result = ll;
+            if (byte1 < byte2)
+                {
+                *result = ~*result & Mask60;
+                }
 
-    /*
-    **  Calculate absolute address with wraparound.
-    */
-    location  = cpuAddRa(activeCpu, address);
-    location %= cpuMaxMemory;
+            return (FALSE);
+            }
 
-    /*
-    **  Fetch the word.
-    */
-    data = cpMem[location] & Mask60;
+        if (++c1 > 9)
+            {
+            c1  = 0;
+            k1 += 1;
+            }
 
-    /*
-    **  Mask the destination position.
-    */
-    data &= ~(((CpWord)Mask6) << ((9 - pos) * 6));
+        if (++c2 > 9)
+            {
+            c2  = 0;
+            k2 += 1;
+            }
 
-    /*
-    **  Store byte into position
-    */
-    data |= (((CpWord)byte) << ((9 - pos) * 6));
+        n  -= 1;
+        ll -= 1;
+        }
+
+    if (ll == 0)
+        {
+        return (FALSE);
+        }
 
     /*
-    **  Store the word.
+    **  The next access fails.
     */
-    cpMem[location] = data & Mask60;
+    if (cpuCmuGetByte(activeCpu, k1, c1, &byte1)
+        || cpuCmuGetByte(activeCpu, k2, c2, &byte2))
+        {
+        return (activeCpu->isStopped);
+        }
 
     return (FALSE);
     }
@@ -2799,11 +4086,8 @@ static void cpuCmuMoveIndirect(CpuContext *activeCpu)
     u32    k1, k2;
     u32    c1, c2;
     u32    ll;
-    u8     byte;
     bool   failed;
 
-    //<<<<<<<<<<<<<<<<<<<<<<<< don't forget to optimise c1 == c2 cases.
-
     /*
     **  Fetch the descriptor word.
     */
@@ -2861,39 +4145,9 @@ static void cpuCmuMoveIndirect(CpuContext *activeCpu)
     /*
     **  Perform the actual move.
     */
-    while (ll--)
+    if (cpuCmuMove(activeCpu, k1, c1, k2, c2, ll))
         {
-        /*
-        **  Transfer one byte, but abort if access fails.
-        */
-        if (cpuCmuGetByte(activeCpu, k1, c1, &byte)
-            || cpuCmuPutByte(activeCpu, k2, c2, byte))
-            {
-            if (activeCpu->isStopped) //????????????????????????
-                {
-                return;
-                }
-
-            /*
-            **  Exit to next instruction.
-            */
-            break;
-            }
-
-        /*
-        **  Advance addresses.
-        */
-        if (++c1 > 9)
-            {
-            c1  = 0;
-            k1 += 1;
-            }
-
-        if (++c2 > 9)
-            {
-            c2  = 0;
-            k2 += 1;
-            }
+        return;
         }
 
     /*
@@ -2922,9 +4176,6 @@ static void cpuCmuMoveDirect(CpuContext *activeCpu)
     u32 k1, k2;
     u32 c1, c2;
     u32 ll;
-    u8  byte;
-
-    //<<<<<<<<<<<<<<<<<<<<<<<< don't forget to optimise c1 == c2 cases.
 
     /*
     **  Decode opcode word.
@@ -2972,39 +4223,9 @@ static void cpuCmuMoveDirect(CpuContext *activeCpu)
     /*
     **  Perform the actual move.
     */
-    while (ll--)
+    if (cpuCmuMove(activeCpu, k1, c1, k2, c2, ll))
         {
-        /*
-        **  Transfer one byte, but abort if access fails.
-        */
-        if (cpuCmuGetByte(activeCpu, k1, c1, &byte)
-            || cpuCmuPutByte(activeCpu, k2, c2, byte))
-            {
-            if (activeCpu->isStopped) //?????????????????????
-                {
-                return;
-                }
-
-            /*
-            **  Exit to next instruction.
-            */
-            break;
-            }
-
-        /*
-        **  Advance addresses.
-        */
-        if (++c1 > 9)
-            {
-            c1  = 0;
-            k1 += 1;
-            }
-
-        if (++c2 > 9)
-            {
-            c2  = 0;
-            k2 += 1;
-            }
+        return;
         }
 
     /*
@@ -3035,7 +4256,6 @@ static void cpuCmuCompareCollated(CpuContext *activeCpu)
     u32    c1, c2;
     u32    ll;
     u32    collTable;
-    u8     byte1, byte2;
 
     /*
     **  Decode opcode word.
@@ -3088,74 +4308,9 @@ static void cpuCmuCompareCollated(CpuContext *activeCpu)
     /*
     **  Perform the actual compare.
     */
-    while (ll--)
+    if (cpuCmuCompare(activeCpu, k1, c1, k2, c2, ll, TRUE, &result))
         {
-        /*
-        **  Check the two bytes raw.
-        */
-        if (cpuCmuGetByte(activeCpu, k1, c1, &byte1)
-            || cpuCmuGetByte(activeCpu, k2, c2, &byte2))
-            {
-            if (activeCpu->isStopped) //?????????????????????
-                {
-                return;
-                }
-
-            /*
-            **  Exit to next instruction.
-            */
-            break;
-            }
-
-        if (byte1 != byte2)
-            {
-            /*
-            **  Bytes differ - check using collating table.
-            */
-            if (cpuCmuGetByte(activeCpu, collTable + ((byte1 >> 3) & Mask3), byte1 & Mask3, &byte1)
-                || cpuCmuGetByte(activeCpu, collTable + ((byte2 >> 3) & Mask3), byte2 & Mask3, &byte2))
-                {
-                if (activeCpu->isStopped) //??????????????????????
-                    {
-                    return;
-                    }
-
-                /*
-                **  Exit to next instruction.
-                */
-                break;
-                }
-
-            if (byte1 != byte2)
-                {
-                /*
-                **  Bytes differ in their collating sequence as well - terminate comparision
-                **  and calculate result.
-                */
-                result = ll + 1;
-                if (byte1 < byte2)
-                    {
-                    result = ~result & Mask60;
-                    }
-
-                break;
-                }
-            }
-
-        /*
-        **  Advance addresses.
-        */
-        if (++c1 > 9)
-            {
-            c1  = 0;
-            k1 += 1;
-            }
-
-        if (++c2 > 9)
-            {
-            c2  = 0;
-            k2 += 1;
-            }
+        return;
         }
 
     /*
@@ -3185,7 +4340,6 @@ static void cpuCmuCompareUncollated(CpuContext *activeCpu)
     u32    k1, k2;
     u32    c1, c2;
     u32    ll;
-    u8     byte1, byte2;
 
     /*
     **  Decode opcode word.
@@ -3233,54 +4387,9 @@ static void cpuCmuCompareUncollated(CpuContext *activeCpu)
     /*
     **  Perform the actual compare.
     */
-    while (ll--)
+    if (cpuCmuCompare(activeCpu, k1, c1, k2, c2, ll, FALSE, &result))
         {
-        /*
-        **  Check the two bytes raw.
-        */
-        if (cpuCmuGetByte(activeCpu, k1, c1, &byte1)
-            || cpuCmuGetByte(activeCpu, k2, c2, &byte2))
-            {
-            if (activeCpu->isStopped) //?????????????????
-                {
-                return;
-                }
-
-            /*
-            **  Exit to next instruction.
-            */
-            break;
-            }
-
-        if (byte1 != byte2)
-            {
-            /*
-            **  Bytes differ - terminate comparision
-            **  and calculate result.
-            */
-            result = ll + 1;
-            if (byte1 < byte2)
-                {
-                result = ~result & Mask60;
-                }
-
-            break;
-            }
-
-        /*
-        **  Advance addresses.
-        */
-        if (++c1 > 9)
-            {
-            c1  = 0;
-            k1 += 1;
-            }
-
-        if (++c2 > 9)
-            {
-            c2  = 0;
-            k2 += 1;
-            }
+        return;
         }
 
     /*
@@ -3462,9 +4571,13 @@ static void cpOp01(CpuContext *activeCpu)
             return;
             }
 
-        cpuAcquireExchangeMutex();
-        if (activeCpu->ppRequestingExchange == -1
-            && (monitorCpu == -1 || monitorCpu == activeCpu->id))
+        if (!cpuAtomicSwap(&activeCpu->ppRequestingExchange, ExchangeIdle, ExchangeClaimed))
+            {
+            activeCpu->exchangesDeferred += 1;
+            activeCpu->opOffset = 60; // arrange to re-execute XJ
+            break;
+            }
+        if (cpuClaimMonitor(activeCpu))
             {
             activeCpu->regP      = (activeCpu->regP + 1) & Mask18;
             activeCpu->isStopped = TRUE;
@@ -3474,9 +4587,10 @@ static void cpOp01(CpuContext *activeCpu)
             }
         else
             {
+            activeCpu->exchangesDeferred += 1;
             activeCpu->opOffset = 60; // arrange to re-execute XJ
             }
-        cpuReleaseExchangeMutex();
+        cpuAtomicStore(&activeCpu->ppRequestingExchange, ExchangeIdle);
         break;
 
     case 4:
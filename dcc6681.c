@@ -79,7 +79,7 @@ static void dcc6681Disconnect(void);
 **  Public Variables
 **  ----------------
 */
-DevSlot *active3000Device;
+ThreadLocal DevSlot *active3000Device;
 
 /*
 **  -----------------
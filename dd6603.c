@@ -118,6 +118,16 @@ typedef struct diskParam
     i32              sector;
     i32              track;
     i32              head;
+
+    /*
+    **  Sector buffer. Reads are prefetched by the disk I/O thread and
+    **  writes are queued to it a sector at a time.
+    */
+    PpWord           buffer[SectorSize];
+    i32              bufPosition;
+    int              bufIndex;
+    bool             isDirty;
+    DiskIoRequest    *prefetch;
     } DiskParam;
 
 /*
@@ -129,6 +139,7 @@ static FcStatus dd6603Func(PpWord funcCode);
 static void dd6603Io(void);
 static void dd6603Activate(void);
 static void dd6603Disconnect(void);
+static void dd6603Flush(DiskParam *dp, FILE *fcb);
 static i32 dd6603Seek(i32 track, i32 head, i32 sector);
 static char *dd6603Func2String(PpWord funcCode);
 
@@ -301,6 +312,7 @@ void dd6603Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
     diskP->unitNo    = unitNo;
 
     dp->fcb[unitNo] = fcb;
+    diskIoInit();
 
     /*
     **  Link into list of disk units.
@@ -323,6 +335,39 @@ void dd6603Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
     printf("(dd6603 ) Initialised on channel %o unit %o\n", channelNo, unitNo);
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Write buffered data of all units to the disk containers.
+**
+**  Parameters:     Name        Description.
+**                  ds          Device slot.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void dd6603Terminate(DevSlot *ds)
+    {
+    DiskParam *dp;
+    int       unitNo;
+
+    for (unitNo = 0; unitNo < MaxUnits; unitNo++)
+        {
+        dp = (DiskParam *)ds->context[unitNo];
+        if (dp == NULL)
+            {
+            continue;
+            }
+
+        dd6603Flush(dp, ds->fcb[unitNo]);
+        if (dp->prefetch != NULL)
+            {
+            diskIoCancel(dp->prefetch);
+            dp->prefetch = NULL;
+            }
+        }
+
+    diskIoDrain();
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Execute function code on 6603 disk drive.
 **
@@ -361,7 +406,19 @@ static FcStatus dd6603Func(PpWord funcCode)
             {
             return (FcDeclined);
             }
-        fseek(fcb, pos, SEEK_SET);
+
+        /*
+        **  Start fetching the sector while the PP gets ready for input.
+        */
+        dd6603Flush(dp, fcb);
+        if (dp->prefetch != NULL)
+            {
+            diskIoCancel(dp->prefetch);
+            }
+
+        dp->bufPosition = pos;
+        dp->bufIndex    = 0;
+        dp->prefetch    = diskIoStartRead(fcb, sizeof dp->buffer, pos);
         logColumn = 0;
         break;
 
@@ -373,7 +430,16 @@ static FcStatus dd6603Func(PpWord funcCode)
             {
             return (FcDeclined);
             }
-        fseek(fcb, pos, SEEK_SET);
+
+        dd6603Flush(dp, fcb);
+        if (dp->prefetch != NULL)
+            {
+            diskIoCancel(dp->prefetch);
+            dp->prefetch = NULL;
+            }
+
+        dp->bufPosition = pos;
+        dp->bufIndex    = 0;
         logColumn = 0;
         break;
 
@@ -420,8 +486,6 @@ static FcStatus dd6603Func(PpWord funcCode)
 **------------------------------------------------------------------------*/
 static void dd6603Io(void)
     {
-    int ignore;
-
     FILE      *fcb = activeDevice->fcb[activeDevice->selectedUnit];
     DiskParam *dp  = (DiskParam *)activeDevice->context[activeDevice->selectedUnit];
 
@@ -437,7 +501,31 @@ static void dd6603Io(void)
     case Fc6603ReadSector:
         if (!activeChannel->full)
             {
-            ignore = fread(&activeChannel->data, 2, 1, fcb);
+            /*
+            **  Present no data until the sector has been fetched.
+            */
+            if (dp->prefetch != NULL)
+                {
+                if (!diskIoIsDone(dp->prefetch))
+                    {
+                    break;
+                    }
+
+                diskIoFinishRead(dp->prefetch, (u8 *)dp->buffer);
+                dp->prefetch = NULL;
+                }
+
+            /*
+            **  Reading past the end of the sector continues with the next one.
+            */
+            if (dp->bufIndex >= SectorSize)
+                {
+                dp->bufPosition += sizeof dp->buffer;
+                dp->bufIndex     = 0;
+                diskIoRead(fcb, (u8 *)dp->buffer, sizeof dp->buffer, dp->bufPosition);
+                }
+
+            activeChannel->data = dp->buffer[dp->bufIndex++];
             activeChannel->full = TRUE;
 
 #if DEBUG
@@ -449,7 +537,15 @@ static void dd6603Io(void)
     case Fc6603WriteSector:
         if (activeChannel->full)
             {
-            fwrite(&activeChannel->data, 2, 1, fcb);
+            dp->buffer[dp->bufIndex++] = activeChannel->data;
+            dp->isDirty                = TRUE;
+            if (dp->bufIndex >= SectorSize)
+                {
+                dd6603Flush(dp, fcb);
+                dp->bufPosition += sizeof dp->buffer;
+                dp->bufIndex     = 0;
+                }
+
             activeChannel->full = FALSE;
 
 #if DEBUG
@@ -505,6 +601,32 @@ static void dd6603Activate(void)
 **------------------------------------------------------------------------*/
 static void dd6603Disconnect(void)
     {
+    /*
+    **  Write a partially transferred sector.
+    */
+    dd6603Flush((DiskParam *)activeDevice->context[activeDevice->selectedUnit],
+                activeDevice->fcb[activeDevice->selectedUnit]);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Queue the write of buffered sector data.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd6603Flush(DiskParam *dp, FILE *fcb)
+    {
+    if (!dp->isDirty)
+        {
+        return;
+        }
+
+    diskIoWrite(fcb, (u8 *)dp->buffer, dp->bufIndex * sizeof(PpWord), dp->bufPosition);
+    dp->isDirty = FALSE;
     }
 
 /*--------------------------------------------------------------------------
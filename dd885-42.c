@@ -137,6 +137,13 @@ typedef struct diskParam
     PpWord           emAddress[2];
     PpWord           writeParams[4];
     Sector           buffer;
+
+    /*
+    **  Container position and outstanding asynchronous read.
+    */
+    i32              position;
+    DiskIoRequest    *prefetch;
+    i32              prefetchPosition;
     } DiskParam;
 
 /*
@@ -150,6 +157,8 @@ static void dd885_42Activate(void);
 static void dd885_42Disconnect(void);
 static i32 dd885_42Seek(DiskParam *dp);
 static i32 dd885_42SeekNext(DiskParam *dp);
+static bool dd885_42IsSectorReady(DiskParam *dp);
+static void dd885_42Prefetch(DiskParam *dp, FILE *fcb);
 static bool dd885_42Read(DiskParam *dp, FILE *fcb);
 static bool dd885_42Write(DiskParam *dp, FILE *fcb);
 static char * dd885_42Func2String(PpWord funcCode);
@@ -472,7 +481,13 @@ void dd885_42Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
     dp->cylinder = 0;
     dp->track    = 0;
     dp->sector   = 0;
-    fseek(fcb, dd885_42Seek(dp), SEEK_SET);
+    dp->position = dd885_42Seek(dp);
+
+    /*
+    **  All further container I/O is done by the disk I/O thread.
+    */
+    fflush(fcb);
+    diskIoInit();
 
     /*
     **  Print a friendly message.
@@ -502,7 +517,6 @@ static FcStatus dd885_42Func(PpWord funcCode)
     {
     i8        unitNo;
     FILE      *fcb;
-    int       ignore;
     DiskParam *dp;
 
     unitNo = activeDevice->selectedUnit;
@@ -654,7 +668,8 @@ static FcStatus dd885_42Func(PpWord funcCode)
     case Fc885_42ReadFactoryData:
     case Fc885_42ReadUtilityMap:
     case Fc885_42ReadProtectedSector:
-        ignore = fread(&dp->buffer, sizeof dp->buffer, 1, fcb);
+        diskIoRead(fcb, (u8 *)&dp->buffer, sizeof dp->buffer, dp->position);
+        dp->position += sizeof dp->buffer;
         activeDevice->recordLength = ShortSectorSize * 5 + 2;
         break;
         }
@@ -749,7 +764,8 @@ static void dd885_42Io(void)
                     pos        = dd885_42Seek(dp);
                     if ((pos >= 0) && (fcb != NULL))
                         {
-                        fseek(fcb, pos, SEEK_SET);
+                        dp->position = pos;
+                        dd885_42Prefetch(dp, fcb);
                         }
                     }
                 else
@@ -774,6 +790,15 @@ static void dd885_42Io(void)
     case Fc885_42Read:
         if (activeChannel->full)
             {
+            /*
+            **  Leave the last address word on the channel until the
+            **  sector has been fetched.
+            */
+            if ((dp != NULL) && (activeDevice->recordLength == 1) && !dd885_42IsSectorReady(dp))
+                {
+                break;
+                }
+
             if (dp != NULL)
                 {
                 switch (activeDevice->recordLength--)
@@ -789,7 +814,8 @@ static void dd885_42Io(void)
                         pos = dd885_42SeekNext(dp);
                         if ((pos >= 0) && (fcb != NULL))
                             {
-                            fseek(fcb, pos, SEEK_SET);
+                            dp->position = pos;
+                            dd885_42Prefetch(dp, fcb);
                             }
                         }
                     break;
@@ -841,7 +867,7 @@ static void dd885_42Io(void)
                         pos = dd885_42SeekNext(dp);
                         if ((pos >= 0) && (fcb != NULL))
                             {
-                            fseek(fcb, pos, SEEK_SET);
+                            dp->position = pos;
                             }
                         }
                     break;
@@ -1130,12 +1156,21 @@ static bool dd885_42Read(DiskParam *dp, FILE *fcb)
     CpWord *data;
     u32    emAddress;
     int    i;
-    int    ignore;
 
     activeDevice->status  = 0;
     dp->detailedStatus[2] = Fc885_42Read << 4;
 
-    ignore = fread(&dp->buffer, sizeof dp->buffer, 1, fcb);
+    if ((dp->prefetch != NULL) && (dp->prefetchPosition == dp->position))
+        {
+        diskIoFinishRead(dp->prefetch, (u8 *)&dp->buffer);
+        dp->prefetch = NULL;
+        }
+    else
+        {
+        diskIoRead(fcb, (u8 *)&dp->buffer, sizeof dp->buffer, dp->position);
+        }
+
+    dp->position += sizeof dp->buffer;
     activeDevice->status = 0;
     dp->generalStatus[3] = dp->buffer.control[0];
     dp->generalStatus[4] = dp->buffer.control[1];
@@ -1230,11 +1265,65 @@ static bool dd885_42Write(DiskParam *dp, FILE *fcb)
         return FALSE;
         }
 
-    fwrite(&dp->buffer, sizeof dp->buffer, 1, fcb);
+    if ((dp->prefetch != NULL) && (dp->prefetchPosition == dp->position))
+        {
+        diskIoCancel(dp->prefetch);
+        dp->prefetch = NULL;
+        }
+
+    diskIoWrite(fcb, (u8 *)&dp->buffer, sizeof dp->buffer, dp->position);
+    dp->position += sizeof dp->buffer;
 
     return TRUE;
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Queue an asynchronous read of the sector at the current
+**                  position, replacing any earlier prefetch.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd885_42Prefetch(DiskParam *dp, FILE *fcb)
+    {
+    if (dp->prefetch != NULL)
+        {
+        if (dp->prefetchPosition == dp->position)
+            {
+            return;
+            }
+
+        diskIoCancel(dp->prefetch);
+        }
+
+    dp->prefetchPosition = dp->position;
+    dp->prefetch         = diskIoStartRead(fcb, sizeof dp->buffer, dp->position);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Check if the sector at the current position can be
+**                  transferred without waiting for the disk I/O thread.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**
+**  Returns:        TRUE if the sector is available or was not prefetched.
+**
+**------------------------------------------------------------------------*/
+static bool dd885_42IsSectorReady(DiskParam *dp)
+    {
+    if ((dp->prefetch == NULL) || (dp->prefetchPosition != dp->position))
+        {
+        return (TRUE);
+        }
+
+    return (diskIoIsDone(dp->prefetch));
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Convert function code to string.
 **
@@ -39,6 +39,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
 #include "const.h"
 #include "types.h"
 #include "proto.h"
@@ -176,6 +179,18 @@
 #define CtClassic            1
 #define CtPacked             2
 
+/*
+**  Sector cache geometry. Each unit caches container sectors in a set
+**  associative cache with LRU replacement within a set. Consecutive
+**  sectors map to consecutive sets.
+*/
+#define CacheSets            256
+#define CacheWays            4
+#define CacheSectors         (CacheSets * CacheWays)
+#define CacheReadAhead       16
+#define CacheDirtyLimit      64
+#define MaxContainerSector   (SectorSize * 2)
+
 /*
 **  -----------------------
 **  Private Macro Functions
@@ -194,6 +209,13 @@ typedef struct diskSize
     i32 maxSectors;
     } DiskSize;
 
+typedef struct diskCacheEntry
+    {
+    i32 block;                          /* container sector number, -1 if free */
+    u32 lastUse;                        /* LRU clock value of last use */
+    bool dirty;                         /* TRUE if not yet written back */
+    } DiskCacheEntry;
+
 typedef struct diskParam
     {
     /*
@@ -221,6 +243,28 @@ typedef struct diskParam
     u8               diskType;
     PpWord           buffer[SectorSize];
     PpWord           *bufPtr;
+    i32              position;          /* byte offset of next container sector */
+
+    /*
+    **  Sector cache and its statistics.
+    */
+    DiskCacheEntry   cache[CacheSectors];
+    u8               *cacheData;
+    u32              cacheClock;
+    u32              dirtyCount;
+    u64              cacheHits;
+    u64              cacheMisses;
+    u64              fileReads;
+    u64              fileReadUsecs;
+    u64              fileWrites;
+
+    /*
+    **  Outstanding asynchronous read ahead.
+    */
+    DiskIoRequest    *prefetch;
+    i32              prefetchBlock;
+    i32              prefetchCount;
+    u64              prefetchHits;
     } DiskParam;
 
 /*
@@ -229,14 +273,27 @@ typedef struct diskParam
 **  ---------------------------
 */
 static void     dd8xxActivate(void);
+static void     dd8xxCacheFlush(DiskParam *dp, FILE *fcb);
+static void     dd8xxCacheInvalidate(DiskParam *dp);
+static DiskCacheEntry *dd8xxCacheLookup(DiskParam *dp, i32 block);
+static u8      *dd8xxCacheRead(DiskParam *dp, FILE *fcb);
+static u8      *dd8xxCacheSlot(DiskParam *dp, FILE *fcb, i32 block);
+static void     dd8xxCacheWrite(DiskParam *dp, FILE *fcb, u8 *data);
+static int      dd8xxCompareBlocks(const void *a, const void *b);
 static void     dd8xxDisconnect(void);
 static void     dd8xxDump(PpWord data);
+static void     dd8xxFileRead(DiskParam *dp, FILE *fcb, u8 *buf, int len, i32 offset);
+static void     dd8xxFileWrite(DiskParam *dp, FILE *fcb, u8 *buf, int len, i32 offset);
 static void     dd8xxFlush(void);
 static FcStatus dd8xxFunc(PpWord funcCode);
 static char    *dd8xxFunc2String(PpWord funcCode);
 static void     dd8xxInit(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName, DiskSize *size, u8 diskType);
 static void     dd8xxIo(void);
+static bool     dd8xxIsSectorReady(DiskParam *dp);
 static FILE    *dd8xxMount(char *deviceName, DiskParam *dp);
+static void     dd8xxPrefetch(DiskParam *dp, FILE *fcb);
+static void     dd8xxPrefetchCancel(DiskParam *dp);
+static i32      dd8xxReadAheadCount(DiskParam *dp, i32 block);
 static PpWord   dd8xxReadClassic(DiskParam *dp, FILE *fcb);
 static PpWord   dd8xxReadPacked(DiskParam *dp, FILE *fcb);
 static void     dd8xxSectorRead(DiskParam *dp, FILE *fcb, PpWord *sector);
@@ -610,8 +667,12 @@ void dd8xxUnloadDisk(char *params)
         }
 
     /*
-    **  Close the file.
+    **  Write back cached sectors and close the file.
     */
+    dd8xxPrefetchCancel(dp);
+    dd8xxCacheFlush(dp, ds->fcb[unitNo]);
+    dd8xxCacheInvalidate(dp);
+    diskIoDrain();
     fclose(ds->fcb[unitNo]);
     ds->fcb[unitNo] = NULL;
 
@@ -624,6 +685,41 @@ void dd8xxUnloadDisk(char *params)
     opDisplay(outBuf);
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Terminate 8xx disk drives on a channel and write back
+**                  cached sectors.
+**
+**  Parameters:     Name        Description.
+**                  ds          Device control block.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void dd8xxTerminate(DevSlot *ds)
+    {
+    DiskParam *dp;
+    u8        unitNo;
+
+    for (unitNo = 0; unitNo < MaxUnits; unitNo++)
+        {
+        dp = (DiskParam *)ds->context[unitNo];
+        if (dp == NULL)
+            {
+            continue;
+            }
+
+        dd8xxPrefetchCancel(dp);
+        dd8xxCacheFlush(dp, ds->fcb[unitNo]);
+        free(dp->cacheData);
+        dp->cacheData = NULL;
+        }
+
+    /*
+    **  The containers are closed by the caller once all writes are done.
+    */
+    diskIoDrain();
+    }
+
 /*
  **--------------------------------------------------------------------------
  **
@@ -761,6 +857,19 @@ static void dd8xxInit(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName, DiskSi
         break;
         }
 
+    /*
+    **  Allocate the sector cache.
+    */
+    dp->cacheData = (u8 *)calloc(CacheSectors, dp->sectorSize);
+    if (dp->cacheData == NULL)
+        {
+        fprintf(stderr, "(dd8xx  ) Failed to allocate dd8xx sector cache\n");
+        exit(1);
+        }
+
+    dd8xxCacheInvalidate(dp);
+    diskIoInit();
+
     /*
     **  Initialize detailed status.
     */
@@ -884,7 +993,7 @@ static FILE *dd8xxMount(char *deviceName, DiskParam *dp)
         dp->cylinder = dp->size.maxCylinders - 1;
         dp->track    = dp->size.maxTracks - 1;
         dp->sector   = dp->size.maxSectors - 1;
-        fseek(fcb, dd8xxSeek(dp), SEEK_SET);
+        dp->position = dd8xxSeek(dp);
         dd8xxSectorWrite(dp, fcb, mySector);
 
         /*
@@ -910,7 +1019,7 @@ static FILE *dd8xxMount(char *deviceName, DiskParam *dp)
             {
             for (dp->sector = 0; dp->sector < dp->size.maxSectors; dp->sector++)
                 {
-                fseek(fcb, dd8xxSeek(dp), SEEK_SET);
+                dp->position = dd8xxSeek(dp);
                 dd8xxSectorWrite(dp, fcb, mySector);
                 }
             }
@@ -934,10 +1043,15 @@ static FILE *dd8xxMount(char *deviceName, DiskParam *dp)
         mySector[2] = (dd / 10) << 8 | (dd % 10) << 4 | mm / 10;
         mySector[3] = (mm % 10) << 8 | (yy / 10) << 4 | yy % 10;
 
-        dp->track  = 0;
-        dp->sector = 0;
-        fseek(fcb, dd8xxSeek(dp), SEEK_SET);
+        dp->track    = 0;
+        dp->sector   = 0;
+        dp->position = dd8xxSeek(dp);
         dd8xxSectorWrite(dp, fcb, mySector);
+
+        /*
+        **  Make sure the new container is complete on disk.
+        */
+        dd8xxCacheFlush(dp, fcb);
         }
 
     /*
@@ -952,7 +1066,7 @@ static FILE *dd8xxMount(char *deviceName, DiskParam *dp)
     dp->track     = 0;
     dp->sector    = 0;
     dp->interlace = 1;
-    fseek(fcb, dd8xxSeek(dp), SEEK_SET);
+    dp->position  = dd8xxSeek(dp);
 
     return fcb;
     }
@@ -1094,6 +1208,7 @@ static FcStatus dd8xxFunc(PpWord funcCode)
     case Fc8xxReadFlawedSector:
     case Fc8xxGapRead:
         activeDevice->recordLength = SectorSize;
+        dd8xxPrefetch(dp, fcb);
         break;
 
     case Fc8xxWrite:
@@ -1108,6 +1223,11 @@ static FcStatus dd8xxFunc(PpWord funcCode)
         break;
 
     case Fc8xxOpComplete:
+        if (fcb != NULL)
+            {
+            dd8xxCacheFlush(dp, fcb);
+            }
+
         return (FcProcessed);
 
     case Fc8xxDropSeeks:
@@ -1186,6 +1306,11 @@ static FcStatus dd8xxFunc(PpWord funcCode)
         break;
 
     case Fc8xxDriveRelease:
+        if (fcb != NULL)
+            {
+            dd8xxCacheFlush(dp, fcb);
+            }
+
         return (FcProcessed);
 
     case Fc8xxDeadstart:
@@ -1212,8 +1337,9 @@ static FcStatus dd8xxFunc(PpWord funcCode)
             break;
         }
 
-        fseek(fcb, dd8xxSeek(dp), SEEK_SET);
+        dp->position = dd8xxSeek(dp);
         activeDevice->recordLength = SectorSize;
+        dd8xxPrefetch(dp, fcb);
         break;
 
     case Fc8xxSetClearFlaw:
@@ -1387,7 +1513,7 @@ static void dd8xxIo(void)
                     pos        = dd8xxSeek(dp);
                     if ((pos >= 0) && (fcb != NULL))
                         {
-                        fseek(fcb, pos, SEEK_SET);
+                        dp->position = pos;
                         }
                     }
                 else
@@ -1412,6 +1538,11 @@ static void dd8xxIo(void)
     case Fc8xxDeadstart:
         if (!activeChannel->full)
             {
+            if (!dd8xxIsSectorReady(dp))
+                {
+                break;
+                }
+
             if (activeDevice->recordLength == SectorSize)
                 {
                 /*
@@ -1438,7 +1569,7 @@ static void dd8xxIo(void)
                 pos = dd8xxSeekNextSector(dp);
                 if (pos >= 0)
                     {
-                    fseek(fcb, pos, SEEK_SET);
+                    dp->position = pos;
                     }
                 }
             }
@@ -1449,6 +1580,14 @@ static void dd8xxIo(void)
     case Fc8xxGapRead:
         if (!activeChannel->full)
             {
+            /*
+            **  Present no data until the sector has been fetched.
+            */
+            if (!dd8xxIsSectorReady(dp))
+                {
+                break;
+                }
+
             activeChannel->data = dp->read(dp, fcb);
             activeChannel->full = TRUE;
 #if DEBUG
@@ -1465,7 +1604,8 @@ static void dd8xxIo(void)
                     }
                 if (pos >= 0)
                     {
-                    fseek(fcb, pos, SEEK_SET);
+                    dp->position = pos;
+                    dd8xxPrefetch(dp, fcb);
                     }
                 }
             }
@@ -1488,7 +1628,7 @@ static void dd8xxIo(void)
                 pos = dd8xxSeekNextSector(dp);
                 if (pos >= 0)
                     {
-                    fseek(fcb, pos, SEEK_SET);
+                    dp->position = pos;
                     }
                 }
             }
@@ -1810,15 +1950,13 @@ static i32 dd8xxSeekNextSector(DiskParam *dp)
 **------------------------------------------------------------------------*/
 static PpWord dd8xxReadClassic(DiskParam *dp, FILE *fcb)
     {
-    int ignore;
-
     /*
-    **  Read an entire sector if the current buffer is empty.
+    **  Fetch an entire sector if the current buffer is empty.
     */
     if (dp->bufPtr == NULL)
         {
         dp->bufPtr = dp->buffer;
-        ignore     = fread(dp->buffer, 1, dp->sectorSize, fcb);
+        memcpy(dp->buffer, dd8xxCacheRead(dp, fcb), dp->sectorSize);
         }
 
     /*
@@ -1868,7 +2006,7 @@ static void dd8xxWriteClassic(DiskParam *dp, FILE *fcb, PpWord data)
     */
     if (dp->bufPtr == dp->buffer + SectorSize)
         {
-        fwrite(dp->buffer, 1, dp->sectorSize, fcb);
+        dd8xxCacheWrite(dp, fcb, (u8 *)dp->buffer);
         }
     }
 
@@ -1884,24 +2022,21 @@ static void dd8xxWriteClassic(DiskParam *dp, FILE *fcb, PpWord data)
 **------------------------------------------------------------------------*/
 static PpWord dd8xxReadPacked(DiskParam *dp, FILE *fcb)
     {
-    u16       byteCount;
-    int       ignore;
-    static u8 sector[512];
-    u8        *sp;
-    PpWord    *pp;
+    u16    byteCount;
+    u8     *sp;
+    PpWord *pp;
 
     /*
-    **  Read an entire sector if the current buffer is empty.
+    **  Fetch an entire sector if the current buffer is empty.
     */
     if (dp->bufPtr == NULL)
         {
         dp->bufPtr = dp->buffer;
-        ignore     = fread(sector, 1, dp->sectorSize, fcb);
 
         /*
         **  Unpack the sector into the buffer.
         */
-        sp = sector;
+        sp = dd8xxCacheRead(dp, fcb);
         pp = dp->buffer;
         for (byteCount = SectorSize; byteCount > 0; byteCount -= 2)
             {
@@ -1938,10 +2073,10 @@ static PpWord dd8xxReadPacked(DiskParam *dp, FILE *fcb)
 **------------------------------------------------------------------------*/
 static void dd8xxWritePacked(DiskParam *dp, FILE *fcb, PpWord data)
     {
-    u16       byteCount;
-    static u8 sector[512];
-    u8        *sp;
-    PpWord    *pp;
+    u16    byteCount;
+    u8     sector[512];
+    u8     *sp;
+    PpWord *pp;
 
     /*
     **  Fail gracefully if we write too much data.
@@ -1981,9 +2116,10 @@ static void dd8xxWritePacked(DiskParam *dp, FILE *fcb, PpWord data)
             }
 
         /*
-        **  Write the sector.
+        **  Write the sector with its unused tail cleared.
         */
-        fwrite(sector, 1, dp->sectorSize, fcb);
+        memset(sp, 0, sector + sizeof(sector) - sp);
+        dd8xxCacheWrite(dp, fcb, sector);
         }
     }
 
@@ -2029,6 +2165,473 @@ static void dd8xxSectorWrite(DiskParam *dp, FILE *fcb, PpWord *sector)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Fetch the container sector at the current position
+**                  through the sector cache and advance the position.
+**                  A miss consumes a matching prefetch, or reads ahead
+**                  the following sectors of the current cylinder in the
+**                  same file read.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**
+**  Returns:        Pointer to cached container sector.
+**
+**------------------------------------------------------------------------*/
+static u8 *dd8xxCacheRead(DiskParam *dp, FILE *fcb)
+    {
+    static u8      readAhead[CacheReadAhead * MaxContainerSector];
+    i32            block;
+    i32            count;
+    DiskCacheEntry *ep;
+    int            i;
+
+    block        = dp->position / dp->sectorSize;
+    dp->position += dp->sectorSize;
+
+    ep = dd8xxCacheLookup(dp, block);
+    if (ep != NULL)
+        {
+        dp->cacheHits += 1;
+        ep->lastUse    = ++dp->cacheClock;
+
+        return (dp->cacheData + (ep - dp->cache) * dp->sectorSize);
+        }
+
+    dp->cacheMisses += 1;
+
+    if ((dp->prefetch != NULL) && (dp->prefetchBlock == block))
+        {
+        count = dp->prefetchCount;
+        diskIoFinishRead(dp->prefetch, readAhead);
+        dp->prefetch        = NULL;
+        dp->prefetchHits   += 1;
+        }
+    else
+        {
+        count = dd8xxReadAheadCount(dp, block);
+        dd8xxFileRead(dp, fcb, readAhead, count * dp->sectorSize, block * dp->sectorSize);
+        }
+
+    /*
+    **  Install the sectors, the last one first so that the requested
+    **  sector ends up most recently used. Sectors which were written
+    **  into the cache in the meantime hold newer data and are skipped.
+    */
+    for (i = count - 1; i >= 0; i--)
+        {
+        if ((i > 0) && (dd8xxCacheLookup(dp, block + i) != NULL))
+            {
+            continue;
+            }
+
+        memcpy(dd8xxCacheSlot(dp, fcb, block + i), readAhead + i * dp->sectorSize, dp->sectorSize);
+        }
+
+    return (dd8xxCacheSlot(dp, fcb, block));
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Look up a container sector in the sector cache.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  block       Container sector number.
+**
+**  Returns:        Pointer to cache entry, NULL if not cached.
+**
+**------------------------------------------------------------------------*/
+static DiskCacheEntry *dd8xxCacheLookup(DiskParam *dp, i32 block)
+    {
+    DiskCacheEntry *ep;
+    int            way;
+
+    ep = dp->cache + (block % CacheSets) * CacheWays;
+    for (way = 0; way < CacheWays; way++, ep++)
+        {
+        if (ep->block == block)
+            {
+            return (ep);
+            }
+        }
+
+    return (NULL);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Work out how many sectors starting at a given sector
+**                  can be read in one go: up to the read ahead limit
+**                  within the current cylinder, stopping at the first
+**                  sector already in the cache so that a newer (possibly
+**                  dirty) copy is never overwritten.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  block       First container sector number.
+**
+**  Returns:        Number of sectors.
+**
+**------------------------------------------------------------------------*/
+static i32 dd8xxReadAheadCount(DiskParam *dp, i32 block)
+    {
+    i32 count;
+    i32 cylinderEnd;
+
+    cylinderEnd = (block / (dp->size.maxTracks * dp->size.maxSectors) + 1) * dp->size.maxTracks * dp->size.maxSectors;
+    for (count = 1; count < CacheReadAhead && block + count < cylinderEnd; count++)
+        {
+        if (dd8xxCacheLookup(dp, block + count) != NULL)
+            {
+            break;
+            }
+        }
+
+    return (count);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Queue an asynchronous read of the sectors at the
+**                  current position unless they are cached or already
+**                  being fetched.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxPrefetch(DiskParam *dp, FILE *fcb)
+    {
+    i32 block;
+
+    if ((fcb == NULL) || (dp->position < 0))
+        {
+        return;
+        }
+
+    block = dp->position / dp->sectorSize;
+    if (dd8xxCacheLookup(dp, block) != NULL)
+        {
+        return;
+        }
+
+    if (dp->prefetch != NULL)
+        {
+        if (dp->prefetchBlock == block)
+            {
+            return;
+            }
+
+        diskIoCancel(dp->prefetch);
+        }
+
+    dp->prefetchBlock = block;
+    dp->prefetchCount = dd8xxReadAheadCount(dp, block);
+    dp->prefetch      = diskIoStartRead(fcb, dp->prefetchCount * dp->sectorSize, block * dp->sectorSize);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Check if the data of the sector about to be read is
+**                  available. While a prefetch of the sector is still in
+**                  progress the drive does not present data, which
+**                  leaves the PP waiting on an empty channel instead of
+**                  stalling the emulation.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**
+**  Returns:        TRUE if data can be presented.
+**
+**------------------------------------------------------------------------*/
+static bool dd8xxIsSectorReady(DiskParam *dp)
+    {
+    if ((dp->bufPtr != NULL) || (dp->prefetch == NULL))
+        {
+        return (TRUE);
+        }
+
+    if (dp->prefetchBlock != dp->position / dp->sectorSize)
+        {
+        return (TRUE);
+        }
+
+    return (diskIoIsDone(dp->prefetch));
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Discard an outstanding prefetch.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxPrefetchCancel(DiskParam *dp)
+    {
+    if (dp->prefetch != NULL)
+        {
+        diskIoCancel(dp->prefetch);
+        dp->prefetch = NULL;
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Store a container sector at the current position in
+**                  the sector cache and advance the position. The sector
+**                  is written back to the container later.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**                  data        Container sector to write.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxCacheWrite(DiskParam *dp, FILE *fcb, u8 *data)
+    {
+    i32            block;
+    DiskCacheEntry *ep;
+    u8             *sp;
+
+    block        = dp->position / dp->sectorSize;
+    dp->position += dp->sectorSize;
+
+    sp = dd8xxCacheSlot(dp, fcb, block);
+    memcpy(sp, data, dp->sectorSize);
+
+    ep = dp->cache + (sp - dp->cacheData) / dp->sectorSize;
+    if (!ep->dirty)
+        {
+        ep->dirty       = TRUE;
+        dp->dirtyCount += 1;
+        }
+
+    /*
+    **  Bound the amount of data which is not yet on disk.
+    */
+    if (dp->dirtyCount >= CacheDirtyLimit)
+        {
+        dd8xxCacheFlush(dp, fcb);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Return the cache slot for a container sector. If the
+**                  sector is not cached, the least recently used slot of
+**                  its set is written back if necessary and reassigned.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**                  block       Container sector number.
+**
+**  Returns:        Pointer to cached container sector.
+**
+**------------------------------------------------------------------------*/
+static u8 *dd8xxCacheSlot(DiskParam *dp, FILE *fcb, i32 block)
+    {
+    DiskCacheEntry *ep;
+    DiskCacheEntry *lru;
+    int            set;
+    int            way;
+
+    set = block % CacheSets;
+    ep  = dp->cache + set * CacheWays;
+    lru = ep;
+    for (way = 0; way < CacheWays; way++, ep++)
+        {
+        if (ep->block == block)
+            {
+            lru = ep;
+            break;
+            }
+
+        if (ep->lastUse < lru->lastUse)
+            {
+            lru = ep;
+            }
+        }
+
+    if (lru->block != block)
+        {
+        if (lru->dirty)
+            {
+            dd8xxFileWrite(dp, fcb, dp->cacheData + (lru - dp->cache) * dp->sectorSize, dp->sectorSize,
+                           lru->block * dp->sectorSize);
+            lru->dirty      = FALSE;
+            dp->dirtyCount -= 1;
+            }
+
+        lru->block = block;
+        }
+
+    lru->lastUse = ++dp->cacheClock;
+
+    return (dp->cacheData + (lru - dp->cache) * dp->sectorSize);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Write back all dirty cached sectors, coalescing runs
+**                  of consecutive sectors into a single file write.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxCacheFlush(DiskParam *dp, FILE *fcb)
+    {
+    static u8             run[CacheReadAhead * MaxContainerSector];
+    static DiskCacheEntry *dirty[CacheSectors];
+    int                   count;
+    int                   first;
+    int                   i;
+    int                   n;
+
+    if ((dp->dirtyCount == 0) || (fcb == NULL))
+        {
+        return;
+        }
+
+    /*
+    **  Collect dirty sectors in container order.
+    */
+    count = 0;
+    for (i = 0; i < CacheSectors; i++)
+        {
+        if (dp->cache[i].dirty)
+            {
+            dirty[count++] = dp->cache + i;
+            }
+        }
+
+    qsort(dirty, count, sizeof(DiskCacheEntry *), dd8xxCompareBlocks);
+
+    /*
+    **  Write runs of consecutive sectors.
+    */
+    for (first = 0; first < count; first += n)
+        {
+        for (n = 0; first + n < count && n < CacheReadAhead; n++)
+            {
+            if ((n > 0) && (dirty[first + n]->block != dirty[first]->block + n))
+                {
+                break;
+                }
+
+            memcpy(run + n * dp->sectorSize, dp->cacheData + (dirty[first + n] - dp->cache) * dp->sectorSize, dp->sectorSize);
+            dirty[first + n]->dirty = FALSE;
+            }
+
+        dd8xxFileWrite(dp, fcb, run, n * dp->sectorSize, dirty[first]->block * dp->sectorSize);
+        }
+
+    dp->dirtyCount = 0;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Discard all cached sectors of a unit.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxCacheInvalidate(DiskParam *dp)
+    {
+    int i;
+
+    for (i = 0; i < CacheSectors; i++)
+        {
+        dp->cache[i].block   = -1;
+        dp->cache[i].lastUse = 0;
+        dp->cache[i].dirty   = FALSE;
+        }
+
+    dp->dirtyCount = 0;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        qsort comparison of cache entries by sector number.
+**
+**  Parameters:     Name        Description.
+**                  a           Pointer to first cache entry pointer.
+**                  b           Pointer to second cache entry pointer.
+**
+**  Returns:        <0, 0 or >0 as for qsort.
+**
+**------------------------------------------------------------------------*/
+static int dd8xxCompareBlocks(const void *a, const void *b)
+    {
+    i32 blockA = (*(DiskCacheEntry **)a)->block;
+    i32 blockB = (*(DiskCacheEntry **)b)->block;
+
+    return ((blockA > blockB) - (blockA < blockB));
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Read from a disk container and wait for the data. The
+**                  read is ordered behind all queued writes.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**                  buf         Buffer to read into.
+**                  len         Number of bytes to read.
+**                  offset      Byte offset in container.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxFileRead(DiskParam *dp, FILE *fcb, u8 *buf, int len, i32 offset)
+    {
+    u64 start;
+
+    start = getMicroseconds();
+    diskIoRead(fcb, buf, len, offset);
+    dp->fileReadUsecs += getMicroseconds() - start;
+    dp->fileReads     += 1;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Queue a write to a disk container. A prefetch which
+**                  overlaps the written sectors is discarded as it may
+**                  return the old data.
+**
+**  Parameters:     Name        Description.
+**                  dp          Disk parameters (context).
+**                  fcb         File control block.
+**                  buf         Data to write.
+**                  len         Number of bytes to write.
+**                  offset      Byte offset in container.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void dd8xxFileWrite(DiskParam *dp, FILE *fcb, u8 *buf, int len, i32 offset)
+    {
+    i32 prefetchOffset;
+
+    if (dp->prefetch != NULL)
+        {
+        prefetchOffset = dp->prefetchBlock * dp->sectorSize;
+        if ((offset < prefetchOffset + dp->prefetchCount * dp->sectorSize) && (prefetchOffset < offset + len))
+            {
+            dd8xxPrefetchCancel(dp);
+            }
+        }
+
+    diskIoWrite(fcb, buf, len, offset);
+    dp->fileWrites += 1;
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Manipulate 844 utility (flaw) map.
 **
@@ -2043,7 +2646,6 @@ static void dd844SetClearFlaw(DiskParam *dp, PpWord flawState)
     {
     u8     unitNo;
     FILE   *fcb;
-    int    ignore;
     int    index;
     PpWord flawWord0;
     PpWord flawWord1;
@@ -2079,8 +2681,8 @@ static void dd844SetClearFlaw(DiskParam *dp, PpWord flawState)
     dp->cylinder = dp->size.maxCylinders - 1;
     dp->track    = 0;
     dp->sector   = 2;
-    fseek(fcb, dd8xxSeek(dp), SEEK_SET);
-    ignore = fread(mySector, 2, SectorSize, fcb);
+    dp->position = dd8xxSeek(dp);
+    dd8xxSectorRead(dp, fcb, mySector);
 
     /*
     **  Process request.
@@ -2139,7 +2741,7 @@ static void dd844SetClearFlaw(DiskParam *dp, PpWord flawState)
     /*
     **  Update the 844 utility map sector.
     */
-    fseek(fcb, dd8xxSeek(dp), SEEK_SET);
+    dp->position = dd8xxSeek(dp);
     dd8xxSectorWrite(dp, fcb, mySector);
     }
 
@@ -2295,6 +2897,16 @@ void dd8xxShowDiskStatus()
             {
             sprintf(outBuf, "   %-20s (cyl 0x%06x trk 0x%06o)\n", dp->fileName, dp->cylinder, dp->track);
             opDisplay(outBuf);
+            sprintf(outBuf, "    >     cache hit rate %.1f%% (%lu/%lu), %lu prefetched, %lu reads waited avg %lu us, %lu writes queued, %u dirty\n",
+                    (dp->cacheHits + dp->cacheMisses) != 0 ? (100.0 * dp->cacheHits) / (dp->cacheHits + dp->cacheMisses) : 0.0,
+                    (unsigned long)dp->cacheHits,
+                    (unsigned long)(dp->cacheHits + dp->cacheMisses),
+                    (unsigned long)dp->prefetchHits,
+                    (unsigned long)dp->fileReads,
+                    (unsigned long)(dp->fileReads != 0 ? dp->fileReadUsecs / dp->fileReads : 0),
+                    (unsigned long)dp->fileWrites,
+                    dp->dirtyCount);
+            opDisplay(outBuf);
             }
         else
             {
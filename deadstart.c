@@ -172,6 +172,14 @@ void deadStart(void)
     channel[0].active   = TRUE;
     channel[0].full     = TRUE;
     channel[0].data     = 0;
+
+    /*
+    **  Wake any PP waiting on a channel changed above.
+    */
+    for (ch = 0; ch < channelCount; ch++)
+        {
+        channel[ch].events += 1;
+        }
     }
 
 /*--------------------------------------------------------------------------
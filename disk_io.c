@@ -0,0 +1,625 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: disk_io.c
+**
+**  Description:
+**      Asynchronous disk container I/O. Reads and writes of disk
+**      containers are handed to a worker thread so that a slow host
+**      file system does not stall the emulation thread. Requests are
+**      processed strictly in the order they are queued, so a read always
+**      sees the data of all writes queued before it.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+#if defined(_WIN32)
+#define diskIoLock()      EnterCriticalSection(&diskIoMutex)
+#define diskIoUnlock()    LeaveCriticalSection(&diskIoMutex)
+#else
+#define diskIoLock()      pthread_mutex_lock(&diskIoMutex)
+#define diskIoUnlock()    pthread_mutex_unlock(&diskIoMutex)
+#endif
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+
+/*
+**  Disk I/O request.
+*/
+struct diskIoRequest
+    {
+    struct diskIoRequest *next;         /* next request in queue */
+    FILE                 *fcb;          /* disk container */
+    i32                  offset;        /* byte offset in container */
+    int                  length;        /* number of bytes to transfer */
+    int                  result;        /* number of bytes transferred */
+    bool                 isWrite;       /* TRUE for write, FALSE for read */
+    bool                 isDone;        /* TRUE when transfer has completed */
+    bool                 isAbandoned;   /* TRUE if nobody waits for the result */
+    bool                 isStalled;     /* TRUE once counted as a stall */
+    u8                   data[1];       /* transfer buffer (variable length) */
+    };
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static void diskIoQueue(DiskIoRequest *rp);
+static void diskIoTransfer(DiskIoRequest *rp);
+static void diskIoWait(void);
+
+#if defined(_WIN32)
+static void diskIoThread(void *param);
+
+#else
+static void *diskIoThread(void *param);
+
+#endif
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+static DiskIoRequest *queueFirst      = NULL;
+static DiskIoRequest *queueLast       = NULL;
+static DiskIoRequest *inProgress      = NULL;
+static bool          isThreadRunning  = FALSE;
+
+static u64           readCount        = 0;
+static u64           readUsecs        = 0;
+static u64           writeCount       = 0;
+static u64           writeUsecs       = 0;
+static u64           stallCount       = 0;
+static u32           queueDepth       = 0;
+static u32           maxQueueDepth    = 0;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION   diskIoMutex;
+static CONDITION_VARIABLE diskIoQueued;
+static CONDITION_VARIABLE diskIoCompleted;
+#else
+static pthread_mutex_t    diskIoMutex     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     diskIoQueued    = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t     diskIoCompleted = PTHREAD_COND_INITIALIZER;
+#endif
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Start the disk I/O worker thread. Called by each disk
+**                  driver during initialisation; only the first call has
+**                  an effect.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void diskIoInit(void)
+    {
+#if defined(_WIN32)
+    DWORD  dwThreadId;
+    HANDLE hThread;
+#else
+    int            rc;
+    pthread_t      thread;
+    pthread_attr_t attr;
+#endif
+
+    if (isThreadRunning)
+        {
+        return;
+        }
+
+#if defined(_WIN32)
+    InitializeCriticalSection(&diskIoMutex);
+    InitializeConditionVariable(&diskIoQueued);
+    InitializeConditionVariable(&diskIoCompleted);
+
+    hThread = CreateThread(
+        NULL,                                       // no security attribute
+        0,                                          // default stack size
+        (LPTHREAD_START_ROUTINE)diskIoThread,
+        NULL,                                       // thread parameter
+        0,                                          // not suspended
+        &dwThreadId);                               // returns thread ID
+
+    if (hThread == NULL)
+        {
+        fputs("(disk_io) Failed to create disk I/O thread\n", stderr);
+        exit(1);
+        }
+#else
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    rc = pthread_create(&thread, &attr, diskIoThread, NULL);
+    if (rc < 0)
+        {
+        fputs("(disk_io) Failed to create disk I/O thread\n", stderr);
+        exit(1);
+        }
+#endif
+
+    isThreadRunning = TRUE;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Queue a read from a disk container.
+**
+**  Parameters:     Name        Description.
+**                  fcb         File control block.
+**                  length      Number of bytes to read.
+**                  offset      Byte offset in container.
+**
+**  Returns:        Request handle to be passed to diskIoFinishRead or
+**                  diskIoCancel.
+**
+**------------------------------------------------------------------------*/
+DiskIoRequest *diskIoStartRead(FILE *fcb, int length, i32 offset)
+    {
+    DiskIoRequest *rp;
+
+    rp = (DiskIoRequest *)calloc(1, sizeof(DiskIoRequest) + length);
+    if (rp == NULL)
+        {
+        fprintf(stderr, "(disk_io) Failed to allocate I/O request\n");
+        exit(1);
+        }
+
+    rp->fcb    = fcb;
+    rp->offset = offset;
+    rp->length = length;
+
+    diskIoQueue(rp);
+
+    return (rp);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Check if a queued read has completed. A read found
+**                  not completed is counted as a device stall, once per
+**                  request however often it is polled.
+**
+**  Parameters:     Name        Description.
+**                  rp          Request handle.
+**
+**  Returns:        TRUE if data is available.
+**
+**------------------------------------------------------------------------*/
+bool diskIoIsDone(DiskIoRequest *rp)
+    {
+    bool isDone;
+
+    diskIoLock();
+    isDone = rp->isDone;
+    if (!isDone && !rp->isStalled)
+        {
+        rp->isStalled = TRUE;
+        stallCount   += 1;
+        }
+
+    diskIoUnlock();
+
+    return (isDone);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Wait for a queued read, copy its data and release the
+**                  request. Data beyond the end of the container reads
+**                  as zero.
+**
+**  Parameters:     Name        Description.
+**                  rp          Request handle.
+**                  buf         Buffer receiving the data.
+**
+**  Returns:        Number of bytes read from the container.
+**
+**------------------------------------------------------------------------*/
+int diskIoFinishRead(DiskIoRequest *rp, u8 *buf)
+    {
+    int result;
+
+    diskIoLock();
+    while (!rp->isDone)
+        {
+        diskIoWait();
+        }
+
+    diskIoUnlock();
+
+    result = rp->result;
+    memcpy(buf, rp->data, rp->length);
+    free(rp);
+
+    return (result);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Give up on a queued read. The request is released
+**                  when the worker has finished with it.
+**
+**  Parameters:     Name        Description.
+**                  rp          Request handle.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void diskIoCancel(DiskIoRequest *rp)
+    {
+    bool isDone;
+
+    diskIoLock();
+    isDone          = rp->isDone;
+    rp->isAbandoned = TRUE;
+    diskIoUnlock();
+
+    if (isDone)
+        {
+        free(rp);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Read from a disk container and wait for the data.
+**
+**  Parameters:     Name        Description.
+**                  fcb         File control block.
+**                  buf         Buffer receiving the data.
+**                  length      Number of bytes to read.
+**                  offset      Byte offset in container.
+**
+**  Returns:        Number of bytes read from the container.
+**
+**------------------------------------------------------------------------*/
+int diskIoRead(FILE *fcb, u8 *buf, int length, i32 offset)
+    {
+    return (diskIoFinishRead(diskIoStartRead(fcb, length, offset), buf));
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Queue a write to a disk container. The data is copied
+**                  and written behind; the caller does not wait.
+**
+**  Parameters:     Name        Description.
+**                  fcb         File control block.
+**                  buf         Data to write.
+**                  length      Number of bytes to write.
+**                  offset      Byte offset in container.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void diskIoWrite(FILE *fcb, u8 *buf, int length, i32 offset)
+    {
+    DiskIoRequest *rp;
+
+    rp = (DiskIoRequest *)calloc(1, sizeof(DiskIoRequest) + length);
+    if (rp == NULL)
+        {
+        fprintf(stderr, "(disk_io) Failed to allocate I/O request\n");
+        exit(1);
+        }
+
+    rp->fcb         = fcb;
+    rp->offset      = offset;
+    rp->length      = length;
+    rp->isWrite     = TRUE;
+    rp->isAbandoned = TRUE;
+    memcpy(rp->data, buf, length);
+
+    diskIoQueue(rp);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Wait until all queued requests have completed. Must
+**                  be called before a disk container is closed.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void diskIoDrain(void)
+    {
+    if (!isThreadRunning)
+        {
+        return;
+        }
+
+    diskIoLock();
+    while ((queueFirst != NULL) || (inProgress != NULL))
+        {
+        diskIoWait();
+        }
+
+    diskIoUnlock();
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Show asynchronous disk I/O statistics (operator
+**                  interface).
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void diskIoShowStatus(void)
+    {
+    char outBuf[200];
+
+    if (!isThreadRunning)
+        {
+        return;
+        }
+
+    sprintf(outBuf, "    >   Async I/O: %lu reads avg %lu us, %lu writes avg %lu us, %lu stalled reads, queue %u (max %u)\n",
+            (unsigned long)readCount,
+            (unsigned long)(readCount != 0 ? readUsecs / readCount : 0),
+            (unsigned long)writeCount,
+            (unsigned long)(writeCount != 0 ? writeUsecs / writeCount : 0),
+            (unsigned long)stallCount,
+            queueDepth,
+            maxQueueDepth);
+    opDisplay(outBuf);
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Append a request to the queue and wake up the worker.
+**
+**  Parameters:     Name        Description.
+**                  rp          Request.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void diskIoQueue(DiskIoRequest *rp)
+    {
+    diskIoLock();
+    if (queueLast == NULL)
+        {
+        queueFirst = rp;
+        }
+    else
+        {
+        queueLast->next = rp;
+        }
+
+    queueLast   = rp;
+    queueDepth += 1;
+    if (queueDepth > maxQueueDepth)
+        {
+        maxQueueDepth = queueDepth;
+        }
+
+#if defined(_WIN32)
+    WakeConditionVariable(&diskIoQueued);
+#else
+    pthread_cond_signal(&diskIoQueued);
+#endif
+    diskIoUnlock();
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Disk I/O worker thread.
+**
+**  Parameters:     Name        Description.
+**                  param       unused
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+#if defined(_WIN32)
+static void diskIoThread(void *param)
+#else
+static void *diskIoThread(void *param)
+#endif
+    {
+    DiskIoRequest *rp;
+    u64           start;
+    u64           usecs;
+
+    diskIoLock();
+    for (;;)
+        {
+        while (queueFirst == NULL)
+            {
+#if defined(_WIN32)
+            SleepConditionVariableCS(&diskIoQueued, &diskIoMutex, INFINITE);
+#else
+            pthread_cond_wait(&diskIoQueued, &diskIoMutex);
+#endif
+            }
+
+        /*
+        **  Take the oldest request and perform it without holding the lock.
+        */
+        rp         = queueFirst;
+        queueFirst = rp->next;
+        if (queueFirst == NULL)
+            {
+            queueLast = NULL;
+            }
+
+        queueDepth -= 1;
+        inProgress  = rp;
+        diskIoUnlock();
+
+        start = getMicroseconds();
+        diskIoTransfer(rp);
+        usecs = getMicroseconds() - start;
+
+        diskIoLock();
+        if (rp->isWrite)
+            {
+            writeCount += 1;
+            writeUsecs += usecs;
+            }
+        else
+            {
+            readCount += 1;
+            readUsecs += usecs;
+            }
+
+        inProgress = NULL;
+        rp->isDone = TRUE;
+        if (rp->isAbandoned)
+            {
+            free(rp);
+            }
+
+#if defined(_WIN32)
+        WakeAllConditionVariable(&diskIoCompleted);
+#else
+        pthread_cond_broadcast(&diskIoCompleted);
+#endif
+        idleWakeup();
+        }
+
+#if !defined(_WIN32)
+    return (NULL);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Perform the transfer of one request.
+**
+**  Parameters:     Name        Description.
+**                  rp          Request.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void diskIoTransfer(DiskIoRequest *rp)
+    {
+    int n;
+
+#if defined(_WIN32)
+    fseek(rp->fcb, rp->offset, SEEK_SET);
+    if (rp->isWrite)
+        {
+        n = (int)fwrite(rp->data, 1, rp->length, rp->fcb);
+        fflush(rp->fcb);
+        }
+    else
+        {
+        n = (int)fread(rp->data, 1, rp->length, rp->fcb);
+        }
+#else
+    if (rp->isWrite)
+        {
+        n = (int)pwrite(fileno(rp->fcb), rp->data, rp->length, rp->offset);
+        }
+    else
+        {
+        n = (int)pread(fileno(rp->fcb), rp->data, rp->length, rp->offset);
+        }
+#endif
+
+    if (n < 0)
+        {
+        n = 0;
+        }
+
+    rp->result = n;
+    if (rp->isWrite)
+        {
+        if (n != rp->length)
+            {
+            fprintf(stderr, "(disk_io) Error writing disk container at offset %ld\n", (long)rp->offset);
+            }
+        }
+    else if (n < rp->length)
+        {
+        memset(rp->data + n, 0, rp->length - n);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Wait for the worker to complete a request. Called with
+**                  the queue locked.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void diskIoWait(void)
+    {
+#if defined(_WIN32)
+    SleepConditionVariableCS(&diskIoCompleted, &diskIoMutex, INFINITE);
+#else
+    pthread_cond_wait(&diskIoCompleted, &diskIoMutex);
+#endif
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
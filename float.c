@@ -27,6 +27,8 @@
 **--------------------------------------------------------------------------
 */
 
+#define DEBUG_FLOAT 0
+
 /*
 **  -------------
 **  Include Files
@@ -52,6 +54,30 @@
 
 #define IND    (ID << 48)
 
+/*
+**  Dividend bits shifted in by a rounding divide after the 48 bit
+**  coefficient (1/3 as 47 bits, starting with a zero or a one bit).
+*/
+#define RoundThirdEven    ((CpWord)01252525252525252)
+#define RoundThirdOdd     ((CpWord)02525252525252525)
+
+/*
+**  Use host 128 bit integer arithmetic for the 96 bit product and
+**  quotient where the compiler provides it. Building with -DFloatWide=0
+**  selects the portable code (floattest compares the two).
+*/
+#if !defined(FloatWide)
+#if defined(__SIZEOF_INT128__)
+#define FloatWide    1
+#else
+#define FloatWide    0
+#endif
+#endif
+
+#if FloatWide
+typedef unsigned __int128 FloatWideInt;
+#endif
+
 /*
 **  -----------------------
 **  Private Macro Functions
@@ -87,6 +113,14 @@
 **  Private Function Prototypes
 **  ---------------------------
 */
+static void floatProduct(CpWord v1, CpWord v2, bool doRound, CpWord *upper, CpWord *lower);
+static CpWord floatQuotient(CpWord v1, CpWord v2, int round, bool doRound);
+
+#if !FloatWide || DEBUG_FLOAT
+static void floatProductPortable(CpWord v1, CpWord v2, bool doRound, CpWord *upper, CpWord *lower);
+static CpWord floatQuotientPortable(CpWord v1, CpWord v2, int round, bool doRound);
+
+#endif
 
 /*
 **  ----------------
@@ -392,7 +426,6 @@ CpWord floatMultiply(CpWord v1, CpWord v2, bool doRound, bool doDouble)
     int    exponent2;
     int    norm;        /* flag for post-normalize */
     CpWord upper;       /* upper 48 bits of product */
-    CpWord middle;      /* middle cross-product */
     CpWord lower;       /* lower 48 bits of product */
 
     sign1 = SignX(v1, 60);
@@ -438,23 +471,9 @@ CpWord floatMultiply(CpWord v1, CpWord v2, bool doRound, bool doDouble)
     norm = (int)((v1 & v2) >> 47);
 
     /*
-    **  form middle cross-product, upper and lower product, and add them
-    **  all together, with a carry from lower to upper.
+    **  form the 96 bit product, including the rounding bit.
     */
-    middle = (v1 & Mask24) * (v2 >> 24);
-    if (doRound)
-        {
-        /*
-        **  rounding bit (46) is bit 22 in the middle cross-product.
-        */
-        middle += ((CpWord)1 << 22);
-        }
-
-    middle += (v1 >> 24) * (v2 & Mask24);
-    lower   = (v1 & Mask24) * (v2 & Mask24);
-    lower  += (middle & Mask24) << 24;
-    upper   = (v1 >> 24) * (v2 >> 24);
-    upper  += (middle >> 24) + (lower >> 48);
+    floatProduct(v1, v2, doRound, &upper, &lower);
 
     /*
     **  do an integer multiply if one or both values are not normalized
@@ -475,9 +494,6 @@ CpWord floatMultiply(CpWord v1, CpWord v2, bool doRound, bool doDouble)
             return 0;
             }
 
-        upper  = (v1 >> 24) * (v2 >> 24);
-        upper += (middle >> 24) + (lower >> 48);
-
         exponent1 -= 02000;
         exponent2 -= 02000;
 
@@ -726,18 +742,183 @@ CpWord floatDivide(CpWord v1, CpWord v2, bool doRound)
         return 0;
         }
 
-    sign2 = 0;  /* used to accumulate the result */
+    sign2 = floatQuotient(v1, v2, round, doRound);
+
+    return ((((CpWord)exponent1) << 48) | sign2) ^ sign1;
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Form the 96 bit product of two 48 bit coefficients.
+**                  With rounding a single bit is added in bit 46.
+**
+**  Parameters:     Name        Description.
+**                  v1          First coefficient
+**                  v2          Second coefficient
+**                  doRound     TRUE if rounding required, FALSE otherwise.
+**                  upper       Pointer to upper 48 bits of product
+**                  lower       Pointer to lower 48 bits of product
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void floatProduct(CpWord v1, CpWord v2, bool doRound, CpWord *upper, CpWord *lower)
+    {
+#if FloatWide
+    FloatWideInt product;
+
+    product = (FloatWideInt)v1 * v2;
+    if (doRound)
+        {
+        product += (CpWord)1 << 46;
+        }
+
+    *upper = (CpWord)(product >> 48);
+    *lower = (CpWord)product & Mask48;
+
+#if DEBUG_FLOAT
+    {
+    CpWord checkUpper;
+    CpWord checkLower;
+
+    floatProductPortable(v1, v2, doRound, &checkUpper, &checkLower);
+    if ((checkUpper != *upper) || ((checkLower & Mask48) != *lower))
+        {
+        fprintf(stderr, "(float  ) product mismatch %016llo * %016llo round %d: %016llo %016llo, expected %016llo %016llo\n",
+                (unsigned long long)v1, (unsigned long long)v2, doRound,
+                (unsigned long long)*upper, (unsigned long long)*lower,
+                (unsigned long long)checkUpper, (unsigned long long)(checkLower & Mask48));
+        }
+    }
+#endif
+#else
+    floatProductPortable(v1, v2, doRound, upper, lower);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Divide a pre-normalized 48 bit coefficient by another
+**                  one, giving a 48 bit quotient. With rounding the
+**                  dividend is extended by alternating bits (1/3).
+**
+**  Parameters:     Name        Description.
+**                  v1          Dividend coefficient, less than 2 * v2
+**                  v2          Divisor coefficient
+**                  round       first rounding bit to shift in (0 or 1)
+**                  doRound     TRUE if rounding required, FALSE otherwise.
+**
+**  Returns:        48 bit quotient.
+**
+**------------------------------------------------------------------------*/
+static CpWord floatQuotient(CpWord v1, CpWord v2, int round, bool doRound)
+    {
+#if FloatWide
+    FloatWideInt dividend;
+    CpWord       quotient;
+
+    /*
+    **  the shift and subtract loop develops the quotient of the dividend
+    **  followed by the 47 bits it shifts in before the last subtract.
+    */
+    dividend = (FloatWideInt)v1 << 47;
+    if (doRound)
+        {
+        dividend |= round ? RoundThirdOdd : RoundThirdEven;
+        }
+
+    quotient = (CpWord)(dividend / v2);
+
+#if DEBUG_FLOAT
+    if (quotient != floatQuotientPortable(v1, v2, round, doRound))
+        {
+        fprintf(stderr, "(float  ) quotient mismatch %016llo / %016llo round %d/%d: %016llo, expected %016llo\n",
+                (unsigned long long)v1, (unsigned long long)v2, round, doRound, (unsigned long long)quotient,
+                (unsigned long long)floatQuotientPortable(v1, v2, round, doRound));
+        }
+#endif
+
+    return (quotient);
+#else
+    return (floatQuotientPortable(v1, v2, round, doRound));
+#endif
+    }
+
+#if !FloatWide || DEBUG_FLOAT
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Form the 96 bit product of two 48 bit coefficients
+**                  using four 24 bit multiplies.
+**
+**  Parameters:     Name        Description.
+**                  v1          First coefficient
+**                  v2          Second coefficient
+**                  doRound     TRUE if rounding required, FALSE otherwise.
+**                  upper       Pointer to upper 48 bits of product
+**                  lower       Pointer to lower 48 bits of product (may
+**                              carry bits above bit 47)
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void floatProductPortable(CpWord v1, CpWord v2, bool doRound, CpWord *upper, CpWord *lower)
+    {
+    CpWord middle;      /* middle cross-product */
+
+    /*
+    **  form middle cross-product, upper and lower product, and add them
+    **  all together, with a carry from lower to upper.
+    */
+    middle = (v1 & Mask24) * (v2 >> 24);
+    if (doRound)
+        {
+        /*
+        **  rounding bit (46) is bit 22 in the middle cross-product.
+        */
+        middle += ((CpWord)1 << 22);
+        }
+
+    middle += (v1 >> 24) * (v2 & Mask24);
+    *lower  = (v1 & Mask24) * (v2 & Mask24);
+    *lower += (middle & Mask24) << 24;
+    *upper  = (v1 >> 24) * (v2 >> 24);
+    *upper += (middle >> 24) + (*lower >> 48);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Divide a pre-normalized 48 bit coefficient by another
+**                  one using shift and subtract.
+**
+**  Parameters:     Name        Description.
+**                  v1          Dividend coefficient, less than 2 * v2
+**                  v2          Divisor coefficient
+**                  round       first rounding bit to shift in (0 or 1)
+**                  doRound     TRUE if rounding required, FALSE otherwise.
+**
+**  Returns:        48 bit quotient.
+**
+**------------------------------------------------------------------------*/
+static CpWord floatQuotientPortable(CpWord v1, CpWord v2, int round, bool doRound)
+    {
+    CpWord quotient = 0;
+    int    bit;
 
     /*
     **  main divide loop - shift and subtract for 48 bits
     */
-    for (exponent2 = 47; exponent2 >= 0; exponent2--)
+    for (bit = 47; bit >= 0; bit--)
         {
-        sign2 <<= 1;
+        quotient <<= 1;
         if (v1 >= v2)
             {
-            v1    -= v2;
-            sign2 += 1;
+            v1       -= v2;
+            quotient += 1;
             }
 
         if (doRound)
@@ -751,15 +932,9 @@ CpWord floatDivide(CpWord v1, CpWord v2, bool doRound)
             }
         }
 
-    return ((((CpWord)exponent1) << 48) | sign2) ^ sign1;
+    return (quotient);
     }
 
-/*
- **--------------------------------------------------------------------------
- **
- **  Private Functions
- **
- **--------------------------------------------------------------------------
- */
+#endif
 
 /*---------------------------  End Of File  ------------------------------*/
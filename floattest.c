@@ -0,0 +1,351 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: floattest.c
+**
+**  Description:
+**      Differential tester of the floating point unit. The multiply and
+**      divide functions of float.c using host 128 bit arithmetic are
+**      compared against the same functions built with -DFloatWide=0
+**      (the portable 24 bit multiply and shift and subtract divide).
+**      Operands are edge values (zero, indefinite, infinite, smallest
+**      and largest exponents and coefficients, unnormalized values)
+**      paired exhaustively, followed by random operands. Every case is
+**      run in all rounding and double precision modes, without and with
+**      the 175 floating point unit.
+**
+**      Usage: floattest [<random pairs> [<seed>]]
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+#define DefaultPairs      10000000
+#define MaxReported       20
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static void floatTestPair(CpWord v1, CpWord v2);
+static CpWord floatTestEdge(int index);
+static CpWord floatTestRandom(void);
+static void floatTestReport(char *op, CpWord v1, CpWord v2, CpWord wide, CpWord portable);
+
+/*
+**  Portable versions, float.c built with -DFloatWide=0 and renamed.
+*/
+CpWord floatDividePortable(CpWord v1, CpWord v2, bool doRound);
+CpWord floatMultiplyPortable(CpWord v1, CpWord v2, bool doRound, bool doDouble);
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+ModelFeatures features;
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+static const u16 edgeExponents[] =
+    {
+    00000, 00001, 00002, 00057, 00060, 00061, 01657, 01660, 01717, 01720,
+    01721, 01776, 01777, 02000, 02001, 02056, 02057, 02060, 03716, 03717,
+    03720, 03776, 03777
+    };
+
+static const CpWord edgeCoefficients[] =
+    {
+    0,
+    1,
+    2,
+    (CpWord)1 << 23,
+    (CpWord)1 << 24,
+    (CpWord)1 << 46,
+    ((CpWord)1 << 47) - 1,
+    (CpWord)1 << 47,
+    ((CpWord)1 << 47) + 1,
+    ((CpWord)1 << 47) | ((CpWord)1 << 23),
+    ((CpWord)1 << 47) | Mask24,
+    00000525252525252525,
+    00000252525252525252,
+    Mask48 - 1,
+    Mask48
+    };
+
+#define EdgeCount    ((int)(2 * (sizeof(edgeExponents) / sizeof(edgeExponents[0])) * (sizeof(edgeCoefficients) / sizeof(edgeCoefficients[0]))))
+
+static u64 randomState = 0x2545F4914F6CDD1DULL;
+static u64 cases;
+static u64 mismatches;
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Compare wide and portable floating point functions.
+**
+**  Parameters:     Name        Description.
+**                  argc        argument count
+**                  argv        number of random pairs and seed
+**
+**  Returns:        0 if all results agree, 1 otherwise.
+**
+**------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+    {
+    u64 pairs = DefaultPairs;
+    u64 n;
+    int i;
+    int j;
+
+    if (argc > 3)
+        {
+        fprintf(stderr, "Usage: floattest [<random pairs> [<seed>]]\n");
+
+        return (1);
+        }
+
+    if (argc > 1)
+        {
+        pairs = strtoull(argv[1], NULL, 10);
+        }
+
+    if (argc > 2)
+        {
+        randomState ^= strtoull(argv[2], NULL, 10) * 0x9E3779B97F4A7C15ULL;
+        }
+
+    for (i = 0; i < EdgeCount; i++)
+        {
+        for (j = 0; j < EdgeCount; j++)
+            {
+            floatTestPair(floatTestEdge(i), floatTestEdge(j));
+            }
+        }
+
+    for (n = 0; n < pairs; n++)
+        {
+        floatTestPair(floatTestRandom(), floatTestRandom());
+        }
+
+    printf("(floattest) %llu cases, %llu mismatches\n",
+           (unsigned long long)cases, (unsigned long long)mismatches);
+
+    return (mismatches == 0 ? 0 : 1);
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Compare multiply and divide of one operand pair in all
+**                  modes.
+**
+**  Parameters:     Name        Description.
+**                  v1          first operand
+**                  v2          second operand
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void floatTestPair(CpWord v1, CpWord v2)
+    {
+    static const char *multiplyOps[] = { "FX", "RX", "DX", "DX round" };
+    static const char *divideOps[]   = { "FX/", "RX/" };
+    CpWord             wide;
+    CpWord             portable;
+    int                model;
+    int                mode;
+
+    for (model = 0; model < 2; model++)
+        {
+        features = (model == 0) ? 0 : Has175Float;
+        for (mode = 0; mode < 4; mode++)
+            {
+            wide     = floatMultiply(v1, v2, (mode & 1) != 0, (mode & 2) != 0);
+            portable = floatMultiplyPortable(v1, v2, (mode & 1) != 0, (mode & 2) != 0);
+            cases   += 1;
+            if (wide != portable)
+                {
+                floatTestReport((char *)multiplyOps[mode], v1, v2, wide, portable);
+                }
+            }
+
+        for (mode = 0; mode < 2; mode++)
+            {
+            wide     = floatDivide(v1, v2, mode != 0);
+            portable = floatDividePortable(v1, v2, mode != 0);
+            cases   += 1;
+            if (wide != portable)
+                {
+                floatTestReport((char *)divideOps[mode], v1, v2, wide, portable);
+                }
+            }
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Return an edge operand.
+**
+**  Parameters:     Name        Description.
+**                  index       0 to EdgeCount - 1
+**
+**  Returns:        60 bit operand.
+**
+**------------------------------------------------------------------------*/
+static CpWord floatTestEdge(int index)
+    {
+    int    coefficients = sizeof(edgeCoefficients) / sizeof(edgeCoefficients[0]);
+    int    exponents    = sizeof(edgeExponents) / sizeof(edgeExponents[0]);
+    CpWord v;
+
+    v = ((CpWord)edgeExponents[(index / coefficients) % exponents] << 48)
+        | edgeCoefficients[index % coefficients];
+
+    if (index >= exponents * coefficients)
+        {
+        v ^= Mask60;
+        }
+
+    return (v);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Return a random operand, biased towards normalized
+**                  coefficients and exponents near the overflow and
+**                  underflow limits.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        60 bit operand.
+**
+**------------------------------------------------------------------------*/
+static CpWord floatTestRandom(void)
+    {
+    CpWord r;
+    CpWord v;
+
+    /*
+    **  xorshift64*
+    */
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    r            = randomState * 0x2545F4914F6CDD1DULL;
+
+    v = (r >> 4) & Mask48;
+    switch (r & 3)
+        {
+    case 0:
+        /*
+        **  Any 60 bit pattern.
+        */
+        v = r & Mask60;
+        break;
+
+    case 1:
+        /*
+        **  Normalized coefficient, any exponent.
+        */
+        v |= ((CpWord)1 << 47) | ((r & ((CpWord)Mask11 << 52)) >> 4);
+        break;
+
+    default:
+        /*
+        **  Normalized coefficient, exponent near a limit.
+        */
+        v |= ((CpWord)1 << 47) | ((CpWord)edgeExponents[(r >> 52) % (sizeof(edgeExponents) / sizeof(edgeExponents[0]))] << 48);
+        break;
+        }
+
+    if ((r & ((CpWord)1 << 63)) != 0)
+        {
+        v ^= Mask60;
+        }
+
+    return (v);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Report a mismatch.
+**
+**  Parameters:     Name        Description.
+**                  op          operation
+**                  v1          first operand
+**                  v2          second operand
+**                  wide        result with 128 bit arithmetic
+**                  portable    result of portable code
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void floatTestReport(char *op, CpWord v1, CpWord v2, CpWord wide, CpWord portable)
+    {
+    mismatches += 1;
+    if (mismatches <= MaxReported)
+        {
+        printf("(floattest) %-8s %s %020llo %020llo: %020llo, expected %020llo\n",
+               op, features != 0 ? "175" : "   ",
+               (unsigned long long)v1, (unsigned long long)v2,
+               (unsigned long long)wide, (unsigned long long)portable);
+        }
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
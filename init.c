@@ -204,11 +204,13 @@ static InitVal sectVals[] =
     "channels",                      "cyber", "Deprecated",
     "clock",                         "cyber", "Valid",
     "cmFile",                        "cyber", "Deprecated",
+    "cpuEngine",                     "cyber", "Valid",
     "cpus",                          "cyber", "Valid",
     "deadstart",                     "cyber", "Valid",
     "displayName",                   "cyber", "Valid",
     "ecsBanks",                      "cyber", "Valid",
     "ecsFile",                       "cyber", "Deprecated",
+    "ecsShared",                     "cyber", "Valid",
     "equipment",                     "cyber", "Valid",
     "esmBanks",                      "cyber", "Valid",
     "helpers",                       "cyber", "Valid",
@@ -218,18 +220,25 @@ static InitVal sectVals[] =
     "ipAddress",                     "cyber", "Valid",
     "memory",                        "cyber", "Valid",
     "model",                         "cyber", "Valid",
+    "mt5744Pipeline",                "cyber", "Valid",
     "networkInterface",              "cyber", "Valid",
     "npuConnections",                "cyber", "Valid",
     "operator",                      "cyber", "Valid",
     "osType",                        "cyber", "Valid",
     "persistDir",                    "cyber", "Valid",
+    "persistMode",                   "cyber", "Valid",
     "platoConns",                    "cyber", "Deprecated",
     "platoPort",                     "cyber", "Deprecated",
     "pps",                           "cyber", "Valid",
+    "ppFastForward",                 "cyber", "Valid",
+    "ppThreads",                     "cyber", "Valid",
     "setMhz",                        "cyber", "Valid",
     "telnetConns",                   "cyber", "Deprecated",
     "telnetPort",                    "cyber", "Deprecated",
     "trace",                         "cyber", "Valid",
+    "traceRecords",                  "cyber", "Valid",
+    "traceTrigger",                  "cyber", "Valid",
+    "virtualTime",                   "cyber", "Valid",
 
     "cdcnetNode",                    "npu",   "Valid",
     "cdcnetPrivilegedTcpPortOffset", "npu",   "Valid",
@@ -717,6 +726,26 @@ static void initCyber(char *config)
         exit(1);
         }
 
+    /*
+    **  Determine whether ECS/ESM is shared with other emulators on this
+    **  host. All emulators configured with the same segment name and
+    **  size see the same extended memory and flag registers.
+    */
+    if (initGetString("ecsShared", "", ecsSharedName, 64))
+        {
+        if ((strchr(ecsSharedName, '/') != NULL) || (strchr(ecsSharedName, '\\') != NULL))
+            {
+            fprintf(stderr, "(init   ) file '%s' section [%s]: Entry 'ecsShared' must be a plain name without '/' or '\\'\n", startupFile, config);
+            exit(1);
+            }
+
+        if ((ecsBanks == 0) && (esmBanks == 0))
+            {
+            fprintf(stderr, "(init   ) file '%s' section [%s]: Entry 'ecsShared' requires 'ecsbanks' or 'esmbanks'\n", startupFile, config);
+            exit(1);
+            }
+        }
+
     /*
     **  Determine the number of CPUs to use.
     */
@@ -728,6 +757,28 @@ static void initCyber(char *config)
         }
     cpuCount = (int)cpus;
 
+    /*
+    **  Determine the CPU execution engine. The threaded engine runs
+    **  straight line code from cached superblocks of decoded instructions
+    **  but still executes one instruction word per CPU step.
+    */
+    initGetString("cpuEngine", "classic", dummy, sizeof(dummy));
+    if (strcasecmp(dummy, "classic") == 0)
+        {
+        cpuEngine = CpuEngineClassic;
+        }
+    else if (strcasecmp(dummy, "threaded") == 0)
+        {
+        cpuEngine = CpuEngineThreaded;
+        fputs("(init   ) Threaded CPU engine selected.\n", stdout);
+        }
+    else
+        {
+        fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid value for 'cpuEngine' - must be one of 'classic' or 'threaded'\n",
+                startupFile, config);
+        exit(1);
+        }
+
     /*
     **  Determine where to persist data between emulator invocations
     **  and check if directory exists.
@@ -755,6 +806,58 @@ static void initCyber(char *config)
         exit(1);
         }
 
+    /*
+    **  Determine how CM, ECS and PP memory are persisted. By default they
+    **  are copied from and to the persistence files at startup and
+    **  shutdown. In mapped mode the memories are mapped directly onto the
+    **  files and dirty pages are flushed every <seconds> seconds.
+    */
+    initGetString("persistMode", "copy", dummy, sizeof(dummy));
+    cp = strchr(dummy, ',');
+    if (cp != NULL)
+        {
+        *cp++ = '\0';
+        }
+    if (strcasecmp(dummy, "copy") == 0)
+        {
+        persistMapped = FALSE;
+        }
+    else if (strcasecmp(dummy, "mapped") == 0)
+        {
+        persistMapped = TRUE;
+        if (cp != NULL)
+            {
+            dummyInt = strtol(cp, NULL, 10);
+            if ((dummyInt < 0) || (dummyInt > 3600))
+                {
+                fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid flush interval for 'persistMode' - must be 0 to 3600 seconds\n",
+                        startupFile, config);
+                exit(1);
+                }
+            persistSyncSecs = (u32)dummyInt;
+            }
+        fprintf(stdout, "(init   ) Memory mapped persistence selected, flush interval %u seconds.\n", persistSyncSecs);
+        }
+    else
+        {
+        fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid value for 'persistMode' - must be one of 'copy' or 'mapped[,<seconds>]'\n",
+                startupFile, config);
+        exit(1);
+        }
+
+    /*
+    **  Determine how many READ requests are kept outstanding ahead of the
+    **  current position on StorageTek tape server connections. Zero turns
+    **  off both read-ahead and write-behind.
+    */
+    (void)initGetInteger("mt5744Pipeline", 4, &dummyInt);
+    if ((dummyInt < 0) || (dummyInt > 16))
+        {
+        fprintf(stderr, "(init   ) file '%s' section [%s]: Entry 'mt5744Pipeline' invalid - correct values are 0 to 16\n", startupFile, config);
+        exit(1);
+        }
+    mt5744Pipeline = (u32)dummyInt;
+
     /*
     **  Initialise CPU.
     */
@@ -779,6 +882,59 @@ static void initCyber(char *config)
         exit(1);
         }
 
+    /*
+    **  Determine how many host threads execute the PP barrel and how many
+    **  barrel passes each of them runs between channel updates.
+    */
+    initGetString("ppThreads", "1", dummy, sizeof(dummy));
+    cp = strchr(dummy, ',');
+    if (cp != NULL)
+        {
+        *cp++ = '\0';
+        dummyInt = strtol(cp, NULL, 10);
+        if ((dummyInt < 1) || (dummyInt > 1000))
+            {
+            fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid number of passes for 'ppThreads' - must be 1 to 1000\n",
+                    startupFile, config);
+            exit(1);
+            }
+        ppBarrelPasses = (u32)dummyInt;
+        }
+    dummyInt = strtol(dummy, NULL, 10);
+    if ((dummyInt < 1) || (dummyInt > pps))
+        {
+        fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid value for 'ppThreads' - must be 1 to number of PPs\n",
+                startupFile, config);
+        exit(1);
+        }
+    ppBarrelThreads = (u8)dummyInt;
+
+    /*
+    **  Determine which PPs may have their delay and polling loops
+    **  fast-forwarded.
+    */
+    initGetString("ppFastForward", "none", dummy, sizeof(dummy));
+    if (strcasecmp(dummy, "all") == 0)
+        {
+        ppFastForward = (1 << pps) - 1;
+        }
+    else if (strcasecmp(dummy, "none") != 0)
+        {
+        cp = strtok(dummy, ",");
+        while (cp != NULL)
+            {
+            dummyInt = strtol(cp, &token, 8);
+            if ((*token != '\0') || (dummyInt < 0) || (dummyInt >= pps))
+                {
+                fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid PP '%s' in 'ppFastForward' - must be all, none or a list of octal PP numbers\n",
+                        startupFile, config, cp);
+                exit(1);
+                }
+            ppFastForward |= 1 << dummyInt;
+            cp = strtok(NULL, ",");
+            }
+        }
+
     ppInit((u8)pps);
 
     /*
@@ -815,8 +971,32 @@ static void initCyber(char *config)
     */
     (void)initGetInteger("clock", 0, &clockIncrement);
 
+    /*
+    **  Get virtual time setting. In virtual time the clock is driven by
+    **  executed cycles instead of host time, and whenever the idle loop
+    **  would sleep the clock skips forward by the given number of
+    **  microseconds instead.
+    */
+    (void)initGetInteger("virtualTime", 0, &dummyInt);
+    if ((dummyInt < 0) || (dummyInt > 1000000))
+        {
+        fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid value for 'virtualTime' - must be 0 (off) to 1000000 microseconds\n",
+                startupFile, config);
+        exit(1);
+        }
+
+    rtcIdleSkip = (u32)dummyInt;
+    if ((rtcIdleSkip != 0) && (clockIncrement == 0))
+        {
+        clockIncrement = 1;
+        }
+
     rtcInit((u8)clockIncrement, setMHz);
     fprintf(stdout, "(init   ) %ld Clock increment set.\n", clockIncrement);
+    if (rtcIdleSkip != 0)
+        {
+        fprintf(stdout, "(init   ) Virtual time, idle periods skip %u microseconds.\n", rtcIdleSkip);
+        }
 
     /*
     **  Initialise optional Interlock Register on channel 15.
@@ -879,6 +1059,50 @@ static void initCyber(char *config)
 
     fprintf(stdout, "(init   ) 0x%08x Tracing mask set.\n", traceMask);
 
+    /*
+    **  Get number of records kept in the trace ring of each CPU and PP
+    **  and the conditions which write the rings to disk.
+    */
+    (void)initGetInteger("traceRecords", 1048576, &dummyInt);
+    if ((dummyInt < 1) || (dummyInt > (1L << 30)))
+        {
+        fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid value for 'traceRecords' - must be 1 to 1073741824\n",
+                startupFile, config);
+        exit(1);
+        }
+
+    traceRecords = (u32)dummyInt;
+
+    initGetString("traceTrigger", "exit", dummy, sizeof(dummy));
+    traceTriggers = TraceTriggerManual;
+    if (strcasecmp(dummy, "none") != 0)
+        {
+        cp = strtok(dummy, ",");
+        while (cp != NULL)
+            {
+            if (strcasecmp(cp, "exit") == 0)
+                {
+                traceTriggers |= TraceTriggerExit;
+                }
+            else if (strcasecmp(cp, "stop") == 0)
+                {
+                traceTriggers |= TraceTriggerStop;
+                }
+            else if (strcasecmp(cp, "function") == 0)
+                {
+                traceTriggers |= TraceTriggerFunction;
+                }
+            else
+                {
+                fprintf(stderr, "(init   ) file '%s' section [%s]: Invalid condition '%s' in 'traceTrigger' - must be none or a list of exit, stop and function\n",
+                        startupFile, config, cp);
+                exit(1);
+                }
+
+            cp = strtok(NULL, ",");
+            }
+        }
+
     /*
     **  Get optional IP address of DtCyber. If not specified, use "0.0.0.0".
     */
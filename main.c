@@ -35,6 +35,10 @@
 
 #define DEBUG    0
 
+#if defined(__linux__)
+#define _GNU_SOURCE             /* for ppoll() */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,6 +54,13 @@
 #else
 #include <signal.h>
 #include <unistd.h>
+#include <time.h>
+#endif
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#elif !defined(_WIN32)
+#include <pthread.h>
 #endif
 
 /*
@@ -57,6 +68,7 @@
 **  Private Constants
 **  -----------------
 */
+#define MaxIdleFds    8
 
 /*
 **  -----------------------
@@ -77,6 +89,7 @@
 */
 static void tracePpuCalls(void);
 static void waitTerminationMessage(void);
+static bool idleAllCpus(void);
 
 static void INThandler(int);
 static void opExit(void);
@@ -111,6 +124,24 @@ double cycleTime;
 **  -----------------
 */
 
+/*
+**  Idle wakeup state. On Linux an idle thread waits in ppoll() on an
+**  eventfd and on the event descriptors of the network layers; elsewhere
+**  it waits on a condition variable.
+*/
+#if defined(__linux__)
+static int                idleEventFd = -1;
+static struct pollfd      idleFds[MaxIdleFds];
+static int                idleFdCount = 0;
+#elif defined(_WIN32)
+static CRITICAL_SECTION   idleMutex;
+static CONDITION_VARIABLE idleSignal;
+static bool               idleIsWoken = FALSE;
+#else
+static pthread_mutex_t    idleMutex   = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     idleSignal  = PTHREAD_COND_INITIALIZER;
+static bool               idleIsWoken = FALSE;
+#endif
 
 
 /*
@@ -187,6 +218,11 @@ int main(int argc, char **argv)
     */
     logInit();
 
+    /*
+    **  Setup idle wakeup before any thread may signal it.
+    */
+    idleInit();
+
     /*
     **  Allow optional command line parameter to specify section to run in "cyber.ini".
     */
@@ -279,6 +315,10 @@ int main(int argc, char **argv)
 
         channelStep();
 
+#if CcDebug == 1
+        traceStep();
+#endif
+
         idleThrottle(cpus);
 
 #if CcCycleTime
@@ -334,7 +374,8 @@ void idleThrottle(CpuContext *ctx)
     {
     if (idle)
         {
-        if ((*idleDetector)(ctx))
+        ctx->isIdle = (*idleDetector)(ctx);
+        if (ctx->isIdle)
             {
             ctx->idleCycles++;
             if ((ctx->idleCycles % idleTrigger) == 0)
@@ -345,8 +386,22 @@ void idleThrottle(CpuContext *ctx)
                         {
                         return;
                         }
+
+                    /*
+                    **  In virtual time the idle period is skipped, not slept,
+                    **  but only while no other CPU is doing work.
+                    */
+                    if (rtcIdleSkip != 0)
+                        {
+                        if (idleAllCpus())
+                            {
+                            rtcSkip(rtcIdleSkip);
+                            }
+
+                        return;
+                        }
                     }
-                sleepUsec(idleTime);
+                idleWait(idleTime);
                 }
             }
         }
@@ -366,7 +421,7 @@ bool idleCheckBusy()
 
     for (u8 i = 0; i < ppuCount; i++)
         {
-        if (ppu[i].busy)
+        if (ppu[i].busy && !ppIsParked(i))
             {
             busyFlag = TRUE;
             break;
@@ -376,6 +431,162 @@ bool idleCheckBusy()
     return busyFlag;
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Initialise idle wakeup.
+**
+**  Parameters:     None.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void idleInit(void)
+    {
+#if defined(__linux__)
+    idleEventFd = eventfd(0, EFD_NONBLOCK);
+    if (idleEventFd >= 0)
+        {
+        idleFds[0].fd     = idleEventFd;
+        idleFds[0].events = POLLIN;
+        idleFdCount       = 1;
+        }
+#elif defined(_WIN32)
+    InitializeCriticalSection(&idleMutex);
+    InitializeConditionVariable(&idleSignal);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Let idle waits also end when a descriptor becomes
+**                  readable (Linux only, ignored elsewhere). The caller
+**                  must keep input it leaves unread from making the
+**                  descriptor readable, or every idle wait ends at once.
+**
+**  Parameters:     Name        Description.
+**                  fd          descriptor, typically an epoll instance
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void idleWatchFd(int fd)
+    {
+#if defined(__linux__)
+    if ((idleFdCount > 0) && (idleFdCount < MaxIdleFds))
+        {
+        idleFds[idleFdCount].fd     = fd;
+        idleFds[idleFdCount].events = POLLIN;
+        idleFdCount                += 1;
+        }
+#else
+    (void)fd;
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Give the host CPU back while the emulated system is
+**                  idle. Returns after the given time, or earlier if work
+**                  arrives through idleWakeup() or a watched descriptor.
+**
+**  Parameters:     Name        Description.
+**                  usec        maximum time to wait in microseconds
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void idleWait(u32 usec)
+    {
+#if defined(__linux__)
+    struct pollfd   fds[MaxIdleFds];
+    struct timespec ts;
+    u64             count;
+
+    if (idleFdCount < 1)
+        {
+        sleepUsec(usec);
+
+        return;
+        }
+
+    /*
+    **  Poll a private copy as several CPU threads may wait at once.
+    */
+    memcpy(fds, idleFds, idleFdCount * sizeof(struct pollfd));
+    ts.tv_sec  = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000;
+    if ((ppoll(fds, idleFdCount, &ts, NULL) > 0) && ((fds[0].revents & POLLIN) != 0))
+        {
+        (void)read(idleEventFd, &count, sizeof(count));
+        }
+#elif defined(_WIN32)
+    DWORD msec;
+
+    msec = usec / 1000;
+    if (msec < 1)
+        {
+        msec = 1;
+        }
+
+    EnterCriticalSection(&idleMutex);
+    if (!idleIsWoken)
+        {
+        SleepConditionVariableCS(&idleSignal, &idleMutex, msec);
+        }
+
+    idleIsWoken = FALSE;
+    LeaveCriticalSection(&idleMutex);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec  += usec / 1000000;
+    ts.tv_nsec += (usec % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000)
+        {
+        ts.tv_sec  += 1;
+        ts.tv_nsec -= 1000000000;
+        }
+
+    pthread_mutex_lock(&idleMutex);
+    if (!idleIsWoken)
+        {
+        pthread_cond_timedwait(&idleSignal, &idleMutex, &ts);
+        }
+
+    idleIsWoken = FALSE;
+    pthread_mutex_unlock(&idleMutex);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        End idle waits because there is work to do. May be
+**                  called from any thread.
+**
+**  Parameters:     None.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void idleWakeup(void)
+    {
+#if defined(__linux__)
+    u64 one = 1;
+
+    if (idleEventFd >= 0)
+        {
+        (void)write(idleEventFd, &one, sizeof(one));
+        }
+#elif defined(_WIN32)
+    EnterCriticalSection(&idleMutex);
+    idleIsWoken = TRUE;
+    LeaveCriticalSection(&idleMutex);
+    WakeAllConditionVariable(&idleSignal);
+#else
+    pthread_mutex_lock(&idleMutex);
+    idleIsWoken = TRUE;
+    pthread_mutex_unlock(&idleMutex);
+    pthread_cond_broadcast(&idleSignal);
+#endif
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Dummy idle cycle detector
 **                  always returns false.
@@ -672,6 +883,30 @@ static void waitTerminationMessage(void)
     sleepMsec(readerScanSecs * 1000);
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Check if every CPU is idle, i.e. was last seen in the
+**                  idle loop or is stopped.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        TRUE if all CPUs are idle.
+**
+**------------------------------------------------------------------------*/
+static bool idleAllCpus(void)
+    {
+    int i;
+
+    for (i = 0; i < cpuCount; i++)
+        {
+        if (!cpus[i].isIdle && !cpus[i].isStopped)
+            {
+            return (FALSE);
+            }
+        }
+
+    return (TRUE);
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Control-C Intercept for Main Loop.
 **
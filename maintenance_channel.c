@@ -606,8 +606,10 @@ static void mchIo(void)
                     u8 pi = (u8)(dp[mchLocation] >> 24) & Mask5;
                     u8 ci = (u8)(dp[mchLocation] >> 16) & Mask5;
 
-                    ppu[pi].opD        = ci;
-                    channel[ci].active = TRUE;
+                    ppUnpark(pi);
+                    ppu[pi].opD         = ci;
+                    channel[ci].active  = TRUE;
+                    channel[ci].events += 1;
 
                     /*
                     **  Set PP to INPUT (71) instruction.
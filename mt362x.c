@@ -175,6 +175,7 @@ typedef struct tapeParam
     PpWord           recordLength;
     PpWord           ioBuffer[MaxPpBuf];
     PpWord           *bp;
+    TapIndex         *index;
     } TapeParam;
 
 /*
@@ -381,6 +382,7 @@ static void mt362xInit(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName, u8 tr
     if (deviceName != NULL)
         {
         strcpy(tp->fileName, deviceName);
+        tp->index = tapIndexOpen(deviceName);
         fcb = fopen(deviceName, "rb");
         if (fcb == NULL)
             {
@@ -546,6 +548,7 @@ void mt362xLoadTape(char *params)
     **  Setup show_tape path name.
     */
     strcpy(tp->fileName, str);
+    tp->index = tapIndexOpen(str);
 
     /*
     **  Setup status.
@@ -641,6 +644,8 @@ void mt362xUnloadTape(char *params)
     */
     fclose(dp->fcb[unitNo]);
     dp->fcb[unitNo] = NULL;
+    tapIndexClose(tp->index);
+    tp->index = NULL;
 
     /*
     **  Clear show_tape path name.
@@ -860,6 +865,7 @@ static void mt362xSetupStatus(TapeParam *tp)
 **------------------------------------------------------------------------*/
 static FcStatus mt362xFunc(PpWord funcCode)
     {
+    u32       blocks;
     u32       recLen1;
     i8        unitNo;
     TapeParam *tp;
@@ -956,6 +962,8 @@ static FcStatus mt362xFunc(PpWord funcCode)
             tp->blockNo   = 0;
             tp->unitReady = FALSE;
             tp->ringIn    = FALSE;
+            tapIndexClose(tp->index);
+            tp->index     = NULL;
             fclose(active3000Device->fcb[unitNo]);
             active3000Device->fcb[unitNo] = NULL;
             tp->endOfOperation            = TRUE;
@@ -988,6 +996,11 @@ static FcStatus mt362xFunc(PpWord funcCode)
         if (tp->unitReady)
             {
             mt362xResetStatus(tp);
+            if (tapIndexSkipFile(tp->index, active3000Device->fcb[unitNo], TRUE, MaxByteBuf, &blocks))
+                {
+                tp->blockNo += blocks;
+                }
+
             do
                 {
                 mt362xFuncForespace();
@@ -1004,6 +1017,11 @@ static FcStatus mt362xFunc(PpWord funcCode)
         if (tp->unitReady)
             {
             mt362xResetStatus(tp);
+            if (tapIndexSkipFile(tp->index, active3000Device->fcb[unitNo], FALSE, MaxByteBuf, &blocks))
+                {
+                tp->blockNo -= blocks;
+                }
+
             do
                 {
                 mt362xFuncBackspace();
@@ -1032,6 +1050,8 @@ static FcStatus mt362xFunc(PpWord funcCode)
             */
             fseek(active3000Device->fcb[unitNo], 0, SEEK_CUR);
 
+            tapIndexInvalidate(tp->index);
+
             /*
             **  Write a TAP tape mark.
             */
@@ -1334,7 +1354,7 @@ static void mt362xIo(void)
 **------------------------------------------------------------------------*/
 static void mt362xActivate(void)
     {
-    activeChannel->delayStatus = 5;
+    channelDelayStatus(5);
     }
 
 /*--------------------------------------------------------------------------
@@ -1485,6 +1505,8 @@ static void mt362xDisconnect(void)
         */
         fseek(fcb, 0, SEEK_CUR);
 
+        tapIndexInvalidate(tp->index);
+
         /*
         **  Write the TAP record.
         */
@@ -2275,6 +2297,8 @@ static void mt362xUnload(TapeParam *tp)
     unitNo             = active3000Device->selectedUnit;
     fclose(active3000Device->fcb[unitNo]);
     active3000Device->fcb[unitNo] = NULL;
+    tapIndexClose(tp->index);
+    tp->index = NULL;
     }
 
 /*--------------------------------------------------------------------------
@@ -50,9 +50,13 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #endif
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 #include <string.h>
 #include "const.h"
 #include "types.h"
@@ -159,11 +163,22 @@
 #define MaxByteBuf                           60000
 #define VolumeNameSize                       6
 
+/*
+**  Request pipeline. The output buffer holds a few WRITE requests so
+**  that writes can be acknowledged behind the PP's back, plus room for
+**  the SPACEBKW requests which undo an abandoned read-ahead window.
+*/
+#define MaxPendingRequests                   64
+#define OutputBufferSize                     (4 * (MaxByteBuf + 16))
+#define OutputBufferSlack                    1024
+
 /*
 **  -----------------------
 **  Private Macro Functions
 **  -----------------------
 */
+#define SendLimit(tp)     ((tp)->isHeld ? (tp)->holdOffset : (tp)->outputBuffer.in)
+
 #if DEBUG
 #define HexColumn(x)      (3 * (x) + 4)
 #define AsciiColumn(x)    (HexColumn(16) + 2 + (x))
@@ -197,6 +212,23 @@ typedef struct tapeBuffer
     u8  data[MaxByteBuf + 16];
     } TapeBuffer;
 
+typedef struct tapeOutputBuffer
+    {
+    u32 in;
+    u32 out;
+    u8  data[OutputBufferSize];
+    } TapeOutputBuffer;
+
+/*
+**  Record read ahead of the position seen by the PP.
+*/
+typedef struct readAheadRecord
+    {
+    int status;
+    u32 length;
+    u8  data[MaxByteBuf + 3];
+    } ReadAheadRecord;
+
 /*
 **  ACS controller.
 */
@@ -222,7 +254,9 @@ typedef struct tapeParam
     CtrlParam          *controller;
     struct tapeParam   *nextTape;
     AcsState           state;
-    void (*callback)(struct tapeParam *tp);
+    void (*pending[MaxPendingRequests])(struct tapeParam *tp);
+    int                pendingFirst;
+    int                pendingCount;
     time_t             nextConnectionAttempt;
     char               *driveName;
     char               *serverName;
@@ -236,8 +270,21 @@ typedef struct tapeParam
 #else
     int                fd;
 #endif
+    bool               isWatched;
     TapeBuffer         inputBuffer;
-    TapeBuffer         outputBuffer;
+    TapeOutputBuffer   outputBuffer;
+    ReadAheadRecord    *raRecords;
+    u32                raFirst;
+    u32                raCount;
+    u32                raOutstanding;
+    u32                raDiscards;
+    u32                raUndo;
+    u32                raBackspaces;
+    bool               raStopped;
+    bool               raWaiting;
+    bool               isHeld;
+    u32                holdOffset;
+    int                heldRequests;
     bool               isAlert;
     bool               isBlockNotFound;
     bool               isBOT;
@@ -262,9 +309,11 @@ static void mt5744Activate(void);
 static void mt5744CalculateBufferedLog(TapeParam *tp);
 static void mt5744CalculateDetailedStatus(TapeParam *tp);
 static void mt5744CalculateGeneralStatus(TapeParam *tp);
+static void mt5744CancelReadAhead(TapeParam *tp, bool isRelative);
 static void mt5744CheckTapeServer(void);
 static void mt5744CloseTapeServerConnection(TapeParam *tp);
 static void mt5744ConnectCallback(TapeParam *tp);
+static void mt5744DiscardRequestCallback(TapeParam *tp);
 static void mt5744DismountRequestCallback(TapeParam *tp);
 static FcStatus mt5744Func(PpWord funcCode);
 static void mt5744FuncBackspace(void);
@@ -275,17 +324,26 @@ static void mt5744Disconnect(void);
 static void mt5744FlushWrite(void);
 static void mt5744Io(void);
 static void mt5744InitiateConnection(TapeParam *tp);
+static void mt5744InsertPendingRequest(TapeParam *tp, int position, void (*callback)(struct tapeParam *tp));
 static void mt5744IssueTapeServerRequest(TapeParam *tp, char *request, void (*callback)(struct tapeParam *tp));
 void mt5744LoadTape(TapeParam *tp, bool writeEnable);
 static void mt5744LocateBlockRequestCallback(TapeParam *tp);
 static int mt5744PackBytes(TapeParam *tp, u8 *rp, int recLen);
 static char *mt5744ParseTapeServerResponse(TapeParam *tp, int *status);
+static bool mt5744QueueTapeServerRequest(TapeParam *tp, char *request, void (*callback)(struct tapeParam *tp));
+static void mt5744ReadAhead(TapeParam *tp);
+static void mt5744ReadAheadRequestCallback(TapeParam *tp);
 static void mt5744ReadBlockIdRequestCallback(TapeParam *tp);
+static bool mt5744ReadComplete(TapeParam *tp, int status, u8 *data, u32 len);
+static void mt5744ReadForward(TapeParam *tp);
 static void mt5744ReadRequestCallback(TapeParam *tp);
 static void mt5744ReceiveTapeServerResponse(TapeParam *tp);
 static void mt5744RegisterUnit(TapeParam *tp);
 static void mt5744RegisterUnitRequestCallback(TapeParam *tp);
+static void mt5744ReleaseHold(TapeParam *tp);
+static u8 *mt5744ReserveOutput(TapeParam *tp, u32 len);
 static void mt5744ResetInputBuffer(TapeParam *tp, u8 *eor);
+static void mt5744ResetPipeline(TapeParam *tp);
 static void mt5744ResetStatus(TapeParam *tp);
 static void mt5744ResetUnit(TapeParam *tp);
 static void mt5744RewindRequestCallback(TapeParam *tp);
@@ -293,6 +351,8 @@ static void mt5744RewindUnloadRequestCallback(TapeParam *tp);
 static void mt5744SendTapeServerRequest(TapeParam *tp);
 static void mt5744SpaceRequestCallback(TapeParam *tp);
 void mt5744UnloadTape(TapeParam *tp);
+static void mt5744WatchBusyUnits(void);
+static void mt5744WatchInput(TapeParam *tp, bool watch);
 static void mt5744WriteRequestCallback(TapeParam *tp);
 static void mt5744WriteMarkRequestCallback(TapeParam *tp);
 
@@ -309,6 +369,7 @@ static void mt5744LogFlush(void);
 **  Public Variables
 **  ----------------
 */
+u32 mt5744Pipeline = 4;
 
 /*
 **  -----------------
@@ -318,6 +379,10 @@ static void mt5744LogFlush(void);
 static TapeParam *firstTape = NULL;
 static TapeParam *lastTape  = NULL;
 
+#if defined(__linux__)
+static int epollFd = -1;
+#endif
+
 #if DEBUG
 static FILE *mt5744Log = NULL;
 static char mt5744LogBuf[LogLineLength + 1];
@@ -408,6 +473,16 @@ void mt5744Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
         exit(1);
         }
 
+    if (mt5744Pipeline > 0)
+        {
+        tp->raRecords = calloc(mt5744Pipeline, sizeof(ReadAheadRecord));
+        if (tp->raRecords == NULL)
+            {
+            fprintf(stderr, "(mt5744 ) Failed to allocate MT5744 read-ahead buffers\n");
+            exit(1);
+            }
+        }
+
     mt5744ResetUnit(tp);
     dp->context[unitNo]       = tp;
     tp->controller            = dp->controllerContext;
@@ -415,6 +490,21 @@ void mt5744Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
     tp->nextConnectionAttempt = 0;
     tp->fd = 0;
 
+#if defined(__linux__)
+    /*
+    **  Tape server responses end idle waits through an epoll instance
+    **  shared by all units.
+    */
+    if (epollFd < 0)
+        {
+        epollFd = epoll_create1(0);
+        if (epollFd >= 0)
+            {
+            idleWatchFd(epollFd);
+            }
+        }
+#endif
+
     /*
     **  Set up server connection
     */
@@ -564,7 +654,7 @@ static void mt5744Activate(void)
             activePpu->regP);
     cp->isJustActivated = TRUE;
 #endif
-    activeChannel->delayStatus = 5;
+    channelDelayStatus(5);
     }
 
 /*--------------------------------------------------------------------------
@@ -677,6 +767,72 @@ static void mt5744CalculateGeneralStatus(TapeParam *tp)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Abandon the records read ahead of the position seen
+**                  by the PP. Records which have already arrived are
+**                  dropped and responses still outstanding are discarded
+**                  on arrival.
+**
+**                  A relative request (space, read backward, write, ...)
+**                  must be executed at the position seen by the PP, so
+**                  every record read ahead is undone by a SPACEBKW. The
+**                  number of records to undo is only known once all
+**                  outstanding reads have been answered, so requests
+**                  queued in the meantime are held back in the output
+**                  buffer until then.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**                  isRelative  TRUE if the next request depends on the
+**                              current tape position
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744CancelReadAhead(TapeParam *tp, bool isRelative)
+    {
+    u32             moved;
+    ReadAheadRecord *rp;
+
+    moved = 0;
+    while (tp->raCount > 0)
+        {
+        rp = tp->raRecords + tp->raFirst;
+        if ((rp->status == 201) || (rp->status == 202))
+            {
+            moved += 1;
+            }
+        tp->raFirst  = (tp->raFirst + 1) % mt5744Pipeline;
+        tp->raCount -= 1;
+        }
+    tp->raFirst    = 0;
+    tp->raStopped  = FALSE;
+    tp->raWaiting  = FALSE;
+    tp->raDiscards += tp->raOutstanding;
+
+    if (!isRelative || ((moved == 0) && (tp->raOutstanding == 0)))
+        {
+        tp->raOutstanding = 0;
+
+        return;
+        }
+
+    if (!tp->isHeld)
+        {
+        tp->isHeld       = TRUE;
+        tp->holdOffset   = tp->outputBuffer.in;
+        tp->heldRequests = 0;
+        }
+    tp->raBackspaces += moved;
+    tp->raUndo       += tp->raOutstanding;
+    tp->raOutstanding = 0;
+
+    if (tp->raUndo == 0)
+        {
+        mt5744ReleaseHold(tp);
+        }
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Process tape server I/O and state transitions.
 **
@@ -754,7 +910,7 @@ static void mt5744CheckTapeServer(void)
         if ((tp->fd > 0) && (tp->state > StAcsConnecting))
             {
             FD_SET(tp->fd, &readFds);
-            if (tp->outputBuffer.out < tp->outputBuffer.in)
+            if (tp->outputBuffer.out < SendLimit(tp))
                 {
                 FD_SET(tp->fd, &writeFds);
                 }
@@ -811,7 +967,10 @@ static void mt5744CloseTapeServerConnection(TapeParam *tp)
     fprintf(mt5744Log, "\n%010u Close connection on socket %d to %s:%u for CH:%02o u:%d", traceSequenceNo,
             tp->fd, tp->serverName, ntohs(tp->serverAddr.sin_port), tp->channelNo, tp->unitNo);
 #endif
+    mt5744WatchInput(tp, FALSE);
     netCloseConnection(tp->fd);
+    mt5744ResetPipeline(tp);
+    tp->inputBuffer.out       = tp->inputBuffer.in = 0;
     tp->fd                    = 0;
     tp->isReady               = FALSE;
     tp->isBusy                = FALSE;
@@ -831,6 +990,7 @@ static void mt5744CloseTapeServerConnection(TapeParam *tp)
 **------------------------------------------------------------------------*/
 static void mt5744ConnectCallback(TapeParam *tp)
     {
+    int optEnable = 1;
     int rc;
 
     rc = netGetErrorStatus(tp->fd);
@@ -848,6 +1008,12 @@ static void mt5744ConnectCallback(TapeParam *tp)
         fprintf(mt5744Log, "\n%010u Connected on socket %d to %s:%u for CH:%02o u:%d", traceSequenceNo,
                 tp->fd, tp->serverName, ntohs(tp->serverAddr.sin_port), tp->channelNo, tp->unitNo);
 #endif
+
+        /*
+        **  Requests are pipelined, so they must not wait for earlier
+        **  ones to be acknowledged.
+        */
+        setsockopt(tp->fd, IPPROTO_TCP, TCP_NODELAY, (void *)&optEnable, sizeof(optEnable));
         mt5744RegisterUnit(tp);
         }
     }
@@ -877,6 +1043,36 @@ static void mt5744Disconnect(void)
     activeChannel->discAfterInput  = FALSE;
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Process a response from the StorageTek simulator to a
+**                  SPACEBKW request which undoes a record read ahead.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744DiscardRequestCallback(TapeParam *tp)
+    {
+    char *eor;
+    int  status;
+
+    eor = mt5744ParseTapeServerResponse(tp, &status);
+    if (eor == NULL)
+        {
+        return;
+        }
+    if ((status != 200) && (status != 202) && (status != 203))
+        {
+        fprintf(stderr, "(mt5744 ) Unexpected status %d received from StorageTek simulator for SPACEBKW request\n", status);
+        mt5744CloseTapeServerConnection(tp);
+
+        return;
+        }
+    mt5744ResetInputBuffer(tp, (u8 *)eor);
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Process a response from the StorageTek simulator to a
 **                  DISMOUNT request.
@@ -923,6 +1119,7 @@ static void mt5744FlushWrite(void)
     char      buffer[10];
     CtrlParam *cp = activeDevice->controllerContext;
     u8        *dataStart;
+    u8        *hp;
     u32       i;
     PpWord    *ip;
     int       len;
@@ -944,8 +1141,18 @@ static void mt5744FlushWrite(void)
     recLen0 = 0;
     recLen2 = tp->recordLength;
     ip      = tp->ioBuffer;
-    memcpy(&tp->outputBuffer.data[0], "WRITE          \n", 16);
-    rp = dataStart = &tp->outputBuffer.data[16];
+
+    if (mt5744Pipeline > 0)
+        {
+        mt5744CancelReadAhead(tp, TRUE);
+        }
+    hp = mt5744ReserveOutput(tp, 16 + ((recLen2 + 1) / 2) * 3);
+    if (hp == NULL)
+        {
+        return;
+        }
+    memcpy(hp, "WRITE          \n", 16);
+    rp = dataStart = hp + 16;
 
     for (i = 0; i < recLen2; i += 2)
         {
@@ -967,13 +1174,21 @@ static void mt5744FlushWrite(void)
         }
 
     len = sprintf(buffer, "%d", recLen0);
-    memcpy(&tp->outputBuffer.data[6], buffer, len);
-    tp->outputBuffer.out = 0;
-    tp->outputBuffer.in  = recLen0 + 16;
-    tp->callback         = mt5744WriteRequestCallback;
-    tp->isBusy           = TRUE;
-    cp->isWriting        = FALSE;
-    cp->isOddFrameCount  = FALSE;
+    memcpy(hp + 6, buffer, len);
+    tp->outputBuffer.in += recLen0 + 16;
+    mt5744InsertPendingRequest(tp, tp->pendingCount, mt5744WriteRequestCallback);
+    cp->isWriting       = FALSE;
+    cp->isOddFrameCount = FALSE;
+
+    /*
+    **  The write is acknowledged to the PP right away unless pipelining
+    **  is off, the request is held back behind an abandoned read-ahead
+    **  window, or there is no room left for another write.
+    */
+    tp->isBusy = (mt5744Pipeline == 0)
+                 || tp->isHeld
+                 || (tp->pendingCount >= MaxPendingRequests / 2)
+                 || (OutputBufferSize - (tp->outputBuffer.in - tp->outputBuffer.out) < MaxByteBuf + 16 + OutputBufferSlack);
 #if DEBUG
     fprintf(mt5744Log, "\n%010u PP:%02o CH:%02o P:%04o Write %d PP words",
             traceSequenceNo,
@@ -1146,7 +1361,7 @@ static FcStatus mt5744Func(PpWord funcCode)
             mt5744ResetStatus(tp);
             if (tp->isReady)
                 {
-                mt5744IssueTapeServerRequest(tp, "READFWD", mt5744ReadRequestCallback);
+                mt5744ReadForward(tp);
                 }
             break;
             }
@@ -1290,6 +1505,41 @@ static void mt5744InitiateConnection(TapeParam *tp)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Insert a response processor into the queue of requests
+**                  awaiting a response from the StorageTek simulator.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**                  position    queue position, 0 for the next response
+**                  callback    pointer to response processor
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744InsertPendingRequest(TapeParam *tp, int position, void (*callback)(struct tapeParam *tp))
+    {
+    int i;
+
+    if (tp->pendingCount >= MaxPendingRequests)
+        {
+        fputs("(mt5744 ) Too many requests pending on StorageTek simulator connection\n", stderr);
+        mt5744CloseTapeServerConnection(tp);
+
+        return;
+        }
+    for (i = tp->pendingCount; i > position; i--)
+        {
+        tp->pending[(tp->pendingFirst + i) % MaxPendingRequests] = tp->pending[(tp->pendingFirst + i - 1) % MaxPendingRequests];
+        }
+    tp->pending[(tp->pendingFirst + position) % MaxPendingRequests] = callback;
+    tp->pendingCount += 1;
+    if (tp->isHeld)
+        {
+        tp->heldRequests += 1;
+        }
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Perform I/O on MT5744.
 **
@@ -1305,6 +1555,8 @@ static void mt5744Io(void)
     TapeParam *tp;
     int       wordNumber;
 
+    mt5744WatchBusyUnits();
+
     /*
     **  The following avoids too rapid changes of the full/empty status
     **  when probed via FJM and EJM PP opcodes. This allows a second PP
@@ -1315,12 +1567,13 @@ static void mt5744Io(void)
         {
         return;
         }
-    activeChannel->delayStatus = 3;
+    channelDelayStatus(3);
 
     /*
     **  Handle tape server events and I/O
     */
     mt5744CheckTapeServer();
+    mt5744WatchBusyUnits();
 
     /*
     **  Setup selected unit context.
@@ -1652,22 +1905,27 @@ static void mt5744Io(void)
 **------------------------------------------------------------------------*/
 static void mt5744IssueTapeServerRequest(TapeParam *tp, char *request, void (*callback)(struct tapeParam *tp))
     {
-    u8   *bp;
-    char *sp;
+    bool isRelative;
 
-    bp = &tp->outputBuffer.data[0];
-    sp = request;
-    while (*sp && *sp != '\n')
+    /*
+    **  A rewind makes the records read ahead irrelevant, so they are
+    **  simply dropped. Everything else (including LOCATEBLOCK, which
+    **  leaves the tape where it is if the block is not found) must see
+    **  the tape where the PP believes it to be.
+    */
+    if (mt5744Pipeline > 0)
         {
-        *bp++ = (u8) * sp++;
+        isRelative = (callback != mt5744RewindRequestCallback)
+                     && (callback != mt5744RewindUnloadRequestCallback);
+        mt5744CancelReadAhead(tp, isRelative);
+        }
+
+    if (mt5744QueueTapeServerRequest(tp, request, callback))
+        {
+        tp->isBusy  = TRUE;
+        tp->isAlert = FALSE;
+        mt5744SendTapeServerRequest(tp);
         }
-    *bp++ = '\n';
-    tp->outputBuffer.out = 0;
-    tp->outputBuffer.in  = bp - &tp->outputBuffer.data[0];
-    tp->callback         = callback;
-    tp->isBusy           = TRUE;
-    tp->isAlert          = FALSE;
-    mt5744SendTapeServerRequest(tp);
     }
 
 /*--------------------------------------------------------------------------
@@ -1775,6 +2033,8 @@ static int mt5744PackBytes(TapeParam *tp, u8 *rp, int recLen)
     int i;
     u16 *op;
     int ppWords;
+    u8  save[2];
+    u8  *tail;
 
     /*
     **  Convert the raw data into PP words suitable for a channel.
@@ -1782,10 +2042,15 @@ static int mt5744PackBytes(TapeParam *tp, u8 *rp, int recLen)
     op = tp->ioBuffer;
 
     /*
-    **  Fill the last few bytes with zeroes.
+    **  Fill the last few bytes with zeroes. With requests pipelined
+    **  these may belong to the next response, so they are restored
+    **  afterwards.
     */
-    rp[recLen + 0] = 0;
-    rp[recLen + 1] = 0;
+    tail    = rp + recLen;
+    save[0] = tail[0];
+    save[1] = tail[1];
+    tail[0] = 0;
+    tail[1] = 0;
 
     for (i = 0; i < recLen; i += 3)
         {
@@ -1797,6 +2062,9 @@ static int mt5744PackBytes(TapeParam *tp, u8 *rp, int recLen)
         *op++ = ((c2 << 8) | (c3 >> 0)) & Mask12;
         }
 
+    tail[0] = save[0];
+    tail[1] = save[1];
+
     ppWords             = op - tp->ioBuffer;
     tp->isCharacterFill = FALSE;
 
@@ -1869,6 +2137,168 @@ static char *mt5744ParseTapeServerResponse(TapeParam *tp, int *status)
     return sp + 1;
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Append a request to the output buffer and queue its
+**                  response processor.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**                  request     the request to send
+**                  callback    pointer to response processor
+**
+**  Returns:        TRUE if the request was queued.
+**
+**------------------------------------------------------------------------*/
+static bool mt5744QueueTapeServerRequest(TapeParam *tp, char *request, void (*callback)(struct tapeParam *tp))
+    {
+    u8   *bp;
+    char *sp;
+    u8   *start;
+
+    bp = start = mt5744ReserveOutput(tp, strlen(request) + 1);
+    if (bp == NULL)
+        {
+        return FALSE;
+        }
+    sp = request;
+    while (*sp && *sp != '\n')
+        {
+        *bp++ = (u8) * sp++;
+        }
+    *bp++ = '\n';
+    tp->outputBuffer.in += bp - start;
+    mt5744InsertPendingRequest(tp, tp->pendingCount, callback);
+
+    return (tp->fd > 0);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Keep the read-ahead window filled with READFWD
+**                  requests. Reading ahead stops after a tape mark or
+**                  end of data until the PP has caught up.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744ReadAhead(TapeParam *tp)
+    {
+    while (!tp->isHeld && !tp->raStopped && tp->isReady
+           && (tp->raCount + tp->raOutstanding < mt5744Pipeline)
+           && (tp->pendingCount < MaxPendingRequests / 2))
+        {
+        if (!mt5744QueueTapeServerRequest(tp, "READFWD", mt5744ReadAheadRequestCallback))
+            {
+            return;
+            }
+        tp->raOutstanding += 1;
+        }
+
+    if (tp->fd > 0)
+        {
+        mt5744SendTapeServerRequest(tp);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Process a response from the StorageTek simulator to a
+**                  READFWD request issued ahead of the PP.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744ReadAheadRequestCallback(TapeParam *tp)
+    {
+    u8              *data;
+    int             dataIdx;
+    char            *eor;
+    long            len;
+    ReadAheadRecord *rp;
+    int             status;
+
+    eor = mt5744ParseTapeServerResponse(tp, &status);
+    if (eor == NULL)
+        {
+        return;
+        }
+    data = (u8 *)eor;
+    len  = 0;
+    if (status == 201)
+        {
+        len = strtol((char *)&tp->inputBuffer.data[4], NULL, 10);
+        if ((len < 0) || (len > MaxByteBuf))
+            {
+            fprintf(stderr, "(mt5744 ) Invalid record length %ld received from StorageTek simulator for READFWD request\n", len);
+            mt5744CloseTapeServerConnection(tp);
+
+            return;
+            }
+        dataIdx = eor - (char *)tp->inputBuffer.data;
+        if ((tp->inputBuffer.in - dataIdx) < len)
+            {
+            return;
+            }
+        eor += len;
+        }
+
+    /*
+    **  Responses to an abandoned window are dropped. Those which have to
+    **  be undone are counted until the held requests can be released.
+    */
+    if (tp->raDiscards > 0)
+        {
+        if (tp->raDiscards <= tp->raUndo)
+            {
+            tp->raUndo -= 1;
+            if ((status == 201) || (status == 202))
+                {
+                tp->raBackspaces += 1;
+                }
+            }
+        tp->raDiscards -= 1;
+        mt5744ResetInputBuffer(tp, (u8 *)eor);
+        if (tp->isHeld && (tp->raUndo == 0))
+            {
+            mt5744ReleaseHold(tp);
+            }
+
+        return;
+        }
+
+    tp->raOutstanding -= 1;
+    if (status != 201)
+        {
+        tp->raStopped = TRUE;
+        }
+
+    if (tp->raWaiting)
+        {
+        /*
+        **  The PP is already waiting for this record.
+        */
+        tp->raWaiting = FALSE;
+        if (mt5744ReadComplete(tp, status, data, len))
+            {
+            mt5744ResetInputBuffer(tp, (u8 *)eor);
+            mt5744ReadAhead(tp);
+            }
+
+        return;
+        }
+
+    rp         = tp->raRecords + (tp->raFirst + tp->raCount) % mt5744Pipeline;
+    rp->status = status;
+    rp->length = len;
+    memcpy(rp->data, data, len);
+    tp->raCount += 1;
+    mt5744ResetInputBuffer(tp, (u8 *)eor);
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Process a response from the StorageTek simulator to a
 **                  READBLOCKID request.
@@ -1932,7 +2362,9 @@ static void mt5744ReadBlockIdRequestCallback(TapeParam *tp)
 **------------------------------------------------------------------------*/
 static void mt5744ReceiveTapeServerResponse(TapeParam *tp)
     {
+    void (*callback)(struct tapeParam *tp);
     char *eor;
+    u32  in;
     int  n;
     int  status;
 
@@ -1955,10 +2387,20 @@ static void mt5744ReceiveTapeServerResponse(TapeParam *tp)
         mt5744LogFlush();
 #endif
         tp->inputBuffer.in += n;
-        if (tp->inputBuffer.data[0] == '1') // mount/dismount event
+
+        /*
+        **  Several responses may have arrived at once. Each one is handed
+        **  to the processor of the oldest pending request, which leaves
+        **  it in the buffer if it is still incomplete.
+        */
+        while ((tp->fd > 0) && (tp->inputBuffer.in > 0))
             {
-            if (tp->inputBuffer.in > 3)
+            if (tp->inputBuffer.data[0] == '1') // mount/dismount event
                 {
+                if (tp->inputBuffer.in <= 3)
+                    {
+                    return;
+                    }
                 eor = mt5744ParseTapeServerResponse(tp, &status);
                 if (eor == NULL)
                     {
@@ -1982,11 +2424,37 @@ static void mt5744ReceiveTapeServerResponse(TapeParam *tp)
                     break;
                     }
                 mt5744ResetInputBuffer(tp, (u8 *)eor);
+                continue;
+                }
+
+            if (tp->pendingCount < 1)
+                {
+                fprintf(stderr, "(mt5744 ) Unsolicited response received from %s:%u for CH:%02o u:%d\n",
+                        tp->serverName, ntohs(tp->serverAddr.sin_port), tp->channelNo, tp->unitNo);
+                mt5744CloseTapeServerConnection(tp);
+
+                return;
+                }
+
+            callback          = tp->pending[tp->pendingFirst];
+            tp->pendingFirst  = (tp->pendingFirst + 1) % MaxPendingRequests;
+            tp->pendingCount -= 1;
+            in                = tp->inputBuffer.in;
+            callback(tp);
+            if (tp->fd <= 0)
+                {
+                return;
+                }
+            if (tp->inputBuffer.in == in)
+                {
+                /*
+                **  Response incomplete, wait for more data.
+                */
+                tp->pendingFirst  = (tp->pendingFirst + MaxPendingRequests - 1) % MaxPendingRequests;
+                tp->pendingCount += 1;
+
+                return;
                 }
-            }
-        else
-            {
-            tp->callback(tp);
             }
         }
     }
@@ -2003,6 +2471,7 @@ static void mt5744ReceiveTapeServerResponse(TapeParam *tp)
 **------------------------------------------------------------------------*/
 static void mt5744ReadRequestCallback(TapeParam *tp)
     {
+    u8   *data;
     int  dataIdx;
     char *eor;
     long len;
@@ -2014,11 +2483,10 @@ static void mt5744ReadRequestCallback(TapeParam *tp)
         {
         return;
         }
-    tp->isEOT = FALSE;
-    tp->bp    = tp->ioBuffer;
-    switch (status)
+    data = (u8 *)eor;
+    len  = 0;
+    if (status == 201)
         {
-    case 201:
         sp      = (char *)&tp->inputBuffer.data[4];
         len     = strtol(sp, NULL, 10);
         dataIdx = eor - (char *)tp->inputBuffer.data;
@@ -2026,9 +2494,37 @@ static void mt5744ReadRequestCallback(TapeParam *tp)
             {
             return;
             }
-        tp->recordLength = mt5744PackBytes(tp, (u8 *)eor, len);
-        eor      += len;
-        tp->isBOT = FALSE;
+        eor += len;
+        }
+    if (mt5744ReadComplete(tp, status, data, len))
+        {
+        mt5744ResetInputBuffer(tp, (u8 *)eor);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Complete a READFWD or READBKW function with the record
+**                  returned by the StorageTek simulator.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**                  status      response status
+**                  data        pointer to record data
+**                  len         record length in bytes
+**
+**  Returns:        FALSE if the response was invalid and the connection
+**                  has been closed.
+**
+**------------------------------------------------------------------------*/
+static bool mt5744ReadComplete(TapeParam *tp, int status, u8 *data, u32 len)
+    {
+    tp->isEOT = FALSE;
+    tp->bp    = tp->ioBuffer;
+    switch (status)
+        {
+    case 201:
+        tp->recordLength = mt5744PackBytes(tp, data, len);
+        tp->isBOT        = FALSE;
         break;
 
     case 202:
@@ -2053,10 +2549,68 @@ static void mt5744ReadRequestCallback(TapeParam *tp)
         fprintf(stderr, "(mt5744 ) Unexpected status %d received from StorageTek simulator for READFWD/READBKW request\n", status);
         mt5744CloseTapeServerConnection(tp);
 
-        return;
+        return FALSE;
         }
     tp->isBusy = FALSE;
-    mt5744ResetInputBuffer(tp, (u8 *)eor);
+
+    return TRUE;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Start a READFWD function. A record read ahead is
+**                  delivered at once, otherwise the PP waits for the
+**                  oldest outstanding read or a new READFWD request.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744ReadForward(TapeParam *tp)
+    {
+    ReadAheadRecord *rp;
+
+    if (mt5744Pipeline == 0)
+        {
+        mt5744IssueTapeServerRequest(tp, "READFWD", mt5744ReadRequestCallback);
+
+        return;
+        }
+
+    if (tp->raCount > 0)
+        {
+        rp           = tp->raRecords + tp->raFirst;
+        tp->raFirst  = (tp->raFirst + 1) % mt5744Pipeline;
+        tp->raCount -= 1;
+        tp->isAlert  = FALSE;
+        if (!mt5744ReadComplete(tp, rp->status, rp->data, rp->length))
+            {
+            return;
+            }
+        }
+    else if (tp->raOutstanding > 0)
+        {
+        tp->raWaiting = TRUE;
+        tp->isBusy    = TRUE;
+        tp->isAlert   = FALSE;
+        }
+    else
+        {
+        /*
+        **  Nothing read ahead, the request is sent together with the
+        **  new window below.
+        */
+        tp->raStopped = FALSE;
+        if (!mt5744QueueTapeServerRequest(tp, "READFWD", mt5744ReadRequestCallback))
+            {
+            return;
+            }
+        tp->isBusy  = TRUE;
+        tp->isAlert = FALSE;
+        }
+
+    mt5744ReadAhead(tp);
     }
 
 /*--------------------------------------------------------------------------
@@ -2073,6 +2627,7 @@ static void mt5744RegisterUnit(TapeParam *tp)
     u8 *bp;
     size_t len;
 
+    mt5744ResetPipeline(tp);
     bp = tp->outputBuffer.data;
     len = strlen(tp->driveName);
     memcpy(bp, "REGISTER ", 9);
@@ -2084,7 +2639,7 @@ static void mt5744RegisterUnit(TapeParam *tp)
     tp->outputBuffer.in  = len + 10;
     tp->outputBuffer.out = 0;
     tp->state            = StAcsRegistering;
-    tp->callback         = mt5744RegisterUnitRequestCallback;
+    mt5744InsertPendingRequest(tp, 0, mt5744RegisterUnitRequestCallback);
     }
 
 /*--------------------------------------------------------------------------
@@ -2119,6 +2674,96 @@ static void mt5744RegisterUnitRequestCallback(TapeParam *tp)
     mt5744ResetInputBuffer(tp, (u8 *)eor);
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Release requests held back behind an abandoned
+**                  read-ahead window. A SPACEBKW request for each record
+**                  which moved the tape is inserted in front of them.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744ReleaseHold(TapeParam *tp)
+    {
+    static char spaceBkw[] = "SPACEBKW\n";
+    u8          *bp;
+    u32         count;
+    u32         i;
+    u32         len;
+    int         position;
+
+    count = tp->raBackspaces;
+    len   = count * (sizeof(spaceBkw) - 1);
+    if (mt5744ReserveOutput(tp, len) == NULL)
+        {
+        return;
+        }
+    bp = &tp->outputBuffer.data[tp->holdOffset];
+    memmove(bp + len, bp, tp->outputBuffer.in - tp->holdOffset);
+    for (i = 0; i < count; i++)
+        {
+        memcpy(bp, spaceBkw, sizeof(spaceBkw) - 1);
+        bp += sizeof(spaceBkw) - 1;
+        }
+    tp->outputBuffer.in += len;
+
+    position         = tp->pendingCount - tp->heldRequests;
+    tp->isHeld       = FALSE;
+    tp->heldRequests = 0;
+    tp->raBackspaces = 0;
+    for (i = 0; i < count; i++)
+        {
+        mt5744InsertPendingRequest(tp, position, mt5744DiscardRequestCallback);
+        }
+
+    if (tp->fd > 0)
+        {
+        mt5744SendTapeServerRequest(tp);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Reserve space at the end of the output buffer,
+**                  moving unsent data to the front if necessary.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**                  len         number of bytes required
+**
+**  Returns:        Pointer to reserved space, NULL if the buffer is full
+**                  and the connection has been closed.
+**
+**------------------------------------------------------------------------*/
+static u8 *mt5744ReserveOutput(TapeParam *tp, u32 len)
+    {
+    u32 used;
+
+    if ((tp->outputBuffer.in + len > OutputBufferSize) && (tp->outputBuffer.out > 0))
+        {
+        used = tp->outputBuffer.in - tp->outputBuffer.out;
+        memmove(tp->outputBuffer.data, &tp->outputBuffer.data[tp->outputBuffer.out], used);
+        if (tp->isHeld)
+            {
+            tp->holdOffset -= tp->outputBuffer.out;
+            }
+        tp->outputBuffer.in  = used;
+        tp->outputBuffer.out = 0;
+        }
+
+    if (tp->outputBuffer.in + len > OutputBufferSize)
+        {
+        fprintf(stderr, "(mt5744 ) Output buffer overflow on connection to %s:%u for CH:%02o u:%d\n",
+                tp->serverName, ntohs(tp->serverAddr.sin_port), tp->channelNo, tp->unitNo);
+        mt5744CloseTapeServerConnection(tp);
+
+        return NULL;
+        }
+
+    return &tp->outputBuffer.data[tp->outputBuffer.in];
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Reset input buffer indices to prepare for processing
 **                  next available input.
@@ -2147,6 +2792,34 @@ static void mt5744ResetInputBuffer(TapeParam *tp, u8 *eor)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Forget all requests sent to the StorageTek simulator
+**                  and all records read ahead.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape parameters
+**
+**  Returns:        Nothing
+**
+**------------------------------------------------------------------------*/
+static void mt5744ResetPipeline(TapeParam *tp)
+    {
+    tp->outputBuffer.out = tp->outputBuffer.in = 0;
+    tp->pendingFirst     = 0;
+    tp->pendingCount     = 0;
+    tp->raFirst          = 0;
+    tp->raCount          = 0;
+    tp->raOutstanding    = 0;
+    tp->raDiscards       = 0;
+    tp->raUndo           = 0;
+    tp->raBackspaces     = 0;
+    tp->raStopped        = FALSE;
+    tp->raWaiting        = FALSE;
+    tp->isHeld           = FALSE;
+    tp->holdOffset       = 0;
+    tp->heldRequests     = 0;
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Reset tape unit status prior to initiating I/O.
 **
@@ -2181,8 +2854,8 @@ static void mt5744ResetStatus(TapeParam *tp)
 **------------------------------------------------------------------------*/
 static void mt5744ResetUnit(TapeParam *tp)
     {
-    tp->inputBuffer.out  = tp->inputBuffer.in = 0;
-    tp->outputBuffer.out = tp->outputBuffer.in = 0;
+    tp->inputBuffer.out = tp->inputBuffer.in = 0;
+    mt5744ResetPipeline(tp);
     mt5744ResetStatus(tp);
     tp->isBusy         = FALSE;
     tp->isReady        = FALSE;
@@ -2266,8 +2939,12 @@ static void mt5744SendTapeServerRequest(TapeParam *tp)
     int len;
     int n;
 
-    len = tp->outputBuffer.in - tp->outputBuffer.out;
-    n   = send(tp->fd, &tp->outputBuffer.data[tp->outputBuffer.out], len, 0);
+    len = SendLimit(tp) - tp->outputBuffer.out;
+    if (len <= 0)
+        {
+        return;
+        }
+    n = send(tp->fd, &tp->outputBuffer.data[tp->outputBuffer.out], len, 0);
     if (n > 0)
         {
 #if DEBUG
@@ -2280,6 +2957,7 @@ static void mt5744SendTapeServerRequest(TapeParam *tp)
         if (tp->outputBuffer.out >= tp->outputBuffer.in)
             {
             tp->outputBuffer.out = tp->outputBuffer.in = 0;
+            tp->holdOffset       = 0;
             }
         }
     }
@@ -2352,6 +3030,60 @@ void mt5744UnloadTape(TapeParam *tp)
 #endif
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Watch the tape server connections of the busy units
+**                  for input, so that the response a PP is polling for
+**                  ends an idle wait. The socket is only read from
+**                  mt5744Io(), so responses which arrive while no PP
+**                  waits (read-ahead records, acknowledgements of writes
+**                  already reported as done) are not watched; they would
+**                  stay unread and keep every idle wait short.
+**
+**  Parameters:     Name        Description.
+**                  None.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744WatchBusyUnits(void)
+    {
+    TapeParam *tp;
+
+    for (tp = firstTape; tp != NULL; tp = tp->nextTape)
+        {
+        mt5744WatchInput(tp, (tp->fd > 0) && (tp->state > StAcsConnecting) && tp->isBusy);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Start or stop watching the tape server connection of a
+**                  unit for input.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to tape unit parameters
+**                  watch       TRUE to watch, FALSE to stop watching
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mt5744WatchInput(TapeParam *tp, bool watch)
+    {
+#if defined(__linux__)
+    struct epoll_event event;
+
+    if ((epollFd < 0) || (tp->isWatched == watch))
+        {
+        return;
+        }
+
+    memset(&event, 0, sizeof(event));
+    event.events   = EPOLLIN;
+    event.data.ptr = tp;
+    epoll_ctl(epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, tp->fd, &event);
+    tp->isWatched = watch;
+#endif
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Process a response from the StorageTek simulator to a
 **                  WRITE request.
@@ -2372,7 +3104,10 @@ static void mt5744WriteRequestCallback(TapeParam *tp)
         {
         return;
         }
-    tp->isBusy = FALSE;
+    if (tp->pendingCount == 0)
+        {
+        tp->isBusy = FALSE;
+        }
     if (status == 200)
         {
         tp->isBOT = FALSE;
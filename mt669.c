@@ -273,6 +273,7 @@ typedef struct tapeParam
     PpWord           recordLength;
     PpWord           ioBuffer[MaxPpBuf];
     PpWord           *bp;
+    TapIndex         *index;
     } TapeParam;
 
 /*
@@ -443,6 +444,7 @@ void mt669Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
     if (deviceName != NULL)
         {
         strcpy(tp->fileName, deviceName);
+        tp->index = tapIndexOpen(deviceName);
         fcb = fopen(deviceName, "rb");
         if (fcb == NULL)
             {
@@ -637,6 +639,7 @@ void mt669LoadTape(char *params)
     **  Setup show_tape path name.
     */
     strcpy(tp->fileName, str);
+    tp->index = tapIndexOpen(str);
 
     /*
     **  Setup status.
@@ -733,6 +736,8 @@ void mt669UnloadTape(char *params)
     */
     fclose(dp->fcb[unitNo]);
     dp->fcb[unitNo] = NULL;
+    tapIndexClose(tp->index);
+    tp->index = NULL;
 
     /*
     **  Clear show_tape path name.
@@ -1046,6 +1051,7 @@ static void mt669SetupUnitReadyStatus(void)
 **------------------------------------------------------------------------*/
 static FcStatus mt669Func(PpWord funcCode)
     {
+    u32       blocks;
     u32       recLen1;
     i8        unitNo;
     TapeParam *tp;
@@ -1183,6 +1189,8 @@ static FcStatus mt669Func(PpWord funcCode)
             tp->ringIn    = FALSE;
             fclose(activeDevice->fcb[unitNo]);
             activeDevice->fcb[unitNo] = NULL;
+            tapIndexClose(tp->index);
+            tp->index = NULL;
             }
 
         return (FcProcessed);
@@ -1192,6 +1200,11 @@ static FcStatus mt669Func(PpWord funcCode)
             {
             mt669ResetStatus(tp);
 
+            if (tapIndexSkipFile(tp->index, activeDevice->fcb[unitNo], TRUE, MaxByteBuf, &blocks))
+                {
+                tp->blockNo += blocks;
+                }
+
             do
                 {
                 mt669FuncForespace();
@@ -1205,6 +1218,11 @@ static FcStatus mt669Func(PpWord funcCode)
             {
             mt669ResetStatus(tp);
 
+            if (tapIndexSkipFile(tp->index, activeDevice->fcb[unitNo], FALSE, MaxByteBuf, &blocks))
+                {
+                tp->blockNo -= blocks;
+                }
+
             do
                 {
                 mt669FuncBackspace();
@@ -1264,6 +1282,8 @@ static FcStatus mt669Func(PpWord funcCode)
             */
             fseek(activeDevice->fcb[unitNo], 0, SEEK_CUR);
 
+            tapIndexInvalidate(tp->index);
+
             /*
             **  Write a TAP tape mark.
             */
@@ -1526,7 +1546,7 @@ static void mt669Io(void)
         return;
         }
 
-    activeChannel->delayStatus = 5;
+    channelDelayStatus(5);
 
     /*
     **  Setup selected unit context.
@@ -1755,9 +1775,9 @@ static void mt669Io(void)
                     **  Last word deactivates function. In case this was triggered by EJM or FJM
                     **  and the status is not picked up by an IAN we disconnect after too many cycles.
                     */
-                    activeDevice->fcode            = 0;
-                    activeChannel->discAfterInput  = TRUE;
-                    activeChannel->delayDisconnect = 50;
+                    activeDevice->fcode           = 0;
+                    activeChannel->discAfterInput = TRUE;
+                    channelDelayDisconnect(50);
                     }
                 else
                     {
@@ -1765,7 +1785,7 @@ static void mt669Io(void)
                     **  Force a disconnect if the PP didn't read the status for too many cycles.
                     **  This is needed for SMM/KRONOS which expect only one status word.
                     */
-                    activeChannel->delayDisconnect = 50;
+                    channelDelayDisconnect(50);
                     }
                 }
             }
@@ -1866,7 +1886,7 @@ static void mt669Io(void)
 **------------------------------------------------------------------------*/
 static void mt669Activate(void)
     {
-    activeChannel->delayStatus = 5;
+    channelDelayStatus(5);
     }
 
 /*--------------------------------------------------------------------------
@@ -2010,6 +2030,8 @@ static void mt669Disconnect(void)
     */
     fseek(fcb, 0, SEEK_CUR);
 
+    tapIndexInvalidate(tp->index);
+
     /*
     **  Write the TAP record.
     */
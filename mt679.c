@@ -202,6 +202,7 @@ typedef struct tapeParam
     PpWord           deviceStatus[17]; // first element not used
     PpWord           ioBuffer[MaxPpBuf];
     PpWord           *bp;
+    TapIndex         *index;
     } TapeParam;
 
 /*
@@ -373,6 +374,7 @@ void mt679Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName)
     if (deviceName != NULL)
         {
         strcpy(tp->fileName, deviceName);
+        tp->index = tapIndexOpen(deviceName);
         fcb = fopen(deviceName, "rb");
         if (fcb == NULL)
             {
@@ -566,6 +568,7 @@ void mt679LoadTape(char *params)
     **  Setup show_tape path name.
     */
     strcpy(tp->fileName, str);
+    tp->index = tapIndexOpen(str);
 
     /*
     **  Setup status.
@@ -662,6 +665,8 @@ void mt679UnloadTape(char *params)
     */
     fclose(dp->fcb[unitNo]);
     dp->fcb[unitNo] = NULL;
+    tapIndexClose(tp->index);
+    tp->index = NULL;
 
     /*
     **  Clear show_tape path name.
@@ -1054,6 +1059,7 @@ static void mt679Unpack6BitTable(u8 *convTable)
 **------------------------------------------------------------------------*/
 static FcStatus mt679Func(PpWord funcCode)
     {
+    u32       blocks;
     u32       recLen1;
     i8        unitNo;
     TapeParam *tp;
@@ -1190,6 +1196,8 @@ static FcStatus mt679Func(PpWord funcCode)
             tp->ringIn    = FALSE;
             fclose(activeDevice->fcb[unitNo]);
             activeDevice->fcb[unitNo] = NULL;
+            tapIndexClose(tp->index);
+            tp->index = NULL;
             }
 
         return (FcProcessed);
@@ -1243,6 +1251,11 @@ static FcStatus mt679Func(PpWord funcCode)
             {
             mt679ResetStatus(tp);
 
+            if (tapIndexSkipFile(tp->index, activeDevice->fcb[unitNo], TRUE, MaxByteBuf, &blocks))
+                {
+                tp->blockNo += blocks;
+                }
+
             do
                 {
                 mt679FuncForespace();
@@ -1256,6 +1269,11 @@ static FcStatus mt679Func(PpWord funcCode)
             {
             mt679ResetStatus(tp);
 
+            if (tapIndexSkipFile(tp->index, activeDevice->fcb[unitNo], FALSE, MaxByteBuf, &blocks))
+                {
+                tp->blockNo -= blocks;
+                }
+
             do
                 {
                 mt679FuncBackspace();
@@ -1452,6 +1470,8 @@ static FcStatus mt679Func(PpWord funcCode)
             */
             fseek(activeDevice->fcb[unitNo], 0, SEEK_CUR);
 
+            tapIndexInvalidate(tp->index);
+
             /*
             **  Write a TAP tape mark.
             */
@@ -1559,7 +1579,7 @@ static void mt679Io(void)
         return;
         }
 
-    activeChannel->delayStatus = 3;
+    channelDelayStatus(3);
 
     /*
     **  Setup selected unit context.
@@ -1714,7 +1734,7 @@ static void mt679Io(void)
                 /*
                 **  It appears that NOS/BE relies on the disconnect to happen delayed.
                 */
-                activeChannel->delayDisconnect = 10;
+                channelDelayDisconnect(10);
                 }
             }
         break;
@@ -1821,7 +1841,7 @@ static void mt679Activate(void)
             activePpu->id,
             activeDevice->channel->id);
 #endif
-    activeChannel->delayStatus = 5;
+    channelDelayStatus(5);
     }
 
 /*--------------------------------------------------------------------------
@@ -2004,6 +2024,8 @@ static void mt679FlushWrite(void)
     */
     fseek(fcb, 0, SEEK_CUR);
 
+    tapIndexInvalidate(tp->index);
+
     /*
     **  Write the TAP record.
     */
@@ -53,6 +53,9 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #endif
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 /*
 **  -----------------
@@ -77,6 +80,7 @@
 #define IoTurnsPerPoll            4
 #define InBufSize                 256
 #define OutBufSize                16
+#define MaxPollEvents             64
 
 /*
 **  -----------------------
@@ -102,6 +106,7 @@ typedef struct portGroup
     int       listenPort;
     int       portIndex;
     int       portCount;
+    bool      isWatched;
     } PortGroup;
 
 typedef struct portParam
@@ -112,6 +117,7 @@ typedef struct portParam
     bool            active;
     bool            enabled;
     bool            carrierOn;
+    bool            isWatched;
     int             connFd;
     int             inInIdx;
     int             inOutIdx;
@@ -130,6 +136,9 @@ typedef struct muxParam
     u8              eqNo;
     int             portCount;
     int             ioTurns;
+#if defined(__linux__)
+    int             epollFd;
+#endif
     PortGroup       portGroups[MaxPortGroups];
     PortParam       *ports;
     } MuxParam;
@@ -140,6 +149,7 @@ typedef struct muxParam
 **  ---------------------------
 */
 static FcStatus mux667xFunc(PpWord funcCode);
+static void mux667xAccept(MuxParam *mp, PortGroup *gp);
 static void mux667xActivate(void);
 static void mux667xCheckIo(MuxParam *mp);
 static void mux667xCreateThread(DevSlot *dp);
@@ -148,6 +158,16 @@ static void mux667xDisconnect(void);
 static void mux667xInit(u8 eqNo, u8 channelNo, int muxType, char *params);
 static void mux667xIo(void);
 static bool mux667xInputRequired(MuxParam *mp);
+static void mux667xReceive(PortParam *pp);
+static void mux667xSend(PortParam *pp);
+static void mux667xWatchListener(MuxParam *mp, PortGroup *gp);
+static void mux667xWatchPort(PortParam *pp);
+
+#if defined(__linux__)
+static void mux667xPollEvents(MuxParam *mp);
+static void mux667xWatchInput(MuxParam *mp, int fd, u32 id, bool watch, bool *isWatched);
+
+#endif
 
 #if DEBUG_6671 || DEBUG_6676
 static char *mux667xFunc2String(PpWord funcCode);
@@ -373,6 +393,9 @@ static void mux667xInit(u8 eqNo, u8 channelNo, int muxType, char *params)
     mp->channelNo  = channelNo;
     mp->eqNo       = eqNo;
     mp->ioTurns    = IoTurnsPerPoll - 1;
+#if defined(__linux__)
+    mp->epollFd = -1;
+#endif
     if (params == NULL)
         {
         params = "";
@@ -472,6 +495,22 @@ static void mux667xInit(u8 eqNo, u8 channelNo, int muxType, char *params)
         pp->id        = i;
         }
 
+#if defined(__linux__)
+    /*
+    **  Ports are serviced through epoll if an instance can be created,
+    **  otherwise through select().
+    */
+    mp->epollFd = epoll_create1(0);
+    if (mp->epollFd >= 0)
+        {
+        idleWatchFd(mp->epollFd);
+        for (g = 0, gp = &mp->portGroups[0]; g < MaxPortGroups && gp->portCount > 0; g++, gp++)
+            {
+            mux667xWatchListener(mp, gp);
+            }
+        }
+#endif
+
     /*
     **  Print a friendly message.
     */
@@ -704,6 +743,7 @@ static void mux667xIo(void)
                         **  Enable.
                         */
                         pp->enabled = TRUE;
+                        mux667xWatchListener(mp, pp->group);
                         break;
 
                     default:
@@ -713,6 +753,7 @@ static void mux667xIo(void)
                 else if ((pp->mux->type == DtMux6671) && (function == 7))
                     {
                     pp->enabled = TRUE;
+                    mux667xWatchListener(mp, pp->group);
                     }
                 }
             }
@@ -740,6 +781,7 @@ static void mux667xIo(void)
                             {
                             pp->inInIdx  = 0;
                             pp->inOutIdx = 0;
+                            mux667xWatchPort(pp);
                             }
                         if (mp->type == DtMux6676)
                             {
@@ -841,23 +883,11 @@ static void mux667xDisconnect(void)
 **------------------------------------------------------------------------*/
 static void mux667xCheckIo(MuxParam *mp)
     {
-    PortParam *availablePort;
-#if defined(_WIN32)
-    u_long blockEnable = 1;
-#endif
-    struct sockaddr_in from;
-#if defined(_WIN32)
-    int fromLen;
-#else
-    socklen_t fromLen;
-#endif
-    int            fd;
     int            g;
     PortGroup      *gp;
     int            i;
     int            maxFd;
     int            n;
-    int            optEnable = 1;
     PortParam      *pp;
     fd_set         readFds;
     struct timeval timeout;
@@ -869,6 +899,15 @@ static void mux667xCheckIo(MuxParam *mp)
         return;
         }
 
+#if defined(__linux__)
+    if (mp->epollFd >= 0)
+        {
+        mux667xPollEvents(mp);
+
+        return;
+        }
+#endif
+
     FD_ZERO(&readFds);
     FD_ZERO(&writeFds);
     maxFd = 0;
@@ -926,135 +965,350 @@ static void mux667xCheckIo(MuxParam *mp)
             {
             if (FD_ISSET(pp->connFd, &readFds))
                 {
-                n = recv(pp->connFd, &pp->inBuffer[pp->inInIdx], InBufSize - pp->inInIdx, 0);
-                if (n > 0)
-                    {
+                mux667xReceive(pp);
+                }
+            if (pp->active && FD_ISSET(pp->connFd, &writeFds))
+                {
+                mux667xSend(pp);
+                }
+            }
+        }
+    for (g = 0, gp = &mp->portGroups[0]; g < MaxPortGroups && gp->portCount > 0; g++, gp++)
+        {
+        if (gp->listenFd != 0 && FD_ISSET(gp->listenFd, &readFds))
+            {
+            mux667xAccept(mp, gp);
+            }
+        }
+    }
+
+#if defined(__linux__)
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Service ports using epoll.
+**
+**                  One epoll_wait reports the ports with input pending and
+**                  the groups with a waiting connection. Only descriptors
+**                  whose input would be taken are registered: a port with
+**                  a full input buffer and a listening socket while no
+**                  enabled port of its group is free are left out, so that
+**                  the epoll instance is not readable while the emulator
+**                  leaves input unread and idle waits watching it are not
+**                  cut short. Output is sent straight away on the non-
+**                  blocking sockets.
+**
+**  Parameters:     Name        Description.
+**                  mp          pointer to mux parameters.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xPollEvents(MuxParam *mp)
+    {
+    struct epoll_event events[MaxPollEvents];
+    int                i;
+    u32                id;
+    int                numEvents;
+    PortParam          *pp;
+
+    for (i = 0, pp = mp->ports; i < mp->portCount; i++, pp++)
+        {
+        if (pp->active && pp->carrierOn && (pp->outInIdx > pp->outOutIdx))
+            {
+            mux667xSend(pp);
+            }
+        }
+
+    numEvents = epoll_wait(mp->epollFd, events, MaxPollEvents, 0);
+    for (i = 0; i < numEvents; i++)
+        {
+        id = events[i].data.u32;
+        if (id < (u32)mp->portCount)
+            {
+            pp = mp->ports + id;
+            if (pp->active && (pp->inInIdx < InBufSize))
+                {
+                mux667xReceive(pp);
+                }
+            }
+        else
+            {
+            mux667xAccept(mp, mp->portGroups + (id - mp->portCount));
+            }
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Start or stop watching a descriptor for input.
+**
+**  Parameters:     Name        Description.
+**                  mp          pointer to mux parameters
+**                  fd          socket
+**                  id          port number, or portCount plus the group
+**                              index for a listening socket
+**                  watch       TRUE to watch, FALSE to stop watching
+**                  isWatched   pointer to the current watch state
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xWatchInput(MuxParam *mp, int fd, u32 id, bool watch, bool *isWatched)
+    {
+    struct epoll_event event;
+
+    if ((mp->epollFd < 0) || (*isWatched == watch))
+        {
+        return;
+        }
+
+    memset(&event, 0, sizeof(event));
+    event.events   = EPOLLIN;
+    event.data.u32 = id;
+    epoll_ctl(mp->epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, fd, &event);
+    *isWatched = watch;
+    }
+
+#endif
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Watch a port for input while it is connected and its
+**                  input buffer has room.
+**
+**  Parameters:     Name        Description.
+**                  pp          pointer to mux port parameters.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xWatchPort(PortParam *pp)
+    {
+#if defined(__linux__)
+    mux667xWatchInput(pp->mux, pp->connFd, pp->id, pp->active && (pp->inInIdx < InBufSize), &pp->isWatched);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Watch a listening socket while an enabled port of its
+**                  group is free to take a connection.
+**
+**  Parameters:     Name        Description.
+**                  mp          pointer to mux parameters.
+**                  gp          pointer to port group.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xWatchListener(MuxParam *mp, PortGroup *gp)
+    {
+#if defined(__linux__)
+    int       i;
+    PortParam *pp;
+    bool      watch = FALSE;
+
+    if (gp->listenFd == 0)
+        {
+        return;
+        }
+
+    for (i = 0, pp = mp->ports + gp->portIndex; i < gp->portCount; i++, pp++)
+        {
+        if (!pp->active && pp->enabled)
+            {
+            watch = TRUE;
+            break;
+            }
+        }
+
+    mux667xWatchInput(mp, gp->listenFd, (u32)(mp->portCount + (gp - mp->portGroups)), watch, &gp->isWatched);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Receive input on a port.
+**
+**  Parameters:     Name        Description.
+**                  pp          pointer to mux port parameters.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xReceive(PortParam *pp)
+    {
+    int n;
+
+    n = recv(pp->connFd, &pp->inBuffer[pp->inInIdx], InBufSize - pp->inInIdx, 0);
+    if (n > 0)
+        {
 #if DEBUG_NETIO
 #if DEBUG_6671
-                    if (pp->mux->type == DtMux6671)
-                        {
-                        fprintf(mux6671Log, "\n%010u %s received %d bytes on port %02o",
-                                traceSequenceNo, mp->name, n, pp->id);
-                        mux667xLogBytes(mux6671Log, mp, &pp->inBuffer[pp->inInIdx], n);
-                        }
+        if (pp->mux->type == DtMux6671)
+            {
+            fprintf(mux6671Log, "\n%010u %s received %d bytes on port %02o",
+                    traceSequenceNo, pp->mux->name, n, pp->id);
+            mux667xLogBytes(mux6671Log, pp->mux, &pp->inBuffer[pp->inInIdx], n);
+            }
 #endif
 #if DEBUG_6676
-                    if (pp->mux->type == DtMux6676)
-                        {
-                        fprintf(mux6676Log, "\n%010u %s received %d bytes on port %02o",
-                                traceSequenceNo, mp->name, n, pp->id);
-                        mux667xLogBytes(mux6676Log, mp, &pp->inBuffer[pp->inInIdx], n);
-                        }
+        if (pp->mux->type == DtMux6676)
+            {
+            fprintf(mux6676Log, "\n%010u %s received %d bytes on port %02o",
+                    traceSequenceNo, pp->mux->name, n, pp->id);
+            mux667xLogBytes(mux6676Log, pp->mux, &pp->inBuffer[pp->inInIdx], n);
+            }
 #endif
 #endif
-                    pp->inInIdx += n;
-                    }
-                else
-                    {
-                    mux667xClose(pp);
-                    }
-                }
-            if (FD_ISSET(pp->connFd, &writeFds) && (pp->outOutIdx < pp->outInIdx))
-                {
-                n = send(pp->connFd, &pp->outBuffer[pp->outOutIdx], pp->outInIdx - pp->outOutIdx, 0);
-                if (n >= 0)
-                    {
+        pp->inInIdx += n;
+        mux667xWatchPort(pp);
+        }
+    else
+        {
+        mux667xClose(pp);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Send pending output of a port.
+**
+**  Parameters:     Name        Description.
+**                  pp          pointer to mux port parameters.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xSend(PortParam *pp)
+    {
+    int n;
+
+    if (pp->outOutIdx >= pp->outInIdx)
+        {
+        return;
+        }
+
+    n = send(pp->connFd, &pp->outBuffer[pp->outOutIdx], pp->outInIdx - pp->outOutIdx, 0);
+    if (n >= 0)
+        {
 #if DEBUG_NETIO
 #if DEBUG_6671
-                    if (pp->mux->type == DtMux6671)
-                        {
-                        fprintf(mux6671Log, "\n%010u %s sent %d bytes to port %02o",
-                                traceSequenceNo, mp->name, n, pp->id);
-                        mux667xLogBytes(mux6671Log, mp, &pp->outBuffer[pp->outOutIdx], n);
-                        }
+        if (pp->mux->type == DtMux6671)
+            {
+            fprintf(mux6671Log, "\n%010u %s sent %d bytes to port %02o",
+                    traceSequenceNo, pp->mux->name, n, pp->id);
+            mux667xLogBytes(mux6671Log, pp->mux, &pp->outBuffer[pp->outOutIdx], n);
+            }
 #endif
 #if DEBUG_6676
-                    if (pp->mux->type == DtMux6676)
-                        {
-                        fprintf(mux6676Log, "\n%010u %s sent %d bytes to port %02o",
-                                traceSequenceNo, mp->name, n, pp->id);
-                        mux667xLogBytes(mux6676Log, mp, &pp->outBuffer[pp->outOutIdx], n);
-                        }
+        if (pp->mux->type == DtMux6676)
+            {
+            fprintf(mux6676Log, "\n%010u %s sent %d bytes to port %02o",
+                    traceSequenceNo, pp->mux->name, n, pp->id);
+            mux667xLogBytes(mux6676Log, pp->mux, &pp->outBuffer[pp->outOutIdx], n);
+            }
 #endif
 #endif
-                    pp->outOutIdx += n;
-                    if (pp->outOutIdx >= pp->outInIdx)
-                        {
-                        pp->outInIdx  = 0;
-                        pp->outOutIdx = 0;
-                        }
-                    }
-                }
+        pp->outOutIdx += n;
+        if (pp->outOutIdx >= pp->outInIdx)
+            {
+            pp->outInIdx  = 0;
+            pp->outOutIdx = 0;
             }
         }
-    for (g = 0, gp = &mp->portGroups[0]; g < MaxPortGroups && gp->portCount > 0; g++, gp++)
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Accept a connection on the listening socket of a port
+**                  group and assign it to a free port of the group.
+**
+**  Parameters:     Name        Description.
+**                  mp          pointer to mux parameters.
+**                  gp          pointer to port group.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void mux667xAccept(MuxParam *mp, PortGroup *gp)
+    {
+    PortParam *availablePort;
+#if defined(_WIN32)
+    u_long blockEnable = 1;
+#endif
+    struct sockaddr_in from;
+#if defined(_WIN32)
+    int fromLen;
+#else
+    socklen_t fromLen;
+#endif
+    int       fd;
+    int       i;
+    int       optEnable = 1;
+    PortParam *pp;
+
+    fromLen = sizeof(from);
+    fd      = accept(gp->listenFd, (struct sockaddr *)&from, &fromLen);
+    if (fd < 0)
         {
-        if (gp->listenFd != 0 && FD_ISSET(gp->listenFd, &readFds))
+        return;
+        }
+    availablePort = NULL;
+    for (i = gp->portIndex; i < gp->portIndex + gp->portCount; i++)
+        {
+        pp = mp->ports + i;
+        if (pp->active == FALSE)
             {
-            fromLen = sizeof(from);
-            fd = accept(gp->listenFd, (struct sockaddr *)&from, &fromLen);
-            if (fd < 0) break;
-            availablePort = NULL;
-            for (i = gp->portIndex; i < gp->portIndex + gp->portCount; i++)
-                {
-                pp = mp->ports + i;
-                if (pp->active == FALSE)
-                    {
-                    availablePort = pp;
-                    break;
-                    }
-                }
-            if (availablePort != NULL)
-                {
-                availablePort->active    = TRUE;
-                availablePort->connFd    = fd;
-                availablePort->inInIdx   = 0;
-                availablePort->inOutIdx  = 0;
-                availablePort->outInIdx  = 0;
-                availablePort->outOutIdx = 0;
-                /*
-                **  Set Keepalive option so that we can eventually discover if
-                **  a client has been rebooted.
-                */
-                setsockopt(availablePort->connFd, SOL_SOCKET, SO_KEEPALIVE, (void *)&optEnable, sizeof(optEnable));
-                /*
-                **  Make socket non-blocking.
-                */
+            availablePort = pp;
+            break;
+            }
+        }
+    if (availablePort != NULL)
+        {
+        availablePort->active    = TRUE;
+        availablePort->connFd    = fd;
+        availablePort->inInIdx   = 0;
+        availablePort->inOutIdx  = 0;
+        availablePort->outInIdx  = 0;
+        availablePort->outOutIdx = 0;
+        /*
+        **  Set Keepalive option so that we can eventually discover if
+        **  a client has been rebooted.
+        */
+        setsockopt(availablePort->connFd, SOL_SOCKET, SO_KEEPALIVE, (void *)&optEnable, sizeof(optEnable));
+        /*
+        **  Make socket non-blocking.
+        */
 #if defined(_WIN32)
-                ioctlsocket(availablePort->connFd, FIONBIO, &blockEnable);
+        ioctlsocket(availablePort->connFd, FIONBIO, &blockEnable);
 #else
-                fcntl(availablePort->connFd, F_SETFL, O_NONBLOCK);
+        fcntl(availablePort->connFd, F_SETFL, O_NONBLOCK);
 #endif
-                if (availablePort->mux->type == DtMux6676)
-                    {
-                    send(fd, connectingMsg, strlen(connectingMsg), 0);
-                    }
+        if (availablePort->mux->type == DtMux6676)
+            {
+            send(fd, connectingMsg, strlen(connectingMsg), 0);
+            }
+        mux667xWatchPort(availablePort);
+        mux667xWatchListener(mp, gp);
 #if DEBUG_NETIO
 #if DEBUG_6671
-                if (availablePort->mux->type == DtMux6671)
-                    {
-                    fprintf(mux6671Log, "\n%010u %s accepted connection on port %02o",
-                            traceSequenceNo, availablePort->mux->name, availablePort->id);
-                    }
+        if (availablePort->mux->type == DtMux6671)
+            {
+            fprintf(mux6671Log, "\n%010u %s accepted connection on port %02o",
+                    traceSequenceNo, availablePort->mux->name, availablePort->id);
+            }
 #endif
 #if DEBUG_6676
-                if (availablePort->mux->type == DtMux6676)
-                    {
-                    fprintf(mux6676Log, "\n%010u %s accepted connection on port %02o",
-                            traceSequenceNo, availablePort->mux->name, availablePort->id);
-                    }
+        if (availablePort->mux->type == DtMux6676)
+            {
+            fprintf(mux6676Log, "\n%010u %s accepted connection on port %02o",
+                    traceSequenceNo, availablePort->mux->name, availablePort->id);
+            }
 #endif
 #endif
-                }
-            else
-                {
-                if (mp->type == DtMux6676)
-                    {
-                    send(fd, noPortsMsg, strlen(noPortsMsg), 0);
-                    }
-                netCloseConnection(fd);
-                }
+        }
+    else
+        {
+        if (mp->type == DtMux6676)
+            {
+            send(fd, noPortsMsg, strlen(noPortsMsg), 0);
             }
+        netCloseConnection(fd);
         }
     }
 
@@ -1094,9 +1348,10 @@ static bool mux667xInputRequired(MuxParam *mp)
 **------------------------------------------------------------------------*/
 static void mux667xClose(PortParam *pp)
     {
+    pp->active    = FALSE;
+    mux667xWatchPort(pp);
     netCloseConnection(pp->connFd);
     pp->connFd    = 0;
-    pp->active    = FALSE;
     pp->inInIdx   = 0;
     pp->inOutIdx  = 0;
     pp->outInIdx  = 0;
@@ -1106,6 +1361,7 @@ static void mux667xClose(PortParam *pp)
         pp->enabled   = FALSE;
         pp->carrierOn = FALSE;
         }
+    mux667xWatchListener(pp->mux, pp->group);
 #if DEBUG_NETIO
 #if DEBUG_6671
     if (pp->mux->type == DtMux6671)
@@ -34,6 +34,9 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #endif
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 #include "const.h"
 #include "types.h"
 #include "proto.h"
@@ -49,6 +52,7 @@
 #define IoTurnsPerPoll      4
 #define InBufSize           32
 #define OutBufSize          256
+#define MaxPollEvents       64
 
 /*
 **  Function codes.
@@ -84,6 +88,7 @@ typedef struct portParam
     u8   inBuffer[InBufSize];
     int  outInIdx;
     int  outOutIdx;
+    bool outQueued;          // port is on the pending output list
     u8   outBuffer[OutBufSize];
     } PortParam;
 
@@ -99,7 +104,10 @@ typedef struct localRing
 **  Private Function Prototypes
 **  ---------------------------
 */
+static void niuAccept(PortParam *pp);
 static void niuClose(PortParam *pp);
+static void niuFlushOutput(void);
+static void niuReceive(PortParam *pp);
 static FcStatus niuInFunc(PpWord funcCode);
 static void niuInIo(void);
 static void niuInit(void);
@@ -113,6 +121,10 @@ static void niuCheckIo(void);
 static void niuWelcome(int stat);
 static void niuSend(int stat, int word);
 static void niuSendstr(int stat, const char *p);
+#if defined(__linux__)
+static void niuPollEvents(void);
+static void niuWatchInput(int fd, u32 id, bool watch);
+#endif
 
 #if DEBUG_PP || DEBUG_NET
 static char *niuFunc2String(PpWord funcCode);
@@ -132,6 +144,7 @@ u16 platoConns;
 **  Private Variables
 **  -----------------
 */
+static int              activePorts;
 static int              currInPort;
 static u32              currOutput;
 static DevSlot          *in = NULL;
@@ -143,6 +156,11 @@ static LocalRing        localInput[NiuLocalStations];
 static int              obytes;
 static niuProcessOutput *outputHandler[NiuLocalStations];
 static PortParam        *portVector;
+static PortParam        **pendingOutput;
+static int              pendingOutputCount;
+#if defined(__linux__)
+static int              epollFd = -1;
+#endif
 
 #if REAL_TIMING
 static bool frameStart;
@@ -407,6 +425,16 @@ static void niuInit(void)
 
     in->context[0] = portVector;
 
+    pendingOutput = calloc(platoConns, sizeof(PortParam *));
+    if (pendingOutput == NULL)
+        {
+        fputs("Failed to allocate NIU output list\n", stderr);
+        exit(1);
+        }
+
+    pendingOutputCount = 0;
+    activePorts        = 0;
+
     /*
     **  Initialise port control blocks.
     */
@@ -442,6 +470,31 @@ static void niuInit(void)
         exit(1);
         }
 
+#if defined(__linux__)
+    /*
+    **  Stations are serviced through epoll if an instance can be created,
+    **  otherwise through select().
+    */
+    epollFd = epoll_create1(0);
+    if (epollFd >= 0)
+        {
+        struct epoll_event event;
+
+        memset(&event, 0, sizeof(event));
+        event.events   = EPOLLIN;
+        event.data.u32 = platoConns;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) != 0)
+            {
+            close(epollFd);
+            epollFd = -1;
+            }
+        else
+            {
+            idleWatchFd(epollFd);
+            }
+        }
+#endif
+
     fprintf(stdout, "(niu    ) Listening on port %d (%d connections permitted).\n", platoPort, platoConns);
 
 #if REAL_TIMING
@@ -574,6 +627,12 @@ static void niuInIo(void)
                 in = pp->inBuffer[pp->inOutIdx++];
                 if (pp->inOutIdx >= pp->inInIdx)
                     {
+#if defined(__linux__)
+                    if (pp->inInIdx >= InBufSize)
+                        {
+                        niuWatchInput(pp->connFd, pp->id, TRUE);
+                        }
+#endif
                     pp->inOutIdx = pp->inInIdx = 0;
                     }
 #if DEBUG_PP
@@ -744,6 +803,14 @@ static void niuOutIo(void)
     port = (d & 01777);
     niuSend(port, currOutput);
     obytes = 0;
+
+    /*
+    **  Send the output of a frame to all stations at its end.
+    */
+    if ((d & 02000) != 0)
+        {
+        niuFlushOutput();
+        }
     }
 
 /*--------------------------------------------------------------------------
@@ -782,23 +849,12 @@ static void niuDisconnect(void)
 static void niuCheckIo(void)
     {
     PortParam      *availablePort;
-#if defined(_WIN32)
-    u_long         blockEnable = 1;
-#endif
-    struct sockaddr_in from;
-#if defined(_WIN32)
-    int            fromLen;
-#else
-    socklen_t      fromLen;
-#endif
     int            i;
     int            maxFd;
     int            n;
-    int            optEnable = 1;
     PortParam      *pp;
     fd_set         readFds;
     struct timeval timeout;
-    fd_set         writeFds;
 
     ioTurns = (ioTurns + 1) % IoTurnsPerPoll;
     if (ioTurns != 0)
@@ -806,8 +862,21 @@ static void niuCheckIo(void)
         return;
         }
 
+    /*
+    **  Retry output which the stations did not take at the end of a frame.
+    */
+    niuFlushOutput();
+
+#if defined(__linux__)
+    if (epollFd >= 0)
+        {
+        niuPollEvents();
+
+        return;
+        }
+#endif
+
     FD_ZERO(&readFds);
-    FD_ZERO(&writeFds);
     maxFd         = 0;
     availablePort = NULL;
 
@@ -823,14 +892,6 @@ static void niuCheckIo(void)
                     maxFd = pp->connFd;
                     }
                 }
-            if (pp->outInIdx > pp->outOutIdx)
-                {
-                FD_SET(pp->connFd, &writeFds);
-                if (pp->connFd > maxFd)
-                    {
-                    maxFd = pp->connFd;
-                    }
-                }
             }
         else if (availablePort == NULL)
             {
@@ -850,7 +911,7 @@ static void niuCheckIo(void)
 
     timeout.tv_sec  = 0;
     timeout.tv_usec = 0;
-    n = select(maxFd + 1, &readFds, &writeFds, NULL, &timeout);
+    n = select(maxFd + 1, &readFds, NULL, NULL, &timeout);
     if (n < 1)
         {
         return;
@@ -858,78 +919,246 @@ static void niuCheckIo(void)
 
     for (i = 0, pp = portVector; i < platoConns; i++, pp++)
         {
-        if (pp->active)
+        if (pp->active && FD_ISSET(pp->connFd, &readFds))
             {
-            if (FD_ISSET(pp->connFd, &readFds))
+            niuReceive(pp);
+            }
+        }
+    if ((availablePort != NULL) && FD_ISSET(listenFd, &readFds))
+        {
+        niuAccept(availablePort);
+        }
+    }
+
+#if defined(__linux__)
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Service stations using epoll.
+**
+**                  One epoll_wait reports the stations with input pending
+**                  and a waiting connection, so the cost of a poll does not
+**                  grow with the number of stations. Only descriptors whose
+**                  input would be taken are registered: a station with a
+**                  full input buffer and the listening socket while all
+**                  ports are busy are left out, so that the epoll instance
+**                  is not readable while the emulator leaves input unread
+**                  and idle waits watching it are not cut short.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void niuPollEvents(void)
+    {
+    struct epoll_event events[MaxPollEvents];
+    int                i;
+    int                numEvents;
+    PortParam          *pp;
+
+    numEvents = epoll_wait(epollFd, events, MaxPollEvents, 0);
+    for (i = 0; i < numEvents; i++)
+        {
+        if (events[i].data.u32 < platoConns)
+            {
+            pp = portVector + events[i].data.u32;
+            if (pp->active && (pp->inInIdx < InBufSize))
                 {
-                n = recv(pp->connFd, &pp->inBuffer[pp->inInIdx], InBufSize - pp->inInIdx, 0);
-                if (n > 0)
-                    {
-#if DEBUG_NET
-                    fprintf(niuLog, "\n%010u received %d bytes on port %02o",
-                            traceSequenceNo, n, pp->id);
-                    niuLogBytes(&pp->inBuffer[pp->inInIdx], n);
-#endif
-                    pp->inInIdx += n;
-                    }
-                else
-                    {
-                    niuClose(pp);
-                    }
+                niuReceive(pp);
                 }
-            if (FD_ISSET(pp->connFd, &writeFds) && (pp->outOutIdx < pp->outInIdx))
+            }
+        else if (activePorts < platoConns)
+            {
+            /*
+            **  A connection is waiting and a port is free.
+            */
+            pp = portVector;
+            while (pp->active)
                 {
-                n = send(pp->connFd, &pp->outBuffer[pp->outOutIdx], pp->outInIdx - pp->outOutIdx, 0);
-                if (n >= 0)
-                    {
-#if DEBUG_NET
-                    fprintf(niuLog, "\n%010u sent %d bytes to port %02o",
-                            traceSequenceNo, n, pp->id);
-                    niuLogBytes(&pp->outBuffer[pp->outOutIdx], n);
-#endif
-                    pp->outOutIdx += n;
-                    if (pp->outOutIdx >= pp->outInIdx)
-                        {
-                        pp->outInIdx  = 0;
-                        pp->outOutIdx = 0;
-                        }
-                    }
+                pp++;
                 }
+
+            niuAccept(pp);
             }
         }
-    if ((availablePort != NULL) && FD_ISSET(listenFd, &readFds))
+    }
+
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Start or stop watching a descriptor for input.
+**
+**  Parameters:     Name        Description.
+**                  fd          socket
+**                  id          port number, platoConns for the listener
+**                  watch       TRUE to watch, FALSE to stop watching
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void niuWatchInput(int fd, u32 id, bool watch)
+    {
+    struct epoll_event event;
+
+    if (epollFd < 0)
+        {
+        return;
+        }
+
+    memset(&event, 0, sizeof(event));
+    event.events   = EPOLLIN;
+    event.data.u32 = id;
+    epoll_ctl(epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, fd, &event);
+    }
+
+#endif
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Receive input from a station.
+**
+**  Parameters:     Name        Description.
+**                  pp          pointer to port parameters.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void niuReceive(PortParam *pp)
+    {
+    int n;
+
+    n = recv(pp->connFd, &pp->inBuffer[pp->inInIdx], InBufSize - pp->inInIdx, 0);
+    if (n > 0)
         {
-        fromLen = sizeof(from);
-        availablePort->connFd = accept(listenFd, (struct sockaddr *)&from, &fromLen);
-        if (availablePort->connFd > 0)
+#if DEBUG_NET
+        fprintf(niuLog, "\n%010u received %d bytes on port %02o",
+                traceSequenceNo, n, pp->id);
+        niuLogBytes(&pp->inBuffer[pp->inInIdx], n);
+#endif
+        pp->inInIdx += n;
+#if defined(__linux__)
+        if (pp->inInIdx >= InBufSize)
             {
-            availablePort->active    = TRUE;
-            availablePort->inInIdx   = 0;
-            availablePort->inOutIdx  = 0;
-            availablePort->outInIdx  = 0;
-            availablePort->outOutIdx = 0;
+            niuWatchInput(pp->connFd, pp->id, FALSE);
+            }
+#endif
+        }
+    else
+        {
+        niuClose(pp);
+        }
+    }
 
-            /*
-            **  Set Keepalive option so that we can eventually discover if
-            **  a client has been rebooted.
-            */
-            setsockopt(availablePort->connFd, SOL_SOCKET, SO_KEEPALIVE, (void *)&optEnable, sizeof(optEnable));
+/*--------------------------------------------------------------------------
+**  Purpose:        Accept a connection on a free port.
+**
+**  Parameters:     Name        Description.
+**                  pp          pointer to free port parameters.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void niuAccept(PortParam *pp)
+    {
+#if defined(_WIN32)
+    u_long             blockEnable = 1;
+#endif
+    struct sockaddr_in from;
+#if defined(_WIN32)
+    int                fromLen;
+#else
+    socklen_t          fromLen;
+#endif
+    int                optEnable = 1;
 
-            /*
-            **  Make socket non-blocking.
-            */
+    fromLen    = sizeof(from);
+    pp->connFd = accept(listenFd, (struct sockaddr *)&from, &fromLen);
+    if (pp->connFd > 0)
+        {
+        pp->active    = TRUE;
+        pp->inInIdx   = 0;
+        pp->inOutIdx  = 0;
+        pp->outInIdx  = 0;
+        pp->outOutIdx = 0;
+        activePorts  += 1;
+
+        /*
+        **  Set Keepalive option so that we can eventually discover if
+        **  a client has been rebooted.
+        */
+        setsockopt(pp->connFd, SOL_SOCKET, SO_KEEPALIVE, (void *)&optEnable, sizeof(optEnable));
+
+        /*
+        **  Make socket non-blocking.
+        */
 #if defined(_WIN32)
-            ioctlsocket(availablePort->connFd, FIONBIO, &blockEnable);
+        ioctlsocket(pp->connFd, FIONBIO, &blockEnable);
 #else
-            fcntl(availablePort->connFd, F_SETFL, O_NONBLOCK);
+        fcntl(pp->connFd, F_SETFL, O_NONBLOCK);
+#endif
+#if defined(__linux__)
+        niuWatchInput(pp->connFd, pp->id, TRUE);
+        if (activePorts >= platoConns)
+            {
+            niuWatchInput(listenFd, platoConns, FALSE);
+            }
 #endif
 #if DEBUG_NET
-            fprintf(niuLog, "\n%010u accepted connection on port %02o",
-                    traceSequenceNo, availablePort->id);
+        fprintf(niuLog, "\n%010u accepted connection on port %02o",
+                traceSequenceNo, pp->id);
 #endif
-            niuWelcome(availablePort->id + NiuLocalStations);
+        niuWelcome(pp->id + NiuLocalStations);
+        niuFlushOutput();
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Send pending output to the stations.
+**
+**                  Only stations on the pending output list are visited.
+**                  A station stays on the list while the socket does not
+**                  take all of its output.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void niuFlushOutput(void)
+    {
+    int       i;
+    int       kept;
+    int       n;
+    PortParam *pp;
+
+    for (i = 0, kept = 0; i < pendingOutputCount; i++)
+        {
+        pp = pendingOutput[i];
+        if (pp->active && (pp->outOutIdx < pp->outInIdx))
+            {
+            n = send(pp->connFd, &pp->outBuffer[pp->outOutIdx], pp->outInIdx - pp->outOutIdx, 0);
+            if (n > 0)
+                {
+#if DEBUG_NET
+                fprintf(niuLog, "\n%010u sent %d bytes to port %02o",
+                        traceSequenceNo, n, pp->id);
+                niuLogBytes(&pp->outBuffer[pp->outOutIdx], n);
+#endif
+                pp->outOutIdx += n;
+                }
+            }
+
+        if (pp->active && (pp->outOutIdx < pp->outInIdx))
+            {
+            pendingOutput[kept++] = pp;
+            }
+        else
+            {
+            pp->outInIdx  = 0;
+            pp->outOutIdx = 0;
+            pp->outQueued = FALSE;
             }
         }
+
+    pendingOutputCount = kept;
     }
 
 /*--------------------------------------------------------------------------
@@ -943,9 +1172,17 @@ static void niuCheckIo(void)
 **------------------------------------------------------------------------*/
 static void niuClose(PortParam *pp)
     {
+#if defined(__linux__)
+    niuWatchInput(pp->connFd, pp->id, FALSE);
+    if (activePorts >= platoConns)
+        {
+        niuWatchInput(listenFd, platoConns, TRUE);
+        }
+#endif
     netCloseConnection(pp->connFd);
-    pp->active = FALSE;
-    pp->connFd = 0;
+    pp->active   = FALSE;
+    pp->connFd   = 0;
+    activePorts -= 1;
 #if DEBUG_NET
     fprintf(niuLog, "\n%010u connection closed on port %02o",
             traceSequenceNo, pp->id);
@@ -1085,6 +1322,11 @@ static void niuSend(int stat, int word)
                     pp->outBuffer[pp->outInIdx++] = word >> 12;
                     pp->outBuffer[pp->outInIdx++] = ((word >> 6) & 077) | 0200;
                     pp->outBuffer[pp->outInIdx++] = (word & 077) | 0300;
+                    if (!pp->outQueued)
+                        {
+                        pp->outQueued                       = TRUE;
+                        pendingOutput[pendingOutputCount++] = pp;
+                        }
                     }
 #if DEBUG_PP || DEBUG_NET
                 else
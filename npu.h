@@ -816,6 +816,9 @@ void npuBipInit(void);
 void npuBipReset(void);
 NpuBuffer *npuBipBufGet(void);
 void npuBipBufRelease(NpuBuffer *bp);
+u64 npuBipInputDeferred(u8 connType);
+bool npuBipIsInputThrottled(u8 connType);
+void npuBipShowStatus(void);
 void npuBipQueueAppend(NpuBuffer *bp, NpuQueue *queue);
 void npuBipQueuePrepend(NpuBuffer *bp, NpuQueue *queue);
 NpuBuffer *npuBipQueueExtract(NpuQueue *queue);
@@ -875,6 +878,7 @@ void npuNetSend(Tcb *tp, u8 *data, int len);
 void npuNetSetMaxCN(u8 cn);
 void npuNetQueueAck(Tcb *tp, u8 blockSeqNo);
 void npuNetQueueOutput(Tcb *tp, u8 *data, int len);
+int npuNetSendQueue(Pcb *pcbp, NpuQueue *queue, void (*sent)(Tcb *tp, NpuBuffer *bp), Tcb *tp);
 void npuNetCheckStatus(void);
 
 /*
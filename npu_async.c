@@ -112,6 +112,7 @@
 static void npuAsyncDoFeBefore(u8 fe);
 static void npuAsyncDoFeAfter(u8 fe);
 static Tcb *npuAsyncFindTcb(Pcb *pcbp);
+static void npuAsyncNotifySent(Tcb *tp, NpuBuffer *bp);
 static void npuAsyncProcessUplineTransparent(Tcb *tp);
 static void npuAsyncProcessUplineAscii(Tcb *tp);
 static void npuAsyncProcessUplineSpecial(Tcb *tp);
@@ -678,10 +679,10 @@ void npuAsyncTelnetNetSend(Tcb *tp, u8 *data, int len)
 **------------------------------------------------------------------------*/
 void npuAsyncTryOutput(Pcb *pcbp)
     {
-    NpuBuffer *bp;
-    u8        *data;
-    int       result;
-    Tcb       *tp;
+    Tcb *tp;
+#if DEBUG
+    int result;
+#endif
 
     tp = npuAsyncFindTcb(pcbp);
     if (tp == NULL)
@@ -709,75 +710,20 @@ void npuAsyncTryOutput(Pcb *pcbp)
         }
 
     /*
-    **  Process all queued output buffers.
+    **  Send all queued output buffers in one call. Likely a failure is a
+    **  "would block" type of error - no need to do anything here. The
+    **  select() call will later tell us when we can send again. Any
+    **  disconnects or other errors will be handled by the receive handler.
     */
-    while ((bp = npuBipQueueExtract(&tp->outputQ)) != NULL)
-        {
-        data = bp->data + bp->offset;
-
-        /*
-        **  Don't call into TCP if there is no data to send.
-        */
-        if (bp->numBytes > 0)
-            {
-            result = send(pcbp->connFd, data, bp->numBytes, 0);
 #if DEBUG
-            if (result > 0)
-                {
-                fprintf(npuAsyncLog, "Port %02x: %d bytes sent to %.7s\n", tp->pcbp->claPort, result, tp->termName);
-                npuAsyncLogBytes(data, result);
-                npuAsyncLogFlush();
-                }
-#endif
-            }
-        else
-            {
-            result = 0;
-            }
-
-        if (result >= bp->numBytes)
-            {
-            /*
-            **  The socket took all our data - let TIP know what block sequence
-            **  number we processed, free the buffer and then continue.
-            */
-            if (bp->blockSeqNo != 0)
-                {
-                tipNotifySent[npuSw](tp, bp->blockSeqNo);
-                }
-
-            npuBipBufRelease(bp);
-            continue;
-            }
-
-        /*
-        **  Not all has been sent. Put the buffer back into the queue.
-        */
-        npuBipQueuePrepend(bp, &tp->outputQ);
-
-        /*
-        **  Was there an error?
-        */
-        if (result < 0)
-            {
-            /*
-            **  Likely this is a "would block" type of error - no need to do
-            **  anything here. The select() call will later tell us when we
-            **  can send again. Any disconnects or other errors will be handled
-            **  by the receive handler.
-            */
-            return;
-            }
-
-        /*
-        **  The socket did not take all data - update offset and count.
-        */
-        if (result > 0)
-            {
-            bp->offset   += result;
-            bp->numBytes -= result;
-            }
+    result = npuNetSendQueue(pcbp, &tp->outputQ, npuAsyncNotifySent, tp);
+    if (result > 0)
+        {
+        fprintf(npuAsyncLog, "Port %02x: %d bytes sent to %.7s\n", tp->pcbp->claPort, result, tp->termName);
         }
+#else
+    npuNetSendQueue(pcbp, &tp->outputQ, npuAsyncNotifySent, tp);
+#endif
     }
 
 /*--------------------------------------------------------------------------
@@ -1215,6 +1161,24 @@ static void npuAsyncDoFeAfter(u8 fe)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Let TIP know what block sequence number the socket took.
+**
+**  Parameters:     Name        Description.
+**                  tp          pointer to TCB
+**                  bp          buffer which has been sent
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void npuAsyncNotifySent(Tcb *tp, NpuBuffer *bp)
+    {
+    if (bp->blockSeqNo != 0)
+        {
+        tipNotifySent[npuSw](tp, bp->blockSeqNo);
+        }
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Find the TCB assoicated with a given PCB
 **
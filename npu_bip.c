@@ -53,7 +53,11 @@
 **  Private Constants
 **  -----------------
 */
-#define NumBuffs    1000
+#define InitialBuffs    1000
+#define SlabBuffs       500
+#define BufLimit        20000
+#define ShrinkDelay     60
+#define NumConnTypes    (ConnTypeTrunk + 1)
 
 /*
 **  -----------------------
@@ -67,11 +71,23 @@
 **  -----------------------------------------
 */
 
+/*
+**  Slab of buffers added to the pool in one allocation.
+*/
+typedef struct bufSlab
+    {
+    struct bufSlab *next;               /* previously allocated slab */
+    NpuBuffer      *buffers;            /* buffers of this slab */
+    int            count;               /* number of buffers in slab */
+    } BufSlab;
+
 /*
 **  ---------------------------
 **  Private Function Prototypes
 **  ---------------------------
 */
+static void npuBipBufGrow(int count);
+static void npuBipBufShrink(void);
 
 /*
 **  ----------------
@@ -84,9 +100,39 @@
 **  Private Variables
 **  -----------------
 */
-static NpuBuffer *buffers = NULL;
-static NpuBuffer *bufPool = NULL;
-static int       bufCount = 0;
+static BufSlab   *slabs        = NULL;
+static int       slabCount     = 0;
+static int       slabFree      = 0;
+static NpuBuffer *bufPool      = NULL;
+static int       bufCount      = 0;
+static int       bufTotal      = 0;
+static int       bufHighWater  = 0;
+static u64       bufAllocs     = 0;
+static u32       bufGrows      = 0;
+static u32       bufShrinks    = 0;
+static time_t    bufLastGrow   = 0;
+static u64       bufShowAllocs = 0;
+static time_t    bufShowTime   = 0;
+
+/*
+**  Percentage of BufLimit buffers which may be in use before input from
+**  connections of a given type is no longer accepted (indexed by
+**  connection type). Interactive connections get the whole pool, bulk
+**  transfers are held back earlier so they cannot starve them.
+*/
+static const int inputQuota[NumConnTypes] =
+    {
+    100,                                // ConnTypeRaw
+    100,                                // ConnTypePterm
+    100,                                // ConnTypeRs232
+    100,                                // ConnTypeTelnet
+    50,                                 // ConnTypeHasp
+    50,                                 // ConnTypeRevHasp
+    50,                                 // ConnTypeNje
+    75                                  // ConnTypeTrunk
+    };
+
+static u64 inputDeferred[NumConnTypes];
 
 static NpuBuffer *bipUplineBuffer = NULL;
 static NpuQueue  *bipUplineQueue;
@@ -149,36 +195,11 @@ static void (*tipProcessBuffer[])(NpuBuffer *np, int priority) =
 **------------------------------------------------------------------------*/
 void npuBipInit(void)
     {
-    NpuBuffer *bp;
-    NpuBuffer *np;
-    int       count;
-
     /*
-    **  Allocate data buffer pool.
+    **  Allocate initial data buffer pool.
     */
-    bufCount = NumBuffs;
-    buffers  = bufPool = calloc(NumBuffs, sizeof(NpuBuffer));
-    if (bufPool == NULL)
-        {
-        fprintf(stderr, "Failed to allocate NPU data buffer pool\n");
-        exit(1);
-        }
-
-    /*
-    **  Link buffers into pool and link in data.
-    */
-    bp = bufPool;
-    for (count = NumBuffs - 1; count > 0; count--)
-        {
-        /*
-        **  Link to next buffer.
-        */
-        np       = bp + 1;
-        bp->next = np;
-        bp       = np;
-        }
-
-    bp->next = NULL;
+    npuBipBufGrow(InitialBuffs);
+    bufShowTime = getSeconds();
 
     /*
     **  Allocate upline buffer queue.
@@ -236,86 +257,50 @@ int npuBipBufCount(void)
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Allocate NPU buffer from pool.
+**  Purpose:        Allocate NPU buffer from pool. The pool grows by a
+**                  slab of buffers when it is empty.
 **
 **  Parameters:     Name        Description.
 **
-**  Returns:        Pointer to newly allocated buffer or NULL if pool
-**                  is empty.
+**  Returns:        Pointer to newly allocated buffer.
 **
 **------------------------------------------------------------------------*/
 NpuBuffer *npuBipBufGet(void)
     {
     NpuBuffer *bp;
 
+    if (bufPool == NULL)
+        {
+        npuBipBufGrow(SlabBuffs);
+        }
+
     /*
-    **  Allocate buffer from pool.
+    **  Unlink allocated buffer.
     */
-    bp = bufPool;
-    if (bp != NULL)
+    bp         = bufPool;
+    bufPool    = bp->next;
+    bufCount  -= 1;
+    bufAllocs += 1;
+    if (bufTotal - bufCount > bufHighWater)
         {
-        /*
-        **  Unlink allocated buffer.
-        */
-        bufPool   = bp->next;
-        bufCount -= 1;
-
-        /*
-        **  Initialise buffer.
-        */
-        bp->next       = NULL;
-        bp->offset     = 0;
-        bp->numBytes   = 0;
-        bp->blockSeqNo = 0;
-#if DEBUG
-        memset(bp->data, 0, MaxBuffer);
-#endif
+        bufHighWater = bufTotal - bufCount;
         }
-    else
+
+    if ((bp >= slabs->buffers) && (bp < slabs->buffers + slabs->count))
         {
-        npuLogMessage("(npu_bip) Out of buffers");
-        fputs("(npu_bip) Fatal error: Out of buffers\n", stderr);
-#if DEBUG
-            {
-            /*
-             *  Dump metadata and first 32 bytes of each buffer to stderr
-             */
-            u8  *data;
-            int i, j, k;
+        slabFree -= 1;
+        }
 
-            for (i = 1, bp = buffers; i <= NumBuffs; i++, bp++)
-                {
-                fprintf(stderr, "\nBuffer %d, offset=%u, numBytes=%u, blockSeqNo=%u\n",
-                        i, bp->offset, bp->numBytes, bp->blockSeqNo);
-                data = bp->data;
-                for (j = 0; j < 2; j++)
-                    {
-                    for (k = 0; k < 16; k++)
-                        {
-                        fprintf(stderr, "%02X ", *data++);
-                        }
-                    data -= 16;
-                    for (k = 0; k < 16; k++)
-                        {
-                        if ((*data >= 0x20) && (*data < 0x7f))
-                            {
-                            fprintf(stderr, "%c", *data);
-                            }
-                        else
-                            {
-                            fputc('.', stderr);
-                            }
-                        data++;
-                        }
-                    fputc('\n', stderr);
-                    }
-                }
-            data  = NULL;
-            *data = 0; // force SEGV to facilitate debugger usage
-            }
+    /*
+    **  Initialise buffer.
+    */
+    bp->next       = NULL;
+    bp->offset     = 0;
+    bp->numBytes   = 0;
+    bp->blockSeqNo = 0;
+#if DEBUG
+    memset(bp->data, 0, MaxBuffer);
 #endif
-        exit(1);
-        }
 
     return (bp);
     }
@@ -330,7 +315,70 @@ NpuBuffer *npuBipBufGet(void)
 **------------------------------------------------------------------------*/
 bool npuBipIsBusy(void)
     {
-    return (NumBuffs - bufCount) >= idleNetBufs;
+    return (bufTotal - bufCount) >= (int)idleNetBufs;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Check if input from a network connection must be
+**                  deferred because its type has used up its share of
+**                  the buffer pool.
+**
+**  Parameters:     Name        Description.
+**                  connType    connection type
+**
+**  Returns:        TRUE if input should not be read now.
+**
+**------------------------------------------------------------------------*/
+bool npuBipIsInputThrottled(u8 connType)
+    {
+    if ((connType >= NumConnTypes) || ((bufTotal - bufCount) * 100 < BufLimit * inputQuota[connType]))
+        {
+        return (FALSE);
+        }
+
+    inputDeferred[connType] += 1;
+
+    return (TRUE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Return number of times input from connections of a
+**                  given type was deferred.
+**
+**  Parameters:     Name        Description.
+**                  connType    connection type
+**
+**  Returns:        Number of deferred polls.
+**
+**------------------------------------------------------------------------*/
+u64 npuBipInputDeferred(u8 connType)
+    {
+    return (connType < NumConnTypes ? inputDeferred[connType] : 0);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Show buffer pool statistics (operator interface).
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void npuBipShowStatus(void)
+    {
+    time_t now;
+    char   outBuf[200];
+
+    now = getSeconds();
+    sprintf(outBuf, "    >   Buffers: %d in use, %d free, %d slab(s), high water %d, grown %u, shrunk %u\n",
+            bufTotal - bufCount, bufCount, slabCount, bufHighWater, bufGrows, bufShrinks);
+    opDisplay(outBuf);
+    sprintf(outBuf, "    >   Buffer allocations: %lu total, %lu/s since last shown\n",
+            (unsigned long)bufAllocs,
+            (unsigned long)((bufAllocs - bufShowAllocs) / (now > bufShowTime ? now - bufShowTime : 1)));
+    opDisplay(outBuf);
+    bufShowAllocs = bufAllocs;
+    bufShowTime   = now;
     }
 
 /*--------------------------------------------------------------------------
@@ -352,6 +400,22 @@ void npuBipBufRelease(NpuBuffer *bp)
         bp->next  = bufPool;
         bufPool   = bp;
         bufCount += 1;
+
+        /*
+        **  Give back the newest slab once all of its buffers are free, the
+        **  rest of the pool has enough headroom and the pool has not had to
+        **  grow for a while.
+        */
+        if ((bp >= slabs->buffers) && (bp < slabs->buffers + slabs->count))
+            {
+            slabFree += 1;
+            if ((slabFree == slabs->count) && (slabs->next != NULL)
+                && (bufCount - slabFree >= SlabBuffs / 2)
+                && (getSeconds() - bufLastGrow >= ShrinkDelay))
+                {
+                npuBipBufShrink();
+                }
+            }
         }
     }
 
@@ -694,4 +758,110 @@ void npuBipNotifyUplineSent(void)
  **--------------------------------------------------------------------------
  */
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Add a slab of buffers to the pool.
+**
+**  Parameters:     Name        Description.
+**                  count       number of buffers in slab
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void npuBipBufGrow(int count)
+    {
+    NpuBuffer *bp;
+    BufSlab   *sp;
+    int       i;
+
+    sp = calloc(1, sizeof(BufSlab));
+    if (sp != NULL)
+        {
+        sp->buffers = calloc(count, sizeof(NpuBuffer));
+        }
+
+    if ((sp == NULL) || (sp->buffers == NULL))
+        {
+        npuLogMessage("(npu_bip) Out of buffers");
+        fputs("(npu_bip) Fatal error: Failed to allocate NPU data buffers\n", stderr);
+        exit(1);
+        }
+
+    /*
+    **  Link buffers into pool.
+    */
+    for (i = 0, bp = sp->buffers; i < count - 1; i++, bp++)
+        {
+        bp->next = bp + 1;
+        }
+
+    bp->next  = bufPool;
+    bufPool   = sp->buffers;
+    bufCount += count;
+    bufTotal += count;
+
+    sp->count  = count;
+    sp->next   = slabs;
+    slabs      = sp;
+    slabFree   = count;
+    slabCount += 1;
+
+    if (slabCount > 1)
+        {
+        bufGrows   += 1;
+        bufLastGrow = getSeconds();
+        npuLogMessage("(npu_bip) Buffer pool grown to %d buffers", bufTotal);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Release the newest slab, all of whose buffers are in
+**                  the pool.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void npuBipBufShrink(void)
+    {
+    NpuBuffer **link;
+    NpuBuffer *bp;
+    BufSlab   *sp;
+
+    sp = slabs;
+
+    /*
+    **  Unlink the slab's buffers from the pool and count the free buffers
+    **  of the slab which now becomes the newest one.
+    */
+    slabFree = 0;
+    link     = &bufPool;
+    while ((bp = *link) != NULL)
+        {
+        if ((bp >= sp->buffers) && (bp < sp->buffers + sp->count))
+            {
+            *link = bp->next;
+            }
+        else
+            {
+            if ((bp >= sp->next->buffers) && (bp < sp->next->buffers + sp->next->count))
+                {
+                slabFree += 1;
+                }
+
+            link = &bp->next;
+            }
+        }
+
+    bufCount   -= sp->count;
+    bufTotal   -= sp->count;
+    slabs       = sp->next;
+    slabCount  -= 1;
+    bufShrinks += 1;
+    free(sp->buffers);
+    free(sp);
+
+    npuLogMessage("(npu_bip) Buffer pool shrunk to %d buffers", bufTotal);
+    }
+
 /*---------------------------  End Of File  ------------------------------*/
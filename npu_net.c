@@ -59,6 +59,10 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/uio.h>
+#endif
+#if defined(__linux__)
+#include <sys/epoll.h>
 #endif
 
 /*
@@ -67,6 +71,7 @@
 **  -----------------
 */
 #define MaxClaPorts       128
+#define MaxSendVector     64
 #define NamStartupTime    30
 
 /*
@@ -92,6 +97,10 @@ static bool npuNetCreateListeningSocket(Ncb *ncbp);
 static void npuNetCreateThread(void);
 static bool npuNetProcessNewConnection(int connFd, Ncb *ncbp, bool isPassive);
 static int npuNetRegisterClaPort(Ncb *ncbp);
+#if defined(__linux__)
+static void npuNetPollEvents(void);
+static void npuNetSyncEpoll(void);
+#endif
 static void npuNetSendConsoleMsg(int connFd, int connType, char *msg);
 static void npuNetTryOutput(Pcb *pcbp);
 
@@ -158,6 +167,16 @@ static int numNcbs = 0;
 
 static int pollIndex = 0;
 
+#if defined(__linux__)
+/*
+**  Event loop state: the epoll instance, the socket registered for each
+**  PCB (0 if none) and the time of the last output sweep.
+*/
+static int epollFd = -1;
+static int epollRegisteredFd[MaxClaPorts];
+static u64 lastOutputSweep = 0;
+#endif
+
 /*
 **  Table of functions that queue data for sending to the network,
 **  indexed by connection type
@@ -662,6 +681,27 @@ void npuNetCheckStatus(void)
     struct timeval timeout;
     fd_set         writeFds;
 
+#if defined(__linux__)
+    /*
+    **  Use the epoll event loop unless the instance can't be created.
+    */
+    if (epollFd < 0)
+        {
+        epollFd = epoll_create1(0);
+        if (epollFd >= 0)
+            {
+            idleWatchFd(epollFd);
+            }
+        }
+
+    if (epollFd >= 0)
+        {
+        npuNetPollEvents();
+
+        return;
+        }
+#endif
+
     timeout.tv_sec  = 0;
     timeout.tv_usec = 0;
 
@@ -685,25 +725,28 @@ void npuNetCheckStatus(void)
             }
 
         /*
-        **  Handle network traffic.
+        **  Handle network traffic. Input is left in the socket while the
+        **  connection type has used up its share of the buffer pool.
         */
-        FD_ZERO(&readFds);
-        FD_ZERO(&writeFds);
-        FD_SET(pcbp->connFd, &readFds);
-        readySockets = select(pcbp->connFd + 1, &readFds, NULL, NULL, &timeout);
-
-        if ((readySockets > 0) && FD_ISSET(pcbp->connFd, &readFds))
+        if (!npuBipIsInputThrottled(pcbp->ncbp->connType))
             {
-            /*
-            **  Receive a block of data.
-            */
-            pcbp->inputCount = recv(pcbp->connFd, pcbp->inputData, MaxBuffer, 0);
-            if (pcbp->inputCount <= 0)
+            FD_ZERO(&readFds);
+            FD_SET(pcbp->connFd, &readFds);
+            readySockets = select(pcbp->connFd + 1, &readFds, NULL, NULL, &timeout);
+
+            if ((readySockets > 0) && FD_ISSET(pcbp->connFd, &readFds))
                 {
-                notifyNetDisconnect[pcbp->ncbp->connType](pcbp);
-                continue;
+                /*
+                **  Receive a block of data.
+                */
+                pcbp->inputCount = recv(pcbp->connFd, pcbp->inputData, MaxBuffer, 0);
+                if (pcbp->inputCount <= 0)
+                    {
+                    notifyNetDisconnect[pcbp->ncbp->connType](pcbp);
+                    continue;
+                    }
+                processUplineData[pcbp->ncbp->connType](pcbp);
                 }
-            processUplineData[pcbp->ncbp->connType](pcbp);
             }
 
         if (pcbp->connFd > 0)
@@ -839,6 +882,17 @@ void npuNetShowStatus()
             chEqStr[0] = '\0';
             }
         }
+
+    npuBipShowStatus();
+    for (i = 0; i < (int)(sizeof(connTypes) / sizeof(connTypes[0])); i++)
+        {
+        if (npuBipInputDeferred(i) != 0)
+            {
+            sprintf(outBuf, "    >   Input deferred for lack of buffers: %lu polls (%s)\n",
+                    (unsigned long)npuBipInputDeferred(i), connTypes[i]);
+            opDisplay(outBuf);
+            }
+        }
     }
 
 /*
@@ -1477,6 +1531,9 @@ static bool npuNetProcessNewConnection(int connFd, Ncb *ncbp, bool isPassive)
     **  Initialize the connection and mark it as active.
     */
     pcbp->connFd = connFd;
+#if defined(__linux__)
+    epollRegisteredFd[pcbp - pcbs] = 0;
+#endif
     if (pcbp->cciWaitForTcb)
         {
         pcbp->cciTcbWaitStart = getSeconds();
@@ -1485,6 +1542,7 @@ static bool npuNetProcessNewConnection(int connFd, Ncb *ncbp, bool isPassive)
         {
         npuNetSendConsoleMsg(connFd, ncbp->connType, connectingMsg);
         pcbp->ncbp->state = StConnConnected;
+        idleWakeup();
 
         return TRUE;
         }
@@ -1566,6 +1624,95 @@ void npuNetQueueOutput(Tcb *tp, u8 *data, int len)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Send the data of a queue of output buffers in one call.
+**
+**                  A buffer holds unsent data from offset up to numBytes.
+**                  Up to MaxSendVector buffers are gathered into a single
+**                  writev(). Buffers sent completely are passed to the
+**                  optional sent handler, then removed from the queue and
+**                  released. A partially sent buffer stays at the head of
+**                  the queue with its offset advanced.
+**
+**  Parameters:     Name        Description.
+**                  pcbp        PCB pointer
+**                  queue       queue of output buffers
+**                  sent        handler for sent buffers, or NULL
+**                  tp          TCB pointer passed to handler
+**
+**  Returns:        Number of bytes sent, or -1 if the socket took no data
+**                  (for example because it would block).
+**
+**------------------------------------------------------------------------*/
+int npuNetSendQueue(Pcb *pcbp, NpuQueue *queue, void (*sent)(Tcb *tp, NpuBuffer *bp), Tcb *tp)
+    {
+    NpuBuffer    *bp;
+    int          n;
+    int          remaining;
+    int          result;
+#if !defined(_WIN32)
+    int          count;
+    struct iovec vec[MaxSendVector];
+#endif
+
+#if defined(_WIN32)
+    /*
+    **  Winsock 1 has no gather send - send the first buffer holding data.
+    */
+    result = 0;
+    for (bp = queue->first; bp != NULL; bp = bp->next)
+        {
+        if (bp->numBytes > bp->offset)
+            {
+            result = send(pcbp->connFd, bp->data + bp->offset, bp->numBytes - bp->offset, 0);
+            break;
+            }
+        }
+#else
+    count = 0;
+    for (bp = queue->first; (bp != NULL) && (count < MaxSendVector); bp = bp->next)
+        {
+        if (bp->numBytes > bp->offset)
+            {
+            vec[count].iov_base  = bp->data + bp->offset;
+            vec[count++].iov_len = bp->numBytes - bp->offset;
+            }
+        }
+
+    result = (count > 0) ? writev(pcbp->connFd, vec, count) : 0;
+#endif
+
+    if (result < 0)
+        {
+        return -1;
+        }
+
+    /*
+    **  Retire the buffers the socket took and account for a partial one.
+    */
+    n = result;
+    while ((bp = queue->first) != NULL)
+        {
+        remaining = bp->numBytes - bp->offset;
+        if (remaining > n)
+            {
+            bp->offset += n;
+            break;
+            }
+
+        n -= remaining;
+        bp = npuBipQueueExtract(queue);
+        if (sent != NULL)
+            {
+            sent(tp, bp);
+            }
+
+        npuBipBufRelease(bp);
+        }
+
+    return result;
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Try to send any queued data.
 **
@@ -1580,4 +1727,166 @@ static void npuNetTryOutput(Pcb *pcbp)
     tryOutput[pcbp->ncbp->connType](pcbp);
     }
 
+#if defined(__linux__)
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Service network connections using epoll.
+**
+**                  A single epoll_wait reports all connections with input
+**                  pending. Each of them receives one block per call,
+**                  starting with a different connection every call so
+**                  that low-numbered connections get no preferential
+**                  treatment. Pending output is tried for all connections
+**                  in one sweep per millisecond.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void npuNetPollEvents(void)
+    {
+    struct epoll_event events[MaxClaPorts];
+    u64                currentTime;
+    int                i;
+    int                n;
+    int                numEvents;
+    Pcb                *pcbp;
+    bool               ready[MaxClaPorts];
+
+    npuNetSyncEpoll();
+
+    /*
+    **  Collect connections with input pending.
+    */
+    memset(ready, 0, sizeof(ready));
+    numEvents = epoll_wait(epollFd, events, MaxClaPorts, 0);
+    for (i = 0; i < numEvents; i++)
+        {
+        ready[events[i].data.u32] = TRUE;
+        }
+
+    /*
+    **  Receive one block from each of them in round robin order.
+    */
+    if (numEvents > 0)
+        {
+        for (n = 0; n <= npuNetMaxClaPort; n++)
+            {
+            i = (pollIndex + n) % (npuNetMaxClaPort + 1);
+            pcbp = &pcbs[i];
+            if (!ready[i] || (pcbp->connFd <= 0) || pcbp->cciWaitForTcb
+                || npuBipIsInputThrottled(pcbp->ncbp->connType))
+                {
+                continue;
+                }
+
+            pcbp->inputCount = recv(pcbp->connFd, pcbp->inputData, MaxBuffer, 0);
+            if (pcbp->inputCount <= 0)
+                {
+                notifyNetDisconnect[pcbp->ncbp->connType](pcbp);
+                continue;
+                }
+
+            processUplineData[pcbp->ncbp->connType](pcbp);
+            }
+        }
+
+    pollIndex = (pollIndex + 1) % (npuNetMaxClaPort + 1);
+
+    /*
+    **  Try pending output on all connections.
+    */
+    currentTime = getMilliseconds();
+    if (currentTime != lastOutputSweep)
+        {
+        lastOutputSweep = currentTime;
+        for (i = 0; i <= npuNetMaxClaPort; i++)
+            {
+            pcbp = &pcbs[i];
+            if ((pcbp->connFd > 0) && !pcbp->cciWaitForTcb)
+                {
+                npuNetTryOutput(pcbp);
+                }
+            }
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Bring the epoll registrations in line with the sockets
+**                  of the PCBs and time out connections waiting for their
+**                  terminal to be configured.
+**
+**                  Only sockets whose input the next poll would take are
+**                  registered; connections waiting for their terminal to
+**                  be configured or whose input is throttled are left
+**                  out until that changes. Otherwise the epoll instance
+**                  stays readable while the input sits unread, and idle
+**                  waits watching it end at once.
+**
+**                  Sockets are only registered or unregistered when they
+**                  change. Stale registrations are removed before new
+**                  ones are added because a TIP may move a socket from
+**                  one PCB to another.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void npuNetSyncEpoll(void)
+    {
+    struct epoll_event event;
+    int                i;
+    Pcb                *pcbp;
+    int                wantedFd[MaxClaPorts];
+
+    for (i = 0; i <= npuNetMaxClaPort; i++)
+        {
+        pcbp = &pcbs[i];
+        if ((pcbp->connFd > 0) && pcbp->cciWaitForTcb
+            && (getSeconds() - pcbp->cciTcbWaitStart > CciWaitForTcbTimeout))
+            {
+            npuNetSendConsoleMsg(pcbp->connFd, pcbp->ncbp->connType, tcbNotConfiguredMsg);
+            netCloseConnection(pcbp->connFd);
+            pcbp->connFd      = 0;
+            pcbp->ncbp->state = StConnInit;
+            }
+
+        wantedFd[i] = 0;
+        if ((pcbp->connFd > 0) && !pcbp->cciWaitForTcb
+            && !npuBipIsInputThrottled(pcbp->ncbp->connType))
+            {
+            wantedFd[i] = pcbp->connFd;
+            }
+
+        if ((epollRegisteredFd[i] != 0) && (epollRegisteredFd[i] != wantedFd[i]))
+            {
+            /*
+            **  Fails harmlessly if the socket has already been closed.
+            */
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, epollRegisteredFd[i], &event);
+            epollRegisteredFd[i] = 0;
+            }
+        }
+
+    for (i = 0; i <= npuNetMaxClaPort; i++)
+        {
+        if ((wantedFd[i] != 0) && (epollRegisteredFd[i] != wantedFd[i]))
+            {
+            memset(&event, 0, sizeof(event));
+            event.events   = EPOLLIN;
+            event.data.u32 = i;
+            if ((epoll_ctl(epollFd, EPOLL_CTL_ADD, wantedFd[i], &event) != 0) && (errno == EEXIST))
+                {
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, wantedFd[i], &event);
+                }
+
+            epollRegisteredFd[i] = wantedFd[i];
+            }
+        }
+    }
+
+#endif
+
 /*---------------------------  End Of File  ------------------------------*/
@@ -366,10 +366,11 @@ static char *LoggedOut               = "LOGGED OUT.";
 **------------------------------------------------------------------------*/
 void npuNjeTryOutput(Pcb *pcbp)
     {
-    NpuBuffer *bp;
-    time_t    currentTime;
-    int       n;
-    Tcb       *tcbp;
+    time_t currentTime;
+    Tcb    *tcbp;
+#if DEBUG
+    int    n;
+#endif
 
     currentTime = getSeconds();
     tcbp        = npuNjeFindTcb(pcbp);
@@ -414,22 +415,18 @@ void npuNjeTryOutput(Pcb *pcbp)
 
     if (tcbp != NULL)
         {
-        while ((bp = npuBipQueueExtract(&tcbp->outputQ)) != NULL)
+        if (npuBipQueueNotEmpty(&tcbp->outputQ))
             {
-            n = npuNjeSend(pcbp, bp->data + bp->offset, bp->numBytes - bp->offset);
+#if DEBUG
+            n = npuNetSendQueue(pcbp, &tcbp->outputQ, NULL, tcbp);
             if (n > 0)
                 {
-                bp->offset += n;
-                }
-            if (bp->offset >= bp->numBytes)
-                {
-                npuBipBufRelease(bp);
-                }
-            else
-                {
-                npuBipQueuePrepend(bp, &tcbp->outputQ);
-                break;
+                fprintf(npuNjeLog, "Port %02x: TCP data sent to %s (%d bytes)\n", pcbp->claPort, pcbp->ncbp->hostName, n);
                 }
+#else
+            npuNetSendQueue(pcbp, &tcbp->outputQ, NULL, tcbp);
+#endif
+            pcbp->controls.nje.lastXmit = getSeconds();
             }
         if (tcbp->state == StTermConnected)
             {
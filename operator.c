@@ -125,9 +125,15 @@ static bool opIsAbsolutePath(char *path);
 static int  opReadLine(char *buf, int size);
 static int  opStartListening(int port);
 
+static void opCmdCheckpoint(bool help, char *cmdParams);
+static void opHelpCheckpoint(void);
+
 static void opCmdCloseConsoleWindow(bool help, char *cmdParams);
 static void opHelpCloseConsoleWindow(void);
 
+static void opCmdCpuPerformance(bool help, char *cmdParams);
+static void opHelpCpuPerformance(void);
+
 static void opCmdDiscRemoteConsole(bool help, char *cmdParams);
 static void opHelpDiscRemoteConsole(void);
 
@@ -240,6 +246,8 @@ volatile bool opPaused = FALSE;
 static OpCmd decode[] =
     {
     "ccw",                   opCmdCloseConsoleWindow,
+    "ckp",                   opCmdCheckpoint,
+    "cpf",                   opCmdCpuPerformance,
     "d",                     opCmdDumpMemory,
     "drc",                   opCmdDiscRemoteConsole,
     "dm",                    opCmdDumpMemory,
@@ -267,7 +275,9 @@ static OpCmd decode[] =
     "sv",                    opCmdShowVersion,
     "ud",                    opCmdUnloadDisk,
     "ut",                    opCmdUnloadTape,
+    "checkpoint",            opCmdCheckpoint,
     "close_console_window",  opCmdCloseConsoleWindow,
+    "cpu_performance",       opCmdCpuPerformance,
     "disconnect_remote_console", opCmdDiscRemoteConsole,
     "dump_memory",           opCmdDumpMemory,
     "enter_keys",            opCmdEnterKeys,
@@ -669,9 +679,13 @@ static void *opThread(void *param)
             {
             if (strcasecmp(cp->name, name) == 0)
                 {
-                if (cp->handler == opCmdEnterKeys)
+                if (cp->handler == opCmdEnterKeys || cp->handler == opCmdCpuPerformance || cp->handler == opCmdCheckpoint)
                     {
-                    opCmdEnterKeys(FALSE, params);
+                    /*
+                    **  These commands run on the operator thread because
+                    **  they wait while emulation continues.
+                    */
+                    cp->handler(FALSE, params);
                     opActive = FALSE;
                     break;
                     }
@@ -682,6 +696,7 @@ static void *opThread(void *param)
                 strcpy(opCmdParams, params);
                 opCmdFunction = cp->handler;
                 opActive      = TRUE;
+                idleWakeup();
                 break;
                 }
             }
@@ -1135,6 +1150,217 @@ static void opHelpCloseConsoleWindow(void)
     opDisplay("    > 'close_console_window' close the local console window.\n");
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Write memory mapped CM, ECS and PPM back to their
+**                  persistence files.
+**
+**  Parameters:     Name        Description.
+**                  help        Request only help on this command.
+**                  cmdParams   Command parameters
+**
+**  Returns:        Nothing.
+**
+**  Note:           This command runs on the operator thread, so emulation
+**                  continues while the data is written.
+**
+**------------------------------------------------------------------------*/
+static void opCmdCheckpoint(bool help, char *cmdParams)
+    {
+    u64 start;
+
+    /*
+    **  Process help request.
+    */
+    if (help)
+        {
+        opHelpCheckpoint();
+
+        return;
+        }
+
+    /*
+    **  Check parameters and process command.
+    */
+    if (strlen(cmdParams) != 0)
+        {
+        opDisplay("    > No parameters expected\n");
+        opHelpCheckpoint();
+
+        return;
+        }
+
+    if (!persistMapped)
+        {
+        opDisplay("    > Memory mapped persistence is not enabled (see 'persistMode')\n");
+
+        return;
+        }
+
+    start = getMilliseconds();
+    persistSync(NULL, TRUE);
+    sprintf(opOutBuf, "    > Checkpoint of CM, ECS and PPM completed in %lu msec\n", (unsigned long)(getMilliseconds() - start));
+    opDisplay(opOutBuf);
+    }
+
+static void opHelpCheckpoint(void)
+    {
+    opDisplay("    > 'checkpoint' write memory mapped CM, ECS and PPM to the persistence directory.\n");
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Show CPU performance counters, control the CPU
+**                  instruction decode cache and benchmark it.
+**
+**  Parameters:     Name        Description.
+**                  help        Request only help on this command.
+**                  cmdParams   Command parameters
+**
+**  Returns:        Nothing.
+**
+**  Note:           This command runs on the operator thread, so the
+**                  benchmark measures the emulation while it continues
+**                  to run normally.
+**
+**------------------------------------------------------------------------*/
+static void opCmdCpuPerformance(bool help, char *cmdParams)
+    {
+    u64    count;
+    int    cpuNum;
+    u64    elapsed;
+    u64    hits;
+    int    i;
+    double mips[2];
+    u64    misses;
+    int    numParam;
+    bool   savedState;
+    int    seconds;
+    u64    start;
+
+    /*
+    **  Process help request.
+    */
+    if (help)
+        {
+        opHelpCpuPerformance();
+
+        return;
+        }
+
+    if (strlen(cmdParams) == 0)
+        {
+        sprintf(opOutBuf, "    > CPU engine: %s\n", cpuEngine == CpuEngineThreaded ? "threaded" : "classic");
+        opDisplay(opOutBuf);
+        sprintf(opOutBuf, "    > Instruction decode cache: %s\n", cpuDecodeCacheEnabled ? "ON" : "OFF");
+        opDisplay(opOutBuf);
+        for (cpuNum = 0; cpuNum < cpuCount; cpuNum++)
+            {
+            count  = cpus[cpuNum].instructionCount;
+            hits   = cpus[cpuNum].decodeHits;
+            misses = cpus[cpuNum].decodeMisses;
+            sprintf(opOutBuf, "    > CPU%o: %.0f instructions, decode cache hit rate %.2f%%\n", cpuNum, (double)count,
+                    (hits + misses) != 0 ? (100.0 * (double)hits) / (double)(hits + misses) : 0.0);
+            opDisplay(opOutBuf);
+            sprintf(opOutBuf, "    >       exchanges requested %.0f, granted %.0f, deferred %.0f\n",
+                    (double)cpus[cpuNum].exchangesRequested, (double)cpus[cpuNum].exchangesGranted,
+                    (double)cpus[cpuNum].exchangesDeferred);
+            opDisplay(opOutBuf);
+            sprintf(opOutBuf, "    >       ECS/UEM block transfers fast path %.0f, word by word %.0f\n",
+                    (double)cpus[cpuNum].extFastTransfers, (double)cpus[cpuNum].extSlowTransfers);
+            opDisplay(opOutBuf);
+            }
+
+        return;
+        }
+
+    if (strcasecmp(cmdParams, "on") == 0)
+        {
+        cpuDecodeCacheEnabled = TRUE;
+
+        return;
+        }
+
+    if (strcasecmp(cmdParams, "off") == 0)
+        {
+        cpuDecodeCacheEnabled = FALSE;
+
+        return;
+        }
+
+    if (strncasecmp(cmdParams, "bench", 5) != 0)
+        {
+        opDisplay("    > Invalid parameter\n");
+        opHelpCpuPerformance();
+
+        return;
+        }
+
+    seconds = 10;
+    if (cmdParams[5] == ',')
+        {
+        numParam = sscanf(cmdParams + 6, "%d", &seconds);
+        if ((numParam != 1) || (seconds < 1))
+            {
+            opDisplay("    > Invalid number of seconds\n");
+
+            return;
+            }
+        }
+    else if (cmdParams[5] != '\0')
+        {
+        opDisplay("    > Invalid parameter\n");
+        opHelpCpuPerformance();
+
+        return;
+        }
+
+    /*
+    **  Measure with the decode cache off, then on.
+    */
+    savedState = cpuDecodeCacheEnabled;
+    for (i = 0; i < 2; i++)
+        {
+        cpuDecodeCacheEnabled = i != 0;
+        sprintf(opOutBuf, "    > Measuring with decode cache %s for %d seconds ...\n", i != 0 ? "ON" : "OFF", seconds);
+        opDisplay(opOutBuf);
+
+        count = 0;
+        for (cpuNum = 0; cpuNum < cpuCount; cpuNum++)
+            {
+            count -= cpus[cpuNum].instructionCount;
+            }
+        start = getMilliseconds();
+        sleepMsec(seconds * 1000);
+        elapsed = getMilliseconds() - start;
+        for (cpuNum = 0; cpuNum < cpuCount; cpuNum++)
+            {
+            count += cpus[cpuNum].instructionCount;
+            }
+
+        mips[i] = (elapsed != 0) ? (double)count / ((double)elapsed * 1000.0) : 0.0;
+        }
+
+    cpuDecodeCacheEnabled = savedState;
+
+    sprintf(opOutBuf, "    > Decode cache OFF: %.2f MIPS\n", mips[0]);
+    opDisplay(opOutBuf);
+    sprintf(opOutBuf, "    > Decode cache ON:  %.2f MIPS\n", mips[1]);
+    opDisplay(opOutBuf);
+    if (mips[0] > 0.0)
+        {
+        sprintf(opOutBuf, "    > Speedup: %.2f\n", mips[1] / mips[0]);
+        opDisplay(opOutBuf);
+        }
+    }
+
+static void opHelpCpuPerformance(void)
+    {
+    opDisplay("    > 'cpu_performance' show CPU instruction counts, decode cache hit rate and\n");
+    opDisplay("    >     PP exchange request and ECS/UEM block transfer statistics.\n");
+    opDisplay("    > 'cpu_performance on|off' enable or disable the CPU instruction decode cache.\n");
+    opDisplay("    > 'cpu_performance bench[,<seconds>]' report MIPS with the decode cache off and on\n");
+    opDisplay("    >     (default 10 seconds per measurement).\n");
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Disconnect Remote Console
 **
@@ -3300,6 +3526,7 @@ static void opCmdShowDisk(bool help, char *cmdParams)
     dd8xxShowDiskStatus();
     dd885_42ShowDiskStatus();
     dd6603ShowDiskStatus();
+    diskIoShowStatus();
     }
 
 static void opHelpShowDisk(void)
@@ -0,0 +1,376 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: persist.c
+**
+**  Description:
+**      Memory mapped persistence of CM, ECS and PP memory. The emulated
+**      memories live directly in files in the persistence directory, so
+**      nothing needs to be read at startup or written at shutdown, and
+**      the latest contents survive a crash of the emulator. Dirty pages
+**      are flushed periodically and on operator request.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+#define MaxPersistRegions    4
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+
+/*
+**  Memory region mapped onto a backing file.
+*/
+typedef struct persistRegion
+    {
+    char   *title;                      /* name used in messages, e.g. "CM" */
+    void   *addr;                       /* start of mapping */
+    size_t size;                        /* length of mapping in bytes */
+#if defined(_WIN32)
+    HANDLE fileHandle;                  /* backing file */
+    HANDLE mapHandle;                   /* file mapping object */
+#endif
+    } PersistRegion;
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static void persistCreateThread(void);
+
+#if defined(_WIN32)
+static void persistThread(void *param);
+
+#else
+static void *persistThread(void *param);
+
+#endif
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+bool persistMapped   = FALSE;
+u32  persistSyncSecs = 30;
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+static PersistRegion regions[MaxPersistRegions];
+static int           regionCount = 0;
+static bool          isThreadRunning = FALSE;
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Map a memory onto its backing file in the persistence
+**                  directory. The file is created if it does not exist;
+**                  if it has an unexpected length the memory is cleared.
+**
+**  Parameters:     Name        Description.
+**                  name        file name within persistence directory
+**                  size        size of memory in bytes
+**                  title       name of memory used in messages
+**
+**  Returns:        Pointer to mapped memory, NULL on failure.
+**
+**------------------------------------------------------------------------*/
+void *persistMap(char *name, size_t size, char *title)
+    {
+    char          fileName[256];
+    PersistRegion *rp;
+    bool          isCleared;
+
+    if (regionCount >= MaxPersistRegions)
+        {
+        fprintf(stderr, "(persist) Too many memory mapped regions\n");
+
+        return (NULL);
+        }
+
+    rp        = regions + regionCount;
+    isCleared = FALSE;
+    strcpy(fileName, persistDir);
+    strcat(fileName, "/");
+    strcat(fileName, name);
+
+#if defined(_WIN32)
+    {
+    LARGE_INTEGER fileSize;
+
+    rp->fileHandle = CreateFile(fileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (rp->fileHandle == INVALID_HANDLE_VALUE)
+        {
+        fprintf(stderr, "(persist) Failed to open %s backing file '%s'\n", title, fileName);
+
+        return (NULL);
+        }
+
+    if (!GetFileSizeEx(rp->fileHandle, &fileSize) || ((u64)fileSize.QuadPart < (u64)size))
+        {
+        isCleared = fileSize.QuadPart != 0;
+        }
+
+    rp->mapHandle = CreateFileMapping(rp->fileHandle, NULL, PAGE_READWRITE, (DWORD)((u64)size >> 32), (DWORD)size, NULL);
+    if (rp->mapHandle == NULL)
+        {
+        fprintf(stderr, "(persist) Failed to map %s backing file '%s'\n", title, fileName);
+        CloseHandle(rp->fileHandle);
+
+        return (NULL);
+        }
+
+    rp->addr = MapViewOfFile(rp->mapHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (rp->addr == NULL)
+        {
+        fprintf(stderr, "(persist) Failed to map %s backing file '%s'\n", title, fileName);
+        CloseHandle(rp->mapHandle);
+        CloseHandle(rp->fileHandle);
+
+        return (NULL);
+        }
+    }
+#else
+    {
+    int         fd;
+    struct stat s;
+
+    fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        {
+        fprintf(stderr, "(persist) Failed to open %s backing file '%s'\n", title, fileName);
+
+        return (NULL);
+        }
+
+    if (fstat(fd, &s) != 0)
+        {
+        s.st_size = 0;
+        }
+
+    /*
+    **  A file which is too short is resized, and cleared unless it was
+    **  just created.
+    */
+    if ((size_t)s.st_size < size)
+        {
+        isCleared = s.st_size != 0;
+        if ((ftruncate(fd, 0) != 0) || (ftruncate(fd, (off_t)size) != 0))
+            {
+            fprintf(stderr, "(persist) Failed to size %s backing file '%s'\n", title, fileName);
+            close(fd);
+
+            return (NULL);
+            }
+        }
+
+    rp->addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (rp->addr == MAP_FAILED)
+        {
+        fprintf(stderr, "(persist) Failed to map %s backing file '%s'\n", title, fileName);
+
+        return (NULL);
+        }
+    }
+#endif
+
+    if (isCleared)
+        {
+        printf("(persist) Unexpected length of %s backing file, clearing %s\n", title, title);
+        memset(rp->addr, 0, size);
+        }
+
+    rp->title    = title;
+    rp->size     = size;
+    regionCount += 1;
+
+    printf("(persist) %s mapped onto '%s'\n", title, fileName);
+
+    if (!isThreadRunning && (persistSyncSecs > 0))
+        {
+        persistCreateThread();
+        isThreadRunning = TRUE;
+        }
+
+    return (rp->addr);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Flush mapped memory to its backing file.
+**
+**  Parameters:     Name        Description.
+**                  addr        start of mapped region, NULL for all regions
+**                  wait        TRUE to wait until data is on disk, FALSE to
+**                              just schedule the write
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void persistSync(void *addr, bool wait)
+    {
+    PersistRegion *rp;
+    int           i;
+
+    for (i = 0; i < regionCount; i++)
+        {
+        rp = regions + i;
+        if ((addr != NULL) && (addr != rp->addr))
+            {
+            continue;
+            }
+
+#if defined(_WIN32)
+        if (!FlushViewOfFile(rp->addr, 0) || (wait && !FlushFileBuffers(rp->fileHandle)))
+#else
+        if (msync(rp->addr, rp->size, wait ? MS_SYNC : MS_ASYNC) != 0)
+#endif
+            {
+            fprintf(stderr, "(persist) Error flushing %s backing file\n", rp->title);
+            }
+        }
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Create thread which periodically flushes mapped memory.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void persistCreateThread(void)
+    {
+#if defined(_WIN32)
+    DWORD  dwThreadId;
+    HANDLE hThread;
+
+    hThread = CreateThread(
+        NULL,                                       // no security attribute
+        0,                                          // default stack size
+        (LPTHREAD_START_ROUTINE)persistThread,
+        NULL,                                       // thread parameter
+        0,                                          // not suspended
+        &dwThreadId);                               // returns thread ID
+
+    if (hThread == NULL)
+        {
+        fputs("(persist) Failed to create persistence thread\n", stderr);
+        exit(1);
+        }
+#else
+    int            rc;
+    pthread_t      thread;
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    rc = pthread_create(&thread, &attr, persistThread, NULL);
+    if (rc < 0)
+        {
+        fputs("(persist) Failed to create persistence thread\n", stderr);
+        exit(1);
+        }
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Persistence thread. Schedules write back of dirty
+**                  pages every persistSyncSecs seconds.
+**
+**  Parameters:     Name        Description.
+**                  param       unused
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+#if defined(_WIN32)
+static void persistThread(void *param)
+#else
+static void *persistThread(void *param)
+#endif
+    {
+    u32 secs;
+
+    for (;;)
+        {
+        for (secs = 0; secs < persistSyncSecs; secs++)
+            {
+            sleepMsec(1000);
+            }
+        persistSync(NULL, FALSE);
+        }
+
+#if !defined(_WIN32)
+    return (NULL);
+#endif
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
@@ -36,6 +36,12 @@
 #include "const.h"
 #include "types.h"
 #include "proto.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 /*
 **  -----------------
@@ -43,6 +49,26 @@
 **  -----------------
 */
 
+/*
+**  Number of times a PP worker thread whose partition made progress polls
+**  for the next epoch before it blocks waiting for it.
+*/
+#define PpWorkerSpinLimit    2000
+
+/*
+**  Longest backward jump considered a loop, and most CM words a parked
+**  polling loop may watch.
+*/
+#define PpLoopMaxSpan        16
+#define PpLoopMaxReads       4
+
+/*
+**  States of the loop detector of a PP.
+*/
+#define PpLoopNone           0      /* no loop being followed */
+#define PpLoopVerify         1      /* following one iteration of a candidate loop */
+#define PpLoopParked         2      /* loop is a fixed point, waiting for CM to change */
+
 /*
 **  -----------------------
 **  Private Macro Functions
@@ -89,6 +115,51 @@
 **  -----------------------------------------
 */
 
+/*
+**  PP barrel partition executed by one host thread.
+*/
+typedef struct ppWorker
+    {
+    u8        first;                    /* first PP of partition */
+    u8        limit;                    /* last PP of partition + 1 */
+    int       epoch;                    /* last epoch started */
+#if defined(_WIN32)
+    HANDLE    thread;                   /* worker thread */
+#else
+    pthread_t thread;                   /* worker thread */
+#endif
+    } PpWorker;
+
+/*
+**  PP parked in a channel wait. It is not stepped until the event count of
+**  its channel moves on.
+*/
+typedef struct ppParking
+    {
+    ChSlot *channel;                    /* channel waited for, NULL if not parked */
+    u32    events;                      /* channel event count when parked */
+    } PpParking;
+
+/*
+**  Loop detector of a PP. A short loop is followed for one iteration; if
+**  only side-effect free instructions were executed and the iteration
+**  ended in the state it started from, every further iteration is the same
+**  until one of the CM words it read changes, so the PP need not be stepped
+**  until then.
+*/
+typedef struct ppLoop
+    {
+    bool   isEnabled;                   /* fast-forwarding enabled for this PP */
+    u8     state;                       /* PpLoopNone, PpLoopVerify or PpLoopParked */
+    bool   isFixed;                     /* iteration so far left PP memory unchanged */
+    PpWord head;                        /* loop head (jump target) */
+    PpWord end;                         /* address of backward jump */
+    u32    regA;                        /* A at loop head */
+    u8     reads;                       /* number of CM words read in iteration */
+    u32    address[PpLoopMaxReads];     /* absolute CM addresses read */
+    CpWord data[PpLoopMaxReads];        /* contents of CM words read */
+    } PpLoop;
+
 /*
 **  ---------------------------
 **  Private Function Prototypes
@@ -159,9 +230,30 @@ static void ppOpDCN(void);    // 75
 static void ppOpFAN(void);    // 76
 static void ppOpFNC(void);    // 77
 
-static u32 ppAdd18(u32 op1, u32 op2);
-static u32 ppSubtract18(u32 op1, u32 op2);
+static u32  ppAdd18(u32 op1, u32 op2);
+static void ppAtomicAdd(AtomicInt *ap, int value);
+static int  ppAtomicLoad(AtomicInt *ap);
+static void ppCreateWorkers(void);
+static void ppExecuteChannel(PpByte op, PpByte d);
+static bool ppIsChannelWait(ChSlot *cc);
+static void ppLoopCheck(PpLoop *lp, PpWord opAddress, PpByte op);
+static bool ppLoopIsPureOp(PpByte op);
+static bool ppLoopIsUnchanged(PpLoop *lp);
+static void ppLoopRecordRead(PpLoop *lp, u32 address, CpWord data);
+static void ppExecute(PpSlot *pp);
 static void ppInterlock(PpWord func);
+static void ppRunEpoch(void);
+static bool ppRunPartition(PpWorker *wp);
+static u32  ppSubtract18(u32 op1, u32 op2);
+static void ppTerminateWorkers(void);
+
+#if defined(_WIN32)
+static void ppThread(void *param);
+
+#else
+static void *ppThread(void *param);
+
+#endif
 
 #if PPDEBUG
 static void ppValidateCmWrite(char *inst, u32 address, CpWord data);
@@ -173,9 +265,12 @@ static void ppValidateCmWrite(char *inst, u32 address, CpWord data);
 **  Public Variables
 **  ----------------
 */
-PpSlot *ppu;
-PpSlot *activePpu;
-u8     ppuCount;
+PpSlot             *ppu;
+ThreadLocal PpSlot *activePpu;
+u32                ppBarrelPasses  = 8;
+u8                 ppBarrelThreads = 1;
+u32                ppFastForward   = 0;
+u8                 ppuCount;
 
 /*
 **  -----------------
@@ -184,11 +279,31 @@ u8     ppuCount;
 */
 static FILE   *ppHandle;
 static u8     pp = 0;
-static PpByte opF;
-static PpByte opD;
-static PpWord location;
-static u32    acc18;
-static bool   noHang;
+static ThreadLocal PpByte opF;
+static ThreadLocal PpByte opD;
+static ThreadLocal PpWord location;
+static ThreadLocal u32    acc18;
+static ThreadLocal bool   noHang;
+
+/*
+**  Multi-threaded PP barrel state.
+*/
+static PpWorker      *ppWorkers;
+static AtomicInt     ppEpoch;          /* incremented by main thread to start an epoch */
+static AtomicInt     ppWorkersBusy;    /* worker threads still running the current epoch, set under ppEpochLock */
+static volatile bool ppWorkersStop;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION   ppChannelLock;
+static CRITICAL_SECTION   ppEpochLock;
+static CONDITION_VARIABLE ppEpochStart;
+static CONDITION_VARIABLE ppEpochDone;
+#else
+static pthread_mutex_t    ppChannelLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t    ppEpochLock   = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     ppEpochStart  = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t     ppEpochDone   = PTHREAD_COND_INITIALIZER;
+#endif
 
 static void (*decodePpuOpcode[])(void) =
     {
@@ -258,6 +373,9 @@ static void (*decodePpuOpcode[])(void) =
     ppOpFNC     // 77
     };
 
+static PpParking   *ppParked;
+static PpLoop      *ppLoops;
+
 #if PPDEBUG
 static FILE *ppLog = NULL;
 #endif
@@ -271,270 +389,1018 @@ static FILE *ppLog = NULL;
  */
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Initialise PP subsystem.
+**  Purpose:        Initialise PP subsystem.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void ppInit(u8 count)
+    {
+    /*
+    **  Allocate ppu structures.
+    */
+    ppuCount = count;
+    if (persistMapped)
+        {
+        ppu = persistMap("ppStore", (size_t)count * sizeof(PpSlot), "PPM");
+        }
+    else
+        {
+        ppu = calloc(count, sizeof(PpSlot));
+        }
+
+    if (ppu == NULL)
+        {
+        fprintf(stderr, "(pp     ) Failed to allocate ppu control blocks\n");
+        exit(1);
+        }
+
+    /*
+    **  Optionally read in persistent PPM contents. Mapped PPM already has
+    **  its persistent contents.
+    */
+    if ((*persistDir != '\0') && !persistMapped)
+        {
+        char fileName[256];
+
+        /*
+        **  Try to open existing CM file.
+        */
+        strcpy(fileName, persistDir);
+        strcat(fileName, "/ppStore");
+        ppHandle = fopen(fileName, "r+b");
+        if (ppHandle != NULL)
+            {
+            /*
+            **  Read PPM contents.
+            */
+            if (fread(ppu, sizeof(PpSlot), count, ppHandle) != count)
+                {
+                printf("(pp     ) Unexpected length of PPM backing file, clearing PPM\n");
+                memset(ppu, 0, count * sizeof(PpSlot));
+                }
+            }
+        else
+            {
+            /*
+            **  Create a new file.
+            */
+            ppHandle = fopen(fileName, "w+b");
+            if (ppHandle == NULL)
+                {
+                fprintf(stderr, "(pp     ) Failed to create PPM backing file\n");
+                exit(1);
+                }
+            }
+        }
+
+    ppParked = calloc(count, sizeof(PpParking));
+    if (ppParked == NULL)
+        {
+        fprintf(stderr, "(pp     ) Failed to allocate PP parking slots\n");
+        exit(1);
+        }
+
+    ppLoops = calloc(count, sizeof(PpLoop));
+    if (ppLoops == NULL)
+        {
+        fprintf(stderr, "(pp     ) Failed to allocate PP loop detectors\n");
+        exit(1);
+        }
+
+    /*
+    **  Initialise all ppus.
+    */
+    for (pp = 0; pp < ppuCount; pp++)
+        {
+        ppu[pp].id            = pp;
+        ppu[pp].exchangingCpu = -1;
+        ppLoops[pp].isEnabled = (ppFastForward & (1 << pp)) != 0;
+        }
+
+    pp = 0;
+
+    /*
+    **  Optionally spread the barrel over several host threads.
+    */
+    if (ppBarrelThreads > 1)
+        {
+        ppCreateWorkers();
+        }
+
+    /*
+    **  Print a friendly message.
+    */
+    printf("(pp     ) PPs initialised (number of PPUs %o)\n", ppuCount);
+
+#if PPDEBUG
+    if (ppLog == NULL)
+        {
+        ppLog = fopen("pplog.txt", "wt");
+        }
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Check whether a PP is parked in a channel wait.
+**
+**  Parameters:     Name        Description.
+**                  pp          PP number
+**
+**  Returns:        TRUE if parked.
+**
+**------------------------------------------------------------------------*/
+bool ppIsParked(u8 pp)
+    {
+    return (ppParked[pp].channel != NULL);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Release a PP from a channel wait or a fast-forwarded
+**                  polling loop. Used when the PP is restarted from
+**                  outside, e.g. by a deadstart through the maintenance
+**                  channel.
+**
+**  Parameters:     Name        Description.
+**                  pp          PP number
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void ppUnpark(u8 pp)
+    {
+    ppParked[pp].channel = NULL;
+    ppLoops[pp].state    = PpLoopNone;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Terminate PP subsystem.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void ppTerminate(void)
+    {
+    /*
+    **  Optionally save PPM.
+    */
+    if (ppHandle != NULL)
+        {
+        fseek(ppHandle, 0, SEEK_SET);
+        if (fwrite(ppu, sizeof(PpSlot), ppuCount, ppHandle) != ppuCount)
+            {
+            fprintf(stderr, "(pp     ) Error writing PPM backing file\n");
+            }
+
+        fclose(ppHandle);
+        }
+
+    /*
+    **  Stop worker threads before their PPs go away.
+    */
+    if (ppBarrelThreads > 1)
+        {
+        ppTerminateWorkers();
+        }
+
+    /*
+    **  Mapped PPM is written back and stays mapped, everything else is
+    **  freed.
+    */
+    if (persistMapped)
+        {
+        persistSync(ppu, TRUE);
+        }
+    else
+        {
+        free(ppu);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Execute one instruction in each active PPU.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void ppStep(void)
+    {
+    u8 i;
+
+    if (ppBarrelThreads > 1)
+        {
+        ppRunEpoch();
+
+        return;
+        }
+
+    /*
+    **  Exercise each PP in the barrel.
+    */
+    for (i = 0; i < ppuCount; i++)
+        {
+        ppExecute(ppu + i);
+        }
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        18 bit ones-complement addition with subtractive adder
+**
+**  Parameters:     Name        Description.
+**                  op1         18 bit operand1
+**                  op2         18 bit operand2
+**
+**  Returns:        18 bit result.
+**
+**------------------------------------------------------------------------*/
+static u32 ppAdd18(u32 op1, u32 op2)
+    {
+    acc18 = (op1 & Mask18) - (~op2 & Mask18);
+    if ((acc18 & Overflow18) != 0)
+        {
+        acc18 -= 1;
+        }
+
+    return (acc18 & Mask18);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        18 bit ones-complement subtraction
+**
+**  Parameters:     Name        Description.
+**                  op1         18 bit operand1
+**                  op2         18 bit operand2
+**
+**  Returns:        18 bit result.
+**
+**------------------------------------------------------------------------*/
+static u32 ppSubtract18(u32 op1, u32 op2)
+    {
+    acc18 = (op1 & Mask18) - (op2 & Mask18);
+    if ((acc18 & Overflow18) != 0)
+        {
+        acc18 -= 1;
+        }
+
+    return (acc18 & Mask18);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Atomically add to a value shared with PP worker threads.
+**
+**  Parameters:     Name        Description.
+**                  ap          pointer to atomic integer
+**                  value       value to add
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void ppAtomicAdd(AtomicInt *ap, int value)
+    {
+#if defined(_WIN32)
+    InterlockedExchangeAdd(ap, value);
+#else
+    atomic_fetch_add_explicit(ap, value, memory_order_acq_rel);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Atomically load a value shared with PP worker threads.
+**
+**  Parameters:     Name        Description.
+**                  ap          pointer to atomic integer
+**
+**  Returns:        Current value.
+**
+**------------------------------------------------------------------------*/
+static int ppAtomicLoad(AtomicInt *ap)
+    {
+#if defined(_WIN32)
+    return InterlockedCompareExchange(ap, 0, 0);
+#else
+    return atomic_load_explicit(ap, memory_order_acquire);
+#endif
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Partition the PP barrel and create the worker threads.
+**                  Partition 0 is executed by the main thread.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void ppCreateWorkers(void)
+    {
+    u8 w;
+
+    ppWorkers = (PpWorker *)calloc(ppBarrelThreads, sizeof(PpWorker));
+    if (ppWorkers == NULL)
+        {
+        fprintf(stderr, "(pp     ) Failed to allocate PP worker control blocks\n");
+        exit(1);
+        }
+
+    ppWorkersStop = FALSE;
+
+#if defined(_WIN32)
+    InitializeCriticalSection(&ppChannelLock);
+    InitializeCriticalSection(&ppEpochLock);
+    InitializeConditionVariable(&ppEpochStart);
+    InitializeConditionVariable(&ppEpochDone);
+#endif
+
+    for (w = 0; w < ppBarrelThreads; w++)
+        {
+        ppWorkers[w].first = (u8)((w * ppuCount) / ppBarrelThreads);
+        ppWorkers[w].limit = (u8)(((w + 1) * ppuCount) / ppBarrelThreads);
+        ppWorkers[w].epoch = ppAtomicLoad(&ppEpoch);
+        if (w == 0)
+            {
+            continue;
+            }
+
+#if defined(_WIN32)
+        ppWorkers[w].thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)ppThread, ppWorkers + w, 0, NULL);
+        if (ppWorkers[w].thread == NULL)
+#else
+        if (pthread_create(&ppWorkers[w].thread, NULL, ppThread, ppWorkers + w) != 0)
+#endif
+            {
+            fprintf(stderr, "(pp     ) Failed to create PP worker thread %d\n", w);
+            exit(1);
+            }
+        }
+
+    printf("(pp     ) PP barrel split over %d threads, %u passes per epoch\n", ppBarrelThreads, ppBarrelPasses);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Execute a channel instruction. When the barrel runs on
+**                  several threads, channel instructions are serialised
+**                  so that channel and device state is only ever changed
+**                  by one thread at a time.
+**
+**                  A change of the channel's active or full state or of its
+**                  device is posted as a channel event. If the PP is left
+**                  waiting for a channel condition which only another PP
+**                  or the channel layer can bring about, it is parked until
+**                  the next event on the channel.
+**
+**  Parameters:     Name        Description.
+**                  op          opcode (064 to 077)
+**                  d           d field of the instruction
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void ppExecuteChannel(PpByte op, PpByte d)
+    {
+    ChSlot  *cc = channel + (d & 037);
+    bool    wasActive;
+    bool    wasFull;
+    DevSlot *device;
+
+    if (ppBarrelThreads > 1)
+        {
+#if defined(_WIN32)
+        EnterCriticalSection(&ppChannelLock);
+#else
+        pthread_mutex_lock(&ppChannelLock);
+#endif
+        }
+
+    wasActive = cc->active;
+    wasFull   = cc->full;
+    device    = cc->ioDevice;
+
+    decodePpuOpcode[op]();
+
+    if ((cc->active != wasActive) || (cc->full != wasFull) || (cc->ioDevice != device))
+        {
+        cc->events += 1;
+        }
+
+    if (activePpu->busy && ppIsChannelWait(cc))
+        {
+        ppParked[activePpu->id].channel = cc;
+        ppParked[activePpu->id].events  = cc->events;
+        }
+
+    if (ppBarrelThreads > 1)
+        {
+#if defined(_WIN32)
+        LeaveCriticalSection(&ppChannelLock);
+#else
+        pthread_mutex_unlock(&ppChannelLock);
+#endif
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Determine whether the active PP, busy in a channel
+**                  instruction, waits for a channel condition without
+**                  polling a device. Such a wait only ends through a
+**                  channel event, so the PP need not be stepped until then.
+**
+**  Parameters:     Name        Description.
+**                  cc          pointer to channel
+**
+**  Returns:        TRUE if the PP may be parked.
+**
+**------------------------------------------------------------------------*/
+static bool ppIsChannelWait(ChSlot *cc)
+    {
+    /*
+    **  The clock channel always has data, and PCI channels report their
+    **  state only when polled.
+    */
+    if ((cc->id == ChClock)
+        || ((cc->ioDevice != NULL) && (cc->ioDevice->devType == DtPciChannel)))
+        {
+        return (FALSE);
+        }
+
+    switch (activePpu->opF)
+        {
+    case 070:   // IAN
+    case 072:   // OAN
+        /*
+        **  Hung on an inactive channel, or waiting for another PP to fill
+        **  or empty a channel without device.
+        */
+        return (!cc->active || (cc->ioDevice == NULL));
+
+    case 071:   // IAM
+    case 073:   // OAM
+        return (cc->ioDevice == NULL);
+
+    case 074:   // ACN
+    case 075:   // DCN
+    case 076:   // FAN
+    case 077:   // FNC
+        /*
+        **  Hung until the channel changes its active state.
+        */
+        return (TRUE);
+
+    default:
+        return (FALSE);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Follow the active PP through short loops after it has
+**                  executed an instruction.
+**
+**                  A taken backward jump of at most PpLoopMaxSpan words
+**                  starts following the loop. If the loop is the delay
+**                  loop "SBN d, NJN *-1", it is run to completion at once.
+**                  Otherwise, if the next iteration executes only side-
+**                  effect free instructions and returns to the loop head
+**                  with A and PP memory unchanged, the PP is parked until
+**                  one of the CM words read by the iteration changes.
+**
+**  Parameters:     Name        Description.
+**                  lp          pointer to loop detector of active PP
+**                  opAddress   address of instruction just executed
+**                  op          opcode of instruction just executed
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void ppLoopCheck(PpLoop *lp, PpWord opAddress, PpByte op)
+    {
+    PpWord head = activePpu->regP;
+    PpWord sbn;
+    u32    count;
+
+    if ((op < 003) || (op > 007) || (head > opAddress) || (opAddress - head > PpLoopMaxSpan))
+        {
+        /*
+        **  Not a backward jump: the iteration being followed must stay
+        **  inside the loop and free of side effects.
+        */
+        if ((lp->state == PpLoopVerify)
+            && (!ppLoopIsPureOp(op) || (opAddress < lp->head) || (opAddress > lp->end)))
+            {
+            lp->state = PpLoopNone;
+            }
+
+        return;
+        }
+
+    if ((lp->state == PpLoopVerify) && (lp->head == head) && (lp->end == opAddress))
+        {
+        /*
+        **  One iteration completed - park if it was a fixed point.
+        */
+        if (lp->isFixed && (lp->regA == activePpu->regA))
+            {
+            lp->state = PpLoopParked;
+
+            return;
+            }
+        }
+    else
+        {
+        /*
+        **  New loop. A delay loop counting A down to zero is completed
+        **  in one step: A ends up +0 and P after the jump.
+        */
+        sbn = activePpu->mem[head] & Mask12;
+        if ((opAddress == head + 1) && ((sbn >> 6) == 017) && ((sbn & 077) != 0)
+            && ((activePpu->mem[opAddress] & Mask12) == 00576))
+            {
+            count = activePpu->regA;
+            if ((count != 0) && (count < 0400000) && ((count % (sbn & 077)) == 0))
+                {
+                activePpu->regA = 0;
+                activePpu->regP = (opAddress + 1) & Mask12;
+                lp->state       = PpLoopNone;
+
+                return;
+                }
+            }
+
+        lp->head = head;
+        lp->end  = opAddress;
+        }
+
+    /*
+    **  Follow the next iteration.
+    */
+    lp->state   = PpLoopVerify;
+    lp->isFixed = TRUE;
+    lp->regA    = activePpu->regA;
+    lp->reads   = 0;
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Determine whether a PP instruction only changes A and P
+**                  (CRD is checked separately for its PP memory stores).
+**
+**  Parameters:     Name        Description.
+**                  op          opcode
+**
+**  Returns:        TRUE if instruction may be part of a polling loop.
+**
+**------------------------------------------------------------------------*/
+static bool ppLoopIsPureOp(PpByte op)
+    {
+    switch (op)
+        {
+    case 000:                       // PSN
+    case 003: case 004: case 005:   // UJN, ZJN, NJN
+    case 006: case 007:             // PJN, MJN
+    case 010: case 011: case 012:   // SHN, LMN, LPN
+    case 013: case 014: case 015:   // SCN, LDN, LCN
+    case 016: case 017:             // ADN, SBN
+    case 020: case 021: case 022:   // LDC, ADC, LPC
+    case 023:                       // LMC
+    case 030: case 031: case 032:   // LDD, ADD, SBD
+    case 033:                       // LMD
+    case 040: case 041: case 042:   // LDI, ADI, SBI
+    case 043:                       // LMI
+    case 050: case 051: case 052:   // LDM, ADM, SBM
+    case 053:                       // LMM
+    case 060:                       // CRD
+        return (TRUE);
+
+    default:
+        return (FALSE);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Check whether the CM words read by a parked loop
+**                  still have the contents they had when it was parked.
+**
+**  Parameters:     Name        Description.
+**                  lp          pointer to loop detector
+**
+**  Returns:        TRUE if all watched words are unchanged.
+**
+**------------------------------------------------------------------------*/
+static bool ppLoopIsUnchanged(PpLoop *lp)
+    {
+    CpWord data;
+    u8     i;
+
+    for (i = 0; i < lp->reads; i++)
+        {
+        cpuPpReadMem(lp->address[i], &data);
+        if (data != lp->data[i])
+            {
+            return (FALSE);
+            }
+        }
+
+    return (TRUE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Record a CRD executed in the loop iteration being
+**                  followed. The iteration stays a fixed point only if
+**                  the CRD stores what PP memory already holds.
+**
+**  Parameters:     Name        Description.
+**                  lp          pointer to loop detector
+**                  address     absolute CM address read
+**                  data        CM word read
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void ppLoopRecordRead(PpLoop *lp, u32 address, CpWord data)
+    {
+    int i;
+
+    if (lp->reads >= PpLoopMaxReads)
+        {
+        lp->isFixed = FALSE;
+
+        return;
+        }
+
+    lp->address[lp->reads] = address;
+    lp->data[lp->reads]    = data;
+    lp->reads             += 1;
+
+    for (i = 0; i < 5; i++)
+        {
+        if ((activePpu->mem[(opD + i) & Mask12] & Mask12) != ((data >> (48 - 12 * i)) & Mask12))
+            {
+            lp->isFixed = FALSE;
+            }
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Execute one instruction in a PPU.
 **
 **  Parameters:     Name        Description.
+**                  slot        pointer to PP control block
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void ppInit(u8 count)
+static void ppExecute(PpSlot *slot)
     {
+    PpParking *pk;
+    PpLoop    *lp;
+    PpWord    opCode;
+    PpWord    opAddress = 0;
+    PpByte    op;
+    PpByte    d;
+    bool      isNew;
+
     /*
-    **  Allocate ppu structures.
+    **  Advance to next PPU.
     */
-    ppuCount = count;
-    ppu      = calloc(count, sizeof(PpSlot));
-    if (ppu == NULL)
+    activePpu = slot;
+
+    /*
+    **  A parked PP stays parked until an event on its channel.
+    */
+    pk = ppParked + activePpu->id;
+    if (pk->channel != NULL)
         {
-        fprintf(stderr, "(pp     ) Failed to allocate ppu control blocks\n");
-        exit(1);
+        if (pk->channel->events == pk->events)
+            {
+            return;
+            }
+
+        pk->channel = NULL;
         }
 
     /*
-    **  Optionally read in persistent CM and ECS contents.
+    **  A PP in a fast-forwarded polling loop is not stepped until one of
+    **  the CM words the loop reads changes.
     */
-    if (*persistDir != '\0')
+    lp = ppLoops + activePpu->id;
+    if (lp->state == PpLoopParked)
         {
-        char fileName[256];
-
-        /*
-        **  Try to open existing CM file.
-        */
-        strcpy(fileName, persistDir);
-        strcat(fileName, "/ppStore");
-        ppHandle = fopen(fileName, "r+b");
-        if (ppHandle != NULL)
+        if (ppLoopIsUnchanged(lp))
             {
-            /*
-            **  Read PPM contents.
-            */
-            if (fread(ppu, sizeof(PpSlot), count, ppHandle) != count)
-                {
-                printf("(pp     ) Unexpected length of PPM backing file, clearing PPM\n");
-                memset(ppu, 0, count * sizeof(PpSlot));
-                }
+            return;
             }
-        else
+
+        lp->state = PpLoopNone;
+        }
+
+    if (activePpu->exchangingCpu >= 0)
+        {
+        if (cpuIsExchangePending(cpus + activePpu->exchangingCpu, activePpu->id))
             {
-            /*
-            **  Create a new file.
-            */
-            ppHandle = fopen(fileName, "w+b");
-            if (ppHandle == NULL)
-                {
-                fprintf(stderr, "(pp     ) Failed to create PPM backing file\n");
-                exit(1);
-                }
+            return;
             }
+        activePpu->exchangingCpu = -1;
         }
 
-    /*
-    **  Initialise all ppus.
-    */
-    for (pp = 0; pp < ppuCount; pp++)
+    isNew = !activePpu->busy;
+    if (isNew)
         {
-        ppu[pp].id            = pp;
-        ppu[pp].exchangingCpu = -1;
-        }
+        /*
+        **  Extract next PPU instruction.
+        */
+        opAddress = activePpu->regP;
+        opCode    = activePpu->mem[activePpu->regP];
+        opF       = (opCode >> 6) & 077;
+        opD       = opCode & 077;
+        op        = opF;
+        d         = opD;
 
-    pp = 0;
+#if CcDebug == 1
+        /*
+        **  Save opF and opD for post-instruction trace.
+        */
+        activePpu->opF = opF;
+        activePpu->opD = opD;
+
+        /*
+        **  Trace instructions.
+        */
+        tracePpStart();
+#else
+        traceSequenceNo += 1;
+#endif
+
+        /*
+        **  Increment register P.
+        */
+        PpIncrement(activePpu->regP);
+        }
+    else
+        {
+        /*
+        **  Resume PPU instruction.
+        */
+        op = activePpu->opF & 077;
+        d  = activePpu->opD;
+        }
 
     /*
-    **  Print a friendly message.
+    **  Execute PPU instruction.
     */
-    printf("(pp     ) PPs initialised (number of PPUs %o)\n", ppuCount);
+    if (op < 064)
+        {
+        decodePpuOpcode[op]();
+        }
+    else
+        {
+        ppExecuteChannel(op, d);
+        }
 
-#if PPDEBUG
-    if (ppLog == NULL)
+    if (lp->isEnabled && isNew)
         {
-        ppLog = fopen("pplog.txt", "wt");
+        ppLoopCheck(lp, opAddress, op);
+        }
+
+#if CcDebug == 1
+    if (!activePpu->busy)
+        {
+        /*
+        **  Trace result and new channel status.
+        */
+        tracePpEnd();
         }
 #endif
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Terminate PP subsystem.
+**  Purpose:        Run one epoch of the multi-threaded PP barrel. The
+**                  worker threads are released, the main thread executes
+**                  partition 0, and then sleeps until the last worker
+**                  signals that it is done, so that the channel layer runs
+**                  in lockstep with them.
 **
 **  Parameters:     Name        Description.
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void ppTerminate(void)
-    {
-    /*
-    **  Optionally save PPM.
-    */
-    if (ppHandle != NULL)
-        {
-        fseek(ppHandle, 0, SEEK_SET);
-        if (fwrite(ppu, sizeof(PpSlot), ppuCount, ppHandle) != ppuCount)
-            {
-            fprintf(stderr, "(pp     ) Error writing PPM backing file\n");
-            }
+static void ppRunEpoch(void)
+    {
+#if defined(_WIN32)
+    EnterCriticalSection(&ppEpochLock);
+    ppAtomicAdd(&ppWorkersBusy, ppBarrelThreads - 1);
+    ppAtomicAdd(&ppEpoch, 1);
+    WakeAllConditionVariable(&ppEpochStart);
+    LeaveCriticalSection(&ppEpochLock);
+#else
+    pthread_mutex_lock(&ppEpochLock);
+    ppAtomicAdd(&ppWorkersBusy, ppBarrelThreads - 1);
+    ppAtomicAdd(&ppEpoch, 1);
+    pthread_cond_broadcast(&ppEpochStart);
+    pthread_mutex_unlock(&ppEpochLock);
+#endif
 
-        fclose(ppHandle);
-        }
+    ppRunPartition(ppWorkers);
 
-    /*
-    **  Free allocated memory.
-    */
-    free(ppu);
+#if defined(_WIN32)
+    EnterCriticalSection(&ppEpochLock);
+    while (ppAtomicLoad(&ppWorkersBusy) != 0)
+        {
+        SleepConditionVariableCS(&ppEpochDone, &ppEpochLock, INFINITE);
+        }
+    LeaveCriticalSection(&ppEpochLock);
+#else
+    pthread_mutex_lock(&ppEpochLock);
+    while (ppAtomicLoad(&ppWorkersBusy) != 0)
+        {
+        pthread_cond_wait(&ppEpochDone, &ppEpochLock);
+        }
+    pthread_mutex_unlock(&ppEpochLock);
+#endif
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Execute one instruction in an active PPU.
+**  Purpose:        Run the PPs of one partition for an epoch. The epoch
+**                  ends early when a whole pass makes no progress, i.e.
+**                  every PP is hung on a channel, spinning on a jump to
+**                  itself or waiting for an exchange, since nothing can
+**                  change until the channel layer has run.
 **
 **  Parameters:     Name        Description.
+**                  wp          pointer to worker control block
 **
-**  Returns:        Nothing.
+**  Returns:        TRUE if any PP of the partition made progress.
 **
 **------------------------------------------------------------------------*/
-void ppStep(void)
-    {
+static bool ppRunPartition(PpWorker *wp)
+    {
+    PpSlot *slot;
+    u32    pass;
+    bool   progress;
+    bool   anyProgress = FALSE;
+    PpWord regP;
+    u32    regA;
+    bool   busy;
     u8     i;
-    PpWord opCode;
 
-    /*
-    **  Exercise each PP in the barrel.
-    */
-    for (i = 0; i < ppuCount; i++)
+    for (pass = 0; pass < ppBarrelPasses; pass++)
         {
-        /*
-        **  Advance to next PPU.
-        */
-        activePpu = ppu + i;
-        
-        if (activePpu->exchangingCpu >= 0)
+        progress = FALSE;
+        for (i = wp->first; i < wp->limit; i++)
             {
-            cpuAcquireExchangeMutex();
-            if (cpus[activePpu->exchangingCpu].ppRequestingExchange == activePpu->id)
-                {
-                cpuReleaseExchangeMutex();
-                continue;
-                }
-            else
+            slot = ppu + i;
+            regP = slot->regP;
+            regA = slot->regA;
+            busy = slot->busy;
+            ppExecute(slot);
+            if ((slot->regP != regP) || (slot->regA != regA) || (slot->busy != busy))
                 {
-                activePpu->exchangingCpu = -1;
-                cpuReleaseExchangeMutex();
+                progress = TRUE;
                 }
             }
 
-        if (!activePpu->busy)
-            {
-            /*
-            **  Extract next PPU instruction.
-            */
-            opCode = activePpu->mem[activePpu->regP];
-            opF    = (opCode >> 6) & 077;
-            opD    = opCode & 077;
-
-#if CcDebug == 1
-            /*
-            **  Save opF and opD for post-instruction trace.
-            */
-            activePpu->opF = opF;
-            activePpu->opD = opD;
-
-            /*
-            **  Trace instructions.
-            */
-            traceSequence();
-            traceRegisters();
-            traceOpcode();
-#else
-            traceSequenceNo += 1;
-#endif
-
-            /*
-            **  Increment register P.
-            */
-            PpIncrement(activePpu->regP);
-
-            /*
-            **  Execute PPU instruction.
-            */
-            decodePpuOpcode[opF]();
-            }
-        else
+        if (!progress)
             {
-            /*
-            **  Resume PPU instruction.
-            */
-            decodePpuOpcode[activePpu->opF]();
+            break;
             }
 
-#if CcDebug == 1
-        if (!activePpu->busy)
-            {
-            /*
-            **  Trace result.
-            */
-            traceRegisters();
-
-            /*
-            **  Trace new channel status.
-            */
-            if (activePpu->opF >= 064)
-                {
-                traceChannel((u8)(activePpu->opD & 037));
-                }
-
-            traceEnd();
-            }
-#endif
+        anyProgress = TRUE;
         }
-    }
 
-/*
- **--------------------------------------------------------------------------
- **
- **  Private Functions
- **
- **--------------------------------------------------------------------------
- */
+    return (anyProgress);
+    }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        18 bit ones-complement addition with subtractive adder
+**  Purpose:        Stop the PP worker threads.
 **
 **  Parameters:     Name        Description.
-**                  op1         18 bit operand1
-**                  op2         18 bit operand2
 **
-**  Returns:        18 bit result.
+**  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-static u32 ppAdd18(u32 op1, u32 op2)
+static void ppTerminateWorkers(void)
     {
-    acc18 = (op1 & Mask18) - (~op2 & Mask18);
-    if ((acc18 & Overflow18) != 0)
+    u8 w;
+
+#if defined(_WIN32)
+    EnterCriticalSection(&ppEpochLock);
+    ppWorkersStop = TRUE;
+    WakeAllConditionVariable(&ppEpochStart);
+    LeaveCriticalSection(&ppEpochLock);
+#else
+    pthread_mutex_lock(&ppEpochLock);
+    ppWorkersStop = TRUE;
+    pthread_cond_broadcast(&ppEpochStart);
+    pthread_mutex_unlock(&ppEpochLock);
+#endif
+
+    for (w = 1; w < ppBarrelThreads; w++)
         {
-        acc18 -= 1;
+#if defined(_WIN32)
+        WaitForSingleObject(ppWorkers[w].thread, INFINITE);
+        CloseHandle(ppWorkers[w].thread);
+#else
+        pthread_join(ppWorkers[w].thread, NULL);
+#endif
         }
 
-    return (acc18 & Mask18);
+    free(ppWorkers);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        18 bit ones-complement subtraction
+**  Purpose:        PP worker thread. Executes its partition once per
+**                  epoch. While its PPs make progress it polls briefly for
+**                  the next epoch before it sleeps; once a whole epoch made
+**                  no progress (all PPs hung, parked or spinning in place)
+**                  it sleeps right away, so an idle partition does not keep
+**                  a host CPU busy.
 **
 **  Parameters:     Name        Description.
-**                  op1         18 bit operand1
-**                  op2         18 bit operand2
+**                  param       pointer to worker control block
 **
-**  Returns:        18 bit result.
+**  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-static u32 ppSubtract18(u32 op1, u32 op2)
+#if defined(_WIN32)
+static void ppThread(void *param)
+#else
+static void *ppThread(void *param)
+#endif
     {
-    acc18 = (op1 & Mask18) - (op2 & Mask18);
-    if ((acc18 & Overflow18) != 0)
+    PpWorker *wp = (PpWorker *)param;
+    bool     progress = FALSE;
+    int      spin;
+
+    activeChannel = channel;
+
+    while (!ppWorkersStop)
         {
-        acc18 -= 1;
+        for (spin = 0; progress && spin < PpWorkerSpinLimit && ppAtomicLoad(&ppEpoch) == wp->epoch; spin++)
+            {
+#if defined(_WIN32)
+            SwitchToThread();
+#else
+            sched_yield();
+#endif
+            }
+
+#if defined(_WIN32)
+        EnterCriticalSection(&ppEpochLock);
+        while (!ppWorkersStop && ppAtomicLoad(&ppEpoch) == wp->epoch)
+            {
+            SleepConditionVariableCS(&ppEpochStart, &ppEpochLock, INFINITE);
+            }
+        LeaveCriticalSection(&ppEpochLock);
+#else
+        pthread_mutex_lock(&ppEpochLock);
+        while (!ppWorkersStop && ppAtomicLoad(&ppEpoch) == wp->epoch)
+            {
+            pthread_cond_wait(&ppEpochStart, &ppEpochLock);
+            }
+        pthread_mutex_unlock(&ppEpochLock);
+#endif
+
+        if (ppWorkersStop)
+            {
+            break;
+            }
+
+        wp->epoch += 1;
+        progress   = ppRunPartition(wp);
+
+#if defined(_WIN32)
+        EnterCriticalSection(&ppEpochLock);
+        ppAtomicAdd(&ppWorkersBusy, -1);
+        if (ppAtomicLoad(&ppWorkersBusy) == 0)
+            {
+            WakeConditionVariable(&ppEpochDone);
+            }
+        LeaveCriticalSection(&ppEpochLock);
+#else
+        pthread_mutex_lock(&ppEpochLock);
+        ppAtomicAdd(&ppWorkersBusy, -1);
+        if (ppAtomicLoad(&ppWorkersBusy) == 0)
+            {
+            pthread_cond_signal(&ppEpochDone);
+            }
+        pthread_mutex_unlock(&ppEpochLock);
+#endif
         }
 
-    return (acc18 & Mask18);
+#if !defined(_WIN32)
+    return (NULL);
+#endif
     }
 
 /*--------------------------------------------------------------------------
@@ -745,8 +1611,11 @@ static void ppOpEXN(void)     // 26
     cpuNum = (cpuCount > 1) ? (opD & 001) : 0;
     cpu = cpus + cpuNum;
 
-    cpuAcquireExchangeMutex();
-    isExchangePending = cpu->ppRequestingExchange != -1;
+    /*
+    **  Claim the CPU's exchange request slot. While it is claimed the CPU
+    **  can't exchange, so its monitor mode and MA are stable.
+    */
+    isExchangePending = !cpuClaimExchange(cpu);
 
     if (((opD & 070) == 0) || ((features & HasNoCejMej) != 0))
         {
@@ -755,8 +1624,7 @@ static void ppOpEXN(void)     // 26
         */
         if (isExchangePending)
             {
-            // Release mutex and arrange to retry instruction
-            cpuReleaseExchangeMutex();
+            // Arrange to retry instruction
             PpDecrement(activePpu->regP);
             return;
             }
@@ -776,12 +1644,19 @@ static void ppOpEXN(void)     // 26
         }
     else
         {
-        if (cpu->isMonitorMode || isExchangePending)
+        if (isExchangePending)
             {
             /*
             **  Pass.
             */
-            cpuReleaseExchangeMutex();
+            return;
+            }
+        if (cpu->isMonitorMode)
+            {
+            /*
+            **  Pass.
+            */
+            cpuReleaseExchange(cpu);
             return;
             }
 
@@ -817,7 +1692,7 @@ static void ppOpEXN(void)     // 26
             /*
             **  Pass.
             */
-            cpuReleaseExchangeMutex();
+            cpuReleaseExchange(cpu);
             return;
             }
         }
@@ -825,12 +1700,8 @@ static void ppOpEXN(void)     // 26
     /*
     **  Request the exchange, and wait for it to complete.
     */
-    cpu->ppRequestingExchange = activePpu->id;
-    cpu->ppExchangeAddress = exchangeAddress;
-    cpu->doChangeMode = doChangeMode;
+    cpuPostExchange(cpu, activePpu->id, exchangeAddress, doChangeMode);
     activePpu->exchangingCpu = cpu->id;
-
-    cpuReleaseExchangeMutex();
     }
 
 static void ppOpRPN(void)     // 27
@@ -997,15 +1868,23 @@ static void ppOpSOM(void)     // 57
 
 static void ppOpCRD(void)     // 60
     {
+    u32    address;
     CpWord data;
 
     if (((activePpu->regA & Sign18) != 0) && ((features & HasRelocationReg) != 0))
         {
-        cpuPpReadMem(activePpu->regR + (activePpu->regA & Mask17), &data);
+        address = activePpu->regR + (activePpu->regA & Mask17);
         }
     else
         {
-        cpuPpReadMem(activePpu->regA & Mask18, &data);
+        address = activePpu->regA & Mask18;
+        }
+
+    cpuPpReadMem(address, &data);
+
+    if (ppLoops[activePpu->id].state == PpLoopVerify)
+        {
+        ppLoopRecordRead(ppLoops + activePpu->id, address, data);
         }
 
     activePpu->mem[opD++ & Mask12] = (PpWord)((data >> 48) & Mask12);
@@ -76,6 +76,8 @@ void channelIn(void);
 void channelSetFull(void);
 void channelSetEmpty(void);
 void channelStep(void);
+void channelDelayStatus(u8 cycles);
+void channelDelayDisconnect(u8 cycles);
 void channelDisplayContext();
 
 /*
@@ -96,14 +98,16 @@ void consoleShowStatus(void);
 /*
 **  cpu.c
 */
-void cpuAcquireExchangeMutex(void);
+bool cpuClaimExchange(CpuContext *cpu);
 bool cpuDdpTransfer(u32 ecsAddress, CpWord *data, bool writeToEcs);
 bool cpuEcsFlagRegister(u32 ecsAddress);
 u32  cpuGetP(u8 cpuNum);
 void cpuInit(char *model, u32 memory, u32 emBanks, ExtMemory emType);
+bool cpuIsExchangePending(CpuContext *cpu, u8 ppId);
+void cpuPostExchange(CpuContext *cpu, u8 ppId, u32 address, bool doChangeMode);
 void cpuPpReadMem(u32 address, CpWord *data);
 void cpuPpWriteMem(u32 address, CpWord data);
-void cpuReleaseExchangeMutex(void);
+void cpuReleaseExchange(CpuContext *cpu);
 void cpuStep(CpuContext *activeCpu);
 void cpuTerminate(void);
 
@@ -143,6 +147,7 @@ void csFeiShowStatus();
 */
 void dd6603Init(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName);
 void dd6603ShowDiskStatus();
+void dd6603Terminate(DevSlot *dp);
 
 /*
 **  dd8xx.c
@@ -153,6 +158,7 @@ void dd885Init_1(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName);
 void dd8xxLoadDisk(char *params);
 void dd8xxUnloadDisk(char *params);
 void dd8xxShowDiskStatus();
+void dd8xxTerminate(DevSlot *dp);
 
 /*
 **  dd885_42.c
@@ -176,6 +182,19 @@ void ddpInit(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName);
 */
 void deadStart(void);
 
+/*
+**  disk_io.c
+*/
+void diskIoCancel(DiskIoRequest *rp);
+void diskIoDrain(void);
+int diskIoFinishRead(DiskIoRequest *rp, u8 *buf);
+void diskIoInit(void);
+bool diskIoIsDone(DiskIoRequest *rp);
+int diskIoRead(FILE *fcb, u8 *buf, int length, i32 offset);
+void diskIoShowStatus(void);
+DiskIoRequest *diskIoStartRead(FILE *fcb, int length, i32 offset);
+void diskIoWrite(FILE *fcb, u8 *buf, int length, i32 offset);
+
 /*
 **  dsa311.c
 */
@@ -376,18 +395,27 @@ void pciInit(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName);
 */
 void pciConsoleInit(u8 eqNo, u8 unitNo, u8 channelNo, char *deviceName);
 
+/*
+**  persist.c
+*/
+void *persistMap(char *name, size_t size, char *title);
+void persistSync(void *addr, bool wait);
+
 /*
 **  pp.c
 */
 void ppInit(u8 count);
+bool ppIsParked(u8 pp);
 void ppTerminate(void);
 void ppStep(void);
+void ppUnpark(u8 pp);
 
 /*
 **  rtc.c
 */
 void rtcInit(u8 increment, u32 setMHz);
 void rtcTick(void);
+void rtcSkip(u32 microseconds);
 void rtcStartTimer(void);
 double rtcStopTimer(void);
 void rtcReadUsCounter(void);
@@ -407,9 +435,18 @@ CpWord shiftUnpack(CpWord number, u32 *expo);
 CpWord shiftNormalize(CpWord number, u32 *shift, bool round);
 CpWord shiftMask(u8 count);
 
+/*
+**  tap_index.c
+*/
+void     tapIndexClose(TapIndex *ip);
+void     tapIndexInvalidate(TapIndex *ip);
+TapIndex *tapIndexOpen(char *fileName);
+bool     tapIndexSkipFile(TapIndex *ip, FILE *fcb, bool forward, u32 maxRecLen, u32 *blocks);
+
 /*
 **  time.c
 */
+u64 getMicroseconds(void);
 u64 getMilliseconds(void);
 time_t getSeconds(void);
 void sleepMsec(u32 msec);
@@ -426,21 +463,28 @@ void tpMuxShowStatus();
 */
 void traceInit(void);
 void traceTerminate(void);
-void traceSequence(void);
-void traceRegisters(void);
-void traceOpcode(void);
-u8 traceDisassembleOpcode(char *str, PpWord *pm);
-void traceChannelFunction(PpWord funcCode);
-void tracePrint(char *str);
-void traceCpuPrint(CpuContext *cpu, char *str);
-void traceChannel(u8 ch);
-void traceEnd(void);
+void traceTrigger(u32 condition);
+void traceStep(void);
 void traceCpu(CpuContext *cpu, u32 p, u8 opFm, u8 opI, u8 opJ, u8 opK, u32 opAddress);
+void traceCpuStop(CpuContext *cpu);
 void traceExchange(CpuContext *cpu, u32 addr, char *title);
+void tracePpStart(void);
+void tracePpEnd(void);
+void traceChannelFunction(PpWord funcCode);
+
+/*
+**  trace_format.c
+*/
+void traceFormatPp(FILE *fp, TracePpRecord *rp);
+void traceFormatCpu(FILE *fp, TraceCpuRecord *rp);
+void tracePackExchange(TraceExchangeRecord *parts, CpuContext *cpu, u32 seq, u32 addr, char *title);
+void traceFormatExchange(FILE *fp, TraceExchangeRecord *parts);
+u8 traceDisassembleOpcode(char *str, PpWord *pm);
 
 /*
 **  window_{win32,x11}.c
 */
+void windowFrameEnd(void);
 void windowInit(void);
 void windowSetFont(u8 font);
 void windowSetX(u16 x);
@@ -456,10 +500,10 @@ void windowTerminate(void);
 **  alpha-order unless there is a good reason not to.
 */
 
-extern DevSlot             *active3000Device;
-extern ChSlot              *activeChannel;
-extern DevSlot             *activeDevice;
-extern PpSlot              *activePpu;
+extern ThreadLocal DevSlot *active3000Device;
+extern ThreadLocal ChSlot  *activeChannel;
+extern ThreadLocal DevSlot *activeDevice;
+extern ThreadLocal PpSlot  *activePpu;
 extern const i8            altKeyToPlato[128];
 extern const u16           asciiTo026[256];
 extern const u16           asciiTo029[256];
@@ -478,6 +522,8 @@ extern const char          consoleToAscii[64];
 extern CpWord              *cpMem;
 extern CpuContext          *cpus;
 extern int                 cpuCount;
+extern volatile bool       cpuDecodeCacheEnabled;
+extern CpuEngine           cpuEngine;
 extern u32                 cpuMaxMemory;
 extern bool                cpuStopped;
 extern u32                 cycles;
@@ -485,6 +531,7 @@ extern u8                  deviceCount;
 extern DevDesc             deviceDesc[];
 extern char                displayName[];
 extern const u8            ebcdicToAscii[256];
+extern char                ecsSharedName[];
 extern bool                emulationActive;
 extern const char          extBcdToAscii[64];
 extern u32                 extMaxMemory;
@@ -492,6 +539,7 @@ extern CpWord              *extMem;
 extern ExtMemory           extMemType;
 extern ModelFeatures       features;
 extern ModelType           modelType;
+extern u32                 mt5744Pipeline;
 extern u16                 mux6676TelnetConns;
 extern u16                 mux6676TelnetPort;
 extern u8                  npuLipTrunkCount;
@@ -509,17 +557,25 @@ extern char                opKeyIn;
 extern long                opKeyInterval;
 extern volatile bool       opPaused;
 extern char                persistDir[];
+extern bool                persistMapped;
+extern u32                 persistSyncSecs;
 extern u16                 platoConns;
 extern u16                 platoPort;
 extern const unsigned char platoStringToAscii[4][65];
+extern u32                 ppBarrelPasses;
+extern u8                  ppBarrelThreads;
+extern u32                 ppFastForward;
 extern char                ppKeyIn;
 extern PpSlot              *ppu;
 extern u8                  ppuCount;
 extern u32                 readerScanSecs;
 extern u32                 rtcClock;
 extern bool                rtcClockIsCurrent;
+extern u32                 rtcIdleSkip;
 extern u32                 traceMask;
+extern u32                 traceRecords;
 extern u32                 traceSequenceNo;
+extern u32                 traceTriggers;
 
 /* Idle Loop throttle */
 extern bool idle;
@@ -539,6 +595,10 @@ bool idleDetectorMACE(CpuContext *ctx);  /* KRONOS1 or MACE, possibly SCOPE too)
 bool idleDetectorNOS(CpuContext *ctx);   /* KRONOS2.1 - NOS 2.8.7 */
 bool idleDetectorNOSBE(CpuContext *ctx); /* NOS/BE (only tested with TUB) */
 void idleThrottle(CpuContext *ctx);
+void idleInit(void);
+void idleWait(u32 usec);
+void idleWakeup(void);
+void idleWatchFd(int fd);
 
 #endif /* PROTO_H */
 /*---------------------------  End Of File  ------------------------------*/
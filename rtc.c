@@ -80,6 +80,7 @@ static u64 rtcGetTick(void);
 */
 u32  rtcClock          = 0;
 bool rtcClockIsCurrent = TRUE;
+u32  rtcIdleSkip       = 0;
 
 
 /*
@@ -169,6 +170,21 @@ void rtcTick(void)
         }
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Advance the clock over time in which the emulated
+**                  system is idle (virtual time mode).
+**
+**  Parameters:     Name        Description.
+**                  microseconds time to skip
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void rtcSkip(u32 microseconds)
+    {
+    rtcClock += microseconds;
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Start timing measurement.
 **
@@ -0,0 +1,710 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: tap_index.c
+**
+**  Description:
+**      Block index of TAP tape containers. The index holds the offset of
+**      every record and tape mark, so that searching for a tape mark
+**      becomes a single seek instead of a walk over all record headers
+**      in between. It is built the first time a tape mark search is
+**      done on a container and kept in a sidecar file ("<tape>.idx")
+**      which is reused as long as size and modification time of the
+**      container are unchanged.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+#define TapIndexMagic      0x58444954   /* "TIDX" in little endian */
+#define TapIndexVersion    1
+#define TapIndexChunk      4096
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+
+/*
+**  Index entries hold the offset of the record header shifted left by
+**  one, with the low bit set for tape marks.
+*/
+#define EntryOffset(e)      ((e) >> 1)
+#define EntryIsMark(e)      (((e) & 1) != 0)
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+
+/*
+**  Sidecar file header.
+*/
+typedef struct tapIndexHeader
+    {
+    u32 magic;                          /* TapIndexMagic */
+    u32 version;                        /* TapIndexVersion */
+    u64 fileSize;                       /* size of container when indexed */
+    u64 fileTime;                       /* modification time of container */
+    u64 dataEnd;                        /* offset following last record */
+    u32 count;                          /* number of records */
+    u32 spare;
+    } TapIndexHeader;
+
+/*
+**  Block index of a TAP container.
+*/
+struct tapIndex
+    {
+    char fileName[MaxFSPath];           /* TAP container */
+    bool isValid;                       /* index matches container */
+    bool isBroken;                      /* container could not be indexed */
+    bool isSidecarPresent;              /* sidecar file may exist */
+    u64  *entries;                      /* record offsets and tape mark flags */
+    u32  count;                         /* number of records */
+    u32  size;                          /* allocated entries */
+    u32  *marks;                        /* ordinals of tape mark records */
+    u32  markCount;                     /* number of tape marks */
+    u64  dataEnd;                       /* offset following last record */
+    };
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static bool tapIndexAdd(TapIndex *ip, u64 entry);
+static bool tapIndexBuild(TapIndex *ip, FILE *fcb, u32 maxRecLen);
+static bool tapIndexFileInfo(TapIndex *ip, u64 *fileSize, u64 *fileTime);
+static bool tapIndexFind(TapIndex *ip, u64 position, u32 *ordinal);
+static bool tapIndexLoad(TapIndex *ip, u64 fileSize, u64 fileTime);
+static bool tapIndexMarks(TapIndex *ip);
+static void tapIndexSave(TapIndex *ip, u64 fileSize, u64 fileTime);
+static void tapIndexSidecarName(TapIndex *ip, char *name);
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Create the (not yet built) index of a TAP container.
+**
+**  Parameters:     Name        Description.
+**                  fileName    path of TAP container
+**
+**  Returns:        Pointer to index.
+**
+**------------------------------------------------------------------------*/
+TapIndex *tapIndexOpen(char *fileName)
+    {
+    TapIndex *ip;
+
+    ip = calloc(1, sizeof(TapIndex));
+    if (ip == NULL)
+        {
+        fprintf(stderr, "(tap_index) Failed to allocate TAP index\n");
+        exit(1);
+        }
+
+    strcpy(ip->fileName, fileName);
+    ip->isSidecarPresent = TRUE;
+
+    return (ip);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Release the index of a TAP container.
+**
+**  Parameters:     Name        Description.
+**                  ip          index (may be NULL)
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void tapIndexClose(TapIndex *ip)
+    {
+    if (ip == NULL)
+        {
+        return;
+        }
+
+    free(ip->entries);
+    free(ip->marks);
+    free(ip);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Discard the index after the container was written.
+**
+**  Parameters:     Name        Description.
+**                  ip          index (may be NULL)
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void tapIndexInvalidate(TapIndex *ip)
+    {
+    char name[MaxFSPath + 8];
+
+    if (ip == NULL)
+        {
+        return;
+        }
+
+    ip->isValid   = FALSE;
+    ip->isBroken  = FALSE;
+    ip->count     = 0;
+    ip->markCount = 0;
+
+    if (ip->isSidecarPresent)
+        {
+        tapIndexSidecarName(ip, name);
+        remove(name);
+        ip->isSidecarPresent = FALSE;
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Position a TAP container for a tape mark search. The
+**                  container is moved to the record header of the next
+**                  tape mark (forward) or just past the previous one
+**                  (backward), so that a single forespace or backspace
+**                  of the driver completes the search. When there is no
+**                  tape mark, the container is moved to the end of the
+**                  data (forward) or just past the first record
+**                  (backward).
+**
+**  Parameters:     Name        Description.
+**                  ip          index (may be NULL)
+**                  fcb         TAP container positioned at a record
+**                  forward     TRUE to search forward, FALSE backward
+**                  maxRecLen   largest record length the driver accepts
+**                  blocks      returns number of records skipped
+**
+**  Returns:        TRUE if positioned, FALSE if the index can't be used
+**                  (the container position is unchanged).
+**
+**------------------------------------------------------------------------*/
+bool tapIndexSkipFile(TapIndex *ip, FILE *fcb, bool forward, u32 maxRecLen, u32 *blocks)
+    {
+    u32  first;
+    u32  last;
+    u32  mid;
+    u32  ordinal;
+    u32  target;
+    long position;
+
+    if ((ip == NULL) || ip->isBroken)
+        {
+        return (FALSE);
+        }
+
+    if (!ip->isValid && !tapIndexBuild(ip, fcb, maxRecLen))
+        {
+        return (FALSE);
+        }
+
+    position = ftell(fcb);
+    if ((position < 0) || !tapIndexFind(ip, (u64)position, &ordinal))
+        {
+        return (FALSE);
+        }
+
+    /*
+    **  Binary search for the first tape mark at or after the current
+    **  record.
+    */
+    first = 0;
+    last  = ip->markCount;
+    while (first < last)
+        {
+        mid = first + (last - first) / 2;
+        if (ip->marks[mid] < ordinal)
+            {
+            first = mid + 1;
+            }
+        else
+            {
+            last = mid;
+            }
+        }
+
+    if (forward)
+        {
+        target = first < ip->markCount ? ip->marks[first] : ip->count;
+        }
+    else
+        {
+        /*
+        **  Stop just past the previous tape mark, or past the first
+        **  record if there is none.
+        */
+        target = first > 0 ? ip->marks[first - 1] + 1 : 1;
+        if (target >= ordinal)
+            {
+            *blocks = 0;
+
+            return (TRUE);
+            }
+        }
+
+    if (fseek(fcb, (long)(target < ip->count ? EntryOffset(ip->entries[target]) : ip->dataEnd), SEEK_SET) != 0)
+        {
+        fseek(fcb, position, SEEK_SET);
+
+        return (FALSE);
+        }
+
+    *blocks = forward ? target - ordinal : ordinal - target;
+
+    return (TRUE);
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Append an entry to the index.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  entry       record offset and tape mark flag
+**
+**  Returns:        TRUE if successful, FALSE if out of memory.
+**
+**------------------------------------------------------------------------*/
+static bool tapIndexAdd(TapIndex *ip, u64 entry)
+    {
+    u64 *entries;
+
+    if (ip->count >= ip->size)
+        {
+        entries = realloc(ip->entries, (ip->size + TapIndexChunk) * sizeof(u64));
+        if (entries == NULL)
+            {
+            return (FALSE);
+            }
+
+        ip->entries = entries;
+        ip->size   += TapIndexChunk;
+        }
+
+    ip->entries[ip->count++] = entry;
+
+    return (TRUE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Load the index from its sidecar file or build it by
+**                  scanning all record headers of the container. The
+**                  container position is preserved.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  fcb         TAP container
+**                  maxRecLen   largest record length the driver accepts
+**
+**  Returns:        TRUE if index is valid, FALSE otherwise.
+**
+**------------------------------------------------------------------------*/
+static bool tapIndexBuild(TapIndex *ip, FILE *fcb, u32 maxRecLen)
+    {
+    u64  fileSize;
+    u64  fileTime;
+    u32  len;
+    u64  offset;
+    long position;
+    u32  recLen0;
+    u32  recLen1;
+    u32  recLen2;
+
+    ip->count     = 0;
+    ip->markCount = 0;
+
+    if (!tapIndexFileInfo(ip, &fileSize, &fileTime))
+        {
+        ip->isBroken = TRUE;
+
+        return (FALSE);
+        }
+
+    if (tapIndexLoad(ip, fileSize, fileTime))
+        {
+        ip->isValid = TRUE;
+
+        return (TRUE);
+        }
+
+    /*
+    **  Walk the record headers and trailers the same way the tape
+    **  drivers' forespace does. Anything the drivers would reject leaves
+    **  the container unindexed, so they report the error themselves.
+    */
+    position = ftell(fcb);
+    fseek(fcb, 0, SEEK_SET);
+    offset       = 0;
+    ip->isBroken = TRUE;
+
+    for (;;)
+        {
+        len = fread(&recLen0, sizeof(recLen0), 1, fcb);
+        if (len != 1)
+            {
+            ip->isBroken = FALSE;
+            break;
+            }
+
+        recLen1 = bigEndian ? initConvertEndian(recLen0) : recLen0;
+        if (recLen1 > maxRecLen)
+            {
+            break;
+            }
+
+        if (!tapIndexAdd(ip, (offset << 1) | (recLen1 == 0 ? 1 : 0)))
+            {
+            break;
+            }
+
+        if (recLen1 == 0)
+            {
+            offset += 4;
+            continue;
+            }
+
+        if ((fseek(fcb, recLen1, SEEK_CUR) != 0)
+            || (fread(&recLen2, sizeof(recLen2), 1, fcb) != 1))
+            {
+            break;
+            }
+
+        offset += 8 + recLen1;
+        if (recLen0 != recLen2)
+            {
+            /*
+            **  Padded TAP record.
+            */
+            if (bigEndian)
+                {
+                recLen2 = initConvertEndian(recLen2);
+                }
+
+            if (recLen1 != ((recLen2 >> 8) & 0xFFFFFF))
+                {
+                break;
+                }
+
+            fseek(fcb, 1, SEEK_CUR);
+            offset += 1;
+            }
+        }
+
+    fseek(fcb, position, SEEK_SET);
+    ip->dataEnd = offset;
+
+    if (ip->isBroken || !tapIndexMarks(ip))
+        {
+        ip->isBroken = TRUE;
+        ip->count    = 0;
+
+        return (FALSE);
+        }
+
+    ip->isValid          = TRUE;
+    ip->isSidecarPresent = TRUE;
+    tapIndexSave(ip, fileSize, fileTime);
+
+    return (TRUE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Determine size and modification time of the container.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  fileSize    returns size in bytes
+**                  fileTime    returns modification time
+**
+**  Returns:        TRUE if successful, FALSE otherwise.
+**
+**------------------------------------------------------------------------*/
+static bool tapIndexFileInfo(TapIndex *ip, u64 *fileSize, u64 *fileTime)
+    {
+    struct stat s;
+
+    if (stat(ip->fileName, &s) != 0)
+        {
+        return (FALSE);
+        }
+
+    *fileSize = (u64)s.st_size;
+    *fileTime = (u64)s.st_mtime;
+
+    return (TRUE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Find the record starting at a container position.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  position    container position
+**                  ordinal     returns record ordinal (count at end of data)
+**
+**  Returns:        TRUE if position is a record boundary, FALSE otherwise.
+**
+**------------------------------------------------------------------------*/
+static bool tapIndexFind(TapIndex *ip, u64 position, u32 *ordinal)
+    {
+    u32 first;
+    u32 last;
+    u32 mid;
+    u64 offset;
+
+    if (position == ip->dataEnd)
+        {
+        *ordinal = ip->count;
+
+        return (TRUE);
+        }
+
+    first = 0;
+    last  = ip->count;
+    while (first < last)
+        {
+        mid    = first + (last - first) / 2;
+        offset = EntryOffset(ip->entries[mid]);
+        if (offset == position)
+            {
+            *ordinal = mid;
+
+            return (TRUE);
+            }
+
+        if (offset < position)
+            {
+            first = mid + 1;
+            }
+        else
+            {
+            last = mid;
+            }
+        }
+
+    return (FALSE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Load the index from its sidecar file.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  fileSize    current size of container
+**                  fileTime    current modification time of container
+**
+**  Returns:        TRUE if sidecar matches container, FALSE otherwise.
+**
+**------------------------------------------------------------------------*/
+static bool tapIndexLoad(TapIndex *ip, u64 fileSize, u64 fileTime)
+    {
+    FILE           *fcb;
+    TapIndexHeader hdr;
+    char           name[MaxFSPath + 8];
+    bool           isOk;
+
+    tapIndexSidecarName(ip, name);
+    fcb = fopen(name, "rb");
+    if (fcb == NULL)
+        {
+        return (FALSE);
+        }
+
+    isOk = (fread(&hdr, sizeof(hdr), 1, fcb) == 1)
+           && (hdr.magic == TapIndexMagic)
+           && (hdr.version == TapIndexVersion)
+           && (hdr.fileSize == fileSize)
+           && (hdr.fileTime == fileTime);
+
+    if (isOk && (hdr.count > ip->size))
+        {
+        free(ip->entries);
+        ip->entries = malloc(hdr.count * sizeof(u64));
+        ip->size    = ip->entries != NULL ? hdr.count : 0;
+        isOk        = ip->entries != NULL;
+        }
+
+    if (isOk)
+        {
+        isOk = fread(ip->entries, sizeof(u64), hdr.count, fcb) == hdr.count;
+        }
+
+    fclose(fcb);
+
+    if (isOk)
+        {
+        ip->count   = hdr.count;
+        ip->dataEnd = hdr.dataEnd;
+        isOk        = tapIndexMarks(ip);
+        }
+
+    if (!isOk)
+        {
+        ip->count = 0;
+        }
+
+    return (isOk);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Collect the ordinals of all tape marks.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**
+**  Returns:        TRUE if successful, FALSE if out of memory.
+**
+**------------------------------------------------------------------------*/
+static bool tapIndexMarks(TapIndex *ip)
+    {
+    u32 i;
+    u32 n;
+
+    for (i = 0, n = 0; i < ip->count; i++)
+        {
+        n += EntryIsMark(ip->entries[i]) ? 1 : 0;
+        }
+
+    free(ip->marks);
+    ip->marks     = malloc((n + 1) * sizeof(u32));
+    ip->markCount = 0;
+    if (ip->marks == NULL)
+        {
+        return (FALSE);
+        }
+
+    for (i = 0; i < ip->count; i++)
+        {
+        if (EntryIsMark(ip->entries[i]))
+            {
+            ip->marks[ip->markCount++] = i;
+            }
+        }
+
+    return (TRUE);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Write the index to its sidecar file. Failure to do
+**                  so (e.g. read only directory) is silently ignored.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  fileSize    size of container
+**                  fileTime    modification time of container
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void tapIndexSave(TapIndex *ip, u64 fileSize, u64 fileTime)
+    {
+    FILE           *fcb;
+    TapIndexHeader hdr;
+    char           name[MaxFSPath + 8];
+
+    tapIndexSidecarName(ip, name);
+    fcb = fopen(name, "wb");
+    if (fcb == NULL)
+        {
+        return;
+        }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic    = TapIndexMagic;
+    hdr.version  = TapIndexVersion;
+    hdr.fileSize = fileSize;
+    hdr.fileTime = fileTime;
+    hdr.dataEnd  = ip->dataEnd;
+    hdr.count    = ip->count;
+
+    if ((fwrite(&hdr, sizeof(hdr), 1, fcb) != 1)
+        || (fwrite(ip->entries, sizeof(u64), ip->count, fcb) != ip->count))
+        {
+        fclose(fcb);
+        remove(name);
+
+        return;
+        }
+
+    fclose(fcb);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Build the name of the sidecar file.
+**
+**  Parameters:     Name        Description.
+**                  ip          index
+**                  name        returns sidecar file name
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void tapIndexSidecarName(TapIndex *ip, char *name)
+    {
+    strcpy(name, ip->fileName);
+    strcat(name, ".idx");
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
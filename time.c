@@ -67,6 +67,38 @@ u64 getMilliseconds(void)
 #endif
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Returns a monotonic microsecond clock value suitable
+**                  for measuring short intervals.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Current microsecond clock value.
+**
+**------------------------------------------------------------------------*/
+u64 getMicroseconds(void)
+    {
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER        counter;
+
+    if (frequency.QuadPart == 0)
+        {
+        QueryPerformanceFrequency(&frequency);
+        }
+
+    QueryPerformanceCounter(&counter);
+
+    return (u64)((counter.QuadPart * 1000000) / frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((u64)ts.tv_sec * (u64)1000000) + ((u64)ts.tv_nsec / (u64)1000);
+#endif
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Returns the current system second clock value.
 **
@@ -5,7 +5,12 @@
 **  Name: trace.c
 **
 **  Description:
-**      Trace execution.
+**      Trace execution. Every traced instruction is stored as a fixed size
+**      binary record in an in-memory ring per CPU and per PP, so tracing
+**      costs little more than copying a few registers. The rings are only
+**      written to disk (as cpuN-S.trb and ppuNN-S.trb) when a trigger
+**      condition fires, and tracedec turns them into the traditional
+**      text format.
 **
 **  This program is free software: you can redistribute it and/or modify
 **  it under the terms of the GNU General Public License version 3 as
@@ -35,68 +40,16 @@
 #include "types.h"
 #include "proto.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
 /*
 **  -----------------
 **  Private Constants
 **  -----------------
 */
-
-/*
-**  PPU command adressing modes.
-*/
-#define AN       1
-#define Amd      2
-#define Ar       3
-#define Ad       4
-#define Adm      5
-
-/*
-**  CPU command adressing modes.
-*/
-#define CN       1
-#define CK       2
-#define Ci       3
-#define Cij      4
-#define CiK      5
-#define CjK      6
-#define Cijk     7
-#define Cik      8
-#define Cikj     9
-#define CijK     10
-#define Cjk      11
-#define Cj       12
-#define CLINK    100
-
-/*
-**  CPU register set markers.
-*/
-#define R        1
-#define RAA      2
-#define RAAB     3
-#define RAB      4
-#define RABB     5
-#define RAX      6
-#define RAXB     7
-#define RBA      8
-#define RBAB     9
-#define RBB      10
-#define RBBB     11
-#define RBX      12
-#define RBXB     13
-#define RX       14
-#define RXA      15
-#define RXAB     16
-#define RXB      17
-#define RXBB     18
-#define RXBX     19
-#define RXX      20
-#define RXXB     21
-#define RXXX     22
-#define RZB      23
-#define RZX      24
-#define RXNX     25
-#define RNXX     26
-#define RNXN     27
+#define TraceDefaultRecords    (1 << 20)
 
 /*
 **  -----------------------
@@ -109,215 +62,54 @@
 **  Private Typedef and Structure Definitions
 **  -----------------------------------------
 */
-typedef struct decPpControl
-    {
-    u8   mode;
-    char *mnemonic;
-    } DecPpControl;
 
-typedef struct decCpControl
+/*
+**  Trace ring of one CPU or PP. Only the thread executing the unit
+**  writes to it; the record count is published with release ordering so
+**  that a flush can copy the ring without stopping the writer.
+*/
+typedef struct traceRing
     {
-    u8   mode;
-    char *mnemonic;
-    u8   regSet;
-    } DecCpControl;
+    u8        *records;                 /* record storage, allocated on first use */
+    u32       recordSize;               /* size of a record */
+    u32       size;                     /* number of records (power of 2) */
+    u32       next;                     /* records written, private to writer */
+    bool      wrapped;                  /* TRUE once every slot has been written */
+    AtomicInt head;                     /* records written, published to readers */
+    } TraceRing;
 
 /*
 **  ---------------------------
 **  Private Function Prototypes
 **  ---------------------------
 */
+static void *traceRingSlot(TraceRing *rp);
+static void traceRingCommit(TraceRing *rp);
+static void traceRingWrite(TraceRing *rp, char *fileName, u32 unitType, u32 unit);
+static void traceFlush(u32 reason);
+static int traceAtomicLoad(AtomicInt *ap);
+static void traceAtomicStore(AtomicInt *ap, int value);
 
 /*
 **  ----------------
 **  Public Variables
 **  ----------------
 */
-u32 traceMask = 0;
+u32 traceMask     = 0;
 u32 traceSequenceNo;
+u32 traceRecords  = TraceDefaultRecords;
+u32 traceTriggers = TraceTriggerExit | TraceTriggerManual;
 
 /*
 **  -----------------
 **  Private Variables
 **  -----------------
 */
-FILE        **cpuF;
-static FILE *devF;
-static FILE **ppuF;
-
-static DecPpControl ppDecode[] =
-    {
-    AN, "PSN",              // 00
-    Amd, "LJM",             // 01
-    Amd, "RJM",             // 02
-    Ar, "UJN",              // 03
-    Ar, "ZJN",              // 04
-    Ar, "NJN",              // 05
-    Ar, "PJN",              // 06
-    Ar, "MJN",              // 07
-
-    Ar, "SHN",              // 10
-    Ad, "LMN",              // 11
-    Ad, "LPN",              // 12
-    Ad, "SCN",              // 13
-    Ad, "LDN",              // 14
-    Ad, "LCN",              // 15
-    Ad, "ADN",              // 16
-    Ad, "SBN",              // 17
-
-    Adm, "LDC",             // 20
-    Adm, "ADC",             // 21
-    Adm, "LPC",             // 22
-    Adm, "LMC",             // 23
-    AN, "PSN",              // 24
-    AN, "PSN",              // 25
-    Ad, "EXN",              // 26
-    Ad, "RPN",              // 27
-
-    Ad, "LDD",              // 30
-    Ad, "ADD",              // 31
-    Ad, "SBD",              // 32
-    Ad, "LMD",              // 33
-    Ad, "STD",              // 34
-    Ad, "RAD",              // 35
-    Ad, "AOD",              // 36
-    Ad, "SOD",              // 37
-
-    Ad, "LDI",              // 40
-    Ad, "ADI",              // 41
-    Ad, "SBI",              // 42
-    Ad, "LMI",              // 43
-    Ad, "STI",              // 44
-    Ad, "RAI",              // 45
-    Ad, "AOI",              // 46
-    Ad, "SOI",              // 47
-
-    Amd, "LDM",             // 50
-    Amd, "ADM",             // 51
-    Amd, "SBM",             // 52
-    Amd, "LMM",             // 53
-    Amd, "STM",             // 54
-    Amd, "RAM",             // 55
-    Amd, "AOM",             // 56
-    Amd, "SOM",             // 57
-
-    Ad, "CRD",              // 60
-    Amd, "CRM",             // 61
-    Ad, "CWD",              // 62
-    Amd, "CWM",             // 63
-    Amd, "AJM",             // 64
-    Amd, "IJM",             // 65
-    Amd, "FJM",             // 66
-    Amd, "EJM",             // 67
-
-    Ad, "IAN",              // 70
-    Amd, "IAM",             // 71
-    Ad, "OAN",              // 72
-    Amd, "OAM",             // 73
-    Ad, "ACN",              // 74
-    Ad, "DCN",              // 75
-    Ad, "FAN",              // 76
-    Amd, "FNC"              // 77
-    };
-
-static DecCpControl rjDecode[010] =
-    {
-    CK,  "RJ    %6.6o", R,                      // 0
-    CjK, "REC   B%o+%6.6o", RZB,                // 1
-    CjK, "WEC   B%o+%6.6o", RZB,                // 2
-    CK,  "XJ    %6.6o", R,                      // 3
-    Cjk, "RX    X%o,X%o", RNXX,                 // 4
-    Cjk, "WX    X%o,X%o", RNXX,                 // 5
-    Cj,  "RC    X%o", RNXN,                     // 6
-    CN,  "Illegal", R,                          // 7
-    };
-
-static DecCpControl cjDecode[010] =
-    {
-    CjK, "ZR    X%o,%6.6o", RZX,                // 0
-    CjK, "NZ    X%o,%6.6o", RZX,                // 1
-    CjK, "PL    X%o,%6.6o", RZX,                // 2
-    CjK, "NG    X%o,%6.6o", RZX,                // 3
-    CjK, "IR    X%o,%6.6o", RZX,                // 4
-    CjK, "OR    X%o,%6.6o", RZX,                // 5
-    CjK, "DF    X%o,%6.6o", RZX,                // 6
-    CjK, "ID    X%o,%6.6o", RZX,                // 7
-    };
-
-static DecCpControl cpDecode[0100] =
-    {
-    CN,    "PS", R,                             // 00
-    CLINK, (char *)rjDecode, R,                 // 01
-    CiK,   "JP    %6.6o", R,                    // 02
-    CLINK, (char *)cjDecode, R,                 // 03
-    CijK,  "EQ    B%o,B%o,%6.6o", RBB,          // 04
-    CijK,  "NE    B%o,B%o,%6.6o", RBB,          // 05
-    CijK,  "GE    B%o,B%o,%6.6o", RBB,          // 06
-    CijK,  "LT    B%o,B%o,%6.6o", RBB,          // 07
-
-    Cij,   "BX%o   X%o", RXX,                   // 10
-    Cijk,  "BX%o   X%o*X%o", RXXX,              // 11
-    Cijk,  "BX%o   X%o+X%o", RXXX,              // 12
-    Cijk,  "BX%o   X%o-X%o", RXXX,              // 13
-    Cik,   "BX%o   -X%o", RXXX,                 // 14
-    Cikj,  "BX%o   -X%o*X%o", RXXX,             // 15
-    Cikj,  "BX%o   -X%o+X%o", RXXX,             // 16
-    Cikj,  "BX%o   -X%o-X%o", RXXX,             // 17
-
-    Cijk,  "LX%o   %o%o", RX,                   // 20
-    Cijk,  "AX%o   %o%o", RX,                   // 21
-    Cijk,  "LX%o   B%o,X%o", RXBX,              // 22
-    Cijk,  "AX%o   B%o,X%o", RXBX,              // 23
-    Cijk,  "NX%o   B%o,X%o", RXBX,              // 24
-    Cijk,  "ZX%o   B%o,X%o", RXBX,              // 25
-    Cijk,  "UX%o   B%o,X%o", RXBX,              // 26
-    Cijk,  "PX%o   B%o,X%o", RXBX,              // 27
-
-    Cijk,  "FX%o   X%o+X%o", RXXX,              // 30
-    Cijk,  "FX%o   X%o-X%o", RXXX,              // 31
-    Cijk,  "DX%o   X%o+X%o", RXXX,              // 32
-    Cijk,  "DX%o   X%o-X%o", RXXX,              // 33
-    Cijk,  "RX%o   X%o+X%o", RXXX,              // 34
-    Cijk,  "RX%o   X%o-X%o", RXXX,              // 35
-    Cijk,  "IX%o   X%o+X%o", RXXX,              // 36
-    Cijk,  "IX%o   X%o-X%o", RXXX,              // 37
-
-    Cijk,  "FX%o   X%o*X%o", RXXX,              // 40
-    Cijk,  "RX%o   X%o*X%o", RXXX,              // 41
-    Cijk,  "DX%o   X%o*X%o", RXXX,              // 42
-    Cijk,  "MX%o   %o%o", RX,                   // 43
-    Cijk,  "FX%o   X%o/X%o", RXXX,              // 44
-    Cijk,  "RX%o   X%o/X%o", RXXX,              // 45
-    CN,    "NO", R,                             // 46
-    Cik,   "CX%o   X%o", RXNX,                  // 47
-
-    CijK,  "SA%o   A%o+%6.6o", RAA,             // 50
-    CijK,  "SA%o   B%o+%6.6o", RAB,             // 51
-    CijK,  "SA%o   X%o+%6.6o", RAX,             // 52
-    Cijk,  "SA%o   X%o+B%o", RAXB,              // 53
-    Cijk,  "SA%o   A%o+B%o", RAAB,              // 54
-    Cijk,  "SA%o   A%o-B%o", RAAB,              // 55
-    Cijk,  "SA%o   B%o+B%o", RABB,              // 56
-    Cijk,  "SA%o   B%o-B%o", RABB,              // 57
-
-    CijK,  "SB%o   A%o+%6.6o", RBA,             // 60
-    CijK,  "SB%o   B%o+%6.6o", RBB,             // 61
-    CijK,  "SB%o   X%o+%6.6o", RBX,             // 62
-    Cijk,  "SB%o   X%o+B%o", RBXB,              // 63
-    Cijk,  "SB%o   A%o+B%o", RBAB,              // 64
-    Cijk,  "SB%o   A%o-B%o", RBAB,              // 65
-    Cijk,  "SB%o   B%o+B%o", RBBB,              // 66
-    Cijk,  "SB%o   B%o-B%o", RBBB,              // 67
-
-    CijK,  "SX%o   A%o+%6.6o", RXA,             // 70
-    CijK,  "SX%o   B%o+%6.6o", RXB,             // 71
-    CijK,  "SX%o   X%o+%6.6o", RXX,             // 72
-    Cijk,  "SX%o   X%o+B%o", RXXB,              // 73
-    Cijk,  "SX%o   A%o+B%o", RXAB,              // 74
-    Cijk,  "SX%o   A%o-B%o", RXAB,              // 75
-    Cijk,  "SX%o   B%o+B%o", RXBB,              // 76
-    Cijk,  "SX%o   B%o-B%o", RXBB,              // 77
-    };
+static FILE      *devF;
+static TraceRing *cpuRings;
+static TraceRing *ppuRings;
+static AtomicInt traceFlushReason;
+static u32       traceFlushCount = 0;
 
 /*
  **--------------------------------------------------------------------------
@@ -337,9 +129,9 @@ static DecCpControl cpDecode[0100] =
 **------------------------------------------------------------------------*/
 void traceInit(void)
     {
-    u8   cp;
-    u8   pp;
-    char fileName[20];
+    u8  cp;
+    u8  pp;
+    u32 size;
 
     devF = fopen("device.trc", "wt");
     if (devF == NULL)
@@ -348,42 +140,42 @@ void traceInit(void)
         exit(1);
         }
 
-    cpuF = calloc(cpuCount, sizeof(FILE *));
-    if (cpuF == NULL)
+    /*
+    **  Round the ring size up to a power of 2. The record storage of a
+    **  ring is only allocated when its CPU or PP is first traced.
+    */
+    for (size = 1; size < traceRecords && size < (1U << 30); size <<= 1)
+        {
+        }
+
+    cpuRings = calloc(cpuCount, sizeof(TraceRing));
+    if (cpuRings == NULL)
         {
-        fprintf(stderr, "(trace  ) Failed to allocate CPU trace FILE pointers - aborting\n");
+        fprintf(stderr, "(trace  ) Failed to allocate CPU trace rings - aborting\n");
         exit(1);
         }
+
     for (cp = 0; cp < cpuCount; cp++)
         {
-        sprintf(fileName, "cpu%o.trc", cp);
-        cpuF[cp] = fopen(fileName, "wt");
-        if (cpuF[cp] == NULL)
-            {
-            fprintf(stderr, "(trace  ) Can't open cpu[%o] trace (%s) - aborting\n", cp, fileName);
-            exit(1);
-            }
+        cpuRings[cp].recordSize = sizeof(TraceCpuRecord);
+        cpuRings[cp].size       = size;
         }
 
-    ppuF = calloc(ppuCount, sizeof(FILE *));
-    if (ppuF == NULL)
+    ppuRings = calloc(ppuCount, sizeof(TraceRing));
+    if (ppuRings == NULL)
         {
-        fprintf(stderr, "(trace  ) Failed to allocate PP trace FILE pointers - aborting\n");
+        fprintf(stderr, "(trace  ) Failed to allocate PP trace rings - aborting\n");
         exit(1);
         }
 
     for (pp = 0; pp < ppuCount; pp++)
         {
-        sprintf(fileName, "ppu%02o.trc", pp);
-        ppuF[pp] = fopen(fileName, "wt");
-        if (ppuF[pp] == NULL)
-            {
-            fprintf(stderr, "(trace  ) Can't open ppu[%02o] trace (%s) - aborting\n", pp, fileName);
-            exit(1);
-            }
+        ppuRings[pp].recordSize = sizeof(TracePpRecord);
+        ppuRings[pp].size       = size;
         }
 
     traceSequenceNo = 0;
+    traceAtomicStore(&traceFlushReason, 0);
     }
 
 /*--------------------------------------------------------------------------
@@ -396,35 +188,74 @@ void traceInit(void)
 **------------------------------------------------------------------------*/
 void traceTerminate(void)
     {
-    u8 cp;
-    u8 pp;
+    if ((traceTriggers & TraceTriggerExit) != 0)
+        {
+        traceFlush(TraceTriggerExit);
+        }
 
-    for (cp = 0; cp < cpuCount; cp++)
+    fclose(devF);
+
+    /*
+    **  The rings are not freed, CPU threads may still be finishing their
+    **  last instruction.
+    */
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Request the trace rings to be written to disk if the
+**                  trigger condition is enabled. Stop and function
+**                  triggers fire only once.
+**
+**  Parameters:     Name        Description.
+**                  condition   TraceTrigger... condition which occurred
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void traceTrigger(u32 condition)
+    {
+    if ((traceTriggers & condition) == 0)
         {
-        if (cpuF[cp] != NULL)
-            {
-            fclose(cpuF[cp]);
-            }
+        return;
         }
 
-    free(cpuF);
+    if (condition != TraceTriggerManual)
+        {
+        traceTriggers &= ~condition;
+        }
 
-    for (pp = 0; pp < ppuCount; pp++)
+    traceAtomicStore(&traceFlushReason, (int)condition);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Write the trace rings to disk if a trigger fired. Called
+**                  by the main thread while the PPs are between epochs.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void traceStep(void)
+    {
+    int reason;
+
+    reason = traceAtomicLoad(&traceFlushReason);
+    if (reason == 0)
         {
-        if (ppuF[pp] != NULL)
-            {
-            fclose(ppuF[pp]);
-            }
+        return;
         }
 
-    free(ppuF);
+    traceAtomicStore(&traceFlushReason, 0);
+    traceFlush((u32)reason);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output CPU opcode.
+**  Purpose:        Record CPU instruction.
 **
 **  Parameters:     Name        Description.
 **                  cpu         Pointer to CPU context
+**                  p           Address of instruction word
 **                  opFm        Opcode
 **                  opI         i
 **                  opJ         j
@@ -436,11 +267,8 @@ void traceTerminate(void)
 **------------------------------------------------------------------------*/
 void traceCpu(CpuContext *cpu, u32 p, u8 opFm, u8 opI, u8 opJ, u8 opK, u32 opAddress)
     {
-    u8           addrMode;
-    bool         link    = TRUE;
-    static bool  oneIdle = TRUE;
-    DecCpControl *decode = cpDecode;
-    static char  str[80];
+    TraceRing      *rp;
+    TraceCpuRecord *rec;
 
     /*
     **  Bail out if no trace of the CPU is requested.
@@ -450,307 +278,58 @@ void traceCpu(CpuContext *cpu, u32 p, u8 opFm, u8 opI, u8 opJ, u8 opK, u32 opAdd
         return;
         }
 
-#if 0
-    /*
-    **  Don't trace Scope 3.1 idle loop.
-    */
-    if ((cpu->regRaCm == 02020) && (cpu->regP == 2))
-        {
-        if (!oneIdle)
-            {
-            return;
-            }
-        else
-            {
-            oneIdle = FALSE;
-            }
-        }
-    else
-        {
-        oneIdle = TRUE;
-        }
-#endif
-
-#if 0
-    for (i = 0; i < 8; i++)
-        {
-        data = cpu->regX[i];
-        fprintf(cpuF[cpu->id], "        A%d %06.6o  X%d %04.4o %04.4o %04.4o %04.4o %04.4o   B%d %06.6o\n",
-                i, cpu->regA[i], i,
-                (PpWord)((data >> 48) & Mask12),
-                (PpWord)((data >> 36) & Mask12),
-                (PpWord)((data >> 24) & Mask12),
-                (PpWord)((data >> 12) & Mask12),
-                (PpWord)((data) & Mask12),
-                i, cpu->regB[i]);
-        }
-#endif
-
-    /*
-    **  Print sequence no.
-    */
     traceSequenceNo += 1;
-    fprintf(cpuF[cpu->id], "%06d ", traceSequenceNo);
 
     /*
-    **  Print program counter and opcode.
+    **  Save the opcode and every register the text line may show.
     */
-    fprintf(cpuF[cpu->id], "%6.6o  ", p);
-    fprintf(cpuF[cpu->id], "%02o %o %o %o   ", opFm, opI, opJ, opK);        // << not quite correct, but still nice for debugging
-
-    /*
-    **  Print opcode mnemonic and operands.
-    */
-    addrMode = decode[opFm].mode;
-
-    if ((opFm == 066) && (opI == 0))
-        {
-        sprintf(str, "CRX%o  X%o", opJ, opK);
-        fprintf(cpuF[cpu->id], "%-30s", str);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opK, cpu->regX[opK]);
-        fprintf(cpuF[cpu->id], "\n");
-
-        return;
-        }
-
-    if ((opFm == 067) && (opI == 0))
-        {
-        sprintf(str, "CWX%o  X%o", opJ, opK);
-        fprintf(cpuF[cpu->id], "%-30s", str);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opK, cpu->regX[opK]);
-        fprintf(cpuF[cpu->id], "\n");
-
-        return;
-        }
-
-    while (link)
-        {
-        link = FALSE;
-
-        switch (addrMode)
-            {
-        case CN:
-            strcpy(str, decode[opFm].mnemonic);
-            break;
-
-        case CK:
-            sprintf(str, decode[opFm].mnemonic, opAddress);
-            break;
-
-        case Ci:
-            sprintf(str, decode[opFm].mnemonic, opI);
-            break;
-
-        case Cij:
-            sprintf(str, decode[opFm].mnemonic, opI, opJ);
-            break;
-
-        case CiK:
-            sprintf(str, decode[opFm].mnemonic, cpu->regB[opI] + opAddress);
-            break;
-
-        case CjK:
-            sprintf(str, decode[opFm].mnemonic, opJ, opAddress);
-            break;
-
-        case Cijk:
-            sprintf(str, decode[opFm].mnemonic, opI, opJ, opK);
-            break;
-
-        case Cik:
-            sprintf(str, decode[opFm].mnemonic, opI, opK);
-            break;
-
-        case Cikj:
-            sprintf(str, decode[opFm].mnemonic, opI, opK, opJ);
-            break;
-
-        case CijK:
-            sprintf(str, decode[opFm].mnemonic, opI, opJ, opAddress);
-            break;
-
-        case Cjk:
-            sprintf(str, decode[opFm].mnemonic, opJ, opK);
-            break;
-
-        case Cj:
-            sprintf(str, decode[opFm].mnemonic, opJ);
-            break;
-
-        case CLINK:
-            decode   = (DecCpControl *)decode[opFm].mnemonic;
-            opFm     = opI;
-            addrMode = decode[opFm].mode;
-            link     = TRUE;
-            break;
-
-        default:
-            sprintf(str, "unsupported mode %02o", opFm);
-            break;
-            }
-        }
+    rp             = cpuRings + cpu->id;
+    rec            = (TraceCpuRecord *)traceRingSlot(rp);
+    rec->seq       = traceSequenceNo;
+    rec->type      = TraceRecCpuOp;
+    rec->cpu       = (u8)cpu->id;
+    rec->opFm      = opFm;
+    rec->opI       = opI;
+    rec->opJ       = opJ;
+    rec->opK       = opK;
+    rec->p         = p;
+    rec->opAddress = opAddress;
+    rec->regA[0]   = cpu->regA[opI];
+    rec->regA[1]   = cpu->regA[opJ];
+    rec->regB[0]   = cpu->regB[opI];
+    rec->regB[1]   = cpu->regB[opJ];
+    rec->regB[2]   = cpu->regB[opK];
+    rec->regX[0]   = cpu->regX[opI];
+    rec->regX[1]   = cpu->regX[opJ];
+    rec->regX[2]   = cpu->regX[opK];
+    traceRingCommit(rp);
+    }
 
-    fprintf(cpuF[cpu->id], "%-30s", str);
+/*--------------------------------------------------------------------------
+**  Purpose:        Record that the CPU stopped.
+**
+**  Parameters:     Name        Description.
+**                  cpu         Pointer to CPU context
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void traceCpuStop(CpuContext *cpu)
+    {
+    TraceRing      *rp;
+    TraceCpuRecord *rec;
 
-    /*
-    **  Dump relevant register set.
-    */
-    switch (decode[opFm].regSet)
+    if ((traceMask & TraceCpu) != 0)
         {
-    case R:
-        break;
-
-    case RAA:
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opI, cpu->regA[opI]);
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opJ, cpu->regA[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RAAB:
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opI, cpu->regA[opI]);
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opJ, cpu->regA[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RAB:
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opI, cpu->regA[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RABB:
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opI, cpu->regA[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RAX:
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opI, cpu->regA[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RAXB:
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opI, cpu->regA[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RBA:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opI, cpu->regB[opI]);
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opJ, cpu->regA[opJ]);
-        break;
-
-    case RBAB:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opI, cpu->regB[opI]);
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opJ, cpu->regA[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        break;
-
-    case RBB:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opI, cpu->regB[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        break;
-
-    case RBBB:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opI, cpu->regB[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        break;
-
-    case RBX:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opI, cpu->regB[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        break;
-
-    case RBXB:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opI, cpu->regB[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        break;
-
-    case RX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        break;
-
-    case RXA:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opJ, cpu->regA[opJ]);
-        break;
-
-    case RXAB:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "A%d=%06o    ", opJ, cpu->regA[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        break;
-
-    case RXB:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        break;
-
-    case RXBB:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        break;
-
-    case RXBX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opK, cpu->regX[opK]);
-        break;
-
-    case RXX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        break;
-
-    case RXXB:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opK, cpu->regB[opK]);
-        break;
-
-    case RXXX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opK, cpu->regX[opK]);
-        break;
-
-    case RZB:
-        fprintf(cpuF[cpu->id], "B%d=%06o    ", opJ, cpu->regB[opJ]);
-        break;
-
-    case RZX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        break;
-
-    case RXNX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opI, cpu->regX[opI]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opK, cpu->regX[opK]);
-        break;
-
-    case RNXX:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opK, cpu->regX[opK]);
-        break;
-
-    case RNXN:
-        fprintf(cpuF[cpu->id], "X%d=" FMT60_020o "   ", opJ, cpu->regX[opJ]);
-        break;
-
-    default:
-        fprintf(cpuF[cpu->id], "unsupported register set %d", decode[opFm].regSet);
-        break;
+        rp        = cpuRings + cpu->id;
+        rec       = (TraceCpuRecord *)traceRingSlot(rp);
+        rec->seq  = traceSequenceNo;
+        rec->type = TraceRecCpuStop;
+        rec->cpu  = (u8)cpu->id;
+        traceRingCommit(rp);
         }
 
-    fprintf(cpuF[cpu->id], "\n");
+    traceTrigger(TraceTriggerStop);
     }
 
 /*--------------------------------------------------------------------------
@@ -759,14 +338,16 @@ void traceCpu(CpuContext *cpu, u32 p, u8 opFm, u8 opI, u8 opJ, u8 opK, u32 opAdd
 **  Parameters:     Name        Description.
 **                  cpu         Pointer to CPU context
 **                  addr        Address of exchange package
+**                  title       "Old" or "New"
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
 void traceExchange(CpuContext *cpu, u32 addr, char *title)
     {
-    CpWord data;
-    u8     i;
+    TraceExchangeRecord parts[TraceExchangeParts];
+    TraceRing           *rp;
+    u8                  i;
 
     /*
     **  Bail out if no trace of exchange jumps is requested.
@@ -776,78 +357,30 @@ void traceExchange(CpuContext *cpu, u32 addr, char *title)
         return;
         }
 
-    fprintf(cpuF[cpu->id], "\n%06d Exchange jump with package address %06o (%s)\n\n", traceSequenceNo, addr, title);
-    fprintf(cpuF[cpu->id], "P       %06o  ", cpu->regP);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 0, cpu->regA[0]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 0, cpu->regB[0]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "RA      %06o  ", cpu->regRaCm);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 1, cpu->regA[1]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 1, cpu->regB[1]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "FL      %06o  ", cpu->regFlCm);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 2, cpu->regA[2]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 2, cpu->regB[2]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "RAE   %08o  ", cpu->regRaEcs);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 3, cpu->regA[3]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 3, cpu->regB[3]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "FLE   %08o  ", cpu->regFlEcs);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 4, cpu->regA[4]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 4, cpu->regB[4]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "EM/FL %08o  ", cpu->exitMode);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 5, cpu->regA[5]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 5, cpu->regB[5]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "MA      %06o  ", cpu->regMa);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 6, cpu->regA[6]);
-    fprintf(cpuF[cpu->id], "B%d %06o", 6, cpu->regB[6]);
-    fprintf(cpuF[cpu->id], "\n");
-
-    fprintf(cpuF[cpu->id], "STOP         %d  ", cpu->isStopped ? 1 : 0);
-    fprintf(cpuF[cpu->id], "A%d %06o  ", 7, cpu->regA[7]);
-    fprintf(cpuF[cpu->id], "B%d %06o  ", 7, cpu->regB[7]);
-    fprintf(cpuF[cpu->id], "\n");
-    fprintf(cpuF[cpu->id], "ECOND       %02o  ", cpu->exitCondition);
-    fprintf(cpuF[cpu->id], "\n");
-    fprintf(cpuF[cpu->id], "MonitorFlag %s", cpu->isMonitorMode ? "TRUE" : "FALSE");
-    fprintf(cpuF[cpu->id], "\n");
-    fprintf(cpuF[cpu->id], "\n");
-
-    for (i = 0; i < 8; i++)
+    tracePackExchange(parts, cpu, traceSequenceNo, addr, title);
+
+    rp = cpuRings + cpu->id;
+    for (i = 0; i < TraceExchangeParts; i++)
         {
-        fprintf(cpuF[cpu->id], "X%d ", i);
-        data = cpu->regX[i];
-        fprintf(cpuF[cpu->id], "%04o %04o %04o %04o %04o   ",
-                (PpWord)((data >> 48) & Mask12),
-                (PpWord)((data >> 36) & Mask12),
-                (PpWord)((data >> 24) & Mask12),
-                (PpWord)((data >> 12) & Mask12),
-                (PpWord)((data) & Mask12));
-        fprintf(cpuF[cpu->id], "\n");
+        memcpy(traceRingSlot(rp), parts + i, sizeof(TraceExchangeRecord));
+        traceRingCommit(rp);
         }
-
-    fprintf(cpuF[cpu->id], "\n\n");
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output sequence number.
+**  Purpose:        Record the start of a PP instruction: sequence no,
+**                  registers and opcode.
 **
 **  Parameters:     Name        Description.
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void traceSequence(void)
+void tracePpStart(void)
     {
+    TraceRing     *rp;
+    TracePpRecord *rec;
+
     /*
     **  Increment sequence number here.
     */
@@ -861,22 +394,33 @@ void traceSequence(void)
         return;
         }
 
-    /*
-    **  Print sequence no and PPU number.
-    */
-    fprintf(ppuF[activePpu->id], "%06d [%2o]    ", traceSequenceNo, activePpu->id);
+    rp         = ppuRings + activePpu->id;
+    rec        = (TracePpRecord *)traceRingSlot(rp);
+    rec->seq   = traceSequenceNo;
+    rec->type  = TraceRecPpStart;
+    rec->pp    = activePpu->id;
+    rec->regP  = activePpu->regP;
+    rec->regA  = activePpu->regA;
+    rec->word1 = activePpu->mem[activePpu->regP];
+    rec->word2 = activePpu->mem[(activePpu->regP + 1) & Mask12];
+    traceRingCommit(rp);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output registers.
+**  Purpose:        Record the end of a PP instruction: registers and, for
+**                  channel instructions, the new channel status.
 **
 **  Parameters:     Name        Description.
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void traceRegisters(void)
+void tracePpEnd(void)
     {
+    TraceRing     *rp;
+    TracePpRecord *rec;
+    ChSlot        *cc;
+
     /*
     **  Bail out if no trace of this PPU is requested.
     */
@@ -885,232 +429,274 @@ void traceRegisters(void)
         return;
         }
 
-    /*
-    **  Print registers.
-    */
-    fprintf(ppuF[activePpu->id], "P:%04o  ", activePpu->regP);
-    fprintf(ppuF[activePpu->id], "A:%06o", activePpu->regA);
-    fprintf(ppuF[activePpu->id], "    ");
+    rp         = ppuRings + activePpu->id;
+    rec        = (TracePpRecord *)traceRingSlot(rp);
+    rec->seq   = traceSequenceNo;
+    rec->type  = TraceRecPpEnd;
+    rec->pp    = activePpu->id;
+    rec->regP  = activePpu->regP;
+    rec->regA  = activePpu->regA;
+    rec->word1 = 0;
+    rec->word2 = 0;
+
+    if (activePpu->opF >= 064)
+        {
+        cc          = channel + (activePpu->opD & 037);
+        rec->word1  = TraceChValid;
+        rec->word1 |= cc->active           ? TraceChActive : 0;
+        rec->word1 |= cc->full             ? TraceChFull : 0;
+        rec->word1 |= cc->ioDevice != NULL ? TraceChDevice : 0;
+        }
+
+    traceRingCommit(rp);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output opcode.
+**  Purpose:        Output channel unclaimed function info.
 **
 **  Parameters:     Name        Description.
+**                  funcCode    Function code.
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void traceOpcode(void)
+void traceChannelFunction(PpWord funcCode)
     {
-    PpWord opCode;
-    u8     addrMode;
-    u8     opF;
-    u8     opD;
-
-    /*
-    **  Bail out if no trace of this PPU is requested.
-    */
-    if ((traceMask & (1 << activePpu->id)) == 0)
-        {
-        return;
-        }
-
-    /*
-    **  Print opcode.
-    */
-    opCode   = activePpu->mem[activePpu->regP];
-    opF      = opCode >> 6;
-    opD      = opCode & 077;
-    addrMode = ppDecode[opF].mode;
-
-    fprintf(ppuF[activePpu->id], "O:%04o   %3.3s ", opCode, ppDecode[opF].mnemonic);
-
-    switch (addrMode)
-        {
-    case AN:
-        fprintf(ppuF[activePpu->id], "        ");
-        break;
-
-    case Amd:
-        fprintf(ppuF[activePpu->id], "%04o,%02o ", activePpu->mem[activePpu->regP + 1], opD);
-        break;
-
-    case Ar:
-        if (opD < 040)
-            {
-            fprintf(ppuF[activePpu->id], "+%02o     ", opD);
-            }
-        else
-            {
-            fprintf(ppuF[activePpu->id], "-%02o     ", 077 - opD);
-            }
-        break;
-
-    case Ad:
-        fprintf(ppuF[activePpu->id], "%02o      ", opD);
-        break;
-
-    case Adm:
-        fprintf(ppuF[activePpu->id], "%02o%04o  ", opD, activePpu->mem[activePpu->regP + 1]);
-        break;
-        }
-
-    fprintf(ppuF[activePpu->id], "    ");
+    fprintf(devF, "%06d [%02o]    ", traceSequenceNo, activePpu->id);
+    fprintf(devF, "Unclaimed function code %04o on CH%02o\n", funcCode, activeChannel->id);
+    traceTrigger(TraceTriggerFunction);
     }
 
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
 /*--------------------------------------------------------------------------
-**  Purpose:        Output opcode.
+**  Purpose:        Return the slot for the next record of a ring.
 **
 **  Parameters:     Name        Description.
+**                  rp          pointer to ring
 **
-**  Returns:        Nothing.
+**  Returns:        Pointer to record slot.
 **
 **------------------------------------------------------------------------*/
-u8 traceDisassembleOpcode(char *str, PpWord *pm)
+static void *traceRingSlot(TraceRing *rp)
     {
-    u8     result = 1;
-    PpWord opCode;
-    u8     addrMode;
-    u8     opF;
-    u8     opD;
-
-    /*
-    **  Print opcode.
-    */
-    opCode   = *pm++;
-    opF      = opCode >> 6;
-    opD      = opCode & 077;
-    addrMode = ppDecode[opF].mode;
-
-    str += sprintf(str, "%3.3s  ", ppDecode[opF].mnemonic);
-
-    switch (addrMode)
+    if (rp->records == NULL)
         {
-    case AN:
-        sprintf(str, "        ");
-        break;
-
-    case Amd:
-        sprintf(str, "%04o,%02o ", *pm, opD);
-        result = 2;
-        break;
-
-    case Ar:
-        if (opD < 040)
-            {
-            sprintf(str, "+%02o     ", opD);
-            }
-        else
+        rp->records = malloc((size_t)rp->size * rp->recordSize);
+        if (rp->records == NULL)
             {
-            sprintf(str, "-%02o     ", 077 - opD);
+            fprintf(stderr, "(trace  ) Failed to allocate trace ring - aborting\n");
+            exit(1);
             }
-        break;
-
-    case Ad:
-        sprintf(str, "%02o      ", opD);
-        break;
-
-    case Adm:
-        sprintf(str, "%02o%04o  ", opD, *pm);
-        result = 2;
-        break;
         }
 
-    return (result);
+    return (rp->records + (size_t)(rp->next & (rp->size - 1)) * rp->recordSize);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output channel unclaimed function info.
+**  Purpose:        Publish the record written to the slot returned by
+**                  traceRingSlot.
 **
 **  Parameters:     Name        Description.
-**                  funcCode    Function code.
+**                  rp          pointer to ring
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void traceChannelFunction(PpWord funcCode)
+static void traceRingCommit(TraceRing *rp)
     {
-    fprintf(devF, "%06d [%02o]    ", traceSequenceNo, activePpu->id);
-    fprintf(devF, "Unclaimed function code %04o on CH%02o\n", funcCode, activeChannel->id);
+    rp->next += 1;
+    if ((rp->next & (rp->size - 1)) == 0)
+        {
+        rp->wrapped = TRUE;
+        }
+
+    traceAtomicStore(&rp->head, (int)rp->next);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output string for PPU.
+**  Purpose:        Write the records of a ring to a file, oldest first.
+**                  The ring is copied first; records the writer may have
+**                  overwritten during the copy are dropped.
 **
 **  Parameters:     Name        Description.
-**                  str         String to output.
+**                  rp          pointer to ring
+**                  fileName    name of trace file
+**                  unitType    TraceUnitCpu or TraceUnitPp
+**                  unit        CPU or PP number
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void tracePrint(char *str)
+static void traceRingWrite(TraceRing *rp, char *fileName, u32 unitType, u32 unit)
     {
-    fputs(str, ppuF[activePpu->id]);
+    TraceFileHeader header;
+    u8              *copy;
+    u32             count;
+    u32             first;
+    u32             head;
+    u32             i;
+    i32             lost;
+    FILE            *fp;
+
+    head = (u32)traceAtomicLoad(&rp->head);
+    if (head == 0)
+        {
+        return;
+        }
+
+    count = (rp->wrapped || head >= rp->size) ? rp->size : head;
+    first = head - count;
+
+    copy = malloc((size_t)count * rp->recordSize);
+    if (copy == NULL)
+        {
+        fprintf(stderr, "(trace  ) Failed to allocate buffer for %s\n", fileName);
+
+        return;
+        }
+
+    for (i = 0; i < count; i++)
+        {
+        memcpy(copy + (size_t)i * rp->recordSize,
+               rp->records + (size_t)((first + i) & (rp->size - 1)) * rp->recordSize,
+               rp->recordSize);
+        }
+
+    /*
+    **  Drop the records whose slots were reused (or are being written)
+    **  while copying.
+    */
+#if defined(_WIN32)
+    MemoryBarrier();
+#else
+    atomic_thread_fence(memory_order_acquire);
+#endif
+    head = (u32)traceAtomicLoad(&rp->head);
+    lost = (i32)(head + 1 - rp->size - first);
+    if (lost < 0)
+        {
+        lost = 0;
+        }
+    else if ((u32)lost > count)
+        {
+        lost = count;
+        }
+
+    fp = fopen(fileName, "wb");
+    if (fp == NULL)
+        {
+        fprintf(stderr, "(trace  ) Can't open %s\n", fileName);
+        free(copy);
+
+        return;
+        }
+
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, "DtTrace");
+    header.recordSize = rp->recordSize;
+    header.unitType   = unitType;
+    header.unit       = unit;
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(copy + (size_t)lost * rp->recordSize, rp->recordSize, count - lost, fp);
+    fclose(fp);
+    free(copy);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output string for CPU.
+**  Purpose:        Write all trace rings to disk.
 **
 **  Parameters:     Name        Description.
-**                  cpu         Pointer to CPU context
-**                  str         String to output.
+**                  reason      TraceTrigger... condition which fired
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void traceCpuPrint(CpuContext *cpu, char *str)
+static void traceFlush(u32 reason)
     {
-    fputs(str, cpuF[cpu->id]);
+    u8   cp;
+    u8   pp;
+    char fileName[40];
+    char *name;
+
+    switch (reason)
+        {
+    case TraceTriggerExit:
+        name = "exit";
+        break;
+
+    case TraceTriggerStop:
+        name = "CPU stop";
+        break;
+
+    case TraceTriggerFunction:
+        name = "unclaimed function";
+        break;
+
+    default:
+        name = "operator";
+        break;
+        }
+
+    traceFlushCount += 1;
+
+    for (cp = 0; cp < cpuCount; cp++)
+        {
+        sprintf(fileName, "cpu%o-%u.trb", cp, traceFlushCount);
+        traceRingWrite(cpuRings + cp, fileName, TraceUnitCpu, cp);
+        }
+
+    for (pp = 0; pp < ppuCount; pp++)
+        {
+        sprintf(fileName, "ppu%02o-%u.trb", pp, traceFlushCount);
+        traceRingWrite(ppuRings + pp, fileName, TraceUnitPp, pp);
+        }
+
+    fprintf(stdout, "(trace  ) Trace triggered by %s - rings written to *-%u.trb\n", name, traceFlushCount);
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output status of channel.
+**  Purpose:        Atomically load a trace ring count with acquire ordering.
 **
 **  Parameters:     Name        Description.
-**                  ch          channel number.
+**                  ap          pointer to atomic integer
 **
-**  Returns:        Nothing.
+**  Returns:        Current value.
 **
 **------------------------------------------------------------------------*/
-void traceChannel(u8 ch)
+static int traceAtomicLoad(AtomicInt *ap)
     {
-    /*
-    **  Bail out if no trace of this PPU is requested.
-    */
-    if ((traceMask & (1 << activePpu->id)) == 0)
-        {
-        return;
-        }
-
-    fprintf(ppuF[activePpu->id], "  CH:%c%c%c",
-            channel[ch].active           ? 'A' : 'D',
-            channel[ch].full             ? 'F' : 'E',
-            channel[ch].ioDevice == NULL ? 'I' : 'S');
+#if defined(_WIN32)
+    return InterlockedCompareExchange(ap, 0, 0);
+#else
+    return atomic_load_explicit(ap, memory_order_acquire);
+#endif
     }
 
 /*--------------------------------------------------------------------------
-**  Purpose:        Output end-of-line.
+**  Purpose:        Atomically store a trace ring count with release ordering.
 **
 **  Parameters:     Name        Description.
+**                  ap          pointer to atomic integer
+**                  value       new value
 **
 **  Returns:        Nothing.
 **
 **------------------------------------------------------------------------*/
-void traceEnd(void)
+static void traceAtomicStore(AtomicInt *ap, int value)
     {
-    /*
-    **  Bail out if no trace of this PPU is requested.
-    */
-    if ((traceMask & (1 << activePpu->id)) == 0)
-        {
-        return;
-        }
-
-    /*
-    **  Print newline.
-    */
-    fprintf(ppuF[activePpu->id], "\n");
+#if defined(_WIN32)
+    InterlockedExchange(ap, value);
+#else
+    atomic_store_explicit(ap, value, memory_order_release);
+#endif
     }
 
 /*---------------------------  End Of File  ------------------------------*/
@@ -0,0 +1,946 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: trace_format.c
+**
+**  Description:
+**      Format binary trace records as text. Used by the emulator and by
+**      the offline decoder (tracedec.c), so nothing in here may refer to
+**      emulator state.
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+
+/*
+**  PPU command adressing modes.
+*/
+#define AN       1
+#define Amd      2
+#define Ar       3
+#define Ad       4
+#define Adm      5
+
+/*
+**  CPU command adressing modes.
+*/
+#define CN       1
+#define CK       2
+#define Ci       3
+#define Cij      4
+#define CiK      5
+#define CjK      6
+#define Cijk     7
+#define Cik      8
+#define Cikj     9
+#define CijK     10
+#define Cjk      11
+#define Cj       12
+#define CLINK    100
+
+/*
+**  CPU register set markers.
+*/
+#define R        1
+#define RAA      2
+#define RAAB     3
+#define RAB      4
+#define RABB     5
+#define RAX      6
+#define RAXB     7
+#define RBA      8
+#define RBAB     9
+#define RBB      10
+#define RBBB     11
+#define RBX      12
+#define RBXB     13
+#define RX       14
+#define RXA      15
+#define RXAB     16
+#define RXB      17
+#define RXBB     18
+#define RXBX     19
+#define RXX      20
+#define RXXB     21
+#define RXXX     22
+#define RZB      23
+#define RZX      24
+#define RXNX     25
+#define RNXX     26
+#define RNXN     27
+
+/*
+**  Layout of a traced exchange package.
+*/
+#define XjRegP       0
+#define XjRegRaCm    1
+#define XjRegFlCm    2
+#define XjRegRaEcs   3
+#define XjRegFlEcs   4
+#define XjExitMode   5
+#define XjRegMa      6
+#define XjFlags      7
+#define XjRegA       8
+#define XjRegB       16
+#define XjRegX       24
+
+#define XjStopped    0x01
+#define XjMonitor    0x02
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+typedef struct decPpControl
+    {
+    u8   mode;
+    char *mnemonic;
+    } DecPpControl;
+
+typedef struct decCpControl
+    {
+    u8   mode;
+    char *mnemonic;
+    u8   regSet;
+    } DecCpControl;
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static void traceFormatA(FILE *fp, u8 reg, u32 value);
+static void traceFormatB(FILE *fp, u8 reg, u32 value);
+static void traceFormatX(FILE *fp, u8 reg, CpWord value);
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+static DecPpControl ppDecode[] =
+    {
+    AN, "PSN",              // 00
+    Amd, "LJM",             // 01
+    Amd, "RJM",             // 02
+    Ar, "UJN",              // 03
+    Ar, "ZJN",              // 04
+    Ar, "NJN",              // 05
+    Ar, "PJN",              // 06
+    Ar, "MJN",              // 07
+
+    Ar, "SHN",              // 10
+    Ad, "LMN",              // 11
+    Ad, "LPN",              // 12
+    Ad, "SCN",              // 13
+    Ad, "LDN",              // 14
+    Ad, "LCN",              // 15
+    Ad, "ADN",              // 16
+    Ad, "SBN",              // 17
+
+    Adm, "LDC",             // 20
+    Adm, "ADC",             // 21
+    Adm, "LPC",             // 22
+    Adm, "LMC",             // 23
+    AN, "PSN",              // 24
+    AN, "PSN",              // 25
+    Ad, "EXN",              // 26
+    Ad, "RPN",              // 27
+
+    Ad, "LDD",              // 30
+    Ad, "ADD",              // 31
+    Ad, "SBD",              // 32
+    Ad, "LMD",              // 33
+    Ad, "STD",              // 34
+    Ad, "RAD",              // 35
+    Ad, "AOD",              // 36
+    Ad, "SOD",              // 37
+
+    Ad, "LDI",              // 40
+    Ad, "ADI",              // 41
+    Ad, "SBI",              // 42
+    Ad, "LMI",              // 43
+    Ad, "STI",              // 44
+    Ad, "RAI",              // 45
+    Ad, "AOI",              // 46
+    Ad, "SOI",              // 47
+
+    Amd, "LDM",             // 50
+    Amd, "ADM",             // 51
+    Amd, "SBM",             // 52
+    Amd, "LMM",             // 53
+    Amd, "STM",             // 54
+    Amd, "RAM",             // 55
+    Amd, "AOM",             // 56
+    Amd, "SOM",             // 57
+
+    Ad, "CRD",              // 60
+    Amd, "CRM",             // 61
+    Ad, "CWD",              // 62
+    Amd, "CWM",             // 63
+    Amd, "AJM",             // 64
+    Amd, "IJM",             // 65
+    Amd, "FJM",             // 66
+    Amd, "EJM",             // 67
+
+    Ad, "IAN",              // 70
+    Amd, "IAM",             // 71
+    Ad, "OAN",              // 72
+    Amd, "OAM",             // 73
+    Ad, "ACN",              // 74
+    Ad, "DCN",              // 75
+    Ad, "FAN",              // 76
+    Amd, "FNC"              // 77
+    };
+
+static DecCpControl rjDecode[010] =
+    {
+    CK,  "RJ    %6.6o", R,                      // 0
+    CjK, "REC   B%o+%6.6o", RZB,                // 1
+    CjK, "WEC   B%o+%6.6o", RZB,                // 2
+    CK,  "XJ    %6.6o", R,                      // 3
+    Cjk, "RX    X%o,X%o", RNXX,                 // 4
+    Cjk, "WX    X%o,X%o", RNXX,                 // 5
+    Cj,  "RC    X%o", RNXN,                     // 6
+    CN,  "Illegal", R,                          // 7
+    };
+
+static DecCpControl cjDecode[010] =
+    {
+    CjK, "ZR    X%o,%6.6o", RZX,                // 0
+    CjK, "NZ    X%o,%6.6o", RZX,                // 1
+    CjK, "PL    X%o,%6.6o", RZX,                // 2
+    CjK, "NG    X%o,%6.6o", RZX,                // 3
+    CjK, "IR    X%o,%6.6o", RZX,                // 4
+    CjK, "OR    X%o,%6.6o", RZX,                // 5
+    CjK, "DF    X%o,%6.6o", RZX,                // 6
+    CjK, "ID    X%o,%6.6o", RZX,                // 7
+    };
+
+static DecCpControl cpDecode[0100] =
+    {
+    CN,    "PS", R,                             // 00
+    CLINK, (char *)rjDecode, R,                 // 01
+    CiK,   "JP    %6.6o", R,                    // 02
+    CLINK, (char *)cjDecode, R,                 // 03
+    CijK,  "EQ    B%o,B%o,%6.6o", RBB,          // 04
+    CijK,  "NE    B%o,B%o,%6.6o", RBB,          // 05
+    CijK,  "GE    B%o,B%o,%6.6o", RBB,          // 06
+    CijK,  "LT    B%o,B%o,%6.6o", RBB,          // 07
+
+    Cij,   "BX%o   X%o", RXX,                   // 10
+    Cijk,  "BX%o   X%o*X%o", RXXX,              // 11
+    Cijk,  "BX%o   X%o+X%o", RXXX,              // 12
+    Cijk,  "BX%o   X%o-X%o", RXXX,              // 13
+    Cik,   "BX%o   -X%o", RXXX,                 // 14
+    Cikj,  "BX%o   -X%o*X%o", RXXX,             // 15
+    Cikj,  "BX%o   -X%o+X%o", RXXX,             // 16
+    Cikj,  "BX%o   -X%o-X%o", RXXX,             // 17
+
+    Cijk,  "LX%o   %o%o", RX,                   // 20
+    Cijk,  "AX%o   %o%o", RX,                   // 21
+    Cijk,  "LX%o   B%o,X%o", RXBX,              // 22
+    Cijk,  "AX%o   B%o,X%o", RXBX,              // 23
+    Cijk,  "NX%o   B%o,X%o", RXBX,              // 24
+    Cijk,  "ZX%o   B%o,X%o", RXBX,              // 25
+    Cijk,  "UX%o   B%o,X%o", RXBX,              // 26
+    Cijk,  "PX%o   B%o,X%o", RXBX,              // 27
+
+    Cijk,  "FX%o   X%o+X%o", RXXX,              // 30
+    Cijk,  "FX%o   X%o-X%o", RXXX,              // 31
+    Cijk,  "DX%o   X%o+X%o", RXXX,              // 32
+    Cijk,  "DX%o   X%o-X%o", RXXX,              // 33
+    Cijk,  "RX%o   X%o+X%o", RXXX,              // 34
+    Cijk,  "RX%o   X%o-X%o", RXXX,              // 35
+    Cijk,  "IX%o   X%o+X%o", RXXX,              // 36
+    Cijk,  "IX%o   X%o-X%o", RXXX,              // 37
+
+    Cijk,  "FX%o   X%o*X%o", RXXX,              // 40
+    Cijk,  "RX%o   X%o*X%o", RXXX,              // 41
+    Cijk,  "DX%o   X%o*X%o", RXXX,              // 42
+    Cijk,  "MX%o   %o%o", RX,                   // 43
+    Cijk,  "FX%o   X%o/X%o", RXXX,              // 44
+    Cijk,  "RX%o   X%o/X%o", RXXX,              // 45
+    CN,    "NO", R,                             // 46
+    Cik,   "CX%o   X%o", RXNX,                  // 47
+
+    CijK,  "SA%o   A%o+%6.6o", RAA,             // 50
+    CijK,  "SA%o   B%o+%6.6o", RAB,             // 51
+    CijK,  "SA%o   X%o+%6.6o", RAX,             // 52
+    Cijk,  "SA%o   X%o+B%o", RAXB,              // 53
+    Cijk,  "SA%o   A%o+B%o", RAAB,              // 54
+    Cijk,  "SA%o   A%o-B%o", RAAB,              // 55
+    Cijk,  "SA%o   B%o+B%o", RABB,              // 56
+    Cijk,  "SA%o   B%o-B%o", RABB,              // 57
+
+    CijK,  "SB%o   A%o+%6.6o", RBA,             // 60
+    CijK,  "SB%o   B%o+%6.6o", RBB,             // 61
+    CijK,  "SB%o   X%o+%6.6o", RBX,             // 62
+    Cijk,  "SB%o   X%o+B%o", RBXB,              // 63
+    Cijk,  "SB%o   A%o+B%o", RBAB,              // 64
+    Cijk,  "SB%o   A%o-B%o", RBAB,              // 65
+    Cijk,  "SB%o   B%o+B%o", RBBB,              // 66
+    Cijk,  "SB%o   B%o-B%o", RBBB,              // 67
+
+    CijK,  "SX%o   A%o+%6.6o", RXA,             // 70
+    CijK,  "SX%o   B%o+%6.6o", RXB,             // 71
+    CijK,  "SX%o   X%o+%6.6o", RXX,             // 72
+    Cijk,  "SX%o   X%o+B%o", RXXB,              // 73
+    Cijk,  "SX%o   A%o+B%o", RXAB,              // 74
+    Cijk,  "SX%o   A%o-B%o", RXAB,              // 75
+    Cijk,  "SX%o   B%o+B%o", RXBB,              // 76
+    Cijk,  "SX%o   B%o-B%o", RXBB,              // 77
+    };
+
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Format a PP trace record. A start record begins the
+**                  line of an instruction, the matching end record
+**                  completes it.
+**
+**  Parameters:     Name        Description.
+**                  fp          output file
+**                  rp          pointer to record
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void traceFormatPp(FILE *fp, TracePpRecord *rp)
+    {
+    PpWord opCode;
+    u8     opF;
+    u8     opD;
+
+    if (rp->type != TraceRecPpStart)
+        {
+        /*
+        **  Print registers after execution and new channel status.
+        */
+        fprintf(fp, "P:%04o  A:%06o    ", rp->regP, rp->regA);
+        if ((rp->word1 & TraceChValid) != 0)
+            {
+            fprintf(fp, "  CH:%c%c%c",
+                    (rp->word1 & TraceChActive) != 0 ? 'A' : 'D',
+                    (rp->word1 & TraceChFull) != 0   ? 'F' : 'E',
+                    (rp->word1 & TraceChDevice) == 0 ? 'I' : 'S');
+            }
+
+        fprintf(fp, "\n");
+
+        return;
+        }
+
+    /*
+    **  Print sequence no, PPU number and registers.
+    */
+    fprintf(fp, "%06d [%2o]    ", rp->seq, rp->pp);
+    fprintf(fp, "P:%04o  A:%06o    ", rp->regP, rp->regA);
+
+    /*
+    **  Print opcode.
+    */
+    opCode = rp->word1;
+    opF    = opCode >> 6;
+    opD    = opCode & 077;
+
+    fprintf(fp, "O:%04o   %3.3s ", opCode, ppDecode[opF].mnemonic);
+
+    switch (ppDecode[opF].mode)
+        {
+    case AN:
+        fprintf(fp, "        ");
+        break;
+
+    case Amd:
+        fprintf(fp, "%04o,%02o ", rp->word2, opD);
+        break;
+
+    case Ar:
+        if (opD < 040)
+            {
+            fprintf(fp, "+%02o     ", opD);
+            }
+        else
+            {
+            fprintf(fp, "-%02o     ", 077 - opD);
+            }
+        break;
+
+    case Ad:
+        fprintf(fp, "%02o      ", opD);
+        break;
+
+    case Adm:
+        fprintf(fp, "%02o%04o  ", opD, rp->word2);
+        break;
+        }
+
+    fprintf(fp, "    ");
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Format a CPU instruction or stop trace record.
+**
+**  Parameters:     Name        Description.
+**                  fp          output file
+**                  rp          pointer to record
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void traceFormatCpu(FILE *fp, TraceCpuRecord *rp)
+    {
+    u8           addrMode;
+    bool         link      = TRUE;
+    DecCpControl *decode   = cpDecode;
+    u8           opFm      = rp->opFm;
+    u8           opI       = rp->opI;
+    u8           opJ       = rp->opJ;
+    u8           opK       = rp->opK;
+    u32          opAddress = rp->opAddress;
+    char         str[80];
+
+    if (rp->type == TraceRecCpuStop)
+        {
+        fprintf(fp, "Stopped\n");
+
+        return;
+        }
+
+    /*
+    **  Print sequence no, program counter and opcode.
+    */
+    fprintf(fp, "%06d ", rp->seq);
+    fprintf(fp, "%6.6o  ", rp->p);
+    fprintf(fp, "%02o %o %o %o   ", opFm, opI, opJ, opK);        // << not quite correct, but still nice for debugging
+
+    /*
+    **  Print opcode mnemonic and operands.
+    */
+    addrMode = decode[opFm].mode;
+
+    if (((opFm == 066) || (opFm == 067)) && (opI == 0))
+        {
+        sprintf(str, "C%cX%o  X%o", opFm == 066 ? 'R' : 'W', opJ, opK);
+        fprintf(fp, "%-30s", str);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatX(fp, opK, rp->regX[2]);
+        fprintf(fp, "\n");
+
+        return;
+        }
+
+    while (link)
+        {
+        link = FALSE;
+
+        switch (addrMode)
+            {
+        case CN:
+            strcpy(str, decode[opFm].mnemonic);
+            break;
+
+        case CK:
+            sprintf(str, decode[opFm].mnemonic, opAddress);
+            break;
+
+        case Ci:
+            sprintf(str, decode[opFm].mnemonic, opI);
+            break;
+
+        case Cij:
+            sprintf(str, decode[opFm].mnemonic, opI, opJ);
+            break;
+
+        case CiK:
+            sprintf(str, decode[opFm].mnemonic, rp->regB[0] + opAddress);
+            break;
+
+        case CjK:
+            sprintf(str, decode[opFm].mnemonic, opJ, opAddress);
+            break;
+
+        case Cijk:
+            sprintf(str, decode[opFm].mnemonic, opI, opJ, opK);
+            break;
+
+        case Cik:
+            sprintf(str, decode[opFm].mnemonic, opI, opK);
+            break;
+
+        case Cikj:
+            sprintf(str, decode[opFm].mnemonic, opI, opK, opJ);
+            break;
+
+        case CijK:
+            sprintf(str, decode[opFm].mnemonic, opI, opJ, opAddress);
+            break;
+
+        case Cjk:
+            sprintf(str, decode[opFm].mnemonic, opJ, opK);
+            break;
+
+        case Cj:
+            sprintf(str, decode[opFm].mnemonic, opJ);
+            break;
+
+        case CLINK:
+            decode   = (DecCpControl *)decode[opFm].mnemonic;
+            opFm     = opI;
+            addrMode = decode[opFm].mode;
+            link     = TRUE;
+            break;
+
+        default:
+            sprintf(str, "unsupported mode %02o", opFm);
+            break;
+            }
+        }
+
+    fprintf(fp, "%-30s", str);
+
+    /*
+    **  Dump relevant register set.
+    */
+    switch (decode[opFm].regSet)
+        {
+    case R:
+        break;
+
+    case RAA:
+        traceFormatA(fp, opI, rp->regA[0]);
+        traceFormatA(fp, opJ, rp->regA[1]);
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RAAB:
+        traceFormatA(fp, opI, rp->regA[0]);
+        traceFormatA(fp, opJ, rp->regA[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RAB:
+        traceFormatA(fp, opI, rp->regA[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RABB:
+        traceFormatA(fp, opI, rp->regA[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RAX:
+        traceFormatA(fp, opI, rp->regA[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RAXB:
+        traceFormatA(fp, opI, rp->regA[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RBA:
+        traceFormatB(fp, opI, rp->regB[0]);
+        traceFormatA(fp, opJ, rp->regA[1]);
+        break;
+
+    case RBAB:
+        traceFormatB(fp, opI, rp->regB[0]);
+        traceFormatA(fp, opJ, rp->regA[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        break;
+
+    case RBB:
+        traceFormatB(fp, opI, rp->regB[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        break;
+
+    case RBBB:
+        traceFormatB(fp, opI, rp->regB[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        break;
+
+    case RBX:
+        traceFormatB(fp, opI, rp->regB[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        break;
+
+    case RBXB:
+        traceFormatB(fp, opI, rp->regB[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        break;
+
+    case RX:
+        traceFormatX(fp, opI, rp->regX[0]);
+        break;
+
+    case RXA:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatA(fp, opJ, rp->regA[1]);
+        break;
+
+    case RXAB:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatA(fp, opJ, rp->regA[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        break;
+
+    case RXB:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        break;
+
+    case RXBB:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        break;
+
+    case RXBX:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatB(fp, opJ, rp->regB[1]);
+        traceFormatX(fp, opK, rp->regX[2]);
+        break;
+
+    case RXX:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        break;
+
+    case RXXB:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatB(fp, opK, rp->regB[2]);
+        break;
+
+    case RXXX:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatX(fp, opK, rp->regX[2]);
+        break;
+
+    case RZB:
+        traceFormatB(fp, opJ, rp->regB[1]);
+        break;
+
+    case RZX:
+        traceFormatX(fp, opJ, rp->regX[1]);
+        break;
+
+    case RXNX:
+        traceFormatX(fp, opI, rp->regX[0]);
+        traceFormatX(fp, opK, rp->regX[2]);
+        break;
+
+    case RNXX:
+        traceFormatX(fp, opJ, rp->regX[1]);
+        traceFormatX(fp, opK, rp->regX[2]);
+        break;
+
+    case RNXN:
+        traceFormatX(fp, opJ, rp->regX[1]);
+        break;
+
+    default:
+        fprintf(fp, "unsupported register set %d", decode[opFm].regSet);
+        break;
+        }
+
+    fprintf(fp, "\n");
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Pack an exchange package into binary trace records.
+**
+**  Parameters:     Name        Description.
+**                  parts       array of TraceExchangeParts records
+**                  cpu         Pointer to CPU context
+**                  seq         trace sequence number
+**                  addr        Address of exchange package
+**                  title       "Old" or "New"
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void tracePackExchange(TraceExchangeRecord *parts, CpuContext *cpu, u32 seq, u32 addr, char *title)
+    {
+    u32 values[TraceExchangeParts * TraceExchangeValues];
+    u8  i;
+
+    memset(values, 0, sizeof(values));
+    values[XjRegP]     = cpu->regP;
+    values[XjRegRaCm]  = cpu->regRaCm;
+    values[XjRegFlCm]  = cpu->regFlCm;
+    values[XjRegRaEcs] = cpu->regRaEcs;
+    values[XjRegFlEcs] = cpu->regFlEcs;
+    values[XjExitMode] = cpu->exitMode;
+    values[XjRegMa]    = cpu->regMa;
+    values[XjFlags]    = (cpu->isStopped ? XjStopped : 0) | (cpu->isMonitorMode ? XjMonitor : 0) | (cpu->exitCondition << 8);
+
+    for (i = 0; i < 8; i++)
+        {
+        values[XjRegA + i]         = cpu->regA[i];
+        values[XjRegB + i]         = cpu->regB[i];
+        values[XjRegX + 2 * i]     = (u32)(cpu->regX[i] >> 32);
+        values[XjRegX + 2 * i + 1] = (u32)(cpu->regX[i] & 0xFFFFFFFF);
+        }
+
+    for (i = 0; i < TraceExchangeParts; i++)
+        {
+        memset(parts + i, 0, sizeof(TraceExchangeRecord));
+        parts[i].seq     = seq;
+        parts[i].type    = TraceRecExchange;
+        parts[i].cpu     = (u8)cpu->id;
+        parts[i].part    = i;
+        parts[i].address = addr;
+        strncpy(parts[i].title, title, sizeof(parts[i].title) - 1);
+        memcpy(parts[i].value, values + i * TraceExchangeValues, sizeof(parts[i].value));
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Format the records of a traced exchange jump.
+**
+**  Parameters:     Name        Description.
+**                  fp          output file
+**                  parts       array of TraceExchangeParts records
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void traceFormatExchange(FILE *fp, TraceExchangeRecord *parts)
+    {
+    static char *label[] =
+        {
+        "P       %06o  ",
+        "RA      %06o  ",
+        "FL      %06o  ",
+        "RAE   %08o  ",
+        "FLE   %08o  ",
+        "EM/FL %08o  ",
+        "MA      %06o  ",
+        };
+    u32    values[TraceExchangeParts * TraceExchangeValues];
+    CpWord data;
+    u8     i;
+
+    for (i = 0; i < TraceExchangeParts; i++)
+        {
+        memcpy(values + i * TraceExchangeValues, parts[i].value, sizeof(parts[i].value));
+        }
+
+    fprintf(fp, "\n%06d Exchange jump with package address %06o (%.3s)\n\n", parts[0].seq, parts[0].address, parts[0].title);
+
+    for (i = 0; i < 7; i++)
+        {
+        fprintf(fp, label[i], values[XjRegP + i]);
+        fprintf(fp, "A%d %06o  ", i, values[XjRegA + i]);
+        fprintf(fp, "B%d %06o", i, values[XjRegB + i]);
+        fprintf(fp, "\n");
+        }
+
+    fprintf(fp, "STOP         %d  ", (values[XjFlags] & XjStopped) != 0 ? 1 : 0);
+    fprintf(fp, "A%d %06o  ", 7, values[XjRegA + 7]);
+    fprintf(fp, "B%d %06o  ", 7, values[XjRegB + 7]);
+    fprintf(fp, "\n");
+    fprintf(fp, "ECOND       %02o  ", (values[XjFlags] >> 8) & Mask8);
+    fprintf(fp, "\n");
+    fprintf(fp, "MonitorFlag %s", (values[XjFlags] & XjMonitor) != 0 ? "TRUE" : "FALSE");
+    fprintf(fp, "\n");
+    fprintf(fp, "\n");
+
+    for (i = 0; i < 8; i++)
+        {
+        fprintf(fp, "X%d ", i);
+        data = ((CpWord)values[XjRegX + 2 * i] << 32) | values[XjRegX + 2 * i + 1];
+        fprintf(fp, "%04o %04o %04o %04o %04o   ",
+                (PpWord)((data >> 48) & Mask12),
+                (PpWord)((data >> 36) & Mask12),
+                (PpWord)((data >> 24) & Mask12),
+                (PpWord)((data >> 12) & Mask12),
+                (PpWord)((data) & Mask12));
+        fprintf(fp, "\n");
+        }
+
+    fprintf(fp, "\n\n");
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Output opcode.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+u8 traceDisassembleOpcode(char *str, PpWord *pm)
+    {
+    u8     result = 1;
+    PpWord opCode;
+    u8     addrMode;
+    u8     opF;
+    u8     opD;
+
+    /*
+    **  Print opcode.
+    */
+    opCode   = *pm++;
+    opF      = opCode >> 6;
+    opD      = opCode & 077;
+    addrMode = ppDecode[opF].mode;
+
+    str += sprintf(str, "%3.3s  ", ppDecode[opF].mnemonic);
+
+    switch (addrMode)
+        {
+    case AN:
+        sprintf(str, "        ");
+        break;
+
+    case Amd:
+        sprintf(str, "%04o,%02o ", *pm, opD);
+        result = 2;
+        break;
+
+    case Ar:
+        if (opD < 040)
+            {
+            sprintf(str, "+%02o     ", opD);
+            }
+        else
+            {
+            sprintf(str, "-%02o     ", 077 - opD);
+            }
+        break;
+
+    case Ad:
+        sprintf(str, "%02o      ", opD);
+        break;
+
+    case Adm:
+        sprintf(str, "%02o%04o  ", opD, *pm);
+        result = 2;
+        break;
+        }
+
+    return (result);
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Print an A register.
+**
+**  Parameters:     Name        Description.
+**                  fp          output file
+**                  reg         register number
+**                  value       register value
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void traceFormatA(FILE *fp, u8 reg, u32 value)
+    {
+    fprintf(fp, "A%d=%06o    ", reg, value);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Print a B register.
+**
+**  Parameters:     Name        Description.
+**                  fp          output file
+**                  reg         register number
+**                  value       register value
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void traceFormatB(FILE *fp, u8 reg, u32 value)
+    {
+    fprintf(fp, "B%d=%06o    ", reg, value);
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Print an X register.
+**
+**  Parameters:     Name        Description.
+**                  fp          output file
+**                  reg         register number
+**                  value       register value
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void traceFormatX(FILE *fp, u8 reg, CpWord value)
+    {
+    fprintf(fp, "X%d=" FMT60_020o "   ", reg, value);
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
@@ -0,0 +1,258 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright (c) 2003-2011, Tom Hunter
+**
+**  Name: tracedec.c
+**
+**  Description:
+**      Offline decoder of the binary trace files (cpuN-S.trb, ppuNN-S.trb)
+**      written by the emulator when a trace trigger fires. The records
+**      are printed in the text format of the original execution trace.
+**
+**      Usage: tracedec <trace file> [<text file>]
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License version 3 as
+**  published by the Free Software Foundation.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License version 3 for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  version 3 along with this program in file "license-gpl-3.0.txt".
+**  If not, see <http://www.gnu.org/licenses/gpl-3.0.txt>.
+**
+**--------------------------------------------------------------------------
+*/
+
+/*
+**  -------------
+**  Include Files
+**  -------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "const.h"
+#include "types.h"
+#include "proto.h"
+
+/*
+**  -----------------
+**  Private Constants
+**  -----------------
+*/
+
+/*
+**  -----------------------
+**  Private Macro Functions
+**  -----------------------
+*/
+
+/*
+**  -----------------------------------------
+**  Private Typedef and Structure Definitions
+**  -----------------------------------------
+*/
+typedef union
+    {
+    TraceCpuRecord      op;
+    TraceExchangeRecord exchange;
+    } CpuEntry;
+
+/*
+**  ---------------------------
+**  Private Function Prototypes
+**  ---------------------------
+*/
+static void traceDecodeCpu(FILE *in, FILE *out);
+static void traceDecodePp(FILE *in, FILE *out);
+
+/*
+**  ----------------
+**  Public Variables
+**  ----------------
+*/
+
+/*
+**  -----------------
+**  Private Variables
+**  -----------------
+*/
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Public Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Decode a binary trace file.
+**
+**  Parameters:     Name        Description.
+**                  argc        argument count
+**                  argv        trace file and optional output file
+**
+**  Returns:        0 on success, 1 on error.
+**
+**------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+    {
+    TraceFileHeader header;
+    FILE            *in;
+    FILE            *out = stdout;
+
+    if ((argc < 2) || (argc > 3))
+        {
+        fprintf(stderr, "Usage: tracedec <trace file> [<text file>]\n");
+
+        return (1);
+        }
+
+    in = fopen(argv[1], "rb");
+    if (in == NULL)
+        {
+        fprintf(stderr, "(tracedec) Can't open %s\n", argv[1]);
+
+        return (1);
+        }
+
+    if ((fread(&header, sizeof(header), 1, in) != 1)
+        || (strcmp(header.magic, "DtTrace") != 0))
+        {
+        fprintf(stderr, "(tracedec) %s is not a DtCyber trace file\n", argv[1]);
+
+        return (1);
+        }
+
+    if (((header.unitType == TraceUnitCpu) && (header.recordSize != sizeof(CpuEntry)))
+        || ((header.unitType == TraceUnitPp) && (header.recordSize != sizeof(TracePpRecord)))
+        || ((header.unitType != TraceUnitCpu) && (header.unitType != TraceUnitPp)))
+        {
+        fprintf(stderr, "(tracedec) %s was written by an incompatible version of DtCyber\n", argv[1]);
+
+        return (1);
+        }
+
+    if (argc == 3)
+        {
+        out = fopen(argv[2], "wt");
+        if (out == NULL)
+            {
+            fprintf(stderr, "(tracedec) Can't open %s\n", argv[2]);
+
+            return (1);
+            }
+        }
+
+    if (header.unitType == TraceUnitCpu)
+        {
+        traceDecodeCpu(in, out);
+        }
+    else
+        {
+        traceDecodePp(in, out);
+        }
+
+    fclose(in);
+    fclose(out);
+
+    return (0);
+    }
+
+/*
+ **--------------------------------------------------------------------------
+ **
+ **  Private Functions
+ **
+ **--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Decode the records of a CPU trace file. An exchange
+**                  jump cut off at the start of the ring is skipped.
+**
+**  Parameters:     Name        Description.
+**                  in          trace file
+**                  out         text file
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void traceDecodeCpu(FILE *in, FILE *out)
+    {
+    CpuEntry            entry;
+    TraceExchangeRecord parts[TraceExchangeParts];
+    u8                  i;
+
+    while (fread(&entry, sizeof(entry), 1, in) == 1)
+        {
+        if (entry.op.type != TraceRecExchange)
+            {
+            traceFormatCpu(out, &entry.op);
+            continue;
+            }
+
+        if (entry.exchange.part != 0)
+            {
+            continue;
+            }
+
+        parts[0] = entry.exchange;
+        for (i = 1; i < TraceExchangeParts; i++)
+            {
+            if (fread(&entry, sizeof(entry), 1, in) != 1)
+                {
+                return;
+                }
+
+            parts[i] = entry.exchange;
+            }
+
+        traceFormatExchange(out, parts);
+        }
+    }
+
+/*--------------------------------------------------------------------------
+**  Purpose:        Decode the records of a PP trace file. An end record
+**                  whose start record was overwritten in the ring is
+**                  skipped.
+**
+**  Parameters:     Name        Description.
+**                  in          trace file
+**                  out         text file
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+static void traceDecodePp(FILE *in, FILE *out)
+    {
+    TracePpRecord record;
+    u8            lastType = 0;
+
+    while (fread(&record, sizeof(record), 1, in) == 1)
+        {
+        if ((record.type != TraceRecPpStart) && (lastType == 0))
+            {
+            continue;
+            }
+
+        traceFormatPp(out, &record);
+        lastType = record.type;
+        }
+
+    /*
+    **  Terminate the line of an instruction still executing when the
+    **  ring was written.
+    */
+    if (lastType == TraceRecPpStart)
+        {
+        fprintf(out, "\n");
+        }
+    }
+
+/*---------------------------  End Of File  ------------------------------*/
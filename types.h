@@ -98,10 +98,41 @@ typedef int bool;
 #include <stdbool.h>
 #endif
 
+/*
+**  Integer shared between CPU and PP threads and accessed only through
+**  atomic operations.
+*/
+#if defined(_WIN32)
+typedef volatile long AtomicInt;
+#else
+#include <stdatomic.h>
+typedef atomic_int AtomicInt;
+#endif
+
+/*
+**  Storage class of emulation state which is private to each host thread
+**  executing PPs (e.g. the active PP, channel and device).
+*/
+#if defined(_WIN32)
+#define ThreadLocal    __declspec(thread)
+#else
+#define ThreadLocal    __thread
+#endif
+
 typedef u16 PpWord;                     /* 12 bit PP word */
 typedef u8  PpByte;                     /* 6 bit PP word */
 typedef u64 CpWord;                     /* 60 bit CPU word */
 
+/*
+**  Asynchronous disk I/O request (opaque, see disk_io.c).
+*/
+typedef struct diskIoRequest DiskIoRequest;
+
+/*
+**  Block index of a TAP tape container (opaque, see tap_index.c).
+*/
+typedef struct tapIndex TapIndex;
+
 /*
 **  Format used in displaying status of data communication interfaces (operator interface).
 **
@@ -190,6 +221,7 @@ typedef struct chSlot
     u8      id;                         /* channel number */
     u8      delayStatus;                /* time to delay change of empty/full status */
     u8      delayDisconnect;            /* time to delay disconnect */
+    u32     events;                     /* count of state changes, wakes parked PPs */
     } ChSlot;
 
 /*
@@ -228,7 +260,7 @@ typedef struct
     u32           exitMode;             /* CPU exit mode (24 bit) */
     volatile bool isMonitorMode;        /* TRUE if CPU is in monitor mode */
     volatile bool isStopped;            /* TRUE if CPU is stopped */
-    volatile int  ppRequestingExchange; /* PP number of PP requesting exchange, -1 if none */
+    AtomicInt     ppRequestingExchange; /* PP number of PP requesting exchange, -1 if none, -2 if claimed */
     u32           ppExchangeAddress;    /* PP-requested exchange address */
     bool          doChangeMode;         /* TRUE if monitor mode flag should be changed by PP exchange jump */
     volatile bool isErrorExitPending;   /* TRUE if error exit pending */
@@ -249,8 +281,91 @@ typedef struct
     bool          iwValid[MaxIwStack];
     u8            iwRank;
     volatile u32 idleCycles;            /* Counter for how many times we've seen the idle loop */
+    volatile bool isIdle;               /* TRUE while the idle loop is seen */
+    /*
+    **  Predecoded instruction word cache.
+    */
+    struct cpuDecodedWord *decodeCache;
+    u32           opLocation;           /* Absolute CM address of current instruction word */
+    volatile u64  instructionCount;     /* Number of instructions executed */
+    volatile u64  decodeHits;           /* Number of decode cache hits */
+    volatile u64  decodeMisses;         /* Number of decode cache misses */
+    /*
+    **  Superblock cache of the threaded engine and the block word expected
+    **  to be executed next.
+    */
+    struct cpuBlock     *blockCache;
+    struct cpuBlockWord *blockWord;
+    /*
+    **  Exchange request statistics.
+    */
+    volatile u64  exchangesRequested;   /* Number of exchanges requested by PPs */
+    volatile u64  exchangesGranted;     /* Number of PP requested exchanges performed */
+    volatile u64  exchangesDeferred;    /* Number of exchanges deferred and retried later */
+    /*
+    **  ECS/UEM block transfer statistics.
+    */
+    volatile u64  extFastTransfers;     /* Number of block transfers validated once and copied in bulk */
+    volatile u64  extSlowTransfers;     /* Number of block transfers performed word by word */
     } CpuContext;
 
+/*
+**  Binary trace records. A PP instruction is traced as a start record
+**  taken before and an end record taken after it executes. All CPU
+**  records have the same size and start with seq, type and cpu.
+*/
+typedef struct tracePpRecord
+    {
+    u32    seq;                         /* trace sequence number */
+    u32    regA;                        /* register A */
+    PpWord regP;                        /* register P */
+    PpWord word1;                       /* opcode (start) or channel status (end) */
+    PpWord word2;                       /* word following the opcode (start) */
+    u8     type;                        /* TraceRecPpStart or TraceRecPpEnd */
+    u8     pp;                          /* PP number */
+    } TracePpRecord;
+
+typedef struct traceCpuRecord
+    {
+    u32    seq;                         /* trace sequence number */
+    u8     type;                        /* TraceRecCpuOp or TraceRecCpuStop */
+    u8     cpu;                         /* CPU number */
+    u8     opFm;                        /* opcode */
+    u8     opI;                         /* i */
+    u8     opJ;                         /* j */
+    u8     opK;                         /* k */
+    u8     spare[2];
+    u32    p;                           /* address of instruction word */
+    u32    opAddress;                   /* K */
+    u32    regA[2];                     /* Ai, Aj after execution */
+    u32    regB[3];                     /* Bi, Bj, Bk after execution */
+    CpWord regX[3];                     /* Xi, Xj, Xk after execution */
+    } TraceCpuRecord;
+
+typedef struct traceExchangeRecord
+    {
+    u32    seq;                         /* trace sequence number */
+    u8     type;                        /* TraceRecExchange */
+    u8     cpu;                         /* CPU number */
+    u8     part;                        /* part of exchange package */
+    u8     spare;
+    u32    address;                     /* exchange package address */
+    char   title[4];                    /* "Old" or "New" */
+    u32    value[TraceExchangeValues];  /* slice of exchange package */
+    } TraceExchangeRecord;
+
+/*
+**  Header of a binary trace file.
+*/
+typedef struct traceFileHeader
+    {
+    char   magic[8];                    /* "DtTrace" */
+    u32    recordSize;                  /* size of each record */
+    u32    unitType;                    /* TraceUnitCpu or TraceUnitPp */
+    u32    unit;                        /* CPU or PP number */
+    u32    spare;
+    } TraceFileHeader;
+
 /*
 **  Model specific feature set.
 */
@@ -297,6 +412,12 @@ typedef enum
     ESM
     } ExtMemory;
 
+typedef enum
+    {
+    CpuEngineClassic,
+    CpuEngineThreaded
+    } CpuEngine;
+
 typedef enum 
     {   
     SwCCP = 0,
@@ -265,6 +265,20 @@ void windowQueue(u8 ch)
     currentX += currentFont;
     }
 
+/*--------------------------------------------------------------------------
+**  Purpose:        Mark the end of a console display refresh cycle.
+**                  Nothing to do, the Windows display list is not
+**                  double buffered.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void windowFrameEnd(void)
+    {
+    }
+
 /*--------------------------------------------------------------------------
 **  Purpose:        Terminate console window.
 **
@@ -673,6 +687,11 @@ static LRESULT CALLBACK windowProcedure(HWND hWnd, UINT message, WPARAM wParam,
             traceMask ^= TraceExchange;
             break;
 
+        case 'T':
+        case 't':
+            traceTrigger(TraceTriggerManual);
+            break;
+
         case 'X':
         case 'x':
             if (traceMask == 0)
@@ -818,7 +837,7 @@ void windowDisplay(HWND hWnd)
                 refreshCount++,
                 ppu[0].regP, ppu[1].regP, ppu[2].regP, ppu[3].regP, ppu[4].regP,
                 ppu[5].regP, ppu[6].regP, ppu[7].regP, ppu[8].regP, ppu[9].regP,
-                cpu.regP);
+                cpus[0].regP);
 
         sprintf(buf + strlen(buf), "   Trace0x: %c%c%c%c%c%c%c%c%c%c%c%c %c",
                 (traceMask >> 0) & 1 ? '0' : '_',
@@ -47,6 +47,8 @@
 **  -----------------
 */
 #define ListSize           5000
+#define ListCount          3
+#define ListFresh          4
 #define FrameTime          100000
 #define FramesPerSecond    (1000000 / FrameTime)
 
@@ -69,6 +71,15 @@ typedef struct dispList
     u8  ch;                         /* character to be displayed */
     } DispList;
 
+/*
+**  Display list holding one frame.
+*/
+typedef struct dispFrame
+    {
+    u32      listEnd;               /* number of entries used */
+    DispList list[ListSize];        /* display list */
+    } DispFrame;
+
 /*
 **  ---------------------------
 **  Private Function Prototypes
@@ -91,21 +102,30 @@ static volatile bool   displayActive = FALSE;
 static u8              currentFont;
 static i16             currentX;
 static i16             currentY;
-static DispList        display[ListSize];
 static pthread_t       displayThread;
-static u32             listEnd;
 static Font            hSmallFont;
 static Font            hMediumFont;
 static Font            hLargeFont;
 static int             width;
 static int             height;
-static pthread_mutex_t mutexDisplay;
 static Display         *disp;
 static Window          window;
 static u8              *lpClipToKeyboard    = NULL;
 static u8              *lpClipToKeyboardPtr = NULL;
 static u8              clipToKeyboardDelay  = 0;
 
+/*
+**  Triple buffered display lists. The emulation thread fills one frame
+**  while the window thread draws another; the third holds the most
+**  recently completed frame. Frames change hands only through an atomic
+**  exchange of readyFrame, so neither thread ever waits for the other.
+**  readyFrame carries ListFresh while its frame has not yet been drawn.
+*/
+static DispFrame       frames[ListCount];
+static DispFrame       *fillFrame;
+static AtomicInt       readyFrame;
+static volatile bool   frameRequested = FALSE;
+
 /*
  **--------------------------------------------------------------------------
  **
@@ -129,14 +149,12 @@ void windowInit(void)
     pthread_attr_t attr;
 
     /*
-    **  Create display list pool.
+    **  Create display list pool. Frame 0 is filled first, frame 1 is the
+    **  (empty) ready frame and frame 2 is initially owned by the window
+    **  thread.
     */
-    listEnd = 0;
-
-    /*
-    **  Create a mutex to synchronise access to display list.
-    */
-    pthread_mutex_init(&mutexDisplay, NULL);
+    fillFrame = frames + 0;
+    atomic_store(&readyFrame, 1);
 
     /*
     **  Create POSIX thread with default attributes.
@@ -202,21 +220,26 @@ void windowQueue(u8 ch)
     {
     DispList *elem;
 
-    if ((listEnd >= ListSize)
+    /*
+    **  Hand over what has been queued so far if the window thread has
+    **  been waiting for a frame for too long (e.g. the console driver
+    **  never polls the keyboard).
+    */
+    if (frameRequested)
+        {
+        windowFrameEnd();
+        }
+
+    if ((fillFrame->listEnd >= ListSize)
         || (currentX == -1)
         || (currentY == -1))
         {
         return;
         }
 
-    /*
-    **  Protect display list.
-    */
-    pthread_mutex_lock(&mutexDisplay);
-
     if (ch != 0)
         {
-        elem           = display + listEnd++;
+        elem           = fillFrame->list + fillFrame->listEnd++;
         elem->ch       = ch;
         elem->fontSize = currentFont;
         elem->xPos     = currentX;
@@ -224,11 +247,26 @@ void windowQueue(u8 ch)
         }
 
     currentX += currentFont;
+    }
 
-    /*
-    **  Release display list.
-    */
-    pthread_mutex_unlock(&mutexDisplay);
+/*--------------------------------------------------------------------------
+**  Purpose:        Mark the end of a console display refresh cycle. The
+**                  completed frame becomes the one drawn next and a
+**                  fresh display list is started.
+**
+**  Parameters:     Name        Description.
+**
+**  Returns:        Nothing.
+**
+**------------------------------------------------------------------------*/
+void windowFrameEnd(void)
+    {
+    int prev;
+
+    prev               = atomic_exchange(&readyFrame, (int)(fillFrame - frames) | ListFresh);
+    fillFrame          = frames + (prev & ~ListFresh);
+    fillFrame->listEnd = 0;
+    frameRequested     = FALSE;
     }
 
 /*--------------------------------------------------------------------------
@@ -272,6 +310,7 @@ void *windowThread(void *param)
     XColor            c;
     DispList          *curr;
     int               depth;
+    DispFrame         *drawFrame;
     DispList          *end;
     XEvent            event;
     unsigned long     fg;
@@ -288,6 +327,7 @@ void *windowThread(void *param)
     unsigned long     retRemaining;
     int               retStatus;
     int               screen;
+    int               staleCount = 0;
     char              str[2] = " ";
     Atom              targetProperty;
     char              text[30];
@@ -394,7 +434,8 @@ void *windowThread(void *param)
     /*
     **  Window thread loop.
     */
-    isMeta = FALSE;
+    isMeta    = FALSE;
+    drawFrame = frames + 2;
 
     while (displayActive)
         {
@@ -526,6 +567,10 @@ void *windowThread(void *param)
                             traceMask ^= (1 << 15);
                             break;
 
+                        case 't':
+                            traceTrigger(TraceTriggerManual);
+                            break;
+
                         case 'x':
                             if (traceMask == 0)
                                 {
@@ -634,7 +679,7 @@ void *windowThread(void *param)
                     refreshCount++,
                     ppu[0].regP, ppu[1].regP, ppu[2].regP, ppu[3].regP, ppu[4].regP,
                     ppu[5].regP, ppu[6].regP, ppu[7].regP, ppu[8].regP, ppu[9].regP,
-                    cpu.regP);
+                    cpus[0].regP);
 
             sprintf(buf + strlen(buf), "   Trace: %c%c%c%c%c%c%c%c%c%c%c%c",
                     (traceMask >> 0) & 1 ? '0' : '_',
@@ -676,9 +721,19 @@ void *windowThread(void *param)
             }
 
         /*
-        **  Protect display list.
+        **  Pick up the latest completed frame. If there is none, draw the
+        **  previous one again and after a while ask the emulation thread
+        **  to hand over whatever it has queued.
         */
-        pthread_mutex_lock(&mutexDisplay);
+        if ((atomic_load(&readyFrame) & ListFresh) != 0)
+            {
+            drawFrame  = frames + (atomic_exchange(&readyFrame, (int)(drawFrame - frames)) & ~ListFresh);
+            staleCount = 0;
+            }
+        else if (++staleCount >= 2)
+            {
+            frameRequested = TRUE;
+            }
 
         if (usageDisplayCount != 0)
             {
@@ -691,17 +746,18 @@ void *windowThread(void *param)
             oldFont = FontMedium;
             XDrawString(disp, pixmap, gc, 20, 256, usageMessage1, strlen(usageMessage1));
             XDrawString(disp, pixmap, gc, 20, 275, usageMessage2, strlen(usageMessage2));
-            listEnd            = 0;
             usageDisplayCount -= 1;
+            end = drawFrame->list;
+            }
+        else
+            {
+            end = drawFrame->list + drawFrame->listEnd;
             }
 
         /*
         **  Draw display list in pixmap.
         */
-        curr = display;
-        end  = display + listEnd;
-
-        for (curr = display; curr < end; curr++)
+        for (curr = drawFrame->list; curr < end; curr++)
             {
             /*
             **  Setup new font if necessary.
@@ -740,15 +796,6 @@ void *windowThread(void *param)
                 }
             }
 
-        listEnd  = 0;
-        currentX = -1;
-        currentY = -1;
-
-        /*
-        **  Release display list.
-        */
-        pthread_mutex_unlock(&mutexDisplay);
-
         /*
         **  Update display from pixmap.
         */
@@ -776,7 +823,6 @@ void *windowThread(void *param)
     XFreePixmap(disp, pixmap);
     XDestroyWindow(disp, window);
     XCloseDisplay(disp);
-    pthread_mutex_destroy(&mutexDisplay);
     pthread_exit(NULL);
     }
 